@@ -0,0 +1,514 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+#include <string.h>
+#include <gdk/gdk.h>
+#ifdef HAVE_LIBX11
+#  include <gdk/gdkx.h>
+#  include <X11/Xlib.h>
+#  include <X11/Xatom.h>
+#  include <X11/Xutil.h>
+#endif
+#include <libxfce4util/libxfce4util.h>
+#include "autoswitch.h"
+#include "parser.h"
+#include "util.h"
+
+/* seconds a new rule has to hold */
+#define AUTOSWITCH_DWELL 15
+
+typedef enum
+{
+   FIELD_CLASS,
+   FIELD_TITLE,
+   FIELDS
+} Field;
+
+typedef struct
+{
+   Field field;
+   gchar *target;             /* what gets tracked, as written */
+   gchar *name;               /* casefolded */
+   gchar *category;           /* casefolded, NULL for any */
+   GRegex *own;               /* has groups of its own, matched alone */
+} Rule;
+
+struct _HamsterAutoSwitch
+{
+   HamsterAutoSwitchFire fire;
+   gpointer data;
+   GPtrArray *rules;          /* Rule* */
+   GRegex *matchers[FIELDS];  /* NULL if no rule of that kind */
+   gchar *running;            /* casefolded name */
+   gchar *runningCategory;    /* casefolded, "" for none */
+   gint pending;              /* rule waiting out the dwell, -1 for none */
+   guint source;
+#ifdef HAVE_LIBX11
+   GdkDisplay *display;       /* while watching */
+   Window active;
+   Atom netActive;
+   Atom netName;
+   Atom utf8;
+#endif
+};
+
+/* Rules */
+
+static void
+autoswitch_rule_free(Rule *rule)
+{
+   g_free(rule->target);
+   g_free(rule->name);
+   g_free(rule->category);
+   if(rule->own)
+      g_regex_unref(rule->own);
+   g_free(rule);
+}
+
+static void
+autoswitch_rules_clear(HamsterAutoSwitch *self)
+{
+   gint i;
+
+   g_ptr_array_set_size(self->rules, 0);
+   for(i = 0; i < FIELDS; i++)
+      g_clear_pointer(&self->matchers[i], g_regex_unref);
+}
+
+/* "^(?:(?<r0>.*?(?:p0))|(?<r3>.*?(?:p3))...)", the anchor makes every
+ * alternative start at 0 so the first rule that matches anywhere wins */
+static GRegex*
+autoswitch_compile(GString *alternatives)
+{
+   GError *error = NULL;
+   GRegex *regex;
+   gchar *pattern;
+
+   if(!alternatives->len)
+      return NULL;
+   pattern = g_strdup_printf("^(?:%s)", alternatives->str);
+   regex = g_regex_new(pattern, G_REGEX_CASELESS | G_REGEX_OPTIMIZE
+         | G_REGEX_DUPNAMES, 0, &error);
+   if(!regex)
+   {
+      g_warning("%s", error->message);
+      g_error_free(error);
+   }
+   g_free(pattern);
+   return regex;
+}
+
+static void
+autoswitch_rules_parse(HamsterAutoSwitch *self, const gchar *rules)
+{
+   GString *alternatives[FIELDS];
+   gchar **lines = g_strsplit(rules ? rules : "", "\n", -1);
+   gchar **line;
+   time_t now = util_local_now();
+   gint i;
+
+   for(i = 0; i < FIELDS; i++)
+      alternatives[i] = g_string_new(NULL);
+   for(line = lines; *line; line++)
+   {
+      gchar *text = g_strstrip(*line), *arrow, *pattern;
+      Field field = FIELD_TITLE;
+      GRegex *check;
+      GError *error = NULL;
+      fact_spec spec;
+      Rule *rule;
+
+      if(!*text || *text == '#' || !(arrow = g_strrstr(text, "=>")))
+         continue;
+      *arrow = '\0';
+      pattern = text;
+      if(g_str_has_prefix(pattern, "class:"))
+      {
+         field = FIELD_CLASS;
+         pattern += 6;
+      }
+      else if(g_str_has_prefix(pattern, "title:"))
+         pattern += 6;
+      pattern = g_strstrip(pattern);
+      arrow = g_strstrip(arrow + 2);
+      if(!*pattern || !*arrow)
+         continue;
+
+      /* a bad pattern would spoil the combined expression */
+      if(!(check = g_regex_new(pattern, G_REGEX_CASELESS, 0, NULL)))
+      {
+         g_warning("autoswitch: bad pattern '%s'", pattern);
+         continue;
+      }
+      if(!fact_spec_parse(&spec, arrow, now, &error))
+      {
+         g_warning("autoswitch: '%s': %s", arrow, error->message);
+         g_error_free(error);
+         g_regex_unref(check);
+         continue;
+      }
+
+      rule = g_new0(Rule, 1);
+      rule->field = field;
+      rule->target = g_strdup(arrow);
+      rule->name = g_utf8_casefold(spec.name, -1);
+      rule->category = spec.category ? g_utf8_casefold(spec.category, -1) : NULL;
+      fact_spec_clear(&spec);
+      /* groups of its own would renumber the combined expression's and
+       * send backreferences astray */
+      if(g_regex_get_capture_count(check))
+         rule->own = check;
+      else
+      {
+         g_string_append_printf(alternatives[field], "%s(?<r%u>.*?(?:%s))",
+               alternatives[field]->len ? "|" : "", self->rules->len, pattern);
+         g_regex_unref(check);
+      }
+      g_ptr_array_add(self->rules, rule);
+   }
+   for(i = 0; i < FIELDS; i++)
+   {
+      self->matchers[i] = autoswitch_compile(alternatives[i]);
+      g_string_free(alternatives[i], TRUE);
+   }
+   g_strfreev(lines);
+   DBG("%u rules", self->rules->len);
+}
+
+static gint
+autoswitch_match_field(HamsterAutoSwitch *self, Field field, const gchar *text)
+{
+   GMatchInfo *info;
+   gint rule = -1;
+   guint i;
+
+   if(!text)
+      return -1;
+   if(self->matchers[field] && g_regex_match(self->matchers[field], text, 0, &info))
+   {
+      for(i = 0; i < self->rules->len && rule < 0; i++)
+      {
+         const Rule *r = g_ptr_array_index(self->rules, i);
+         gchar name[16];
+         gint start = -1;
+
+         if(r->field != field || r->own)
+            continue;
+         g_snprintf(name, sizeof(name), "r%u", i);
+         if(g_match_info_fetch_named_pos(info, name, &start, NULL) && start >= 0)
+            rule = i;
+      }
+   }
+   if(self->matchers[field])
+      g_match_info_free(info);
+   /* the rules matched alone, as far as they come first */
+   for(i = 0; i < self->rules->len && (rule < 0 || i < (guint)rule); i++)
+   {
+      const Rule *r = g_ptr_array_index(self->rules, i);
+
+      if(r->field == field && r->own && g_regex_match(r->own, text, 0, NULL))
+         rule = i;
+   }
+   return rule;
+}
+
+gint
+hamster_autoswitch_match(HamsterAutoSwitch *self, const gchar *wmclass,
+                         const gchar *title)
+{
+   gint byClass = autoswitch_match_field(self, FIELD_CLASS, wmclass);
+   gint byTitle = autoswitch_match_field(self, FIELD_TITLE, title);
+
+   if(byClass < 0)
+      return byTitle;
+   if(byTitle < 0)
+      return byClass;
+   return MIN(byClass, byTitle);
+}
+
+/* Hysteresis */
+
+static gboolean
+autoswitch_cb_dwell(HamsterAutoSwitch *self)
+{
+   const gchar *activity = ((Rule*)g_ptr_array_index(self->rules,
+         self->pending))->target;
+
+   self->source = 0;
+   self->pending = -1;
+   DBG("switching to %s", activity);
+   self->fire(activity, self->data);
+   return FALSE;
+}
+
+static void
+autoswitch_cancel(HamsterAutoSwitch *self)
+{
+   if(self->source)
+      g_source_remove(self->source);
+   self->source = 0;
+   self->pending = -1;
+}
+
+static gboolean
+autoswitch_is_running(HamsterAutoSwitch *self, gint rule)
+{
+   const Rule *r = g_ptr_array_index(self->rules, rule);
+
+   /* a rule without category takes the activity in any */
+   return self->running && !strcmp(r->name, self->running)
+      && (!r->category || !strcmp(r->category, self->runningCategory));
+}
+
+static void
+autoswitch_consider(HamsterAutoSwitch *self, gint rule)
+{
+   if(rule == self->pending)
+      return;
+   /* whatever pends no longer has the focus */
+   autoswitch_cancel(self);
+   /* nothing matches, or flipped back before the dwell was over */
+   if(rule < 0 || autoswitch_is_running(self, rule))
+      return;
+   self->pending = rule;
+   self->source = g_timeout_add_seconds(AUTOSWITCH_DWELL,
+         (GSourceFunc)autoswitch_cb_dwell, self);
+}
+
+/* X11 */
+
+#ifdef HAVE_LIBX11
+static gchar*
+autoswitch_window_title(HamsterAutoSwitch *self, Display *dpy, Window w)
+{
+   Atom type;
+   gint format;
+   gulong n, after;
+   guchar *data = NULL;
+   gchar *title = NULL, *name = NULL;
+
+   if(XGetWindowProperty(dpy, w, self->netName, 0, 1024, False, self->utf8,
+            &type, &format, &n, &after, &data) == Success && data)
+   {
+      if(type == self->utf8 && format == 8)
+         title = g_strndup((gchar*)data, n);
+      XFree(data);
+   }
+   if(!title && XFetchName(dpy, w, &name) && name)
+   {
+      title = g_locale_to_utf8(name, -1, NULL, NULL, NULL);
+      XFree(name);
+   }
+   return title;
+}
+
+static void
+autoswitch_check(HamsterAutoSwitch *self)
+{
+   Display *dpy = GDK_DISPLAY_XDISPLAY(self->display);
+   XClassHint hint = { NULL, NULL };
+   gchar *wmclass = NULL, *title;
+
+   if(!self->active)
+   {
+      autoswitch_cancel(self);
+      return;
+   }
+   gdk_x11_display_error_trap_push(self->display);
+   if(XGetClassHint(dpy, self->active, &hint))
+   {
+      wmclass = g_strdup_printf("%s %s", hint.res_name ? hint.res_name : "",
+            hint.res_class ? hint.res_class : "");
+      XFree(hint.res_name);
+      XFree(hint.res_class);
+   }
+   title = autoswitch_window_title(self, dpy, self->active);
+   gdk_x11_display_error_trap_pop_ignored(self->display);
+
+   autoswitch_consider(self, hamster_autoswitch_match(self, wmclass, title));
+   g_free(wmclass);
+   g_free(title);
+}
+
+/* our own windows are left alone, GDK owns their event masks */
+static gboolean
+autoswitch_is_foreign(HamsterAutoSwitch *self, Window w)
+{
+   return w && !gdk_x11_window_lookup_for_display(self->display, w);
+}
+
+static void
+autoswitch_follow(HamsterAutoSwitch *self)
+{
+   Display *dpy = GDK_DISPLAY_XDISPLAY(self->display);
+   Window root = GDK_ROOT_WINDOW(), active = None;
+   Atom type;
+   gint format;
+   gulong n, after;
+   guchar *data = NULL;
+
+   gdk_x11_display_error_trap_push(self->display);
+   if(XGetWindowProperty(dpy, root, self->netActive, 0, 1, False, XA_WINDOW,
+            &type, &format, &n, &after, &data) == Success && data)
+   {
+      if(type == XA_WINDOW && format == 32 && n == 1)
+         active = *(Window*)data;
+      XFree(data);
+   }
+   if(active != self->active)
+   {
+      if(autoswitch_is_foreign(self, self->active))
+         XSelectInput(dpy, self->active, NoEventMask);
+      self->active = autoswitch_is_foreign(self, active) ? active : None;
+      if(self->active)
+         XSelectInput(dpy, self->active, PropertyChangeMask);
+   }
+   gdk_x11_display_error_trap_pop_ignored(self->display);
+   autoswitch_check(self);
+}
+
+static GdkFilterReturn
+autoswitch_cb_filter(GdkXEvent *gxev, GdkEvent *event, HamsterAutoSwitch *self)
+{
+   XEvent *xev = gxev;
+
+   if(xev->type != PropertyNotify)
+      return GDK_FILTER_CONTINUE;
+   if(xev->xproperty.atom == self->netActive
+         && xev->xproperty.window == GDK_ROOT_WINDOW())
+      autoswitch_follow(self);
+   else if(xev->xproperty.window == self->active && self->active
+         && (xev->xproperty.atom == self->netName
+            || xev->xproperty.atom == XA_WM_NAME))
+      autoswitch_check(self);
+   return GDK_FILTER_CONTINUE;
+}
+
+static void
+autoswitch_watch(HamsterAutoSwitch *self)
+{
+   GdkDisplay *display = gdk_display_get_default();
+   GdkWindow *root;
+
+   if(self->display)
+   {
+      /* new rules for the same window */
+      autoswitch_check(self);
+      return;
+   }
+   if(!GDK_IS_X11_DISPLAY(display))
+   {
+      DBG("not on X11, rules are ignored");
+      return;
+   }
+   self->display = display;
+   self->netActive = gdk_x11_get_xatom_by_name_for_display(display,
+         "_NET_ACTIVE_WINDOW");
+   self->netName = gdk_x11_get_xatom_by_name_for_display(display,
+         "_NET_WM_NAME");
+   self->utf8 = gdk_x11_get_xatom_by_name_for_display(display, "UTF8_STRING");
+   root = gdk_get_default_root_window();
+   gdk_window_set_events(root, gdk_window_get_events(root)
+         | GDK_PROPERTY_CHANGE_MASK);
+   /* NULL sees the events of foreign windows too */
+   gdk_window_add_filter(NULL, (GdkFilterFunc)autoswitch_cb_filter, self);
+   autoswitch_follow(self);
+}
+
+static void
+autoswitch_unwatch(HamsterAutoSwitch *self)
+{
+   if(!self->display)
+      return;
+   gdk_window_remove_filter(NULL, (GdkFilterFunc)autoswitch_cb_filter, self);
+   gdk_x11_display_error_trap_push(self->display);
+   if(autoswitch_is_foreign(self, self->active))
+      XSelectInput(GDK_DISPLAY_XDISPLAY(self->display), self->active,
+            NoEventMask);
+   gdk_x11_display_error_trap_pop_ignored(self->display);
+   self->active = None;
+   self->display = NULL;
+}
+#else
+static void
+autoswitch_watch(HamsterAutoSwitch *self)
+{
+   DBG("built without X11, rules are ignored");
+}
+
+static void
+autoswitch_unwatch(HamsterAutoSwitch *self)
+{
+}
+#endif
+
+/* Public */
+
+HamsterAutoSwitch*
+hamster_autoswitch_new(HamsterAutoSwitchFire fire, gpointer data)
+{
+   HamsterAutoSwitch *self = g_new0(HamsterAutoSwitch, 1);
+
+   self->fire = fire;
+   self->data = data;
+   self->rules = g_ptr_array_new_with_free_func(
+         (GDestroyNotify)autoswitch_rule_free);
+   self->pending = -1;
+   return self;
+}
+
+void
+hamster_autoswitch_free(HamsterAutoSwitch *self)
+{
+   if(!self)
+      return;
+   autoswitch_unwatch(self);
+   autoswitch_cancel(self);
+   autoswitch_rules_clear(self);
+   g_ptr_array_unref(self->rules);
+   g_free(self->running);
+   g_free(self->runningCategory);
+   g_free(self);
+}
+
+void
+hamster_autoswitch_set_rules(HamsterAutoSwitch *self, const gchar *rules)
+{
+   autoswitch_cancel(self);
+   autoswitch_rules_clear(self);
+   autoswitch_rules_parse(self, rules);
+   if(self->rules->len)
+      autoswitch_watch(self);
+   else
+      autoswitch_unwatch(self);
+}
+
+void
+hamster_autoswitch_set_running(HamsterAutoSwitch *self, const gchar *name,
+                               const gchar *category)
+{
+   g_free(self->running);
+   g_free(self->runningCategory);
+   self->running = name ? g_utf8_casefold(name, -1) : NULL;
+   self->runningCategory = g_utf8_casefold(category ? category : "", -1);
+   if(self->pending >= 0 && autoswitch_is_running(self, self->pending))
+      autoswitch_cancel(self);
+}
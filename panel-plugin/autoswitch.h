@@ -0,0 +1,63 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <glib.h>
+
+/*
+ * Switches the activity by the focused window. Rules come one per line:
+ *
+ *   class:PATTERN => activity[@category][, description][ #tag...]
+ *   title:PATTERN => activity[@category][, description][ #tag...]
+ *
+ * PATTERN is a case-insensitive regular expression, a line without prefix
+ * matches the title and lines starting with '#' are comments. The first
+ * matching rule wins. All patterns of a kind are compiled into one
+ * expression, so a focus change costs two matches; patterns with groups of
+ * their own are matched one by one. A rule whose activity already runs,
+ * in its category or in any if it names none, doesn't switch.
+ *
+ * Focus changes come from _NET_ACTIVE_WINDOW property events, titles are
+ * followed on the focused window the same way. A switch only happens once
+ * the new rule has held for a while, and a window no rule matches keeps
+ * things as they are.
+ */
+typedef struct _HamsterAutoSwitch HamsterAutoSwitch;
+
+typedef void (*HamsterAutoSwitchFire)(const gchar *activity, gpointer data);
+
+HamsterAutoSwitch*
+hamster_autoswitch_new(HamsterAutoSwitchFire fire, gpointer data);
+
+void
+hamster_autoswitch_free(HamsterAutoSwitch *self);
+
+/* empty or NULL stops watching */
+void
+hamster_autoswitch_set_rules(HamsterAutoSwitch *self, const gchar *rules);
+
+/* the activity being tracked, name NULL if none; a rule for it cancels
+ * a pending switch */
+void
+hamster_autoswitch_set_running(HamsterAutoSwitch *self, const gchar *name,
+                               const gchar *category);
+
+/* index of the first matching rule, -1 for none */
+gint
+hamster_autoswitch_match(HamsterAutoSwitch *self, const gchar *wmclass,
+                         const gchar *title);
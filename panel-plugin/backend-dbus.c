@@ -0,0 +1,585 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+#include <time.h>
+#include <gio/gio.h>
+#include <libxfce4util/libxfce4util.h>
+#include "backend.h"
+#include "hamster.h"
+#include "windowserver.h"
+#include "trace.h"
+
+typedef struct
+{
+   HamsterBackend  parent;
+   Hamster        *hamster;
+   WindowServer   *windowserver;
+   gboolean        json;      /* the daemon has the JSON methods */
+   GCancellable   *probe;     /* asking it which it has */
+   HamsterTrace   *trace;     /* recording, see trace.h */
+} DBusBackend;
+
+#define DBUS_BACKEND(b) ((DBusBackend*)(b))
+
+/* all or nothing, they came in together */
+static const gchar *dbus_backend_json_methods[] =
+{
+   "GetTodaysFactsJSON", "GetFactsJSON", "GetFactJSON"
+};
+
+static gboolean
+dbus_backend_ready(DBusBackend *self, GError **error)
+{
+   if(self->hamster)
+      return TRUE;
+   g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_NOT_CONNECTED,
+         "org.gnome.Hamster is not available");
+   return FALSE;
+}
+
+static gboolean
+dbus_backend_windows_ready(DBusBackend *self, GError **error)
+{
+   if(self->windowserver)
+      return TRUE;
+   g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_NOT_CONNECTED,
+         "org.gnome.Hamster.WindowServer is not available");
+   return FALSE;
+}
+
+/* the JSON replies are taken apart by hand: the generated wrappers would
+ * copy them into a strv only for fact_new() to read each string once */
+static GVariant*
+dbus_backend_json_reply(GVariant *ret)
+{
+   GVariant *res = g_variant_get_child_value(ret, 0);
+   g_variant_unref(ret);
+   return res;
+}
+
+/* NULL if the tuple method has to answer instead */
+static GVariant*
+dbus_backend_call_json(DBusBackend *self, const gchar *method,
+                       GVariant *args)
+{
+   GError *error = NULL;
+   GVariant *ret;
+
+   if(!self->json)
+   {
+      if(args)
+         g_variant_unref(g_variant_ref_sink(args));
+      return NULL;
+   }
+   ret = g_dbus_proxy_call_sync(G_DBUS_PROXY(self->hamster), method, args,
+         G_DBUS_CALL_FLAGS_NONE, -1, NULL, &error);
+   if(ret)
+      return dbus_backend_json_reply(ret);
+   DBG("%s: %s", method, error->message);
+   if(g_error_matches(error, G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_METHOD))
+      self->json = FALSE;
+   g_error_free(error);
+   return NULL;
+}
+
+static GVariant*
+dbus_backend_get_todays_facts(HamsterBackend *backend, GError **error)
+{
+   DBusBackend *self = DBUS_BACKEND(backend);
+   GVariant *res = NULL;
+
+   if(!dbus_backend_ready(self, error))
+      return NULL;
+   res = dbus_backend_call_json(self, "GetTodaysFactsJSON", NULL);
+   if(!res)
+      hamster_call_get_todays_facts_sync(self->hamster, &res, NULL, error);
+   return res;
+}
+
+static void
+dbus_backend_cb_todays_facts(Hamster *proxy, GAsyncResult *result, GTask *task)
+{
+   GVariant *res = NULL;
+   GError *error = NULL;
+
+   if(hamster_call_get_todays_facts_finish(proxy, &res, result, &error))
+      g_task_return_pointer(task, res, (GDestroyNotify)g_variant_unref);
+   else
+      g_task_return_error(task, error);
+   g_object_unref(task);
+}
+
+/* falls back to the tuple method on anything but cancellation */
+static void
+dbus_backend_cb_todays_facts_json(GDBusProxy *proxy, GAsyncResult *result,
+                                  GTask *task)
+{
+   GVariant *ret;
+   GError *error = NULL;
+
+   ret = g_dbus_proxy_call_finish(proxy, result, &error);
+   if(ret)
+   {
+      g_task_return_pointer(task, dbus_backend_json_reply(ret),
+            (GDestroyNotify)g_variant_unref);
+      g_object_unref(task);
+      return;
+   }
+   if(g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+   {
+      g_task_return_error(task, error);
+      g_object_unref(task);
+      return;
+   }
+   DBG("GetTodaysFactsJSON: %s", error->message);
+   g_error_free(error);
+   hamster_call_get_todays_facts(HAMSTER(proxy), g_task_get_cancellable(task),
+         (GAsyncReadyCallback)dbus_backend_cb_todays_facts, task);
+}
+
+static void
+dbus_backend_get_todays_facts_async(HamsterBackend *backend, GTask *task)
+{
+   DBusBackend *self = DBUS_BACKEND(backend);
+   GError *error = NULL;
+
+   if(!dbus_backend_ready(self, &error))
+   {
+      g_task_return_error(task, error);
+      g_object_unref(task);
+      return;
+   }
+   /* the call holds the proxy, so freeing us meanwhile is fine */
+   if(self->json)
+      g_dbus_proxy_call(G_DBUS_PROXY(self->hamster), "GetTodaysFactsJSON",
+            NULL, G_DBUS_CALL_FLAGS_NONE, -1, g_task_get_cancellable(task),
+            (GAsyncReadyCallback)dbus_backend_cb_todays_facts_json, task);
+   else
+      hamster_call_get_todays_facts(self->hamster, g_task_get_cancellable(task),
+            (GAsyncReadyCallback)dbus_backend_cb_todays_facts, task);
+}
+
+static GVariant*
+dbus_backend_get_facts(HamsterBackend *backend, guint start_date,
+                       guint end_date, const gchar *search, GError **error)
+{
+   DBusBackend *self = DBUS_BACKEND(backend);
+   GVariant *res = NULL;
+   gchar range[32];
+   time_t start = start_date, end = end_date;
+   struct tm from, to;
+
+   if(!dbus_backend_ready(self, error))
+      return NULL;
+   /* both days inclusive, like start_date and end_date */
+   gmtime_r(&start, &from);
+   gmtime_r(&end, &to);
+   g_snprintf(range, sizeof(range), "%04d-%02d-%02d - %04d-%02d-%02d",
+         from.tm_year + 1900, from.tm_mon + 1, from.tm_mday,
+         to.tm_year + 1900, to.tm_mon + 1, to.tm_mday);
+   res = dbus_backend_call_json(self, "GetFactsJSON",
+         g_variant_new("(ss)", range, search));
+   if(!res)
+      hamster_call_get_facts_sync(self->hamster, start_date, end_date, search,
+            &res, NULL, error);
+   return res;
+}
+
+static GVariant*
+dbus_backend_get_activities(HamsterBackend *backend, const gchar *search,
+                            GError **error)
+{
+   DBusBackend *self = DBUS_BACKEND(backend);
+   GVariant *res = NULL;
+
+   if(dbus_backend_ready(self, error))
+      hamster_call_get_activities_sync(self->hamster, search, &res, NULL,
+            error);
+   return res;
+}
+
+static GVariant*
+dbus_backend_get_tags(HamsterBackend *backend, gboolean only_autocomplete,
+                      GError **error)
+{
+   DBusBackend *self = DBUS_BACKEND(backend);
+   GVariant *res = NULL;
+
+   if(dbus_backend_ready(self, error))
+      hamster_call_get_tags_sync(self->hamster, only_autocomplete, &res, NULL,
+            error);
+   return res;
+}
+
+static GVariant*
+dbus_backend_get_fact(HamsterBackend *backend, gint id, GError **error)
+{
+   DBusBackend *self = DBUS_BACKEND(backend);
+   GVariant *res = NULL;
+
+   if(!dbus_backend_ready(self, error))
+      return NULL;
+   res = dbus_backend_call_json(self, "GetFactJSON", g_variant_new("(i)", id));
+   if(!res)
+      hamster_call_get_fact_sync(self->hamster, id, &res, NULL, error);
+   return res;
+}
+
+static gboolean
+dbus_backend_add_fact(HamsterBackend *backend, const gchar *fact,
+                      gint start_time, gint end_time, gint *id, GError **error)
+{
+   DBusBackend *self = DBUS_BACKEND(backend);
+
+   return dbus_backend_ready(self, error)
+      && hamster_call_add_fact_sync(self->hamster, fact, start_time, end_time,
+            FALSE, id, NULL, error);
+}
+
+static void
+dbus_backend_cb_add_fact(Hamster *proxy, GAsyncResult *result, GTask *task)
+{
+   GError *error = NULL;
+   gint id = 0;
+
+   if(hamster_call_add_fact_finish(proxy, &id, result, &error))
+      g_task_return_int(task, id);
+   else
+      g_task_return_error(task, error);
+   g_object_unref(task);
+}
+
+static void
+dbus_backend_add_fact_async(HamsterBackend *backend, const gchar *fact,
+                            gint start_time, gint end_time, GTask *task)
+{
+   DBusBackend *self = DBUS_BACKEND(backend);
+   GError *error = NULL;
+
+   if(!dbus_backend_ready(self, &error))
+   {
+      g_task_return_error(task, error);
+      g_object_unref(task);
+      return;
+   }
+   hamster_call_add_fact(self->hamster, fact, start_time, end_time, FALSE,
+         g_task_get_cancellable(task),
+         (GAsyncReadyCallback)dbus_backend_cb_add_fact, task);
+}
+
+static gboolean
+dbus_backend_stop_tracking(HamsterBackend *backend, gint end_time,
+                           GError **error)
+{
+   DBusBackend *self = DBUS_BACKEND(backend);
+   GVariant *var;
+
+   if(!dbus_backend_ready(self, error))
+      return FALSE;
+   var = g_variant_new_variant(g_variant_new_int32(end_time));
+   return hamster_call_stop_tracking_sync(self->hamster, var, NULL, error);
+}
+
+static gboolean
+dbus_backend_update_fact(HamsterBackend *backend, gint id, const gchar *fact,
+                         gint start_time, gint end_time, gint *new_id,
+                         GError **error)
+{
+   DBusBackend *self = DBUS_BACKEND(backend);
+
+   return dbus_backend_ready(self, error)
+      && hamster_call_update_fact_sync(self->hamster, id, fact, start_time,
+            end_time, FALSE, new_id, NULL, error);
+}
+
+static void
+dbus_backend_cb_update_fact(Hamster *proxy, GAsyncResult *result, GTask *task)
+{
+   GError *error = NULL;
+   gint id = 0;
+
+   if(hamster_call_update_fact_finish(proxy, &id, result, &error))
+      g_task_return_int(task, id);
+   else
+      g_task_return_error(task, error);
+   g_object_unref(task);
+}
+
+static void
+dbus_backend_update_fact_async(HamsterBackend *backend, gint id,
+                               const gchar *fact, gint start_time,
+                               gint end_time, GTask *task)
+{
+   DBusBackend *self = DBUS_BACKEND(backend);
+   GError *error = NULL;
+
+   if(!dbus_backend_ready(self, &error))
+   {
+      g_task_return_error(task, error);
+      g_object_unref(task);
+      return;
+   }
+   hamster_call_update_fact(self->hamster, id, fact, start_time, end_time,
+         FALSE, g_task_get_cancellable(task),
+         (GAsyncReadyCallback)dbus_backend_cb_update_fact, task);
+}
+
+static gboolean
+dbus_backend_edit(HamsterBackend *backend, gint id, GError **error)
+{
+   DBusBackend *self = DBUS_BACKEND(backend);
+   GVariant *ret;
+
+   if(!dbus_backend_windows_ready(self, error))
+      return FALSE;
+
+   if(id)
+   {
+      GVariant *var = g_variant_new_variant(g_variant_new_int32(id));
+      return window_server_call_edit_sync(self->windowserver, var, NULL, error);
+   }
+
+   /* a new fact: hamster wants edit() without arguments here, which the
+    * generated proxy cannot express */
+   ret = g_dbus_proxy_call_sync(G_DBUS_PROXY(self->windowserver),
+         "edit",
+         g_variant_new("()"),
+         G_DBUS_CALL_FLAGS_NONE,
+         -1,
+         NULL,
+         error);
+   if(ret == NULL)
+      return FALSE;
+   g_variant_unref(ret);
+   return TRUE;
+}
+
+static gboolean
+dbus_backend_overview(HamsterBackend *backend, GError **error)
+{
+   DBusBackend *self = DBUS_BACKEND(backend);
+
+   return dbus_backend_windows_ready(self, error)
+      && window_server_call_overview_sync(self->windowserver, NULL, error);
+}
+
+static gboolean
+dbus_backend_preferences(HamsterBackend *backend, GError **error)
+{
+   DBusBackend *self = DBUS_BACKEND(backend);
+
+   return dbus_backend_windows_ready(self, error)
+      && window_server_call_preferences_sync(self->windowserver, NULL, error);
+}
+
+static void
+dbus_backend_free(HamsterBackend *backend)
+{
+   DBusBackend *self = DBUS_BACKEND(backend);
+
+   if(self->probe)
+   {
+      g_cancellable_cancel(self->probe);
+      g_object_unref(self->probe);
+   }
+   hamster_trace_free(self->trace);
+   if(self->hamster)
+   {
+      g_signal_handlers_disconnect_by_data(self->hamster, self);
+      g_object_unref(self->hamster);
+   }
+   if(self->windowserver)
+      g_object_unref(self->windowserver);
+   g_free(self);
+}
+
+static const HamsterBackendIface dbus_backend_iface =
+{
+   .name             = "dbus",
+   .get_todays_facts = dbus_backend_get_todays_facts,
+   .get_todays_facts_async = dbus_backend_get_todays_facts_async,
+   .get_facts        = dbus_backend_get_facts,
+   .get_activities   = dbus_backend_get_activities,
+   .get_tags         = dbus_backend_get_tags,
+   .get_fact         = dbus_backend_get_fact,
+   .add_fact         = dbus_backend_add_fact,
+   .add_fact_async   = dbus_backend_add_fact_async,
+   .stop_tracking    = dbus_backend_stop_tracking,
+   .update_fact      = dbus_backend_update_fact,
+   .update_fact_async = dbus_backend_update_fact_async,
+   .edit             = dbus_backend_edit,
+   .overview         = dbus_backend_overview,
+   .preferences      = dbus_backend_preferences,
+   .free             = dbus_backend_free,
+};
+
+static gboolean
+dbus_backend_cb_facts_changed(Hamster *hamster, DBusBackend *self)
+{
+   hamster_backend_emit(&self->parent, HAMSTER_BACKEND_FACTS);
+   return FALSE;
+}
+
+static gboolean
+dbus_backend_cb_activities_changed(Hamster *hamster, DBusBackend *self)
+{
+   hamster_backend_emit(&self->parent, HAMSTER_BACKEND_ACTIVITIES);
+   return FALSE;
+}
+
+static gboolean
+dbus_backend_cb_tags_changed(Hamster *hamster, DBusBackend *self)
+{
+   hamster_backend_emit(&self->parent, HAMSTER_BACKEND_TAGS);
+   return FALSE;
+}
+
+static void
+dbus_backend_cb_introspect(GDBusConnection *bus, GAsyncResult *result,
+                           DBusBackend *self)
+{
+   GError *error = NULL;
+   GVariant *ret = g_dbus_connection_call_finish(bus, result, &error);
+   GDBusNodeInfo *node = NULL;
+   GDBusInterfaceInfo *info = NULL;
+   const gchar *xml;
+   guint i;
+
+   if(!ret)
+   {
+      /* cancelled means we are gone */
+      if(!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+         DBG("%s", error->message);
+      g_error_free(error);
+      return;
+   }
+   g_variant_get(ret, "(&s)", &xml);
+   node = g_dbus_node_info_new_for_xml(xml, NULL);
+   if(node)
+      info = g_dbus_node_info_lookup_interface(node, "org.gnome.Hamster");
+   self->json = NULL != info;
+   for(i = 0; i < G_N_ELEMENTS(dbus_backend_json_methods) && self->json; i++)
+      self->json = NULL != g_dbus_interface_info_lookup_method(info,
+            dbus_backend_json_methods[i]);
+   if(node)
+      g_dbus_node_info_unref(node);
+   g_variant_unref(ret);
+   DBG("JSON API: %s", self->json ? "yes" : "no");
+}
+
+/* the tuple API until the daemon said it has the JSON one */
+static void
+dbus_backend_probe(DBusBackend *self)
+{
+   self->json = FALSE;
+   if(self->probe)
+   {
+      g_cancellable_cancel(self->probe);
+      g_object_unref(self->probe);
+   }
+   self->probe = g_cancellable_new();
+   g_dbus_connection_call(g_dbus_proxy_get_connection(G_DBUS_PROXY(self->hamster)),
+         "org.gnome.Hamster",
+         "/org/gnome/Hamster",
+         "org.freedesktop.DBus.Introspectable",
+         "Introspect",
+         NULL,
+         G_VARIANT_TYPE("(s)"),
+         G_DBUS_CALL_FLAGS_NONE,
+         -1,
+         self->probe,
+         (GAsyncReadyCallback)dbus_backend_cb_introspect,
+         self);
+}
+
+/* a restarted daemon may be another version */
+static void
+dbus_backend_cb_owner(GObject *proxy, GParamSpec *pspec, DBusBackend *self)
+{
+   gchar *owner = g_dbus_proxy_get_name_owner(G_DBUS_PROXY(proxy));
+
+   if(owner)
+      dbus_backend_probe(self);
+   else
+      self->json = FALSE;
+   g_free(owner);
+}
+
+/* before the proxies, so their setup is in the trace too */
+static HamsterTrace*
+dbus_backend_record(const gchar *path)
+{
+   GDBusConnection *bus = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, NULL);
+   HamsterTrace *trace = NULL;
+   GError *error = NULL;
+
+   if(!bus)
+      return NULL;
+   if(!(trace = hamster_trace_new(bus, path, &error)))
+   {
+      g_warning("not recording: %s", error->message);
+      g_error_free(error);
+   }
+   g_object_unref(bus);
+   return trace;
+}
+
+HamsterBackend*
+hamster_backend_dbus_new(void)
+{
+   DBusBackend *self = g_new0(DBusBackend, 1);
+   self->parent.iface = &dbus_backend_iface;
+
+   if(g_getenv(HAMSTER_RECORD_ENV))
+      self->trace = dbus_backend_record(g_getenv(HAMSTER_RECORD_ENV));
+   self->hamster = hamster_proxy_new_for_bus_sync
+         (
+                     G_BUS_TYPE_SESSION,
+                     G_DBUS_PROXY_FLAGS_NONE,
+                     "org.gnome.Hamster",             /* bus name */
+                     "/org/gnome/Hamster",            /* object */
+                     NULL,                            /* GCancellable* */
+                     NULL);
+
+   if(self->hamster)
+   {
+      g_signal_connect(self->hamster, "facts-changed",
+                       G_CALLBACK(dbus_backend_cb_facts_changed), self);
+      g_signal_connect(self->hamster, "activities-changed",
+                       G_CALLBACK(dbus_backend_cb_activities_changed), self);
+      g_signal_connect(self->hamster, "tags-changed",
+                       G_CALLBACK(dbus_backend_cb_tags_changed), self);
+      g_signal_connect(self->hamster, "notify::g-name-owner",
+                       G_CALLBACK(dbus_backend_cb_owner), self);
+      dbus_backend_probe(self);
+   }
+
+   self->windowserver = window_server_proxy_new_for_bus_sync
+         (
+               G_BUS_TYPE_SESSION,
+               G_DBUS_PROXY_FLAGS_NONE,
+               "org.gnome.Hamster.WindowServer",      /* bus name */
+               "/org/gnome/Hamster/WindowServer",     /* object */
+               NULL,                                  /* GCancellable* */
+               NULL);
+
+   return &self->parent;
+}
@@ -0,0 +1,797 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Tracking without hamster-service: facts are kept in a hamster.db of our
+ * own, in hamster's schema, so the service can take over the file later.
+ * Every query is a prepared statement on an in-process connection; there
+ * is no IPC. hamster's windows aren't there, the popup's editor is. The
+ * full text index of hamster's search is left for hamster to fill when it
+ * next opens the file, and so is trimming facts a new one overlaps.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+#include <string.h>
+#include <sqlite3.h>
+#include <gio/gio.h>
+#include <libxfce4util/libxfce4util.h>
+#include "backend.h"
+#include "parser.h"
+#include "util.h"
+
+#define DAY_SECONDS (24 * 60 * 60)
+#define TAG_SEPARATOR "\x1f"
+#define DEBOUNCE_MS 250
+#define UNSORTED_ID -1        /* hamster's category_id for none */
+
+/* what hamster creates, version 9 */
+static const gchar *const sql_schema =
+   "CREATE TABLE IF NOT EXISTS version (version integer);"
+   "INSERT INTO version SELECT 9 WHERE NOT EXISTS (SELECT * FROM version);"
+   "CREATE TABLE IF NOT EXISTS categories (id integer primary key,"
+   " name varchar2(500), color_code varchar2(50), category_order integer,"
+   " search_name varchar2);"
+   "CREATE TABLE IF NOT EXISTS activities (id integer primary key,"
+   " name varchar2(500), work integer, activity_order integer,"
+   " deleted integer, category_id integer, search_name varchar2);"
+   "CREATE TABLE IF NOT EXISTS tags (id integer primary key,"
+   " name text not null, autocomplete bool default true);"
+   "CREATE TABLE IF NOT EXISTS facts (id integer primary key,"
+   " activity_id integer, start_time timestamp, end_time timestamp,"
+   " description varchar2);"
+   "CREATE TABLE IF NOT EXISTS fact_tags (fact_id integer, tag_id integer);";
+
+#define SQL_FACT_COLUMNS \
+   "SELECT f.id," \
+   " CAST(strftime('%s', f.start_time) AS INTEGER)," \
+   " COALESCE(CAST(strftime('%s', f.end_time) AS INTEGER), 0)," \
+   " COALESCE(f.description, '')," \
+   " a.name," \
+   " a.id," \
+   " COALESCE(c.name, '')," \
+   " (SELECT group_concat(t.name, char(31)) FROM fact_tags ft" \
+   "   JOIN tags t ON t.id = ft.tag_id WHERE ft.fact_id = f.id)" \
+   " FROM facts f" \
+   " JOIN activities a ON a.id = f.activity_id" \
+   " LEFT JOIN categories c ON c.id = a.category_id"
+
+typedef enum
+{
+   STMT_FACTS,
+   STMT_FACT,
+   STMT_ACTIVITIES,
+   STMT_TAGS,
+   STMT_CATEGORY_FIND,
+   STMT_CATEGORY_ADD,
+   STMT_ACTIVITY_FIND,
+   STMT_ACTIVITY_FIND_ANY,
+   STMT_ACTIVITY_ADD,
+   STMT_ACTIVITY_UNDELETE,
+   STMT_TAG_FIND,
+   STMT_TAG_ADD,
+   STMT_FACT_ADD,
+   STMT_FACT_UPDATE,
+   STMT_FACT_TAGS_CLEAR,
+   STMT_FACT_TAG_ADD,
+   STMT_RUNNING_AFTER,
+   STMT_STOP,
+   STMT_BEGIN,
+   STMT_COMMIT,
+   STMT_ROLLBACK,
+   STMT_DATA_VERSION,
+   STMTS
+} Stmt;
+
+static const gchar *const sql_stmts[STMTS] =
+{
+   [STMT_FACTS] = SQL_FACT_COLUMNS
+      " WHERE f.start_time < ?2 AND (f.end_time IS NULL OR f.end_time > ?1)"
+      " AND (?3 = '' OR instr(lower(a.name || ' ' || COALESCE(c.name, '')"
+      "   || ' ' || COALESCE(f.description, '')), lower(?3)) > 0)"
+      " ORDER BY f.start_time",
+   [STMT_FACT] = SQL_FACT_COLUMNS " WHERE f.id = ?1",
+   [STMT_ACTIVITIES] =
+      "SELECT a.name, COALESCE(c.name, '')"
+      " FROM activities a"
+      " LEFT JOIN categories c ON c.id = a.category_id"
+      " LEFT JOIN facts f ON f.activity_id = a.id"
+      " WHERE a.deleted IS NULL AND (?1 = '' OR instr(lower(a.name), lower(?1)) > 0)"
+      " GROUP BY a.id"
+      " ORDER BY max(f.start_time) DESC, lower(a.name)",
+   [STMT_TAGS] =
+      "SELECT id, name, autocomplete IN (1, 'true') FROM tags"
+      " WHERE ?1 = 0 OR autocomplete IN (1, 'true') ORDER BY lower(name)",
+   [STMT_CATEGORY_FIND] =
+      "SELECT id FROM categories WHERE name = ?1 COLLATE NOCASE",
+   [STMT_CATEGORY_ADD] =
+      "INSERT INTO categories (name, search_name) VALUES (?1, ?2)",
+   [STMT_ACTIVITY_FIND] =
+      "SELECT id, deleted IS NOT NULL FROM activities"
+      " WHERE name = ?1 COLLATE NOCASE AND category_id = ?2"
+      " ORDER BY deleted IS NOT NULL, id DESC LIMIT 1",
+   [STMT_ACTIVITY_FIND_ANY] =
+      "SELECT id, deleted IS NOT NULL FROM activities"
+      " WHERE name = ?1 COLLATE NOCASE"
+      " ORDER BY deleted IS NOT NULL, id DESC LIMIT 1",
+   [STMT_ACTIVITY_ADD] =
+      "INSERT INTO activities (name, category_id, search_name)"
+      " VALUES (?1, ?2, ?3)",
+   [STMT_ACTIVITY_UNDELETE] =
+      "UPDATE activities SET deleted = NULL WHERE id = ?1",
+   [STMT_TAG_FIND] =
+      "SELECT id FROM tags WHERE name = ?1 COLLATE NOCASE",
+   [STMT_TAG_ADD] =
+      "INSERT INTO tags (name) VALUES (?1)",
+   [STMT_FACT_ADD] =
+      "INSERT INTO facts (activity_id, start_time, end_time, description)"
+      " VALUES (?1, ?2, ?3, ?4)",
+   [STMT_FACT_UPDATE] =
+      "UPDATE facts SET activity_id = ?2, start_time = ?3, end_time = ?4,"
+      " description = ?5 WHERE id = ?1",
+   [STMT_FACT_TAGS_CLEAR] =
+      "DELETE FROM fact_tags WHERE fact_id = ?1",
+   [STMT_FACT_TAG_ADD] =
+      "INSERT INTO fact_tags (fact_id, tag_id) VALUES (?1, ?2)",
+   [STMT_RUNNING_AFTER] =
+      "SELECT id FROM facts WHERE end_time IS NULL AND start_time > ?1",
+   [STMT_STOP] =
+      "UPDATE facts SET end_time = ?1"
+      " WHERE end_time IS NULL AND start_time <= ?1",
+   [STMT_BEGIN] = "BEGIN IMMEDIATE",
+   [STMT_COMMIT] = "COMMIT",
+   [STMT_ROLLBACK] = "ROLLBACK",
+   [STMT_DATA_VERSION] = "PRAGMA data_version",
+};
+
+typedef struct
+{
+   HamsterBackend   parent;
+   sqlite3         *db;
+   sqlite3_stmt    *stmts[STMTS];
+   GMutex           lock;       /* the search worker reads too */
+   gint             dayStart;   /* hamster's, seconds after midnight */
+   gint64           dataVersion;/* as of our last look, see cb_file */
+   GFileMonitor    *monitor;
+   GFileMonitor    *monitorWal;
+   guint            debounce;
+} LocalBackend;
+
+#define LOCAL_BACKEND(b) ((LocalBackend*)(b))
+
+static void
+local_backend_set_error(LocalBackend *self, GError **error)
+{
+   g_set_error(error, G_IO_ERROR, G_IO_ERROR_FAILED, "hamster.db: %s",
+         sqlite3_errmsg(self->db));
+}
+
+/* hamster's naive local "YYYY-MM-DD HH:MM:SS" */
+static gchar*
+local_backend_stamp(time_t t)
+{
+   GDateTime *dt = g_date_time_new_from_unix_utc(t);
+   gchar *stamp = g_date_time_format(dt, "%Y-%m-%d %H:%M:%S");
+   g_date_time_unref(dt);
+   return stamp;
+}
+
+/* with the lock held; resets the statement for the next use */
+static gboolean
+local_backend_run(LocalBackend *self, sqlite3_stmt *stmt, GError **error)
+{
+   gint rc = sqlite3_step(stmt);
+
+   if(rc != SQLITE_DONE && rc != SQLITE_ROW)
+      local_backend_set_error(self, error);
+   sqlite3_reset(stmt);
+   sqlite3_clear_bindings(stmt);
+   return rc == SQLITE_DONE || rc == SQLITE_ROW;
+}
+
+/* with the lock held; the first column of the first row, 0 if none */
+static gint64
+local_backend_lookup(sqlite3_stmt *stmt, gboolean *flag)
+{
+   gint64 id = 0;
+
+   if(sqlite3_step(stmt) == SQLITE_ROW)
+   {
+      id = sqlite3_column_int64(stmt, 0);
+      if(flag)
+         *flag = sqlite3_column_int(stmt, 1);
+   }
+   sqlite3_reset(stmt);
+   sqlite3_clear_bindings(stmt);
+   return id;
+}
+
+static gint64
+local_backend_data_version(LocalBackend *self)
+{
+   return local_backend_lookup(self->stmts[STMT_DATA_VERSION], NULL);
+}
+
+/* Reading */
+/* the day a fact counts for, as hamster reports it: midnight of the day
+ * whose day_start it follows */
+static gint
+local_backend_date(gint dayStart, time_t start)
+{
+   time_t shifted = start - dayStart;
+   return shifted - shifted % DAY_SECONDS;
+}
+
+/* one (iiissisasii), floating */
+static GVariant*
+local_backend_row(sqlite3_stmt *s, gint now, gint dayStart)
+{
+   const gchar *tags = (const gchar*)sqlite3_column_text(s, 7);
+   gchar **tagv = g_strsplit(tags ? tags : "", TAG_SEPARATOR, -1);
+   gint start = sqlite3_column_int(s, 1);
+   gint end = sqlite3_column_int(s, 2);
+   GVariant *row;
+
+   row = g_variant_new("(iiissis^asii)",
+         sqlite3_column_int(s, 0),
+         start,
+         end,
+         (const gchar*)sqlite3_column_text(s, 3),
+         (const gchar*)sqlite3_column_text(s, 4),
+         sqlite3_column_int(s, 5),
+         (const gchar*)sqlite3_column_text(s, 6),
+         tagv,
+         local_backend_date(dayStart, start),
+         (end ? end : now) - start);
+   g_strfreev(tagv);
+   return row;
+}
+
+/* [from, to) in hamster's local epoch seconds */
+static GVariant*
+local_backend_query_facts(LocalBackend *self, time_t from, time_t to,
+                          const gchar *search, GError **error)
+{
+   sqlite3_stmt *s = self->stmts[STMT_FACTS];
+   GVariantBuilder builder;
+   gchar *lo = local_backend_stamp(from);
+   gchar *hi = local_backend_stamp(to);
+   gint now = util_local_now();
+   gint rc;
+
+   g_variant_builder_init(&builder, G_VARIANT_TYPE("a(iiissisasii)"));
+   g_mutex_lock(&self->lock);
+   sqlite3_bind_text(s, 1, lo, -1, SQLITE_TRANSIENT);
+   sqlite3_bind_text(s, 2, hi, -1, SQLITE_TRANSIENT);
+   sqlite3_bind_text(s, 3, search, -1, SQLITE_TRANSIENT);
+   while((rc = sqlite3_step(s)) == SQLITE_ROW)
+      g_variant_builder_add_value(&builder,
+            local_backend_row(s, now, self->dayStart));
+   if(rc != SQLITE_DONE)
+      local_backend_set_error(self, error);
+   sqlite3_reset(s);
+   sqlite3_clear_bindings(s);
+   g_mutex_unlock(&self->lock);
+   g_free(lo);
+   g_free(hi);
+
+   if(rc != SQLITE_DONE)
+   {
+      g_variant_builder_clear(&builder);
+      return NULL;
+   }
+   return g_variant_ref_sink(g_variant_builder_end(&builder));
+}
+
+static GVariant*
+local_backend_get_todays_facts(HamsterBackend *backend, GError **error)
+{
+   LocalBackend *self = LOCAL_BACKEND(backend);
+   time_t today = local_backend_date(self->dayStart, util_local_now())
+      + self->dayStart;
+   return local_backend_query_facts(self, today, today + DAY_SECONDS, "",
+         error);
+}
+
+static GVariant*
+local_backend_get_facts(HamsterBackend *backend, guint start_date,
+                        guint end_date, const gchar *search, GError **error)
+{
+   LocalBackend *self = LOCAL_BACKEND(backend);
+   return local_backend_query_facts(self, (time_t)start_date + self->dayStart,
+         (time_t)end_date + DAY_SECONDS + self->dayStart, search, error);
+}
+
+static GVariant*
+local_backend_get_fact(HamsterBackend *backend, gint id, GError **error)
+{
+   LocalBackend *self = LOCAL_BACKEND(backend);
+   sqlite3_stmt *s = self->stmts[STMT_FACT];
+   GVariant *res = NULL;
+   gint rc;
+
+   g_mutex_lock(&self->lock);
+   sqlite3_bind_int(s, 1, id);
+   if((rc = sqlite3_step(s)) == SQLITE_ROW)
+      res = g_variant_ref_sink(local_backend_row(s, util_local_now(),
+            self->dayStart));
+   else if(rc == SQLITE_DONE)
+      g_set_error(error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "no fact %d", id);
+   else
+      local_backend_set_error(self, error);
+   sqlite3_reset(s);
+   sqlite3_clear_bindings(s);
+   g_mutex_unlock(&self->lock);
+   return res;
+}
+
+static GVariant*
+local_backend_get_activities(HamsterBackend *backend, const gchar *search,
+                             GError **error)
+{
+   LocalBackend *self = LOCAL_BACKEND(backend);
+   sqlite3_stmt *s = self->stmts[STMT_ACTIVITIES];
+   GVariantBuilder builder;
+   gint rc;
+
+   g_variant_builder_init(&builder, G_VARIANT_TYPE("a(ss)"));
+   g_mutex_lock(&self->lock);
+   sqlite3_bind_text(s, 1, search, -1, SQLITE_TRANSIENT);
+   while((rc = sqlite3_step(s)) == SQLITE_ROW)
+      g_variant_builder_add(&builder, "(ss)",
+            (const gchar*)sqlite3_column_text(s, 0),
+            (const gchar*)sqlite3_column_text(s, 1));
+   if(rc != SQLITE_DONE)
+      local_backend_set_error(self, error);
+   sqlite3_reset(s);
+   sqlite3_clear_bindings(s);
+   g_mutex_unlock(&self->lock);
+
+   if(rc != SQLITE_DONE)
+   {
+      g_variant_builder_clear(&builder);
+      return NULL;
+   }
+   return g_variant_ref_sink(g_variant_builder_end(&builder));
+}
+
+static GVariant*
+local_backend_get_tags(HamsterBackend *backend, gboolean only_autocomplete,
+                       GError **error)
+{
+   LocalBackend *self = LOCAL_BACKEND(backend);
+   sqlite3_stmt *s = self->stmts[STMT_TAGS];
+   GVariantBuilder builder;
+   gint rc;
+
+   g_variant_builder_init(&builder, G_VARIANT_TYPE("a(isb)"));
+   g_mutex_lock(&self->lock);
+   sqlite3_bind_int(s, 1, only_autocomplete);
+   while((rc = sqlite3_step(s)) == SQLITE_ROW)
+      g_variant_builder_add(&builder, "(isb)",
+            sqlite3_column_int(s, 0),
+            (const gchar*)sqlite3_column_text(s, 1),
+            (gboolean)sqlite3_column_int(s, 2));
+   if(rc != SQLITE_DONE)
+      local_backend_set_error(self, error);
+   sqlite3_reset(s);
+   sqlite3_clear_bindings(s);
+   g_mutex_unlock(&self->lock);
+
+   if(rc != SQLITE_DONE)
+   {
+      g_variant_builder_clear(&builder);
+      return NULL;
+   }
+   return g_variant_ref_sink(g_variant_builder_end(&builder));
+}
+
+/* Writing, all with the lock held and inside a transaction */
+
+/* found or made, like hamster: a named category or UNSORTED_ID, and an
+ * activity without one takes the category it was last used with */
+static gint64
+local_backend_activity(LocalBackend *self, const fact_spec *spec,
+                       GError **error)
+{
+   sqlite3_stmt *s;
+   gint64 category = UNSORTED_ID, id;
+   gboolean deleted = FALSE;
+   gchar *search;
+
+   if(spec->category)
+   {
+      s = self->stmts[STMT_CATEGORY_FIND];
+      sqlite3_bind_text(s, 1, spec->category, -1, SQLITE_STATIC);
+      if(!(category = local_backend_lookup(s, NULL)))
+      {
+         s = self->stmts[STMT_CATEGORY_ADD];
+         search = g_utf8_casefold(spec->category, -1);
+         sqlite3_bind_text(s, 1, spec->category, -1, SQLITE_STATIC);
+         sqlite3_bind_text(s, 2, search, -1, SQLITE_TRANSIENT);
+         g_free(search);
+         if(!local_backend_run(self, s, error))
+            return 0;
+         category = sqlite3_last_insert_rowid(self->db);
+      }
+      s = self->stmts[STMT_ACTIVITY_FIND];
+      sqlite3_bind_text(s, 1, spec->name, -1, SQLITE_STATIC);
+      sqlite3_bind_int64(s, 2, category);
+   }
+   else
+   {
+      s = self->stmts[STMT_ACTIVITY_FIND_ANY];
+      sqlite3_bind_text(s, 1, spec->name, -1, SQLITE_STATIC);
+   }
+
+   if((id = local_backend_lookup(s, &deleted)))
+   {
+      if(deleted)
+      {
+         s = self->stmts[STMT_ACTIVITY_UNDELETE];
+         sqlite3_bind_int64(s, 1, id);
+         if(!local_backend_run(self, s, error))
+            return 0;
+      }
+      return id;
+   }
+
+   s = self->stmts[STMT_ACTIVITY_ADD];
+   search = g_utf8_casefold(spec->name, -1);
+   sqlite3_bind_text(s, 1, spec->name, -1, SQLITE_STATIC);
+   sqlite3_bind_int64(s, 2, category);
+   sqlite3_bind_text(s, 3, search, -1, SQLITE_TRANSIENT);
+   g_free(search);
+   if(!local_backend_run(self, s, error))
+      return 0;
+   return sqlite3_last_insert_rowid(self->db);
+}
+
+static gboolean
+local_backend_tags(LocalBackend *self, gint64 factId, gchar **tags,
+                   GError **error)
+{
+   sqlite3_stmt *s = self->stmts[STMT_FACT_TAGS_CLEAR];
+   gint64 tagId;
+
+   sqlite3_bind_int64(s, 1, factId);
+   if(!local_backend_run(self, s, error))
+      return FALSE;
+   for(; tags && *tags; tags++)
+   {
+      s = self->stmts[STMT_TAG_FIND];
+      sqlite3_bind_text(s, 1, *tags, -1, SQLITE_STATIC);
+      if(!(tagId = local_backend_lookup(s, NULL)))
+      {
+         s = self->stmts[STMT_TAG_ADD];
+         sqlite3_bind_text(s, 1, *tags, -1, SQLITE_STATIC);
+         if(!local_backend_run(self, s, error))
+            return FALSE;
+         tagId = sqlite3_last_insert_rowid(self->db);
+      }
+      s = self->stmts[STMT_FACT_TAG_ADD];
+      sqlite3_bind_int64(s, 1, factId);
+      sqlite3_bind_int64(s, 2, tagId);
+      if(!local_backend_run(self, s, error))
+         return FALSE;
+   }
+   return TRUE;
+}
+
+static gboolean
+local_backend_stop(LocalBackend *self, time_t endTime, GError **error)
+{
+   sqlite3_stmt *s = self->stmts[STMT_RUNNING_AFTER];
+   gchar *stamp = local_backend_stamp(endTime);
+   gboolean ok = FALSE;
+
+   /* hamster won't end a fact before it began, neither do we */
+   sqlite3_bind_text(s, 1, stamp, -1, SQLITE_STATIC);
+   if(local_backend_lookup(s, NULL))
+      g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+            "the running fact starts after %s", stamp);
+   else
+   {
+      s = self->stmts[STMT_STOP];
+      sqlite3_bind_text(s, 1, stamp, -1, SQLITE_STATIC);
+      ok = local_backend_run(self, s, error);
+   }
+   g_free(stamp);
+   return ok;
+}
+
+/* binds the fact's own columns from the given index on */
+static void
+local_backend_bind_fact(sqlite3_stmt *s, gint first, gint64 activity,
+                        time_t startTime, time_t endTime,
+                        const gchar *description)
+{
+   sqlite3_bind_int64(s, first, activity);
+   sqlite3_bind_text(s, first + 1, local_backend_stamp(startTime), -1, g_free);
+   if(endTime)
+      sqlite3_bind_text(s, first + 2, local_backend_stamp(endTime), -1, g_free);
+   else
+      sqlite3_bind_null(s, first + 2);
+   if(description && *description)
+      sqlite3_bind_text(s, first + 3, description, -1, SQLITE_STATIC);
+   else
+      sqlite3_bind_null(s, first + 3);
+}
+
+/* id 0 adds, otherwise updates in place: hamster would hand out a new id,
+ * nothing here depends on that. Unlike hamster, overlaps are left alone:
+ * a running fact started in the past stops the one running before it, but
+ * completed facts after its start are neither trimmed nor split, so the
+ * two overlap until one is edited */
+static gboolean
+local_backend_write(LocalBackend *self, gint id, const gchar *text,
+                    gint start_time, gint end_time, gint *out,
+                    GError **error)
+{
+   time_t now = util_local_now();
+   time_t startTime, endTime;
+   fact_spec spec;
+   gint64 activity, factId = id;
+   sqlite3_stmt *s;
+   gboolean ok = FALSE;
+
+   if(!fact_spec_parse(&spec, text, now, error))
+      return FALSE;
+   /* explicit times win over those in the text, like in hamster */
+   startTime = start_time ? start_time : (spec.startTime ? spec.startTime : now);
+   endTime = end_time ? end_time : spec.endTime;
+
+   g_mutex_lock(&self->lock);
+   if(!local_backend_run(self, self->stmts[STMT_BEGIN], error))
+      goto done;
+   if(!(activity = local_backend_activity(self, &spec, error)))
+      goto rollback;
+   if(!endTime && !id && !local_backend_stop(self, startTime, error))
+      goto rollback;
+   if(id)
+   {
+      s = self->stmts[STMT_FACT_UPDATE];
+      sqlite3_bind_int64(s, 1, id);
+      local_backend_bind_fact(s, 2, activity, startTime, endTime,
+            spec.description);
+   }
+   else
+   {
+      s = self->stmts[STMT_FACT_ADD];
+      local_backend_bind_fact(s, 1, activity, startTime, endTime,
+            spec.description);
+   }
+   if(!local_backend_run(self, s, error))
+      goto rollback;
+   if(!id)
+      factId = sqlite3_last_insert_rowid(self->db);
+   if(!local_backend_tags(self, factId, spec.tags, error)
+         || !local_backend_run(self, self->stmts[STMT_COMMIT], error))
+      goto rollback;
+   self->dataVersion = local_backend_data_version(self);
+   *out = factId;
+   ok = TRUE;
+   goto done;
+
+rollback:
+   local_backend_run(self, self->stmts[STMT_ROLLBACK], NULL);
+done:
+   g_mutex_unlock(&self->lock);
+   fact_spec_clear(&spec);
+   if(ok)
+      hamster_backend_emit(&self->parent, HAMSTER_BACKEND_FACTS
+            | HAMSTER_BACKEND_ACTIVITIES | HAMSTER_BACKEND_TAGS);
+   return ok;
+}
+
+static gboolean
+local_backend_add_fact(HamsterBackend *backend, const gchar *fact,
+                       gint start_time, gint end_time, gint *id,
+                       GError **error)
+{
+   return local_backend_write(LOCAL_BACKEND(backend), 0, fact, start_time,
+         end_time, id, error);
+}
+
+static gboolean
+local_backend_update_fact(HamsterBackend *backend, gint id, const gchar *fact,
+                          gint start_time, gint end_time, gint *new_id,
+                          GError **error)
+{
+   return local_backend_write(LOCAL_BACKEND(backend), id, fact, start_time,
+         end_time, new_id, error);
+}
+
+/* 0 is now */
+static gboolean
+local_backend_stop_tracking(HamsterBackend *backend, gint end_time,
+                            GError **error)
+{
+   LocalBackend *self = LOCAL_BACKEND(backend);
+   gboolean ok = FALSE;
+
+   /* the check and the update see the same facts, like in a write */
+   g_mutex_lock(&self->lock);
+   if(local_backend_run(self, self->stmts[STMT_BEGIN], error))
+   {
+      ok = local_backend_stop(self, end_time ? end_time : util_local_now(),
+            error) && local_backend_run(self, self->stmts[STMT_COMMIT], error);
+      if(ok)
+         self->dataVersion = local_backend_data_version(self);
+      else
+         local_backend_run(self, self->stmts[STMT_ROLLBACK], NULL);
+   }
+   g_mutex_unlock(&self->lock);
+   if(ok)
+      hamster_backend_emit(&self->parent, HAMSTER_BACKEND_FACTS);
+   return ok;
+}
+
+static void
+local_backend_free(HamsterBackend *backend)
+{
+   LocalBackend *self = LOCAL_BACKEND(backend);
+   guint i;
+
+   if(self->debounce)
+      g_source_remove(self->debounce);
+   if(self->monitor)
+   {
+      g_signal_handlers_disconnect_by_data(self->monitor, self);
+      g_object_unref(self->monitor);
+   }
+   if(self->monitorWal)
+   {
+      g_signal_handlers_disconnect_by_data(self->monitorWal, self);
+      g_object_unref(self->monitorWal);
+   }
+   for(i = 0; i < STMTS; i++)
+      sqlite3_finalize(self->stmts[i]);
+   sqlite3_close(self->db);
+   g_mutex_clear(&self->lock);
+   g_free(self);
+}
+
+/* hamster's windows need hamster */
+static const HamsterBackendIface local_backend_iface =
+{
+   .name             = "local",
+   .get_todays_facts = local_backend_get_todays_facts,
+   .get_facts        = local_backend_get_facts,
+   .get_activities   = local_backend_get_activities,
+   .get_tags         = local_backend_get_tags,
+   .get_fact         = local_backend_get_fact,
+   .add_fact         = local_backend_add_fact,
+   .stop_tracking    = local_backend_stop_tracking,
+   .update_fact      = local_backend_update_fact,
+   .free             = local_backend_free,
+};
+
+static gboolean
+local_backend_cb_debounce(LocalBackend *self)
+{
+   self->debounce = 0;
+   hamster_backend_emit(&self->parent, HAMSTER_BACKEND_FACTS
+         | HAMSTER_BACKEND_ACTIVITIES | HAMSTER_BACKEND_TAGS);
+   return FALSE;
+}
+
+/* another connection committed, an import or hamster itself; our own
+ * commits leave data_version alone */
+static void
+local_backend_cb_file(GFileMonitor *monitor,
+                      GFile *file,
+                      GFile *other,
+                      GFileMonitorEvent event,
+                      LocalBackend *self)
+{
+   gint64 version;
+
+   if(event != G_FILE_MONITOR_EVENT_CHANGED
+         && event != G_FILE_MONITOR_EVENT_CREATED)
+      return;
+   g_mutex_lock(&self->lock);
+   version = local_backend_data_version(self);
+   g_mutex_unlock(&self->lock);
+   if(version == self->dataVersion)
+      return;
+   self->dataVersion = version;
+   if(!self->debounce)
+      self->debounce = g_timeout_add(DEBOUNCE_MS,
+            (GSourceFunc)local_backend_cb_debounce, self);
+}
+
+static GFileMonitor*
+local_backend_watch(LocalBackend *self, const gchar *path)
+{
+   GFile *file = g_file_new_for_path(path);
+   GFileMonitor *monitor = g_file_monitor_file(file, G_FILE_MONITOR_NONE,
+         NULL, NULL);
+   g_object_unref(file);
+   if(monitor)
+      g_signal_connect(monitor, "changed",
+            G_CALLBACK(local_backend_cb_file), self);
+   return monitor;
+}
+
+/*
+ * Returns a backend keeping facts in hamster.db itself, the one hamster
+ * uses if there is one, else a new one where hamster would look for it.
+ * NULL and error set if it can't be opened or isn't hamster's.
+ */
+HamsterBackend*
+hamster_backend_local_new(GError **error)
+{
+   LocalBackend *self;
+   gchar *path, *dir, *wal;
+   sqlite3 *db = NULL;
+   gchar *message = NULL;
+   guint i;
+
+   path = hamster_backend_sqlite_find_db();
+   if(!path)
+   {
+      dir = g_build_filename(g_get_user_data_dir(), "hamster", NULL);
+      g_mkdir_with_parents(dir, 0700);
+      path = g_build_filename(dir, "hamster.db", NULL);
+      g_free(dir);
+   }
+
+   if(sqlite3_open_v2(path, &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE,
+            NULL) != SQLITE_OK
+         || sqlite3_exec(db, sql_schema, NULL, NULL, &message) != SQLITE_OK)
+   {
+      g_set_error(error, G_IO_ERROR, G_IO_ERROR_FAILED, "%s: %s", path,
+            message ? message : sqlite3_errmsg(db));
+      sqlite3_free(message);
+      sqlite3_close(db);
+      g_free(path);
+      return NULL;
+   }
+   /* hamster, an import or the search worker may hold the write lock */
+   sqlite3_busy_timeout(db, 1000);
+
+   self = g_new0(LocalBackend, 1);
+   self->parent.iface = &local_backend_iface;
+   self->db = db;
+   self->dayStart = util_day_start();
+   g_mutex_init(&self->lock);
+   for(i = 0; i < STMTS; i++)
+   {
+      if(sqlite3_prepare_v2(db, sql_stmts[i], -1, &self->stmts[i], NULL)
+            != SQLITE_OK)
+      {
+         g_set_error(error, G_IO_ERROR, G_IO_ERROR_FAILED, "%s: %s", path,
+               sqlite3_errmsg(db));
+         local_backend_free(&self->parent);
+         g_free(path);
+         return NULL;
+      }
+   }
+   self->dataVersion = local_backend_data_version(self);
+
+   wal = g_strconcat(path, "-wal", NULL);
+   self->monitor = local_backend_watch(self, path);
+   self->monitorWal = local_backend_watch(self, wal);
+   g_free(wal);
+
+   DBG("tracking in %s", path);
+   g_free(path);
+   return &self->parent;
+}
@@ -0,0 +1,469 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * In-process stand-in for hamster-service. Keeps facts in a plain array,
+ * answers in the same wire format and raises change notifications from
+ * an idle callback like a D-Bus signal would arrive. Meant for profiling
+ * and benchmarking the UI without a session bus.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+#include <string.h>
+#include <gio/gio.h>
+#include <libxfce4util/libxfce4util.h>
+#include "backend.h"
+#include "parser.h"
+#include "util.h"
+
+#define DAY_SECONDS (24 * 60 * 60)
+
+typedef struct
+{
+   gint    id;
+   gint    startTime;
+   gint    endTime;
+   gchar  *name;
+   gchar  *category;
+   gchar  *description;
+   gchar **tags;
+   gint    activityId;
+} MemFact;
+
+typedef struct
+{
+   gint    id;                   /* in order of creation, like hamster's */
+   gchar  *name;
+   gchar  *category;
+} MemActivity;
+
+typedef struct
+{
+   HamsterBackend  parent;
+   GMutex          lock;
+   GPtrArray      *facts;        /* MemFact*, ordered by start */
+   GPtrArray      *activities;   /* MemActivity*, most recent first */
+   GPtrArray      *tags;         /* gchar*, id is index + 1 */
+   gint            lastId;
+   gint            lastActivityId;
+   guint           pending;      /* HamsterBackendChange not yet emitted */
+   guint           idleSource;
+} MemBackend;
+
+#define MEM_BACKEND(b) ((MemBackend*)(b))
+
+static void
+mem_fact_free(MemFact *f)
+{
+   g_free(f->name);
+   g_free(f->category);
+   g_free(f->description);
+   g_strfreev(f->tags);
+   g_free(f);
+}
+
+static void
+mem_activity_free(MemActivity *a)
+{
+   g_free(a->name);
+   g_free(a->category);
+   g_free(a);
+}
+
+static gboolean
+mem_backend_cb_idle(MemBackend *self)
+{
+   guint what;
+
+   g_mutex_lock(&self->lock);
+   what = self->pending;
+   self->pending = 0;
+   self->idleSource = 0;
+   g_mutex_unlock(&self->lock);
+
+   if(what)
+      hamster_backend_emit(&self->parent, what);
+   return FALSE;
+}
+
+/* call with lock held */
+static void
+mem_backend_changed(MemBackend *self, HamsterBackendChange what)
+{
+   self->pending |= what;
+   if(!self->idleSource)
+      self->idleSource = g_idle_add((GSourceFunc)mem_backend_cb_idle, self);
+}
+
+/* call with lock held; moves or inserts the activity to the front and
+ * returns its id */
+static gint
+mem_backend_touch_activity(MemBackend *self, const gchar *name,
+                           const gchar *category)
+{
+   guint i;
+   MemActivity *a = NULL;
+
+   for(i = 0; i < self->activities->len; i++)
+   {
+      MemActivity *it = g_ptr_array_index(self->activities, i);
+      if(!strcmp(it->name, name) && !strcmp(it->category, category))
+      {
+         a = g_ptr_array_steal_index(self->activities, i);
+         break;
+      }
+   }
+   if(!a)
+   {
+      a = g_new0(MemActivity, 1);
+      a->id = ++self->lastActivityId;
+      a->name = g_strdup(name);
+      a->category = g_strdup(category);
+      mem_backend_changed(self, HAMSTER_BACKEND_ACTIVITIES);
+   }
+   g_ptr_array_insert(self->activities, 0, a);
+   return a->id;
+}
+
+/* call with lock held */
+static void
+mem_backend_touch_tags(MemBackend *self, gchar **tags)
+{
+   for(; tags && *tags; tags++)
+   {
+      guint i;
+      for(i = 0; i < self->tags->len; i++)
+         if(!strcmp(g_ptr_array_index(self->tags, i), *tags))
+            break;
+      if(i == self->tags->len)
+      {
+         g_ptr_array_add(self->tags, g_strdup(*tags));
+         mem_backend_changed(self, HAMSTER_BACKEND_TAGS);
+      }
+   }
+}
+
+static GVariant*
+mem_fact_variant(const MemFact *f, gint now)
+{
+   gint end = f->endTime ? f->endTime : now;
+   return g_variant_new("(iiissis^asii)",
+         f->id,
+         f->startTime,
+         f->endTime,
+         f->description,
+         f->name,
+         f->activityId,
+         f->category,
+         f->tags,
+         f->startTime - f->startTime % DAY_SECONDS,
+         end - f->startTime);
+}
+
+static GVariant*
+mem_backend_collect(MemBackend *self, gint from, gint to, const gchar *search)
+{
+   GVariantBuilder builder;
+   gchar *needle = (search && *search) ? g_utf8_casefold(search, -1) : NULL;
+   gint now = util_local_now();
+   guint i;
+
+   g_variant_builder_init(&builder, G_VARIANT_TYPE("a(iiissisasii)"));
+   g_mutex_lock(&self->lock);
+   for(i = 0; i < self->facts->len; i++)
+   {
+      MemFact *f = g_ptr_array_index(self->facts, i);
+
+      /* whatever overlaps the range, a running fact has no end yet */
+      if(f->startTime >= to || (f->endTime && f->endTime <= from))
+         continue;
+      if(needle)
+      {
+         gchar *hay = g_utf8_casefold(f->name, -1);
+         gboolean hit = strstr(hay, needle) != NULL;
+         g_free(hay);
+         if(!hit)
+            continue;
+      }
+      g_variant_builder_add_value(&builder, mem_fact_variant(f, now));
+   }
+   g_mutex_unlock(&self->lock);
+   g_free(needle);
+   return g_variant_ref_sink(g_variant_builder_end(&builder));
+}
+
+static GVariant*
+mem_backend_get_todays_facts(HamsterBackend *backend, GError **error)
+{
+   gint now = util_local_now();
+   gint today = now - now % DAY_SECONDS;
+   return mem_backend_collect(MEM_BACKEND(backend), today,
+         today + DAY_SECONDS, NULL);
+}
+
+static GVariant*
+mem_backend_get_facts(HamsterBackend *backend, guint start_date,
+                      guint end_date, const gchar *search, GError **error)
+{
+   /* like hamster, end_date is inclusive */
+   return mem_backend_collect(MEM_BACKEND(backend), start_date,
+         end_date + DAY_SECONDS, search);
+}
+
+static GVariant*
+mem_backend_get_activities(HamsterBackend *backend, const gchar *search,
+                           GError **error)
+{
+   MemBackend *self = MEM_BACKEND(backend);
+   GVariantBuilder builder;
+   gchar *needle = *search ? g_utf8_casefold(search, -1) : NULL;
+   guint i;
+
+   g_variant_builder_init(&builder, G_VARIANT_TYPE("a(ss)"));
+   g_mutex_lock(&self->lock);
+   for(i = 0; i < self->activities->len; i++)
+   {
+      MemActivity *a = g_ptr_array_index(self->activities, i);
+      if(needle)
+      {
+         gchar *hay = g_utf8_casefold(a->name, -1);
+         gboolean hit = strstr(hay, needle) != NULL;
+         g_free(hay);
+         if(!hit)
+            continue;
+      }
+      g_variant_builder_add(&builder, "(ss)", a->name, a->category);
+   }
+   g_mutex_unlock(&self->lock);
+   g_free(needle);
+   return g_variant_ref_sink(g_variant_builder_end(&builder));
+}
+
+static GVariant*
+mem_backend_get_tags(HamsterBackend *backend, gboolean only_autocomplete,
+                     GError **error)
+{
+   MemBackend *self = MEM_BACKEND(backend);
+   GVariantBuilder builder;
+   guint i;
+
+   g_variant_builder_init(&builder, G_VARIANT_TYPE("a(isb)"));
+   g_mutex_lock(&self->lock);
+   for(i = 0; i < self->tags->len; i++)
+      g_variant_builder_add(&builder, "(isb)", i + 1,
+            g_ptr_array_index(self->tags, i), TRUE);
+   g_mutex_unlock(&self->lock);
+   return g_variant_ref_sink(g_variant_builder_end(&builder));
+}
+
+/* call with lock held */
+static MemFact*
+mem_backend_find(MemBackend *self, gint id, GError **error)
+{
+   guint i;
+
+   for(i = 0; i < self->facts->len; i++)
+   {
+      MemFact *f = g_ptr_array_index(self->facts, i);
+      if(f->id == id)
+         return f;
+   }
+   g_set_error(error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "no fact %d", id);
+   return NULL;
+}
+
+static GVariant*
+mem_backend_get_fact(HamsterBackend *backend, gint id, GError **error)
+{
+   MemBackend *self = MEM_BACKEND(backend);
+   GVariant *res = NULL;
+   MemFact *f;
+
+   g_mutex_lock(&self->lock);
+   if((f = mem_backend_find(self, id, error)))
+      res = g_variant_ref_sink(mem_fact_variant(f, util_local_now()));
+   g_mutex_unlock(&self->lock);
+   return res;
+}
+
+/* call with lock held */
+static void
+mem_backend_stop_running(MemBackend *self, gint end_time)
+{
+   MemFact *last;
+
+   if(!self->facts->len)
+      return;
+   last = g_ptr_array_index(self->facts, self->facts->len - 1);
+   if(last->endTime == 0)
+   {
+      last->endTime = MAX(end_time, last->startTime);
+      mem_backend_changed(self, HAMSTER_BACKEND_FACTS);
+   }
+}
+
+static gint
+mem_fact_compare(gconstpointer a, gconstpointer b)
+{
+   const MemFact *fa = *(MemFact**)a;
+   const MemFact *fb = *(MemFact**)b;
+   return (fa->startTime > fb->startTime) - (fa->startTime < fb->startTime);
+}
+
+/* explicit times win over those in the text, like in hamster */
+static gboolean
+mem_backend_add_fact(HamsterBackend *backend, const gchar *text,
+                     gint start_time, gint end_time, gint *id, GError **error)
+{
+   MemBackend *self = MEM_BACKEND(backend);
+   time_t now = util_local_now();
+   fact_spec spec;
+   MemFact *f;
+
+   if(!fact_spec_parse(&spec, text, now, error))
+      return FALSE;
+
+   f = g_new0(MemFact, 1);
+   f->name = spec.name;
+   f->category = spec.category ? spec.category : g_strdup("");
+   f->description = spec.description ? spec.description : g_strdup("");
+   f->tags = spec.tags;
+   f->startTime = start_time ? start_time : (spec.startTime ? spec.startTime : now);
+   f->endTime = end_time ? end_time : spec.endTime;
+
+   g_mutex_lock(&self->lock);
+   if(!f->endTime)
+      mem_backend_stop_running(self, f->startTime);
+   f->id = ++self->lastId;
+   f->activityId = mem_backend_touch_activity(self, f->name, f->category);
+   mem_backend_touch_tags(self, f->tags);
+   g_ptr_array_add(self->facts, f);
+   g_ptr_array_sort(self->facts, mem_fact_compare);
+   mem_backend_changed(self, HAMSTER_BACKEND_FACTS);
+   *id = f->id;
+   g_mutex_unlock(&self->lock);
+   return TRUE;
+}
+
+/* keeps the id, hamster would hand out a new one */
+static gboolean
+mem_backend_update_fact(HamsterBackend *backend, gint id, const gchar *text,
+                        gint start_time, gint end_time, gint *new_id,
+                        GError **error)
+{
+   MemBackend *self = MEM_BACKEND(backend);
+   time_t now = util_local_now();
+   fact_spec spec;
+   MemFact *f;
+
+   if(!fact_spec_parse(&spec, text, now, error))
+      return FALSE;
+
+   g_mutex_lock(&self->lock);
+   if(!(f = mem_backend_find(self, id, error)))
+   {
+      g_mutex_unlock(&self->lock);
+      fact_spec_clear(&spec);
+      return FALSE;
+   }
+   g_free(f->name);
+   g_free(f->category);
+   g_free(f->description);
+   g_strfreev(f->tags);
+   f->name = spec.name;
+   f->category = spec.category ? spec.category : g_strdup("");
+   f->description = spec.description ? spec.description : g_strdup("");
+   f->tags = spec.tags;
+   f->startTime = start_time ? start_time : (spec.startTime ? spec.startTime : f->startTime);
+   f->endTime = end_time ? end_time : spec.endTime;
+   f->activityId = mem_backend_touch_activity(self, f->name, f->category);
+   mem_backend_touch_tags(self, f->tags);
+   g_ptr_array_sort(self->facts, mem_fact_compare);
+   mem_backend_changed(self, HAMSTER_BACKEND_FACTS);
+   *new_id = f->id;
+   g_mutex_unlock(&self->lock);
+   return TRUE;
+}
+
+static gboolean
+mem_backend_stop_tracking(HamsterBackend *backend, gint end_time,
+                          GError **error)
+{
+   MemBackend *self = MEM_BACKEND(backend);
+
+   g_mutex_lock(&self->lock);
+   mem_backend_stop_running(self, end_time ? end_time : util_local_now());
+   g_mutex_unlock(&self->lock);
+   return TRUE;
+}
+
+static void
+mem_backend_free(HamsterBackend *backend)
+{
+   MemBackend *self = MEM_BACKEND(backend);
+
+   if(self->idleSource)
+      g_source_remove(self->idleSource);
+   g_ptr_array_free(self->facts, TRUE);
+   g_ptr_array_free(self->activities, TRUE);
+   g_ptr_array_free(self->tags, TRUE);
+   g_mutex_clear(&self->lock);
+   g_free(self);
+}
+
+static const HamsterBackendIface mem_backend_iface =
+{
+   .name             = "memory",
+   .get_todays_facts = mem_backend_get_todays_facts,
+   .get_facts        = mem_backend_get_facts,
+   .get_activities   = mem_backend_get_activities,
+   .get_tags         = mem_backend_get_tags,
+   .get_fact         = mem_backend_get_fact,
+   .add_fact         = mem_backend_add_fact,
+   .stop_tracking    = mem_backend_stop_tracking,
+   .update_fact      = mem_backend_update_fact,
+   .free             = mem_backend_free,
+};
+
+void
+hamster_backend_memory_add_activity(HamsterBackend *backend,
+                                    const gchar *activity,
+                                    const gchar *category)
+{
+   MemBackend *self = MEM_BACKEND(backend);
+
+   g_return_if_fail(backend->iface == &mem_backend_iface);
+   g_mutex_lock(&self->lock);
+   mem_backend_touch_activity(self, activity, category ? category : "");
+   g_mutex_unlock(&self->lock);
+}
+
+HamsterBackend*
+hamster_backend_memory_new(void)
+{
+   MemBackend *self = g_new0(MemBackend, 1);
+   self->parent.iface = &mem_backend_iface;
+   g_mutex_init(&self->lock);
+   self->facts = g_ptr_array_new_with_free_func((GDestroyNotify)mem_fact_free);
+   self->activities = g_ptr_array_new_with_free_func(
+         (GDestroyNotify)mem_activity_free);
+   self->tags = g_ptr_array_new_with_free_func(g_free);
+   return &self->parent;
+}
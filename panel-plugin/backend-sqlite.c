@@ -0,0 +1,515 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Read-only shortcut into hamster's own database. Facts and activities are
+ * read with prepared statements instead of a round trip through the
+ * Python service; anything that writes or opens a window is passed on to
+ * the wrapped backend, whose change signals are forwarded. A monitor on
+ * the database file drops the cached activity list when hamster commits.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+#include <string.h>
+#include <sqlite3.h>
+#include <gio/gio.h>
+#include <libxfce4util/libxfce4util.h>
+#include "backend.h"
+#include "util.h"
+
+#define DAY_SECONDS (24 * 60 * 60)
+#define TAG_SEPARATOR "\x1f"
+#define DEBOUNCE_MS 250
+
+static const gchar *const sql_facts =
+   "SELECT f.id,"
+   " CAST(strftime('%s', f.start_time) AS INTEGER),"
+   " COALESCE(CAST(strftime('%s', f.end_time) AS INTEGER), 0),"
+   " COALESCE(f.description, ''),"
+   " a.name,"
+   " a.id,"
+   " COALESCE(c.name, ''),"
+   " (SELECT group_concat(t.name, char(31)) FROM fact_tags ft"
+   "   JOIN tags t ON t.id = ft.tag_id WHERE ft.fact_id = f.id)"
+   " FROM facts f"
+   " JOIN activities a ON a.id = f.activity_id"
+   " LEFT JOIN categories c ON c.id = a.category_id"
+   /* whatever overlaps the range, a running fact has no end yet */
+   " WHERE f.start_time < ?2 AND (f.end_time IS NULL OR f.end_time > ?1)"
+   " ORDER BY f.start_time";
+
+static const gchar *const sql_activities =
+   "SELECT a.name, COALESCE(c.name, '')"
+   " FROM activities a"
+   " LEFT JOIN categories c ON c.id = a.category_id"
+   " LEFT JOIN facts f ON f.activity_id = a.id"
+   " WHERE a.deleted IS NULL"
+   " GROUP BY a.id"
+   " ORDER BY max(f.start_time) DESC, lower(a.name)";
+
+typedef struct
+{
+   HamsterBackend   parent;
+   HamsterBackend  *writer;
+   sqlite3         *db;
+   sqlite3_stmt    *stmtFacts;
+   sqlite3_stmt    *stmtActivities;
+   GMutex           lock;
+   gint             dayStart;     /* hamster's, seconds after midnight */
+   GVariant        *activities;   /* cached a(ss), NULL when stale */
+   GFileMonitor    *monitor;
+   GFileMonitor    *monitorWal;
+   guint            debounce;
+} SqliteBackend;
+
+#define SQLITE_BACKEND(b) ((SqliteBackend*)(b))
+
+gchar*
+hamster_backend_sqlite_find_db(void)
+{
+   const gchar *const dirs[] = { "hamster", "hamster-applet", NULL };
+   gint i;
+
+   for(i = 0; dirs[i]; i++)
+   {
+      gchar *path = g_build_filename(g_get_user_data_dir(), dirs[i],
+            "hamster.db", NULL);
+      if(g_file_test(path, G_FILE_TEST_IS_REGULAR))
+         return path;
+      g_free(path);
+   }
+   return NULL;
+}
+
+static void
+sqlite_backend_set_error(SqliteBackend *self, GError **error)
+{
+   g_set_error(error, G_IO_ERROR, G_IO_ERROR_FAILED, "hamster.db: %s",
+         sqlite3_errmsg(self->db));
+}
+
+static gchar*
+sqlite_backend_stamp(time_t t)
+{
+   GDateTime *dt = g_date_time_new_from_unix_utc(t);
+   gchar *stamp = g_date_time_format(dt, "%Y-%m-%d %H:%M:%S");
+   g_date_time_unref(dt);
+   return stamp;
+}
+
+/* the day a fact counts for, as hamster reports it: midnight of the day
+ * whose day_start it follows */
+static gint
+sqlite_backend_date(const SqliteBackend *self, time_t start)
+{
+   time_t shifted = start - self->dayStart;
+   return shifted - shifted % DAY_SECONDS;
+}
+
+/* [from, to) in hamster's local epoch seconds */
+static GVariant*
+sqlite_backend_query_facts(SqliteBackend *self, time_t from, time_t to,
+                           GError **error)
+{
+   GVariantBuilder builder;
+   gchar *lo = sqlite_backend_stamp(from);
+   gchar *hi = sqlite_backend_stamp(to);
+   gint now = util_local_now();
+   gint rc;
+
+   g_variant_builder_init(&builder, G_VARIANT_TYPE("a(iiissisasii)"));
+   g_mutex_lock(&self->lock);
+   sqlite3_bind_text(self->stmtFacts, 1, lo, -1, SQLITE_TRANSIENT);
+   sqlite3_bind_text(self->stmtFacts, 2, hi, -1, SQLITE_TRANSIENT);
+   while((rc = sqlite3_step(self->stmtFacts)) == SQLITE_ROW)
+   {
+      sqlite3_stmt *s = self->stmtFacts;
+      const gchar *tags = (const gchar*)sqlite3_column_text(s, 7);
+      gchar **tagv = g_strsplit(tags ? tags : "", TAG_SEPARATOR, -1);
+      gint start = sqlite3_column_int(s, 1);
+      gint end = sqlite3_column_int(s, 2);
+
+      g_variant_builder_add(&builder, "(iiissis^asii)",
+            sqlite3_column_int(s, 0),
+            start,
+            end,
+            (const gchar*)sqlite3_column_text(s, 3),
+            (const gchar*)sqlite3_column_text(s, 4),
+            sqlite3_column_int(s, 5),
+            (const gchar*)sqlite3_column_text(s, 6),
+            tagv,
+            sqlite_backend_date(self, start),
+            (end ? end : now) - start);
+      g_strfreev(tagv);
+   }
+   if(rc != SQLITE_DONE)
+      sqlite_backend_set_error(self, error);
+   sqlite3_reset(self->stmtFacts);
+   sqlite3_clear_bindings(self->stmtFacts);
+   g_mutex_unlock(&self->lock);
+   g_free(lo);
+   g_free(hi);
+
+   if(rc != SQLITE_DONE)
+   {
+      g_variant_builder_clear(&builder);
+      return NULL;
+   }
+   return g_variant_ref_sink(g_variant_builder_end(&builder));
+}
+
+static GVariant*
+sqlite_backend_get_todays_facts(HamsterBackend *backend, GError **error)
+{
+   SqliteBackend *self = SQLITE_BACKEND(backend);
+   time_t today = sqlite_backend_date(self, util_local_now()) + self->dayStart;
+   return sqlite_backend_query_facts(self, today, today + DAY_SECONDS, error);
+}
+
+static GVariant*
+sqlite_backend_get_facts(HamsterBackend *backend, guint start_date,
+                         guint end_date, const gchar *search, GError **error)
+{
+   SqliteBackend *self = SQLITE_BACKEND(backend);
+
+   /* hamster's search syntax stays with hamster */
+   if(*search)
+      return hamster_backend_get_facts(self->writer, start_date, end_date,
+            search, error);
+   return sqlite_backend_query_facts(self, (time_t)start_date + self->dayStart,
+         (time_t)end_date + DAY_SECONDS + self->dayStart, error);
+}
+
+static GVariant*
+sqlite_backend_get_activities(HamsterBackend *backend, const gchar *search,
+                              GError **error)
+{
+   SqliteBackend *self = SQLITE_BACKEND(backend);
+   GVariantBuilder builder;
+   GVariant *res;
+   gint rc;
+
+   if(*search)
+      return hamster_backend_get_activities(self->writer, search, error);
+
+   g_mutex_lock(&self->lock);
+   if(self->activities)
+   {
+      res = g_variant_ref(self->activities);
+      g_mutex_unlock(&self->lock);
+      return res;
+   }
+
+   g_variant_builder_init(&builder, G_VARIANT_TYPE("a(ss)"));
+   while((rc = sqlite3_step(self->stmtActivities)) == SQLITE_ROW)
+   {
+      g_variant_builder_add(&builder, "(ss)",
+            (const gchar*)sqlite3_column_text(self->stmtActivities, 0),
+            (const gchar*)sqlite3_column_text(self->stmtActivities, 1));
+   }
+   sqlite3_reset(self->stmtActivities);
+   if(rc != SQLITE_DONE)
+   {
+      sqlite_backend_set_error(self, error);
+      g_mutex_unlock(&self->lock);
+      g_variant_builder_clear(&builder);
+      return NULL;
+   }
+   self->activities = g_variant_ref_sink(g_variant_builder_end(&builder));
+   res = g_variant_ref(self->activities);
+   g_mutex_unlock(&self->lock);
+   return res;
+}
+
+static void
+sqlite_backend_invalidate(SqliteBackend *self)
+{
+   g_mutex_lock(&self->lock);
+   g_clear_pointer(&self->activities, g_variant_unref);
+   g_mutex_unlock(&self->lock);
+}
+
+/* the catalog is small and fetched once, no need for a statement */
+static GVariant*
+sqlite_backend_get_tags(HamsterBackend *backend, gboolean only_autocomplete,
+                        GError **error)
+{
+   return hamster_backend_get_tags(SQLITE_BACKEND(backend)->writer,
+         only_autocomplete, error);
+}
+
+/* writes and windows go through the wrapped backend */
+static gboolean
+sqlite_backend_add_fact(HamsterBackend *backend, const gchar *fact,
+                        gint start_time, gint end_time, gint *id,
+                        GError **error)
+{
+   return hamster_backend_add_fact(SQLITE_BACKEND(backend)->writer, fact,
+         start_time, end_time, id, error);
+}
+
+/* the writer's answer, passed on */
+static void
+sqlite_backend_cb_added(GObject *source, GAsyncResult *result, GTask *task)
+{
+   GError *error = NULL;
+   gint id = 0;
+
+   if(hamster_backend_add_fact_finish(result, &id, &error))
+      g_task_return_int(task, id);
+   else
+      g_task_return_error(task, error);
+   g_object_unref(task);
+}
+
+static void
+sqlite_backend_add_fact_async(HamsterBackend *backend, const gchar *fact,
+                              gint start_time, gint end_time, GTask *task)
+{
+   hamster_backend_add_fact_async(SQLITE_BACKEND(backend)->writer, fact,
+         start_time, end_time, g_task_get_cancellable(task),
+         (GAsyncReadyCallback)sqlite_backend_cb_added, task);
+}
+
+static gboolean
+sqlite_backend_stop_tracking(HamsterBackend *backend, gint end_time,
+                             GError **error)
+{
+   return hamster_backend_stop_tracking(SQLITE_BACKEND(backend)->writer,
+         end_time, error);
+}
+
+static GVariant*
+sqlite_backend_get_fact(HamsterBackend *backend, gint id, GError **error)
+{
+   return hamster_backend_get_fact(SQLITE_BACKEND(backend)->writer, id, error);
+}
+
+static gboolean
+sqlite_backend_update_fact(HamsterBackend *backend, gint id, const gchar *fact,
+                           gint start_time, gint end_time, gint *new_id,
+                           GError **error)
+{
+   return hamster_backend_update_fact(SQLITE_BACKEND(backend)->writer, id,
+         fact, start_time, end_time, new_id, error);
+}
+
+static void
+sqlite_backend_cb_updated(GObject *source, GAsyncResult *result, GTask *task)
+{
+   GError *error = NULL;
+   gint id = 0;
+
+   if(hamster_backend_update_fact_finish(result, &id, &error))
+      g_task_return_int(task, id);
+   else
+      g_task_return_error(task, error);
+   g_object_unref(task);
+}
+
+static void
+sqlite_backend_update_fact_async(HamsterBackend *backend, gint id,
+                                 const gchar *fact, gint start_time,
+                                 gint end_time, GTask *task)
+{
+   hamster_backend_update_fact_async(SQLITE_BACKEND(backend)->writer, id,
+         fact, start_time, end_time, g_task_get_cancellable(task),
+         (GAsyncReadyCallback)sqlite_backend_cb_updated, task);
+}
+
+static gboolean
+sqlite_backend_edit(HamsterBackend *backend, gint id, GError **error)
+{
+   return hamster_backend_edit(SQLITE_BACKEND(backend)->writer, id, error);
+}
+
+static gboolean
+sqlite_backend_overview(HamsterBackend *backend, GError **error)
+{
+   return hamster_backend_overview(SQLITE_BACKEND(backend)->writer, error);
+}
+
+static gboolean
+sqlite_backend_preferences(HamsterBackend *backend, GError **error)
+{
+   return hamster_backend_preferences(SQLITE_BACKEND(backend)->writer, error);
+}
+
+static void
+sqlite_backend_free(HamsterBackend *backend)
+{
+   SqliteBackend *self = SQLITE_BACKEND(backend);
+
+   if(self->debounce)
+      g_source_remove(self->debounce);
+   if(self->monitor)
+   {
+      g_signal_handlers_disconnect_by_data(self->monitor, self);
+      g_object_unref(self->monitor);
+   }
+   if(self->monitorWal)
+   {
+      g_signal_handlers_disconnect_by_data(self->monitorWal, self);
+      g_object_unref(self->monitorWal);
+   }
+   sqlite3_finalize(self->stmtFacts);
+   sqlite3_finalize(self->stmtActivities);
+   sqlite3_close(self->db);
+   if(self->activities)
+      g_variant_unref(self->activities);
+   g_mutex_clear(&self->lock);
+   hamster_backend_free(self->writer);
+   g_free(self);
+}
+
+static const HamsterBackendIface sqlite_backend_iface =
+{
+   .name             = "sqlite",
+   .get_todays_facts = sqlite_backend_get_todays_facts,
+   .get_facts        = sqlite_backend_get_facts,
+   .get_activities   = sqlite_backend_get_activities,
+   .get_tags         = sqlite_backend_get_tags,
+   .get_fact         = sqlite_backend_get_fact,
+   .add_fact         = sqlite_backend_add_fact,
+   .add_fact_async   = sqlite_backend_add_fact_async,
+   .stop_tracking    = sqlite_backend_stop_tracking,
+   .update_fact      = sqlite_backend_update_fact,
+   .update_fact_async = sqlite_backend_update_fact_async,
+   .edit             = sqlite_backend_edit,
+   .overview         = sqlite_backend_overview,
+   .preferences      = sqlite_backend_preferences,
+   .free             = sqlite_backend_free,
+};
+
+/* the service announced a change: that is authoritative */
+static void
+sqlite_backend_cb_writer(HamsterBackend *writer,
+                         HamsterBackendChange what,
+                         SqliteBackend *self)
+{
+   if(self->debounce)
+   {
+      g_source_remove(self->debounce);
+      self->debounce = 0;
+   }
+   sqlite_backend_invalidate(self);
+   hamster_backend_emit(&self->parent, what);
+}
+
+static gboolean
+sqlite_backend_cb_debounce(SqliteBackend *self)
+{
+   self->debounce = 0;
+   hamster_backend_emit(&self->parent,
+         HAMSTER_BACKEND_FACTS | HAMSTER_BACKEND_ACTIVITIES);
+   return FALSE;
+}
+
+/* someone committed to the database; if the service doesn't tell us about
+ * it shortly, announce it ourselves */
+static void
+sqlite_backend_cb_file(GFileMonitor *monitor,
+                       GFile *file,
+                       GFile *other,
+                       GFileMonitorEvent event,
+                       SqliteBackend *self)
+{
+   if(event != G_FILE_MONITOR_EVENT_CHANGED
+         && event != G_FILE_MONITOR_EVENT_CREATED)
+      return;
+   sqlite_backend_invalidate(self);
+   if(!self->debounce)
+      self->debounce = g_timeout_add(DEBOUNCE_MS,
+            (GSourceFunc)sqlite_backend_cb_debounce, self);
+}
+
+static GFileMonitor*
+sqlite_backend_watch(SqliteBackend *self, const gchar *path)
+{
+   GFile *file = g_file_new_for_path(path);
+   GFileMonitor *monitor = g_file_monitor_file(file, G_FILE_MONITOR_NONE,
+         NULL, NULL);
+   g_object_unref(file);
+   if(monitor)
+      g_signal_connect(monitor, "changed",
+            G_CALLBACK(sqlite_backend_cb_file), self);
+   return monitor;
+}
+
+/*
+ * Returns a backend reading from hamster.db and writing through writer,
+ * which it takes ownership of. If the database can't be used, writer is
+ * returned unchanged.
+ */
+HamsterBackend*
+hamster_backend_sqlite_new(HamsterBackend *writer)
+{
+   SqliteBackend *self;
+   gchar *path, *wal;
+   sqlite3 *db = NULL;
+
+   path = hamster_backend_sqlite_find_db();
+   if(!path)
+   {
+      DBG("no hamster.db, reading through %s", writer->iface->name);
+      return writer;
+   }
+
+   if(sqlite3_open_v2(path, &db, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK)
+   {
+      DBG("%s: %s", path, sqlite3_errmsg(db));
+      sqlite3_close(db);
+      g_free(path);
+      return writer;
+   }
+   /* hamster holds the write lock only briefly */
+   sqlite3_busy_timeout(db, 100);
+
+   self = g_new0(SqliteBackend, 1);
+   self->parent.iface = &sqlite_backend_iface;
+   self->writer = writer;
+   self->db = db;
+   self->dayStart = util_day_start();
+   g_mutex_init(&self->lock);
+
+   if(sqlite3_prepare_v2(db, sql_facts, -1, &self->stmtFacts, NULL) != SQLITE_OK
+      || sqlite3_prepare_v2(db, sql_activities, -1, &self->stmtActivities,
+            NULL) != SQLITE_OK)
+   {
+      /* unknown schema, leave it to the service */
+      DBG("%s: %s", path, sqlite3_errmsg(db));
+      self->writer = NULL;
+      sqlite_backend_free(&self->parent);
+      g_free(path);
+      return writer;
+   }
+
+   hamster_backend_set_notify(writer,
+         (HamsterBackendNotify)sqlite_backend_cb_writer, self);
+
+   wal = g_strconcat(path, "-wal", NULL);
+   self->monitor = sqlite_backend_watch(self, path);
+   self->monitorWal = sqlite_backend_watch(self, wal);
+   g_free(wal);
+
+   DBG("reading from %s", path);
+   g_free(path);
+   return &self->parent;
+}
@@ -0,0 +1,311 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+#include <string.h>
+#include <gio/gio.h>
+#include <libxfce4util/libxfce4util.h>
+#include "backend.h"
+
+#define BACKEND_CHECK(backend, member, error, retval)                   \
+   G_STMT_START {                                                       \
+      g_return_val_if_fail((backend) != NULL, retval);                  \
+      if((backend)->iface->member == NULL)                              \
+      {                                                                 \
+         g_set_error(error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,       \
+               "%s: %s not supported", (backend)->iface->name, #member);\
+         return retval;                                                 \
+      }                                                                 \
+   } G_STMT_END
+
+HamsterBackend*
+hamster_backend_new(gboolean directReads, gboolean standalone)
+{
+   const gchar *which = g_getenv(HAMSTER_BACKEND_ENV);
+   HamsterBackend *backend;
+
+   if(which && !strcmp(which, "memory"))
+   {
+      DBG("using in-memory backend");
+      return hamster_backend_memory_new();
+   }
+#ifdef HAVE_SQLITE
+   if(standalone)
+   {
+      GError *error = NULL;
+      if((backend = hamster_backend_local_new(&error)))
+         return backend;
+      g_warning("%s, using hamster-service", error->message);
+      g_error_free(error);
+   }
+#endif
+   backend = hamster_backend_dbus_new();
+#ifdef HAVE_SQLITE
+   if(directReads)
+      backend = hamster_backend_sqlite_new(backend);
+#endif
+   return backend;
+}
+
+void
+hamster_backend_free(HamsterBackend *backend)
+{
+   if(backend)
+      backend->iface->free(backend);
+}
+
+void
+hamster_backend_set_notify(HamsterBackend *backend,
+                           HamsterBackendNotify notify,
+                           gpointer user_data)
+{
+   g_return_if_fail(backend != NULL);
+   backend->notify = notify;
+   backend->notify_data = user_data;
+}
+
+void
+hamster_backend_emit(HamsterBackend *backend, HamsterBackendChange what)
+{
+   DBG("%s changed %d", backend->iface->name, what);
+   if(backend->notify)
+      backend->notify(backend, what, backend->notify_data);
+}
+
+GVariant*
+hamster_backend_get_todays_facts(HamsterBackend *backend, GError **error)
+{
+   BACKEND_CHECK(backend, get_todays_facts, error, NULL);
+   return backend->iface->get_todays_facts(backend, error);
+}
+
+void
+hamster_backend_get_todays_facts_async(HamsterBackend *backend,
+                                       GCancellable *cancellable,
+                                       GAsyncReadyCallback callback,
+                                       gpointer user_data)
+{
+   GTask *task = g_task_new(NULL, cancellable, callback, user_data);
+   GError *error = NULL;
+   GVariant *res;
+
+   g_task_set_source_tag(task, hamster_backend_get_todays_facts_async);
+   if(backend == NULL)
+   {
+      g_task_return_pointer(task, NULL, NULL);
+      g_object_unref(task);
+      return;
+   }
+   if(backend->iface->get_todays_facts_async)
+   {
+      backend->iface->get_todays_facts_async(backend, task);
+      return;
+   }
+   if((res = hamster_backend_get_todays_facts(backend, &error)))
+      g_task_return_pointer(task, res, (GDestroyNotify)g_variant_unref);
+   else
+      g_task_return_error(task, error);
+   g_object_unref(task);
+}
+
+GVariant*
+hamster_backend_get_todays_facts_finish(GAsyncResult *result, GError **error)
+{
+   g_return_val_if_fail(g_task_is_valid(result, NULL), NULL);
+   return g_task_propagate_pointer(G_TASK(result), error);
+}
+
+GVariant*
+hamster_backend_get_facts(HamsterBackend *backend, guint start_date,
+                          guint end_date, const gchar *search, GError **error)
+{
+   BACKEND_CHECK(backend, get_facts, error, NULL);
+   return backend->iface->get_facts(backend, start_date, end_date,
+         search ? search : "", error);
+}
+
+GVariant*
+hamster_backend_get_activities(HamsterBackend *backend, const gchar *search,
+                               GError **error)
+{
+   BACKEND_CHECK(backend, get_activities, error, NULL);
+   return backend->iface->get_activities(backend, search ? search : "", error);
+}
+
+GVariant*
+hamster_backend_get_tags(HamsterBackend *backend, gboolean only_autocomplete,
+                         GError **error)
+{
+   BACKEND_CHECK(backend, get_tags, error, NULL);
+   return backend->iface->get_tags(backend, only_autocomplete, error);
+}
+
+gboolean
+hamster_backend_add_fact(HamsterBackend *backend, const gchar *fact,
+                         gint start_time, gint end_time, gint *id,
+                         GError **error)
+{
+   gint unused;
+   BACKEND_CHECK(backend, add_fact, error, FALSE);
+   return backend->iface->add_fact(backend, fact, start_time, end_time,
+         id ? id : &unused, error);
+}
+
+void
+hamster_backend_add_fact_async(HamsterBackend *backend, const gchar *fact,
+                               gint start_time, gint end_time,
+                               GCancellable *cancellable,
+                               GAsyncReadyCallback callback,
+                               gpointer user_data)
+{
+   GTask *task = g_task_new(NULL, cancellable, callback, user_data);
+   GError *error = NULL;
+   gint id = 0;
+
+   g_task_set_source_tag(task, hamster_backend_add_fact_async);
+   if(backend == NULL)
+   {
+      g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_NOT_CONNECTED,
+            "no backend");
+      g_object_unref(task);
+      return;
+   }
+   if(backend->iface->add_fact_async)
+   {
+      backend->iface->add_fact_async(backend, fact, start_time, end_time,
+            task);
+      return;
+   }
+   if(hamster_backend_add_fact(backend, fact, start_time, end_time, &id,
+            &error))
+      g_task_return_int(task, id);
+   else
+      g_task_return_error(task, error);
+   g_object_unref(task);
+}
+
+gboolean
+hamster_backend_add_fact_finish(GAsyncResult *result, gint *id,
+                                GError **error)
+{
+   gssize ret;
+
+   g_return_val_if_fail(g_task_is_valid(result, NULL), FALSE);
+   ret = g_task_propagate_int(G_TASK(result), error);
+   if(ret < 0)
+      return FALSE;
+   if(id)
+      *id = ret;
+   return TRUE;
+}
+
+gboolean
+hamster_backend_stop_tracking(HamsterBackend *backend, gint end_time,
+                              GError **error)
+{
+   BACKEND_CHECK(backend, stop_tracking, error, FALSE);
+   return backend->iface->stop_tracking(backend, end_time, error);
+}
+
+GVariant*
+hamster_backend_get_fact(HamsterBackend *backend, gint id, GError **error)
+{
+   BACKEND_CHECK(backend, get_fact, error, NULL);
+   return backend->iface->get_fact(backend, id, error);
+}
+
+gboolean
+hamster_backend_update_fact(HamsterBackend *backend, gint id,
+                            const gchar *fact, gint start_time, gint end_time,
+                            gint *new_id, GError **error)
+{
+   BACKEND_CHECK(backend, update_fact, error, FALSE);
+   return backend->iface->update_fact(backend, id, fact, start_time, end_time,
+         new_id, error);
+}
+
+void
+hamster_backend_update_fact_async(HamsterBackend *backend, gint id,
+                                  const gchar *fact, gint start_time,
+                                  gint end_time, GCancellable *cancellable,
+                                  GAsyncReadyCallback callback,
+                                  gpointer user_data)
+{
+   GTask *task = g_task_new(NULL, cancellable, callback, user_data);
+   GError *error = NULL;
+   gint new_id = 0;
+
+   g_task_set_source_tag(task, hamster_backend_update_fact_async);
+   if(backend == NULL)
+   {
+      g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_NOT_CONNECTED,
+            "no backend");
+      g_object_unref(task);
+      return;
+   }
+   if(backend->iface->update_fact_async)
+   {
+      backend->iface->update_fact_async(backend, id, fact, start_time,
+            end_time, task);
+      return;
+   }
+   if(hamster_backend_update_fact(backend, id, fact, start_time, end_time,
+            &new_id, &error))
+      g_task_return_int(task, new_id);
+   else
+      g_task_return_error(task, error);
+   g_object_unref(task);
+}
+
+gboolean
+hamster_backend_update_fact_finish(GAsyncResult *result, gint *new_id,
+                                   GError **error)
+{
+   gssize ret;
+
+   g_return_val_if_fail(g_task_is_valid(result, NULL), FALSE);
+   ret = g_task_propagate_int(G_TASK(result), error);
+   if(ret < 0)
+      return FALSE;
+   if(new_id)
+      *new_id = ret;
+   return TRUE;
+}
+
+gboolean
+hamster_backend_edit(HamsterBackend *backend, gint id, GError **error)
+{
+   BACKEND_CHECK(backend, edit, error, FALSE);
+   return backend->iface->edit(backend, id, error);
+}
+
+gboolean
+hamster_backend_overview(HamsterBackend *backend, GError **error)
+{
+   BACKEND_CHECK(backend, overview, error, FALSE);
+   return backend->iface->overview(backend, error);
+}
+
+gboolean
+hamster_backend_preferences(HamsterBackend *backend, GError **error)
+{
+   BACKEND_CHECK(backend, preferences, error, FALSE);
+   return backend->iface->preferences(backend, error);
+}
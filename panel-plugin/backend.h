@@ -0,0 +1,209 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <glib.h>
+#include <gio/gio.h>
+
+/*
+ * A backend is whatever answers the questions the view asks: the hamster
+ * D-Bus service normally, an in-memory fake when profiling the UI.
+ * Replies keep the org.gnome.Hamster wire signatures so fact_new() works
+ * for every provider:
+ *   facts      a(iiissisasii), or as of JSON facts from the JSON API
+ *   fact       (iiissisasii), or s
+ *   activities a(ss)
+ *   tags       a(isb)
+ */
+
+#define HAMSTER_BACKEND_ENV "XFCE4_HAMSTER_BACKEND"
+
+typedef struct _HamsterBackend HamsterBackend;
+typedef struct _HamsterBackendIface HamsterBackendIface;
+
+typedef enum
+{
+   HAMSTER_BACKEND_FACTS      = 1 << 0,
+   HAMSTER_BACKEND_ACTIVITIES = 1 << 1,
+   HAMSTER_BACKEND_TAGS       = 1 << 2
+} HamsterBackendChange;
+
+typedef void (*HamsterBackendNotify)(HamsterBackend *backend,
+                                     HamsterBackendChange what,
+                                     gpointer user_data);
+
+struct _HamsterBackendIface
+{
+   const gchar *name;
+
+   /* reads */
+   GVariant* (*get_todays_facts)(HamsterBackend*, GError**);
+   /* optional, returns the reply as the task's pointer */
+   void (*get_todays_facts_async)(HamsterBackend*, GTask *task);
+   GVariant* (*get_facts)(HamsterBackend*, guint start_date, guint end_date,
+                          const gchar *search, GError**);
+   GVariant* (*get_activities)(HamsterBackend*, const gchar *search, GError**);
+   GVariant* (*get_tags)(HamsterBackend*, gboolean only_autocomplete, GError**);
+   GVariant* (*get_fact)(HamsterBackend*, gint id, GError**);
+
+   /* writes */
+   gboolean (*add_fact)(HamsterBackend*, const gchar *fact, gint start_time,
+                        gint end_time, gint *id, GError**);
+   /* optional, returns the id as the task's int */
+   void (*add_fact_async)(HamsterBackend*, const gchar *fact, gint start_time,
+                          gint end_time, GTask *task);
+   gboolean (*stop_tracking)(HamsterBackend*, gint end_time, GError**);
+   /* like hamster, the fact may come back with a new id */
+   gboolean (*update_fact)(HamsterBackend*, gint id, const gchar *fact,
+                           gint start_time, gint end_time, gint *new_id,
+                           GError**);
+   /* optional, returns the new id as the task's int */
+   void (*update_fact_async)(HamsterBackend*, gint id, const gchar *fact,
+                             gint start_time, gint end_time, GTask *task);
+
+   /* tracker windows, optional; id 0 edits a new fact */
+   gboolean (*edit)(HamsterBackend*, gint id, GError**);
+   gboolean (*overview)(HamsterBackend*, GError**);
+   gboolean (*preferences)(HamsterBackend*, GError**);
+
+   void (*free)(HamsterBackend*);
+};
+
+struct _HamsterBackend
+{
+   const HamsterBackendIface *iface;
+   HamsterBackendNotify       notify;
+   gpointer                   notify_data;
+};
+
+/* providers */
+HamsterBackend*
+hamster_backend_dbus_new(void);
+
+HamsterBackend*
+hamster_backend_memory_new(void);
+
+void
+hamster_backend_memory_add_activity(HamsterBackend *backend,
+                                    const gchar *activity,
+                                    const gchar *category);
+
+HamsterBackend*
+hamster_backend_sqlite_new(HamsterBackend *writer);
+
+/* hamster.db where hamster keeps it, NULL if there is none */
+gchar*
+hamster_backend_sqlite_find_db(void);
+
+/* hamster.db without the service, see backend-local.c */
+HamsterBackend*
+hamster_backend_local_new(GError **error);
+
+/* picks a provider, honoring $XFCE4_HAMSTER_BACKEND=memory; standalone
+ * falls back to the service if hamster.db can't be used */
+HamsterBackend*
+hamster_backend_new(gboolean directReads, gboolean standalone);
+
+void
+hamster_backend_free(HamsterBackend *backend);
+
+void
+hamster_backend_set_notify(HamsterBackend *backend,
+                           HamsterBackendNotify notify,
+                           gpointer user_data);
+
+/* for providers */
+void
+hamster_backend_emit(HamsterBackend *backend, HamsterBackendChange what);
+
+/* dispatch */
+GVariant*
+hamster_backend_get_todays_facts(HamsterBackend *backend, GError **error);
+
+/* local providers answer at once and only defer the callback */
+void
+hamster_backend_get_todays_facts_async(HamsterBackend *backend,
+                                       GCancellable *cancellable,
+                                       GAsyncReadyCallback callback,
+                                       gpointer user_data);
+
+/* does not need the backend, it may have been replaced meanwhile */
+GVariant*
+hamster_backend_get_todays_facts_finish(GAsyncResult *result, GError **error);
+
+GVariant*
+hamster_backend_get_facts(HamsterBackend *backend, guint start_date,
+                          guint end_date, const gchar *search, GError **error);
+
+GVariant*
+hamster_backend_get_activities(HamsterBackend *backend, const gchar *search,
+                               GError **error);
+
+GVariant*
+hamster_backend_get_tags(HamsterBackend *backend, gboolean only_autocomplete,
+                         GError **error);
+
+GVariant*
+hamster_backend_get_fact(HamsterBackend *backend, gint id, GError **error);
+
+gboolean
+hamster_backend_add_fact(HamsterBackend *backend, const gchar *fact,
+                         gint start_time, gint end_time, gint *id,
+                         GError **error);
+
+/* for many facts in flight at once, see import.c */
+void
+hamster_backend_add_fact_async(HamsterBackend *backend, const gchar *fact,
+                               gint start_time, gint end_time,
+                               GCancellable *cancellable,
+                               GAsyncReadyCallback callback,
+                               gpointer user_data);
+
+gboolean
+hamster_backend_add_fact_finish(GAsyncResult *result, gint *id,
+                                GError **error);
+
+gboolean
+hamster_backend_stop_tracking(HamsterBackend *backend, gint end_time,
+                              GError **error);
+
+gboolean
+hamster_backend_update_fact(HamsterBackend *backend, gint id,
+                            const gchar *fact, gint start_time, gint end_time,
+                            gint *new_id, GError **error);
+
+/* keeps the popup responsive while the service writes, see editor.c */
+void
+hamster_backend_update_fact_async(HamsterBackend *backend, gint id,
+                                  const gchar *fact, gint start_time,
+                                  gint end_time, GCancellable *cancellable,
+                                  GAsyncReadyCallback callback,
+                                  gpointer user_data);
+
+gboolean
+hamster_backend_update_fact_finish(GAsyncResult *result, gint *new_id,
+                                   GError **error);
+
+gboolean
+hamster_backend_edit(HamsterBackend *backend, gint id, GError **error);
+
+gboolean
+hamster_backend_overview(HamsterBackend *backend, GError **error);
+
+gboolean
+hamster_backend_preferences(HamsterBackend *backend, GError **error);
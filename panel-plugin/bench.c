@@ -0,0 +1,114 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+#include <string.h>
+#include <time.h>
+#include "bench.h"
+
+#define DAY_SECONDS (24 * 60 * 60)
+#define CATEGORIES 8
+
+static const gchar *categories[CATEGORIES] =
+{
+   "Work", "Meetings", "Email", "Study", "Reading", "Exercise", "Chores",
+   "Long category name with some unicode: Überstunden"
+};
+
+GVariant*
+bench_facts_reply(gint count)
+{
+   GVariantBuilder builder;
+   time_t day = BENCH_DAY;
+   gint span = MAX(DAY_SECONDS / MAX(count, 1), 1);
+   gint i;
+
+   g_variant_builder_init(&builder, G_VARIANT_TYPE("a(iiissisasii)"));
+   for(i = 0; i < count; i++)
+   {
+      const gchar *tags[] = { "client-a", "billable", "focus", NULL };
+      gchar *name = g_strdup_printf("activity %d", i % 37);
+      gchar *description = i % 3 ? g_strdup_printf("ticket #%d", i) : g_strdup("");
+      gint start = day + i * span;
+      gboolean running = i == count - 1;
+
+      /* zero to three tags */
+      tags[i % 4] = NULL;
+      g_variant_builder_add(&builder, "(iiissis^asii)",
+            i + 1, start, running ? 0 : start + span, description, name,
+            i % 37, categories[i % CATEGORIES], tags, (gint)day, span);
+      g_free(name);
+      g_free(description);
+   }
+   return g_variant_ref_sink(g_variant_builder_end(&builder));
+}
+
+/* "YYYY-MM-DD HH:MM", the first ten for the date */
+static void
+bench_format_time(gchar *buf, gsize size, time_t t)
+{
+   struct tm tm;
+
+   gmtime_r(&t, &tm);
+   strftime(buf, size, "%Y-%m-%d %H:%M", &tm);
+}
+
+GVariant*
+bench_facts_reply_json(gint count)
+{
+   GVariantBuilder builder;
+   GVariant *tuples = bench_facts_reply(count);
+   GString *str = g_string_new(NULL);
+   gsize i, n = g_variant_n_children(tuples);
+
+   /* the same facts, as the JSON API lists them */
+   g_variant_builder_init(&builder, G_VARIANT_TYPE("as"));
+   for(i = 0; i < n; i++)
+   {
+      GVariant *child = g_variant_get_child_value(tuples, i);
+      gint id, start, end, activityId, date, seconds;
+      const gchar *description, *name, *category, **tags, **tag;
+      gchar startText[20], endText[20];
+
+      g_variant_get(child, "(ii&s&si&s^a&sii)", &id, &start, &end,
+            &description, &name, &activityId, &category, &tags, &date,
+            &seconds);
+      bench_format_time(startText, sizeof(startText), start);
+      bench_format_time(endText, sizeof(endText), end);
+      /* nothing here needs escaping */
+      g_string_printf(str, "{\"activity\": \"%s\", \"category\": \"%s\", "
+            "\"description\": \"%s\", \"tags\": [",
+            name, category, description);
+      for(tag = tags; *tag; tag++)
+         g_string_append_printf(str, tag == tags ? "\"%s\"" : ", \"%s\"", *tag);
+      /* the end's date only when it differs from the start's */
+      g_string_append_printf(str, "], \"id\": %d, \"activity_id\": %d, "
+            "\"exported\": false, \"range\": \"%s - %s\"}",
+            id, activityId, startText,
+            !end ? "--" : memcmp(startText, endText, 10) ? endText
+            : endText + 11);
+      g_variant_builder_add(&builder, "s", str->str);
+      g_free(tags);
+      g_variant_unref(child);
+   }
+   g_string_free(str, TRUE);
+   g_variant_unref(tuples);
+   return g_variant_ref_sink(g_variant_builder_end(&builder));
+}
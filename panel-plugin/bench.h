@@ -0,0 +1,34 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <glib.h>
+
+/* synthetic data for the benchmark programs, not part of the plugin */
+
+/* midnight of the day the facts are on */
+#define BENCH_DAY (1700000000 - 1700000000 % (24 * 60 * 60))
+
+/* a GetTodaysFacts reply of count facts laid out back to back over the
+ * day, the last one running */
+GVariant*
+bench_facts_reply(gint count);
+
+/* the same facts as GetTodaysFactsJSON would list them */
+GVariant*
+bench_facts_reply_json(gint count);
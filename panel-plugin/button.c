@@ -56,6 +56,7 @@
 #include "button.h"
 
 #define BOX_SPACING 2
+#define PROGRESS_THICKNESS 4
 
 enum
 {
@@ -103,10 +104,30 @@ places_button_set_label(PlacesButton *self, const gchar *label)
     places_button_resize(self);
 }
 
+void
+places_button_set_progress(PlacesButton *self, gint percent)
+{
+    g_assert(PLACES_IS_BUTTON(self));
+
+    percent = CLAMP(percent, -1, 100);
+    if (percent == self->percent)
+        return;
+
+    DBG("new progress: %d", percent);
+    self->percent = percent;
+
+    if (self->progress == NULL)
+        return;
+    gtk_widget_set_visible(self->progress, percent >= 0);
+    gtk_widget_queue_draw(self->progress);
+}
+
 void
 places_button_set_ellipsize(PlacesButton *self, gboolean ellipsize)
 {
    g_assert(PLACES_IS_BUTTON(self));
+   if (self->ellipsize == ellipsize)
+      return;
    self->ellipsize = ellipsize;
 
    places_button_resize(self);
@@ -203,8 +224,42 @@ places_button_init(PlacesButton *self)
     self->plugin = NULL;
     self->box = NULL;
     self->label = NULL;
+    self->progress = NULL;
     self->plugin_size = -1;
     self->ellipsize = FALSE;
+    self->percent = -1;
+}
+
+static gboolean
+places_button_progress_draw(GtkWidget *widget, cairo_t *cr, PlacesButton *self)
+{
+    GtkStyleContext *context;
+    GdkRGBA color;
+    gint width, height, filled;
+
+    width = gtk_widget_get_allocated_width(widget);
+    height = gtk_widget_get_allocated_height(widget);
+    context = gtk_widget_get_style_context(GTK_WIDGET(self));
+    gtk_style_context_get_color(context,
+        gtk_style_context_get_state(context), &color);
+
+    /* track */
+    cairo_set_source_rgba(cr, color.red, color.green, color.blue, 0.25);
+    cairo_rectangle(cr, 0, 0, width, height);
+    cairo_fill(cr);
+
+    /* fill grows upwards, or rightwards in a vertical panel */
+    cairo_set_source_rgba(cr, color.red, color.green, color.blue, 0.9);
+    if (width <= height) {
+        filled = height * self->percent / 100;
+        cairo_rectangle(cr, 0, height - filled, width, filled);
+    } else {
+        filled = width * self->percent / 100;
+        cairo_rectangle(cr, 0, 0, filled, height);
+    }
+    cairo_fill(cr);
+
+    return FALSE;
 }
 
 static void
@@ -227,6 +282,13 @@ places_button_construct(PlacesButton *self, XfcePanelPlugin *plugin)
     gtk_container_add(GTK_CONTAINER(self), self->box);
     gtk_widget_show(self->box);
 
+    self->progress = gtk_drawing_area_new();
+    gtk_widget_set_no_show_all(self->progress, TRUE);
+    gtk_widget_set_visible(self->progress, self->percent >= 0);
+    gtk_box_pack_start(GTK_BOX(self->box), self->progress, FALSE, FALSE, 0);
+    g_signal_connect(G_OBJECT(self->progress), "draw",
+                     G_CALLBACK(places_button_progress_draw), self);
+
     places_button_resize(self);
 
     g_signal_connect(G_OBJECT(plugin), "mode-changed",
@@ -332,7 +394,7 @@ places_button_resize_label(PlacesButton *self,
         gtk_widget_set_valign(self->label, GTK_ALIGN_CENTER);
       }
     if(self->ellipsize)
-       gtk_label_set_max_width_chars (GTK_LABEL (self->label), 25);
+       gtk_label_set_max_width_chars (GTK_LABEL (self->label), PLACES_BUTTON_MAX_CHARS);
     else
        gtk_label_set_max_width_chars (GTK_LABEL (self->label), 255);
 
@@ -382,6 +444,14 @@ places_button_resize(PlacesButton *self)
           gtk_widget_set_valign(self->box, GTK_ALIGN_CENTER);
     }
 
+    /* progress bar runs along the panel's short side */
+    if (self->progress != NULL) {
+        if (vertical)
+            gtk_widget_set_size_request(self->progress, -1, PROGRESS_THICKNESS);
+        else
+            gtk_widget_set_size_request(self->progress, PROGRESS_THICKNESS, -1);
+    }
+
     /* label */
     places_button_resize_label(self, show_label);
 }
@@ -38,6 +38,9 @@ typedef struct _PlacesButtonClass       PlacesButtonClass;
 
 typedef GdkPixbuf* (places_button_image_pixbuf_factory) (int size);
 
+/* label width when ellipsizing */
+#define PLACES_BUTTON_MAX_CHARS 25
+
 struct _PlacesButton
 {
     GtkToggleButton parent;
@@ -46,7 +49,9 @@ struct _PlacesButton
     XfcePanelPlugin *plugin;
     GtkWidget *box;
     GtkWidget *label;
+    GtkWidget *progress;
     gchar *label_text;
+    gint percent;
     gint plugin_size;
     gulong style_set_id;
     gulong screen_changed_id;
@@ -70,6 +75,10 @@ places_button_set_label(PlacesButton*, const gchar *label);
 void
 places_button_set_ellipsize(PlacesButton *self, gboolean ellipsize);
 
+/* 0..100 draws a thin bar next to the label, -1 hides it */
+void
+places_button_set_progress(PlacesButton *self, gint percent);
+
 const gchar*
 places_button_get_label(PlacesButton*);
 
@@ -0,0 +1,440 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+#include <stdio.h>
+#include <string.h>
+#include <libxfce4util/libxfce4util.h>
+#include "editor.h"
+#include "parser.h"
+#include "util.h"
+
+#define DAY_SECONDS (24 * 60 * 60)
+#define DAY_MINUTES (24 * 60)
+#define NEW_FACT_MINUTES 60
+
+struct _HamsterEditor
+{
+   HamsterEditorDone done;
+   gpointer data;
+   HamsterBackend *backend;    /* while open */
+   gint id;                    /* 0 for a new fact */
+   time_t day;                 /* the fact's date */
+   GCancellable *saving;       /* the write in flight */
+
+   GtkWidget *grid;
+   GtkWidget *start;
+   GtkWidget *end;
+   GtkWidget *running;
+   GtkWidget *name;
+   GtkWidget *category;
+   GtkWidget *description;
+   GtkWidget *tags;
+   GtkWidget *error;
+};
+
+/* Time spinners hold minutes of the day, shown as HH:MM */
+
+static gboolean
+editor_cb_time_output(GtkSpinButton *spin, gpointer unused)
+{
+   gint minutes = gtk_spin_button_get_value_as_int(spin);
+   gchar text[8];
+
+   g_snprintf(text, sizeof(text), "%02d:%02d", minutes / 60, minutes % 60);
+   if(strcmp(text, gtk_entry_get_text(GTK_ENTRY(spin))))
+      gtk_entry_set_text(GTK_ENTRY(spin), text);
+   return TRUE;
+}
+
+static gint
+editor_cb_time_input(GtkSpinButton *spin, gdouble *value, gpointer unused)
+{
+   const gchar *text = gtk_entry_get_text(GTK_ENTRY(spin));
+   gint h, m;
+
+   if(sscanf(text, "%d:%d", &h, &m) != 2 && sscanf(text, "%d.%d", &h, &m) != 2)
+      return GTK_INPUT_ERROR;
+   if(h < 0 || h > 23 || m < 0 || m > 59)
+      return GTK_INPUT_ERROR;
+   *value = h * 60 + m;
+   return TRUE;
+}
+
+static GtkWidget*
+editor_time_new(void)
+{
+   GtkWidget *spin = gtk_spin_button_new_with_range(0, DAY_MINUTES - 1, 5);
+
+   gtk_spin_button_set_wrap(GTK_SPIN_BUTTON(spin), TRUE);
+   gtk_entry_set_width_chars(GTK_ENTRY(spin), 5);
+   g_signal_connect(spin, "output", G_CALLBACK(editor_cb_time_output), NULL);
+   g_signal_connect(spin, "input", G_CALLBACK(editor_cb_time_input), NULL);
+   return spin;
+}
+
+static void
+editor_time_set(GtkWidget *spin, time_t t)
+{
+   gtk_spin_button_set_value(GTK_SPIN_BUTTON(spin), (t % DAY_SECONDS) / 60);
+}
+
+static time_t
+editor_time_get(HamsterEditor *self, GtkWidget *spin)
+{
+   gtk_spin_button_update(GTK_SPIN_BUTTON(spin));
+   return self->day + gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(spin)) * 60;
+}
+
+/* Saving */
+
+static void
+editor_finish(HamsterEditor *self, HamsterEditorResult result, gint id)
+{
+   /* the service may still write it, we just don't wait */
+   if(self->saving)
+   {
+      g_cancellable_cancel(self->saving);
+      g_clear_object(&self->saving);
+   }
+   gtk_widget_set_sensitive(self->grid, TRUE);
+   self->backend = NULL;
+   gtk_widget_hide(self->grid);
+   self->done(result, id, self->data);
+}
+
+static void
+editor_fail(HamsterEditor *self, const gchar *message)
+{
+   gtk_label_set_text(GTK_LABEL(self->error), message);
+   gtk_widget_show(self->error);
+   gtk_widget_error_bell(self->grid);
+}
+
+/* "#a b, c" -> {"a", "b", "c"} */
+static gchar**
+editor_tags_split(const gchar *text)
+{
+   GPtrArray *tags = g_ptr_array_new();
+   gchar **words = g_strsplit_set(text, " \t,", -1);
+   gchar **word;
+
+   for(word = words; *word; word++)
+   {
+      const gchar *tag = *word;
+      while(*tag == '#')
+         tag++;
+      if(*tag)
+         g_ptr_array_add(tags, g_strdup(tag));
+   }
+   g_strfreev(words);
+   g_ptr_array_add(tags, NULL);
+   return (gchar**)g_ptr_array_free(tags, FALSE);
+}
+
+static gchar*
+editor_strip_dup(GtkWidget *entry)
+{
+   gchar *text = g_strstrip(g_strdup(gtk_entry_get_text(GTK_ENTRY(entry))));
+   if(!*text)
+   {
+      g_free(text);
+      return NULL;
+   }
+   return text;
+}
+
+/* cancelled means we closed or went away meanwhile */
+static void
+editor_cb_saved(GObject *source, GAsyncResult *result, HamsterEditor *self)
+{
+   GError *error = NULL;
+   gboolean ok;
+   gint id = 0;
+
+   if(g_task_get_source_tag(G_TASK(result))
+         == (gpointer)hamster_backend_update_fact_async)
+      ok = hamster_backend_update_fact_finish(result, &id, &error);
+   else
+      ok = hamster_backend_add_fact_finish(result, &id, &error);
+   if(!ok && g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+   {
+      g_error_free(error);
+      return;
+   }
+   g_clear_object(&self->saving);
+   gtk_widget_set_sensitive(self->grid, TRUE);
+   DBG("saved [%d]", id);
+   if(ok)
+      editor_finish(self, HAMSTER_EDITOR_SAVED, id);
+   else
+   {
+      editor_fail(self, error->message);
+      g_error_free(error);
+   }
+}
+
+static void
+editor_cb_save(GtkWidget *widget, HamsterEditor *self)
+{
+   fact_spec spec = { 0 };
+   gchar *text;
+
+   if(!self->backend || self->saving)
+      return;
+   spec.name = editor_strip_dup(self->name);
+   spec.category = editor_strip_dup(self->category);
+   spec.description = editor_strip_dup(self->description);
+   spec.tags = editor_tags_split(gtk_entry_get_text(GTK_ENTRY(self->tags)));
+   spec.startTime = editor_time_get(self, self->start);
+   if(!gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(self->running)))
+   {
+      spec.endTime = editor_time_get(self, self->end);
+      /* past midnight */
+      if(spec.endTime <= spec.startTime)
+         spec.endTime += DAY_SECONDS;
+   }
+
+   /* these would be read back as part of the fact syntax */
+   if(!spec.name)
+      editor_fail(self, _("Activity is missing"));
+   else if(strpbrk(spec.name, "@,#"))
+      editor_fail(self, _("Activity can't contain '@', ',' or '#'"));
+   else if(spec.category && strpbrk(spec.category, ",#"))
+      editor_fail(self, _("Category can't contain ',' or '#'"));
+   else if(!spec.endTime && spec.startTime > util_local_now())
+      editor_fail(self, _("Starts in the future"));
+   else
+   {
+      text = fact_spec_to_string(&spec);
+      DBG("saving %s", text);
+      /* the popup stays as it is until the service answers */
+      self->saving = g_cancellable_new();
+      gtk_widget_set_sensitive(self->grid, FALSE);
+      if(self->id)
+         hamster_backend_update_fact_async(self->backend, self->id, text,
+               spec.startTime, spec.endTime, self->saving,
+               (GAsyncReadyCallback)editor_cb_saved, self);
+      else
+         hamster_backend_add_fact_async(self->backend, text, spec.startTime,
+               spec.endTime, self->saving,
+               (GAsyncReadyCallback)editor_cb_saved, self);
+      g_free(text);
+   }
+   fact_spec_clear(&spec);
+}
+
+static void
+editor_cb_cancel(GtkWidget *widget, HamsterEditor *self)
+{
+   editor_finish(self, HAMSTER_EDITOR_CANCELLED, self->id);
+}
+
+static void
+editor_cb_external(GtkWidget *widget, HamsterEditor *self)
+{
+   editor_finish(self, HAMSTER_EDITOR_EXTERNAL, self->id);
+}
+
+static void
+editor_cb_running(GtkToggleButton *toggle, HamsterEditor *self)
+{
+   gtk_widget_set_sensitive(self->end, !gtk_toggle_button_get_active(toggle));
+}
+
+/* Construction */
+
+static GtkWidget*
+editor_entry_new(HamsterEditor *self, const gchar *placeholder)
+{
+   GtkWidget *entry = gtk_entry_new();
+
+   gtk_entry_set_placeholder_text(GTK_ENTRY(entry), placeholder);
+   gtk_widget_set_hexpand(entry, TRUE);
+   g_signal_connect(entry, "activate", G_CALLBACK(editor_cb_save), self);
+   return entry;
+}
+
+static void
+editor_attach(HamsterEditor *self, const gchar *label, GtkWidget *widget,
+              gint row, gint width)
+{
+   GtkWidget *lbl = gtk_label_new_with_mnemonic(label);
+
+   gtk_widget_set_halign(lbl, GTK_ALIGN_END);
+   gtk_label_set_mnemonic_widget(GTK_LABEL(lbl), widget);
+   gtk_grid_attach(GTK_GRID(self->grid), lbl, 0, row, 1, 1);
+   gtk_grid_attach(GTK_GRID(self->grid), widget, 1, row, width, 1);
+}
+
+HamsterEditor*
+hamster_editor_new(HamsterEditorDone done, gpointer data)
+{
+   HamsterEditor *self = g_new0(HamsterEditor, 1);
+   GtkWidget *box, *btn;
+
+   self->done = done;
+   self->data = data;
+
+   self->grid = g_object_ref_sink(gtk_grid_new());
+   gtk_grid_set_row_spacing(GTK_GRID(self->grid), 4);
+   gtk_grid_set_column_spacing(GTK_GRID(self->grid), 6);
+
+   self->start = editor_time_new();
+   editor_attach(self, _("_Start"), self->start, 0, 1);
+   self->end = editor_time_new();
+   gtk_grid_attach(GTK_GRID(self->grid), gtk_label_new("-"), 2, 0, 1, 1);
+   gtk_grid_attach(GTK_GRID(self->grid), self->end, 3, 0, 1, 1);
+   self->running = gtk_check_button_new_with_mnemonic(_("_Running"));
+   g_signal_connect(self->running, "toggled", G_CALLBACK(editor_cb_running), self);
+   gtk_grid_attach(GTK_GRID(self->grid), self->running, 4, 0, 1, 1);
+
+   self->name = editor_entry_new(self, NULL);
+   editor_attach(self, _("_Activity"), self->name, 1, 4);
+   self->category = editor_entry_new(self, NULL);
+   editor_attach(self, _("_Category"), self->category, 2, 4);
+   self->description = editor_entry_new(self, NULL);
+   editor_attach(self, _("_Description"), self->description, 3, 4);
+   self->tags = editor_entry_new(self, _("#tag #tag"));
+   editor_attach(self, _("_Tags"), self->tags, 4, 4);
+
+   self->error = gtk_label_new(NULL);
+   gtk_style_context_add_class(gtk_widget_get_style_context(self->error),
+         GTK_STYLE_CLASS_ERROR);
+   gtk_widget_set_halign(self->error, GTK_ALIGN_START);
+   gtk_widget_set_no_show_all(self->error, TRUE);
+   gtk_grid_attach(GTK_GRID(self->grid), self->error, 0, 5, 5, 1);
+
+   box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+   btn = gtk_button_new_with_mnemonic(_("More..."));
+   gtk_widget_set_tooltip_text(btn, _("Edit in the Hamster window"));
+   g_signal_connect(btn, "clicked", G_CALLBACK(editor_cb_external), self);
+   gtk_box_pack_start(GTK_BOX(box), btn, FALSE, FALSE, 0);
+   btn = gtk_button_new_with_mnemonic(_("_Save"));
+   g_signal_connect(btn, "clicked", G_CALLBACK(editor_cb_save), self);
+   gtk_box_pack_end(GTK_BOX(box), btn, FALSE, FALSE, 0);
+   btn = gtk_button_new_with_mnemonic(_("_Cancel"));
+   g_signal_connect(btn, "clicked", G_CALLBACK(editor_cb_cancel), self);
+   gtk_box_pack_end(GTK_BOX(box), btn, FALSE, FALSE, 0);
+   gtk_grid_attach(GTK_GRID(self->grid), box, 0, 6, 5, 1);
+
+   gtk_widget_show_all(self->grid);
+   gtk_widget_hide(self->grid);
+   gtk_widget_set_no_show_all(self->grid, TRUE);
+   return self;
+}
+
+void
+hamster_editor_free(HamsterEditor *self)
+{
+   if(!self)
+      return;
+   if(self->saving)
+   {
+      g_cancellable_cancel(self->saving);
+      g_object_unref(self->saving);
+   }
+   gtk_widget_destroy(self->grid);
+   g_object_unref(self->grid);
+   g_free(self);
+}
+
+GtkWidget*
+hamster_editor_get_widget(HamsterEditor *self)
+{
+   return self->grid;
+}
+
+time_t
+hamster_editor_get_day(HamsterEditor *self)
+{
+   return self->day;
+}
+
+gboolean
+hamster_editor_open(HamsterEditor *self, HamsterBackend *backend, gint id,
+                    GError **error)
+{
+   time_t now = util_local_now();
+   gchar *tags, *joined;
+
+   if(id)
+   {
+      GVariant *res = hamster_backend_get_fact(backend, id, error);
+      fact *f;
+
+      if(!res)
+         return FALSE;
+      f = fact_new(res);
+      g_variant_unref(res);
+      if(!f)
+      {
+         g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+               "fact %d can't be read", id);
+         return FALSE;
+      }
+      self->day = f->startTime - f->startTime % DAY_SECONDS;
+      editor_time_set(self->start, f->startTime);
+      editor_time_set(self->end, f->endTime ? f->endTime : now);
+      gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(self->running), !f->endTime);
+      gtk_entry_set_text(GTK_ENTRY(self->name), f->name);
+      gtk_entry_set_text(GTK_ENTRY(self->category), f->category);
+      gtk_entry_set_text(GTK_ENTRY(self->description),
+            f->description ? f->description : "");
+      joined = g_strjoinv(" #", f->tags);
+      tags = g_strdup_printf(*joined ? "#%s" : "%s", joined);
+      gtk_entry_set_text(GTK_ENTRY(self->tags), tags);
+      g_free(joined);
+      g_free(tags);
+      fact_free(f);
+   }
+   else
+   {
+      /* the last hour, on five minute marks */
+      time_t end = now - now % 300;
+      self->day = now - now % DAY_SECONDS;
+      editor_time_set(self->start, MAX(end - NEW_FACT_MINUTES * 60, self->day));
+      editor_time_set(self->end, end);
+      gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(self->running), FALSE);
+      gtk_entry_set_text(GTK_ENTRY(self->name), "");
+      gtk_entry_set_text(GTK_ENTRY(self->category), "");
+      gtk_entry_set_text(GTK_ENTRY(self->description), "");
+      gtk_entry_set_text(GTK_ENTRY(self->tags), "");
+   }
+   self->backend = backend;
+   self->id = id;
+   gtk_widget_hide(self->error);
+   gtk_widget_show(self->grid);
+   gtk_widget_grab_focus(self->name);
+   return TRUE;
+}
+
+gboolean
+hamster_editor_is_open(HamsterEditor *self)
+{
+   return self->backend != NULL;
+}
+
+void
+hamster_editor_close(HamsterEditor *self)
+{
+   if(self->backend)
+      editor_finish(self, HAMSTER_EDITOR_CANCELLED, self->id);
+}
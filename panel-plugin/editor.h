@@ -0,0 +1,65 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <gtk/gtk.h>
+#include "backend.h"
+
+/*
+ * Edits one fact inside the popup: times, activity, category, description
+ * and tags. The fact is read through GetFact and written back through
+ * UpdateFact, or AddFact for a new one, so no tracker window has to start.
+ * The write is asynchronous, done comes once the service has answered.
+ */
+typedef struct _HamsterEditor HamsterEditor;
+
+typedef enum
+{
+   HAMSTER_EDITOR_SAVED,
+   HAMSTER_EDITOR_CANCELLED,
+   HAMSTER_EDITOR_EXTERNAL     /* the user asked for the tracker's window */
+} HamsterEditorResult;
+
+typedef void (*HamsterEditorDone)(HamsterEditorResult result, gint id,
+                                  gpointer data);
+
+HamsterEditor*
+hamster_editor_new(HamsterEditorDone done, gpointer data);
+
+void
+hamster_editor_free(HamsterEditor *self);
+
+/* hidden until opened */
+GtkWidget*
+hamster_editor_get_widget(HamsterEditor *self);
+
+/* id 0 adds a new fact; FALSE if the backend can't read it */
+gboolean
+hamster_editor_open(HamsterEditor *self, HamsterBackend *backend, gint id,
+                    GError **error);
+
+gboolean
+hamster_editor_is_open(HamsterEditor *self);
+
+/* the day of the fact last opened, which it stays on */
+time_t
+hamster_editor_get_day(HamsterEditor *self);
+
+/* closes as cancelled */
+void
+hamster_editor_close(HamsterEditor *self);
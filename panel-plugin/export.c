@@ -0,0 +1,458 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+#include <stdio.h>
+#include <string.h>
+#include <libxfce4util/libxfce4util.h>
+#include <libxfce4ui/libxfce4ui.h>
+#include "export.h"
+#include "backend.h"
+#include "util.h"
+
+#define DAY_SECONDS (24 * 60 * 60)
+#define CHUNK_DAYS 7
+
+typedef enum
+{
+   EXPORT_CSV,
+   EXPORT_JSON
+} ExportFormat;
+
+typedef struct
+{
+   HamsterBackend *backend;   /* our own, picked like the view's */
+   GFile *file;
+   ExportFormat format;
+   time_t from;               /* first and last day, inclusive */
+   time_t to;
+   gint days;                 /* done so far, read by the progress timer */
+   GCancellable *cancellable;
+   GtkWidget *window;
+   GtkWidget *progress;
+   guint timer;
+} Export;
+
+/* Range and format */
+static gboolean
+export_parse_day(const gchar *text, time_t *day)
+{
+   gint y, m, d;
+   GDate date;
+
+   if(sscanf(text, "%4d-%2d-%2d", &y, &m, &d) != 3
+         || !g_date_valid_dmy(d, m, y))
+      return FALSE;
+   g_date_clear(&date, 1);
+   g_date_set_dmy(&date, d, m, y);
+   /* 1970-01-01 is julian day 719163 */
+   *day = ((time_t)g_date_get_julian(&date) - 719163) * DAY_SECONDS;
+   return TRUE;
+}
+
+static void
+export_format_time(GString *out, time_t t)
+{
+   struct tm tm;
+
+   /* hamster times are local already */
+   gmtime_r(&t, &tm);
+   g_string_append_printf(out, "%04d-%02d-%02d %02d:%02d",
+         tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min);
+}
+
+static void
+export_csv_field(GString *out, const gchar *str)
+{
+   if(!str)
+      str = "";
+   if(!strpbrk(str, ",\"\r\n"))
+   {
+      g_string_append(out, str);
+      return;
+   }
+   g_string_append_c(out, '"');
+   for(; *str; str++)
+   {
+      if(*str == '"')
+         g_string_append_c(out, '"');
+      g_string_append_c(out, *str);
+   }
+   g_string_append_c(out, '"');
+}
+
+static void
+export_json_string(GString *out, const gchar *str)
+{
+   g_string_append_c(out, '"');
+   for(; str && *str; str++)
+   {
+      guchar c = *str;
+      switch(c)
+      {
+         case '"':  g_string_append(out, "\\\""); break;
+         case '\\': g_string_append(out, "\\\\"); break;
+         case '\n': g_string_append(out, "\\n"); break;
+         case '\r': g_string_append(out, "\\r"); break;
+         case '\t': g_string_append(out, "\\t"); break;
+         default:
+            if(c < 0x20)
+               g_string_append_printf(out, "\\u%04x", c);
+            else
+               g_string_append_c(out, c);
+      }
+   }
+   g_string_append_c(out, '"');
+}
+
+static void
+export_row(GString *out, ExportFormat format, const fact *f, gboolean first)
+{
+   gchar **tag;
+   gchar *tags;
+
+   if(format == EXPORT_CSV)
+   {
+      tags = g_strjoinv(" ", f->tags);
+      g_string_append_printf(out, "%d,", f->id);
+      export_format_time(out, f->startTime);
+      g_string_append_c(out, ',');
+      if(f->endTime)
+         export_format_time(out, f->endTime);
+      g_string_append_printf(out, ",%d,", f->seconds / 60);
+      export_csv_field(out, f->name);
+      g_string_append_c(out, ',');
+      export_csv_field(out, f->category);
+      g_string_append_c(out, ',');
+      export_csv_field(out, f->description);
+      g_string_append_c(out, ',');
+      export_csv_field(out, tags);
+      g_string_append(out, "\r\n");
+      g_free(tags);
+      return;
+   }
+
+   g_string_append(out, first ? "\n  {" : ",\n  {");
+   g_string_append_printf(out, "\"id\": %d, \"start\": ", f->id);
+   g_string_append_c(out, '"');
+   export_format_time(out, f->startTime);
+   g_string_append(out, "\", \"end\": ");
+   if(f->endTime)
+   {
+      g_string_append_c(out, '"');
+      export_format_time(out, f->endTime);
+      g_string_append_c(out, '"');
+   }
+   else
+      g_string_append(out, "null");
+   g_string_append_printf(out, ", \"minutes\": %d, \"activity\": ",
+         f->seconds / 60);
+   export_json_string(out, f->name);
+   g_string_append(out, ", \"category\": ");
+   export_json_string(out, f->category);
+   g_string_append(out, ", \"description\": ");
+   export_json_string(out, f->description);
+   g_string_append(out, ", \"tags\": [");
+   for(tag = f->tags; tag && *tag; tag++)
+   {
+      if(tag != f->tags)
+         g_string_append(out, ", ");
+      export_json_string(out, *tag);
+   }
+   g_string_append(out, "]}");
+}
+
+/* Worker */
+static void
+export_run(GTask *task, gpointer source, Export *exp, GCancellable *cancellable)
+{
+   GError *error = NULL;
+   GFileOutputStream *file;
+   GOutputStream *out;
+   GString *buf = g_string_new(NULL);
+   /* facts reaching into the next chunk show up there again */
+   GHashTable *carried = g_hash_table_new(NULL, NULL);
+   GHashTable *carry = g_hash_table_new(NULL, NULL);
+   gint rows = 0;
+   time_t day;
+
+   file = g_file_replace(exp->file, NULL, FALSE,
+         G_FILE_CREATE_REPLACE_DESTINATION, cancellable, &error);
+   if(!file)
+      goto done;
+   out = g_buffered_output_stream_new(G_OUTPUT_STREAM(file));
+   g_object_unref(file);
+
+   g_string_append(buf, exp->format == EXPORT_CSV
+         ? "id,start,end,minutes,activity,category,description,tags\r\n"
+         : "[");
+
+   for(day = exp->from; day <= exp->to; day += CHUNK_DAYS * DAY_SECONDS)
+   {
+      time_t last = MIN(day + (CHUNK_DAYS - 1) * DAY_SECONDS, exp->to);
+      GVariant *res;
+      GHashTable *swap;
+      gsize i, n;
+
+      if(g_cancellable_set_error_if_cancelled(cancellable, &error))
+         break;
+      res = hamster_backend_get_facts(exp->backend, day, last, "", &error);
+      if(!res)
+         break;
+      n = g_variant_n_children(res);
+      for(i = 0; i < n; i++)
+      {
+         GVariant *child = g_variant_get_child_value(res, i);
+         fact *f = fact_new(child);
+         g_variant_unref(child);
+         if(!f)
+            continue;
+         if(!g_hash_table_contains(carried, GINT_TO_POINTER(f->id)))
+            export_row(buf, exp->format, f, rows++ == 0);
+         if(!f->endTime || f->endTime > last + DAY_SECONDS)
+            g_hash_table_add(carry, GINT_TO_POINTER(f->id));
+         fact_free(f);
+      }
+      g_variant_unref(res);
+
+      swap = carried;
+      carried = carry;
+      carry = swap;
+      g_hash_table_remove_all(carry);
+
+      if(!g_output_stream_write_all(out, buf->str, buf->len, NULL,
+               cancellable, &error))
+         break;
+      g_string_truncate(buf, 0);
+      g_atomic_int_set(&exp->days, (last - exp->from) / DAY_SECONDS + 1);
+   }
+
+   if(!error && exp->format == EXPORT_JSON)
+   {
+      g_string_append(buf, rows ? "\n]\n" : "]\n");
+      g_output_stream_write_all(out, buf->str, buf->len, NULL,
+            cancellable, &error);
+   }
+   if(error)
+   {
+      /* a cancelled close does not replace the old file */
+      GCancellable *abandon = g_cancellable_new();
+      g_cancellable_cancel(abandon);
+      g_output_stream_close(out, abandon, NULL);
+      g_object_unref(abandon);
+   }
+   else
+      g_output_stream_close(out, cancellable, &error);
+   g_object_unref(out);
+
+done:
+   g_hash_table_unref(carried);
+   g_hash_table_unref(carry);
+   g_string_free(buf, TRUE);
+   if(error)
+      g_task_return_error(task, error);
+   else
+      g_task_return_int(task, rows);
+}
+
+/* Progress */
+static gboolean
+export_cb_progress(Export *exp)
+{
+   gint total = (exp->to - exp->from) / DAY_SECONDS + 1;
+   gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(exp->progress),
+         (gdouble)g_atomic_int_get(&exp->days) / total);
+   return TRUE;
+}
+
+static void
+export_free(Export *exp)
+{
+   if(exp->timer)
+      g_source_remove(exp->timer);
+   if(exp->window)
+      gtk_widget_destroy(exp->window);
+   hamster_backend_free(exp->backend);
+   g_object_unref(exp->file);
+   g_object_unref(exp->cancellable);
+   g_free(exp);
+}
+
+static void
+export_cb_done(GObject *source, GAsyncResult *result, Export *exp)
+{
+   GError *error = NULL;
+   gssize rows = g_task_propagate_int(G_TASK(result), &error);
+
+   if(error)
+   {
+      if(!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+         xfce_dialog_show_error(NULL, error, _("Export failed"));
+      g_error_free(error);
+   }
+   else
+   {
+      gchar *name = g_file_get_parse_name(exp->file);
+      gchar *body = g_strdup_printf(_("Facts written: %d\n%s"),
+            (gint)rows, name);
+      util_notify(_("Export finished"), body);
+      g_free(body);
+      g_free(name);
+   }
+   export_free(exp);
+}
+
+static void
+export_cb_cancel(GtkWidget *widget, Export *exp)
+{
+   g_cancellable_cancel(exp->cancellable);
+}
+
+static void
+export_start(Export *exp)
+{
+   GtkWidget *box, *lbl, *btn;
+   GTask *task;
+   gchar *name = g_file_get_basename(exp->file);
+   gchar *text = g_strdup_printf(_("Exporting to %s"), name);
+
+   exp->window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+   gtk_window_set_title(GTK_WINDOW(exp->window), _("Export"));
+   gtk_window_set_icon_name(GTK_WINDOW(exp->window), "org.gnome.Hamster.GUI");
+   gtk_window_set_deletable(GTK_WINDOW(exp->window), FALSE);
+   box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 6);
+   gtk_container_set_border_width(GTK_CONTAINER(box), 12);
+   gtk_container_add(GTK_CONTAINER(exp->window), box);
+   lbl = gtk_label_new(text);
+   gtk_container_add(GTK_CONTAINER(box), lbl);
+   exp->progress = gtk_progress_bar_new();
+   gtk_container_add(GTK_CONTAINER(box), exp->progress);
+   btn = gtk_button_new_with_mnemonic(_("_Cancel"));
+   gtk_widget_set_halign(btn, GTK_ALIGN_END);
+   g_signal_connect(btn, "clicked", G_CALLBACK(export_cb_cancel), exp);
+   gtk_container_add(GTK_CONTAINER(box), btn);
+   gtk_widget_show_all(exp->window);
+   g_free(text);
+   g_free(name);
+
+   exp->timer = g_timeout_add(200, (GSourceFunc)export_cb_progress, exp);
+   task = g_task_new(NULL, exp->cancellable,
+         (GAsyncReadyCallback)export_cb_done, exp);
+   g_task_set_task_data(task, exp, NULL);
+   g_task_run_in_thread(task, (GTaskThreadFunc)export_run);
+   g_object_unref(task);
+}
+
+/* Dialog */
+static void
+export_cb_format(GtkComboBox *combo, GtkFileChooser *chooser)
+{
+   gchar *name = gtk_file_chooser_get_current_name(chooser);
+   gchar *dot = name ? strrchr(name, '.') : NULL;
+
+   if(dot)
+   {
+      *dot = '\0';
+      gchar *renamed = g_strconcat(name,
+            gtk_combo_box_get_active(combo) == EXPORT_JSON ? ".json" : ".csv",
+            NULL);
+      gtk_file_chooser_set_current_name(chooser, renamed);
+      g_free(renamed);
+   }
+   g_free(name);
+}
+
+static GtkWidget*
+export_date_entry(GDateTime *dt)
+{
+   GtkWidget *entry = gtk_entry_new();
+   gchar *text = g_date_time_format(dt, "%Y-%m-%d");
+
+   gtk_entry_set_text(GTK_ENTRY(entry), text);
+   gtk_entry_set_width_chars(GTK_ENTRY(entry), 10);
+   g_free(text);
+   return entry;
+}
+
+void
+export_show(GtkWindow *parent, gboolean directReads, gboolean standalone)
+{
+   GtkWidget *dlg, *grd, *from, *to, *fmt;
+   GDateTime *now = g_date_time_new_now_local();
+   GDateTime *month = g_date_time_new_local(g_date_time_get_year(now),
+         g_date_time_get_month(now), 1, 0, 0, 0);
+   GDateTime *first = g_date_time_add_months(month, -1);
+   GDateTime *last = g_date_time_add_days(month, -1);
+   gchar *name = g_date_time_format(first, "hamster-%Y-%m.csv");
+
+   /* month-end invoicing is the common case, offer last month */
+   dlg = gtk_file_chooser_dialog_new(_("Export facts"), parent,
+         GTK_FILE_CHOOSER_ACTION_SAVE,
+         _("_Cancel"), GTK_RESPONSE_CANCEL,
+         _("_Export"), GTK_RESPONSE_ACCEPT,
+         NULL);
+   gtk_file_chooser_set_do_overwrite_confirmation(GTK_FILE_CHOOSER(dlg), TRUE);
+   gtk_file_chooser_set_current_name(GTK_FILE_CHOOSER(dlg), name);
+
+   grd = gtk_grid_new();
+   gtk_grid_set_column_spacing(GTK_GRID(grd), 6);
+   gtk_grid_attach(GTK_GRID(grd), gtk_label_new(_("From")), 0, 0, 1, 1);
+   from = export_date_entry(first);
+   gtk_grid_attach(GTK_GRID(grd), from, 1, 0, 1, 1);
+   gtk_grid_attach(GTK_GRID(grd), gtk_label_new(_("to")), 2, 0, 1, 1);
+   to = export_date_entry(last);
+   gtk_grid_attach(GTK_GRID(grd), to, 3, 0, 1, 1);
+   fmt = gtk_combo_box_text_new();
+   gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(fmt), "CSV");
+   gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(fmt), "JSON");
+   gtk_combo_box_set_active(GTK_COMBO_BOX(fmt), EXPORT_CSV);
+   g_signal_connect(fmt, "changed", G_CALLBACK(export_cb_format), dlg);
+   gtk_grid_attach(GTK_GRID(grd), fmt, 4, 0, 1, 1);
+   gtk_widget_show_all(grd);
+   gtk_file_chooser_set_extra_widget(GTK_FILE_CHOOSER(dlg), grd);
+
+   g_free(name);
+   g_date_time_unref(last);
+   g_date_time_unref(first);
+   g_date_time_unref(month);
+   g_date_time_unref(now);
+
+   while(gtk_dialog_run(GTK_DIALOG(dlg)) == GTK_RESPONSE_ACCEPT)
+   {
+      Export *exp = g_new0(Export, 1);
+
+      if(!export_parse_day(gtk_entry_get_text(GTK_ENTRY(from)), &exp->from)
+            || !export_parse_day(gtk_entry_get_text(GTK_ENTRY(to)), &exp->to)
+            || exp->to < exp->from)
+      {
+         g_free(exp);
+         xfce_dialog_show_warning(GTK_WINDOW(dlg), NULL,
+               _("Enter the range as YYYY-MM-DD, the first day before the last."));
+         continue;
+      }
+      exp->file = gtk_file_chooser_get_file(GTK_FILE_CHOOSER(dlg));
+      exp->format = gtk_combo_box_get_active(GTK_COMBO_BOX(fmt));
+      exp->backend = hamster_backend_new(directReads, standalone);
+      exp->cancellable = g_cancellable_new();
+      export_start(exp);
+      break;
+   }
+   gtk_widget_destroy(dlg);
+}
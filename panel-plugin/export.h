@@ -0,0 +1,29 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <gtk/gtk.h>
+
+/*
+ * Asks for a date range and a file, then writes the facts as CSV or JSON
+ * on a worker thread. The range is fetched a week at a time so memory use
+ * does not depend on its length. The backend is picked like the view's,
+ * hamster_backend_new() with the same settings.
+ */
+void
+export_show(GtkWindow *parent, gboolean directReads, gboolean standalone);
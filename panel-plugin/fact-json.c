@@ -0,0 +1,592 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * One pass over a fact of hamster's JSON D-Bus API, straight into a fact:
+ * no tree, no copies but for the strings the fact keeps. Keys it doesn't
+ * know are skipped whatever they hold.
+ *
+ *   {"activity": "Coding", "category": "Work", "description": "",
+ *    "tags": ["a", "b"], "id": 7, "activity_id": 3, "exported": false,
+ *    "range": "2024-05-02 09:30 - 11:15", "date": "2024-05-02"}
+ *
+ * The range leaves out the start's date on the daemon's today and the end's
+ * date on the start's day, and says "--" or nothing for a running end.
+ * Times are the daemon's wall clock, which is what hamster's local epoch
+ * seconds are. The start and end keys of other writers are read too, a
+ * trailing UTC offset there is read past and not applied and numbers are
+ * taken as local epoch seconds already.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+#include <string.h>
+#include "fact.h"
+
+#define DAY_SECONDS (24 * 60 * 60)
+#define MAX_DEPTH 32
+
+G_DEFINE_QUARK(fact-json-error-quark, fact_json_error)
+
+typedef struct
+{
+   const gchar *start;
+   const gchar *p;
+   const gchar *end;
+   GError **error;
+} JsonReader;
+
+static gboolean
+json_fail(JsonReader *r, const gchar *what)
+{
+   if(r->error && !*r->error)
+      g_set_error(r->error, FACT_JSON_ERROR, 0, "%s at offset %d", what,
+            (gint)(r->p - r->start));
+   return FALSE;
+}
+
+static void
+json_skip_space(JsonReader *r)
+{
+   while(r->p < r->end
+         && (*r->p == ' ' || *r->p == '\n' || *r->p == '\r' || *r->p == '\t'))
+      r->p++;
+}
+
+/* skips blanks, then c */
+static gboolean
+json_expect(JsonReader *r, gchar c)
+{
+   json_skip_space(r);
+   if(r->p >= r->end || *r->p != c)
+      return json_fail(r, "unexpected character");
+   r->p++;
+   return TRUE;
+}
+
+static gboolean
+json_peek(JsonReader *r, gchar c)
+{
+   json_skip_space(r);
+   return r->p < r->end && *r->p == c;
+}
+
+static gint
+json_hex4(const gchar *s)
+{
+   gint i, v = 0;
+
+   for(i = 0; i < 4; i++)
+   {
+      gint d = g_ascii_xdigit_value(s[i]);
+      if(d < 0)
+         return -1;
+      v = v * 16 + d;
+   }
+   return v;
+}
+
+/* the slow path, for strings with escapes */
+static gboolean
+json_unescape(JsonReader *r, const gchar *start, gchar **out)
+{
+   GString *str = g_string_sized_new(r->p - start + 16);
+   const gchar *s = start;
+
+   while(s < r->end && *s != '"')
+   {
+      gunichar c;
+      gint v;
+
+      if(*s != '\\')
+      {
+         g_string_append_c(str, *s++);
+         continue;
+      }
+      if(++s >= r->end)
+         break;
+      switch(*s++)
+      {
+         case '"': g_string_append_c(str, '"'); continue;
+         case '\\': g_string_append_c(str, '\\'); continue;
+         case '/': g_string_append_c(str, '/'); continue;
+         case 'b': g_string_append_c(str, '\b'); continue;
+         case 'f': g_string_append_c(str, '\f'); continue;
+         case 'n': g_string_append_c(str, '\n'); continue;
+         case 'r': g_string_append_c(str, '\r'); continue;
+         case 't': g_string_append_c(str, '\t'); continue;
+         case 'u': break;
+         default: goto bad;
+      }
+      if(r->end - s < 4 || (v = json_hex4(s)) < 0)
+         goto bad;
+      c = v;
+      s += 4;
+      /* a surrogate pair spells one character */
+      if(c >= 0xD800 && c < 0xDC00)
+      {
+         gint low;
+         if(r->end - s < 6 || s[0] != '\\' || s[1] != 'u'
+               || (low = json_hex4(s + 2)) < 0xDC00 || low >= 0xE000)
+            goto bad;
+         c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+         s += 6;
+      }
+      g_string_append_unichar(str, c);
+   }
+   if(s >= r->end)
+      goto bad;
+   r->p = s + 1;
+   *out = g_string_free(str, FALSE);
+   return TRUE;
+
+bad:
+   g_string_free(str, TRUE);
+   return json_fail(r, "bad string");
+}
+
+/* out NULL skips it */
+static gboolean
+json_string(JsonReader *r, gchar **out)
+{
+   const gchar *start;
+
+   if(!json_expect(r, '"'))
+      return FALSE;
+   start = r->p;
+   while(r->p < r->end && *r->p != '"' && *r->p != '\\')
+      r->p++;
+   if(r->p < r->end && *r->p == '"')
+   {
+      if(out)
+         *out = g_strndup(start, r->p - start);
+      r->p++;
+      return TRUE;
+   }
+   if(!out)
+   {
+      /* only find the end */
+      while(r->p < r->end && *r->p != '"')
+         r->p += *r->p == '\\' ? 2 : 1;
+      if(r->p >= r->end)
+         return json_fail(r, "unterminated string");
+      r->p++;
+      return TRUE;
+   }
+   return json_unescape(r, start, out);
+}
+
+static gboolean
+json_literal(JsonReader *r, const gchar *word)
+{
+   gsize n = strlen(word);
+
+   json_skip_space(r);
+   if((gsize)(r->end - r->p) < n || memcmp(r->p, word, n))
+      return json_fail(r, "unexpected value");
+   r->p += n;
+   return TRUE;
+}
+
+/* the integer part, fractions and exponents are read past */
+static gboolean
+json_number(JsonReader *r, gint64 *out)
+{
+   gboolean negative;
+   gint64 v = 0;
+
+   json_skip_space(r);
+   negative = r->p < r->end && *r->p == '-';
+   if(negative)
+      r->p++;
+   if(r->p >= r->end || !g_ascii_isdigit(*r->p))
+      return json_fail(r, "bad number");
+   while(r->p < r->end && g_ascii_isdigit(*r->p))
+      v = v * 10 + (*r->p++ - '0');
+   while(r->p < r->end && (g_ascii_isdigit(*r->p) || *r->p == '.'
+            || *r->p == 'e' || *r->p == 'E' || *r->p == '+' || *r->p == '-'))
+      r->p++;
+   *out = negative ? -v : v;
+   return TRUE;
+}
+
+static gboolean
+json_skip_value(JsonReader *r, gint depth)
+{
+   gint64 unused;
+
+   if(depth > MAX_DEPTH)
+      return json_fail(r, "nested too deep");
+   json_skip_space(r);
+   if(r->p >= r->end)
+      return json_fail(r, "truncated");
+   switch(*r->p)
+   {
+      case '"':
+         return json_string(r, NULL);
+      case 't':
+         return json_literal(r, "true");
+      case 'f':
+         return json_literal(r, "false");
+      case 'n':
+         return json_literal(r, "null");
+      case '[':
+         r->p++;
+         if(json_peek(r, ']'))
+            return json_expect(r, ']');
+         do
+            if(!json_skip_value(r, depth + 1))
+               return FALSE;
+         while(json_peek(r, ',') && json_expect(r, ','));
+         return json_expect(r, ']');
+      case '{':
+         r->p++;
+         if(json_peek(r, '}'))
+            return json_expect(r, '}');
+         do
+            if(!json_string(r, NULL) || !json_expect(r, ':')
+                  || !json_skip_value(r, depth + 1))
+               return FALSE;
+         while(json_peek(r, ',') && json_expect(r, ','));
+         return json_expect(r, '}');
+      default:
+         return json_number(r, &unused);
+   }
+}
+
+/* days since 1970-01-01 of a proleptic gregorian date */
+static gint64
+json_days(gint y, gint m, gint d)
+{
+   gint era, yoe, doy, doe;
+
+   y -= m <= 2;
+   era = (y >= 0 ? y : y - 399) / 400;
+   yoe = y - era * 400;
+   doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+   doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+   return (gint64)era * 146097 + doe - 719468;
+}
+
+static gint
+json_digits(const gchar *s, gint n)
+{
+   gint i, v = 0;
+
+   for(i = 0; i < n; i++)
+   {
+      if(!g_ascii_isdigit(s[i]))
+         return -1;
+      v = v * 10 + (s[i] - '0');
+   }
+   return v;
+}
+
+/* "YYYY-MM-DD[( |T)HH:MM[:SS[.f]]][Z|+HH:MM]" */
+static gboolean
+json_parse_time(const gchar *s, gsize n, time_t *out)
+{
+   gint y, m, d, hh = 0, mm = 0, ss = 0;
+
+   if(n < 10 || s[4] != '-' || s[7] != '-'
+         || (y = json_digits(s, 4)) < 0
+         || (m = json_digits(s + 5, 2)) < 1 || m > 12
+         || (d = json_digits(s + 8, 2)) < 1 || d > 31)
+      return FALSE;
+   if(n >= 16 && (s[10] == ' ' || s[10] == 'T'))
+   {
+      if(s[13] != ':' || (hh = json_digits(s + 11, 2)) < 0 || hh > 23
+            || (mm = json_digits(s + 14, 2)) < 0 || mm > 59)
+         return FALSE;
+      if(n >= 19 && s[16] == ':'
+            && ((ss = json_digits(s + 17, 2)) < 0 || ss > 60))
+         return FALSE;
+   }
+   *out = json_days(y, m, d) * DAY_SECONDS + hh * 3600 + mm * 60 + ss;
+   return TRUE;
+}
+
+/* a datetime string, local epoch seconds or null for none */
+static gboolean
+json_time(JsonReader *r, time_t *out)
+{
+   const gchar *start;
+   gint64 v;
+
+   if(json_peek(r, 'n'))
+   {
+      *out = 0;
+      return json_literal(r, "null");
+   }
+   if(!json_peek(r, '"'))
+   {
+      if(!json_number(r, &v))
+         return FALSE;
+      *out = v;
+      return TRUE;
+   }
+   start = r->p + 1;
+   if(!json_string(r, NULL))
+      return FALSE;
+   if(r->p - 1 == start)
+   {
+      *out = 0;
+      return TRUE;
+   }
+   if(!json_parse_time(start, r->p - 1 - start, out))
+      return json_fail(r, "bad time");
+   return TRUE;
+}
+
+static gboolean
+json_int(JsonReader *r, int *out)
+{
+   gint64 v;
+
+   if(json_peek(r, 'n'))
+      return json_literal(r, "null");
+   if(!json_number(r, &v))
+      return FALSE;
+   *out = (int)v;
+   return TRUE;
+}
+
+/* replaces *out, null leaves it alone */
+static gboolean
+json_text(JsonReader *r, gchar **out)
+{
+   gchar *s;
+
+   if(json_peek(r, 'n'))
+      return json_literal(r, "null");
+   if(!json_string(r, &s))
+      return FALSE;
+   g_free(*out);
+   *out = s;
+   return TRUE;
+}
+
+static gboolean
+json_tags(JsonReader *r, gchar ***out)
+{
+   GPtrArray *tags;
+
+   if(json_peek(r, 'n'))
+      return json_literal(r, "null");
+   if(!json_expect(r, '['))
+      return FALSE;
+   tags = g_ptr_array_new();
+   if(!json_peek(r, ']'))
+   {
+      do
+      {
+         gchar *tag;
+         if(!json_string(r, &tag))
+         {
+            g_ptr_array_set_free_func(tags, g_free);
+            g_ptr_array_free(tags, TRUE);
+            return FALSE;
+         }
+         g_ptr_array_add(tags, tag);
+      }
+      while(json_peek(r, ',') && json_expect(r, ','));
+   }
+   g_ptr_array_add(tags, NULL);
+   g_strfreev(*out);
+   *out = (gchar**)g_ptr_array_free(tags, FALSE);
+   return json_expect(r, ']');
+}
+
+/* "HH:MM" or "YYYY-MM-DD HH:MM", the time of day alone for the former */
+static gboolean
+json_parse_clock(const gchar *s, gsize n, gboolean *dated, time_t *out)
+{
+   gint hh, mm;
+
+   *dated = n > 5;
+   if(*dated)
+      return n == 16 && s[10] == ' ' && json_parse_time(s, n, out);
+   if(n != 5 || s[2] != ':' || (hh = json_digits(s, 2)) < 0 || hh > 23
+         || (mm = json_digits(s + 3, 2)) < 0 || mm > 59)
+      return FALSE;
+   *out = hh * 3600 + mm * 60;
+   return TRUE;
+}
+
+/* hamster's local epoch seconds for now */
+static time_t
+json_now(void)
+{
+   GDateTime *dt = g_date_time_new_now_local();
+   time_t now = g_date_time_to_unix(dt)
+      + g_date_time_get_utc_offset(dt) / G_TIME_SPAN_SECOND;
+
+   g_date_time_unref(dt);
+   return now;
+}
+
+/* "start - end" as hamster's Range.format writes it */
+static gboolean
+json_parse_range(const gchar *s, gsize n, time_t *start, time_t *end)
+{
+   const gchar *dash = g_strstr_len(s, n, " - ");
+   gsize startLength = dash ? (gsize)(dash - s) : n;
+   gsize endLength = dash ? n - startLength - 3 : 0;
+   gboolean dated;
+
+   if(!json_parse_clock(s, startLength, &dated, start))
+      return FALSE;
+   if(!dated)
+   {
+      /* the daemon's today, which ends at its day start past midnight */
+      time_t now = json_now();
+      *start += now - now % DAY_SECONDS;
+      if(*start > now)
+         *start -= DAY_SECONDS;
+   }
+   if(!endLength || (endLength == 2 && !memcmp(dash + 3, "--", 2)))
+   {
+      *end = 0;
+      return TRUE;
+   }
+   if(!json_parse_clock(dash + 3, endLength, &dated, end))
+      return FALSE;
+   if(!dated)
+   {
+      /* on the start's day, unless that was past midnight */
+      *end += *start - *start % DAY_SECONDS;
+      if(*end < *start)
+         *end += DAY_SECONDS;
+   }
+   return *end >= *start;
+}
+
+static gboolean
+json_range(JsonReader *r, fact *out)
+{
+   const gchar *start;
+
+   if(json_peek(r, 'n'))
+      return json_literal(r, "null");
+   start = r->p + 1;
+   if(!json_string(r, NULL))
+      return FALSE;
+   if(!json_parse_range(start, r->p - 1 - start, &out->startTime,
+            &out->endTime))
+      return json_fail(r, "bad range");
+   return TRUE;
+}
+
+/* keys are compared as they are on the wire, escaped keys are unknown */
+#define JSON_KEY_IS(k, n, lit) ((n) == sizeof(lit) - 1 && !memcmp((k), (lit), (n)))
+
+static gboolean
+json_member(JsonReader *r, fact *out)
+{
+   const gchar *key;
+   gsize n;
+
+   if(!json_expect(r, '"'))
+      return FALSE;
+   key = r->p;
+   while(r->p < r->end && *r->p != '"' && *r->p != '\\')
+      r->p++;
+   n = r->p - key;
+   if(r->p < r->end && *r->p == '"')
+      r->p++;
+   else
+   {
+      n = 0;
+      r->p = key - 1;
+      if(!json_string(r, NULL))
+         return FALSE;
+   }
+   if(!json_expect(r, ':'))
+      return FALSE;
+
+   if(JSON_KEY_IS(key, n, "id"))
+      return json_int(r, &out->id);
+   if(JSON_KEY_IS(key, n, "activity") || JSON_KEY_IS(key, n, "name"))
+      return json_text(r, &out->name);
+   if(JSON_KEY_IS(key, n, "category"))
+      return json_text(r, &out->category);
+   if(JSON_KEY_IS(key, n, "description"))
+      return json_text(r, &out->description);
+   if(JSON_KEY_IS(key, n, "tags"))
+      return json_tags(r, &out->tags);
+   if(JSON_KEY_IS(key, n, "range"))
+      return json_range(r, out);
+   /* the service's day, which starts at its day_start setting */
+   if(JSON_KEY_IS(key, n, "date"))
+      return json_time(r, &out->date);
+   if(JSON_KEY_IS(key, n, "activity_id"))
+      return json_int(r, &out->activityId);
+   /* not hamster's, but cheap to take */
+   if(JSON_KEY_IS(key, n, "start") || JSON_KEY_IS(key, n, "start_time"))
+      return json_time(r, &out->startTime);
+   if(JSON_KEY_IS(key, n, "end") || JSON_KEY_IS(key, n, "end_time"))
+      return json_time(r, &out->endTime);
+   return json_skip_value(r, 1);
+}
+
+fact*
+fact_new_json(const gchar *json, gssize length, GError **error)
+{
+   JsonReader r = { json, json,
+                    json + (length < 0 ? strlen(json) : (gsize)length), error };
+   fact *out = g_new0(fact, 1);
+
+   if(!json_expect(&r, '{'))
+      goto fail;
+   if(!json_peek(&r, '}'))
+   {
+      do
+         if(!json_member(&r, out))
+            goto fail;
+      while(json_peek(&r, ',') && json_expect(&r, ','));
+   }
+   if(!json_expect(&r, '}'))
+      goto fail;
+   json_skip_space(&r);
+   if(r.p != r.end)
+   {
+      json_fail(&r, "trailing data");
+      goto fail;
+   }
+
+   /* what the tuple API never leaves out */
+   if(!out->name)
+      out->name = g_strdup("");
+   if(!out->category)
+      out->category = g_strdup("");
+   if(!out->description)
+      out->description = g_strdup("");
+   if(!out->tags)
+      out->tags = g_new0(gchar*, 1);
+   if(!out->date)
+      out->date = out->startTime - out->startTime % DAY_SECONDS;
+   if(out->startTime)
+      out->seconds = out->endTime ? out->endTime - out->startTime
+         : MAX(json_now() - out->startTime, 0);
+   return out;
+
+fail:
+   fact_free(out);
+   return NULL;
+}
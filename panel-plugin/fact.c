@@ -0,0 +1,79 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "fact.h"
+
+fact *
+fact_new(GVariant *in)
+{
+   //bzero(out, sizeof(fact));
+   fact *out;
+
+   if(g_variant_is_of_type(in, G_VARIANT_TYPE_STRING))
+   {
+      GError *error = NULL;
+      gsize length;
+      const gchar *json = g_variant_get_string(in, &length);
+
+      out = fact_new_json(json, length, &error);
+      if(out)
+         return out;
+      g_warning("not a fact: %s", error->message);
+      g_error_free(error);
+      return NULL;
+   }
+   out = g_new0(fact, 1);
+   g_variant_get(in, "(iiissis^asii)",
+         &out->id,
+         &out->startTime,
+         &out->endTime,
+         &out->description,
+         &out->name,
+         &out->activityId,
+         &out->category,
+         &out->tags,
+         &out->date,
+         &out->seconds
+         );
+   return out;
+}
+
+fact*
+fact_dup(const fact *in)
+{
+   fact *out = g_new(fact, 1);
+
+   *out = *in;
+   out->description = g_strdup(in->description);
+   out->name = g_strdup(in->name);
+   out->category = g_strdup(in->category);
+   out->tags = g_strdupv(in->tags);
+   return out;
+}
+
+void
+fact_free(fact *in)
+{
+   if(!in)
+      return;
+   g_free(in->description);
+   g_free(in->name);
+   g_free(in->category);
+   g_strfreev(in->tags);
+   g_free(in);
+}
@@ -0,0 +1,59 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <time.h>
+#include <glib.h>
+
+/* one element of a facts reply, see backend.h; no GTK in here, this is
+ * part of libhamster-model */
+typedef struct _fact
+{
+   int id; // 0
+   time_t startTime; // 1
+   time_t endTime; // 2
+   char *description; // 3
+   char *name; // 4
+   int activityId; // 5
+   char *category; // 6
+   char **tags; // 7
+   time_t date; // 8
+   int seconds; // 9
+}fact;
+
+/* in is one element of a tuple API reply, (iiissisasii), or a JSON fact
+ * of the JSON API, s; NULL, with a warning, for a broken JSON fact, which
+ * callers skip */
+fact*
+fact_new(GVariant *in);
+
+#define FACT_JSON_ERROR (fact_json_error_quark())
+
+GQuark
+fact_json_error_quark(void);
+
+/* one JSON fact as GetFactsJSON lists them, see fact-json.c; NULL and error
+ * set if it isn't one */
+fact*
+fact_new_json(const gchar *json, gssize length, GError **error);
+
+fact*
+fact_dup(const fact *in);
+
+void
+fact_free(fact *in);
@@ -0,0 +1,102 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+#include <libxfce4util/libxfce4util.h>
+#include "factlist.h"
+
+GtkListStore*
+fact_list_store_new(void)
+{
+   return gtk_list_store_new(NUM_COL, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING,
+         G_TYPE_STRING, G_TYPE_STRING, G_TYPE_INT, G_TYPE_STRING, G_TYPE_STRING);
+}
+
+void
+fact_list_store_set(GtkListStore *store, GtkTreeIter *iter,
+                    const HamsterModelRow *row)
+{
+   gtk_list_store_set (store, iter,
+                       TIME_SPAN, row->span,
+                       TITLE, row->fact->name,
+                       DURATION, row->duration,
+                       BTNEDIT, "gtk-edit",
+                       BTNCONT, row->fact->endTime ? "gtk-media-play" : "",
+                       ID, row->fact->id,
+                       CATEGORY, row->fact->category,
+                       TAGS, row->hashtags,
+                       -1);
+}
+
+void
+fact_list_store_append(GtkListStore *store, const HamsterModelRow *row)
+{
+   GtkTreeIter   iter;
+   gtk_list_store_append (store, &iter);  /* Acquire an iterator */
+   fact_list_store_set(store, &iter, row);
+}
+
+void
+fact_list_columns_add(GtkTreeView *tv)
+{
+   GtkCellRenderer *renderer, *tagRenderer;
+   GtkTreeViewColumn *column;
+
+   gtk_tree_view_set_headers_visible(tv, FALSE);
+   gtk_tree_view_set_hover_selection(tv, TRUE);
+   gtk_widget_set_can_focus(GTK_WIDGET(tv), FALSE);
+   gtk_tree_view_set_grid_lines(tv, GTK_TREE_VIEW_GRID_LINES_NONE);
+   renderer = gtk_cell_renderer_text_new ();
+   column = gtk_tree_view_column_new_with_attributes ("Time",
+                                                      renderer,
+                                                      "text", TIME_SPAN,
+                                                      NULL);
+   gtk_tree_view_append_column (tv, column);
+   column = gtk_tree_view_column_new_with_attributes ("Name",
+                                                      renderer,
+                                                      "text", TITLE,
+                                                      NULL);
+   gtk_tree_view_append_column (tv, column);
+   tagRenderer = gtk_cell_renderer_text_new ();
+   g_object_set(tagRenderer, "style", PANGO_STYLE_ITALIC, NULL);
+   column = gtk_tree_view_column_new_with_attributes ("Tags",
+                                                      tagRenderer,
+                                                      "text", TAGS,
+                                                      NULL);
+   gtk_tree_view_append_column (tv, column);
+   column = gtk_tree_view_column_new_with_attributes ("Duration",
+                                                      renderer,
+                                                      "text", DURATION,
+                                                      NULL);
+   gtk_tree_view_append_column (tv, column);
+   renderer = gtk_cell_renderer_pixbuf_new();
+   column = gtk_tree_view_column_new_with_attributes ("ed",
+                                                      renderer,
+                                                      "stock-id", BTNEDIT,
+                                                      NULL);
+   g_object_set_data(G_OBJECT(column), "tip", _("Edit activity"));
+   gtk_tree_view_append_column (tv, column);
+   column = gtk_tree_view_column_new_with_attributes ("ct",
+                                                      renderer,
+                                                      "stock-id", BTNCONT,
+                                                      NULL);
+   g_object_set_data(G_OBJECT(column), "tip", _("Resume activity"));
+   gtk_tree_view_append_column (tv, column);
+}
@@ -0,0 +1,53 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <gtk/gtk.h>
+#include "model.h"
+
+/*
+ * The fact list of the popup, shared by today's facts, search results and
+ * render-bench. The "ed" and "ct" columns are found by title when clicked,
+ * the others carry a "tip" for their tooltip.
+ */
+enum
+{
+   TIME_SPAN,
+   TITLE,
+   DURATION,
+   BTNEDIT,
+   BTNCONT,
+   ID,
+   CATEGORY,
+   TAGS,
+   NUM_COL
+};
+
+GtkListStore*
+fact_list_store_new(void);
+
+void
+fact_list_store_set(GtkListStore *store, GtkTreeIter *iter,
+                    const HamsterModelRow *row);
+
+void
+fact_list_store_append(GtkListStore *store, const HamsterModelRow *row);
+
+/* the columns and the popup's look */
+void
+fact_list_columns_add(GtkTreeView *tv);
@@ -0,0 +1,410 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * hamster-replay: serves a recording made with XFCE4_HAMSTER_RECORD (see
+ * trace.h) as org.gnome.Hamster, so a user's database and timing can be
+ * brought to a test session. Not installed, "make replay" builds it. Run it
+ * on a bus of its own and start the panel there:
+ *
+ *   dbus-run-session -- sh -c 'hamster-replay trace.gz & xfce4-panel'
+ *
+ * A call is answered with the recorded reply to the same method with the
+ * same arguments, the next unused one first, else with that of any
+ * recorded call to the method. The reply is sent after the recorded
+ * delay times --scale, 0 answers at once. Signals follow the recorded
+ * timeline from the first call on. The plugin's latency histograms then
+ * tell how refresh, completion and switching fare; on exit this prints
+ * what was served.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <gio/gio.h>
+#include <glib-unix.h>
+#include "trace.h"
+
+typedef struct
+{
+   HamsterTraceEntry *call;
+   HamsterTraceEntry *reply;  /* NULL if none was recorded */
+   gboolean used;
+} ReplayCall;
+
+typedef struct
+{
+   guint served;
+   guint guessed;             /* same method, other arguments */
+   guint missed;
+   gint64 delay;              /* usec, recorded, summed */
+} ReplayStats;
+
+typedef struct
+{
+   GDBusConnection *bus;
+   GMainLoop *loop;
+   GPtrArray *entries;
+   GHashTable *exact;         /* "interface.member body" -> GQueue of ReplayCall* */
+   GHashTable *byMember;      /* "interface.member" -> GQueue of ReplayCall* */
+   GHashTable *stats;         /* "interface.member" -> ReplayStats* */
+   gdouble scale;
+   gint64 firstCall;          /* recorded time of the first call */
+   gboolean started;
+} Replay;
+
+typedef struct
+{
+   Replay *replay;
+   GDBusMessage *message;     /* to be answered, or the signal to emit */
+   HamsterTraceEntry *entry;
+} ReplayPending;
+
+static gchar*
+replay_method(const gchar *interface, const gchar *member)
+{
+   return g_strdup_printf("%s.%s", interface ? interface : "", member);
+}
+
+static gchar*
+replay_key(const gchar *interface, const gchar *member, GVariant *body)
+{
+   gchar *args = body ? g_variant_print(body, TRUE) : g_strdup("-");
+   gchar *key = g_strdup_printf("%s.%s %s", interface ? interface : "",
+         member, args);
+   g_free(args);
+   return key;
+}
+
+static void
+replay_queue(GHashTable *table, gchar *key, ReplayCall *call)
+{
+   GQueue *queue = g_hash_table_lookup(table, key);
+
+   if(!queue)
+   {
+      queue = g_queue_new();
+      g_hash_table_insert(table, key, queue);
+   }
+   else
+      g_free(key);
+   g_queue_push_tail(queue, call);
+}
+
+/* the first unused call in key's queue */
+static ReplayCall*
+replay_take(GHashTable *table, const gchar *key)
+{
+   GQueue *queue = g_hash_table_lookup(table, key);
+   GList *l;
+
+   for(l = queue ? queue->head : NULL; l; l = l->next)
+   {
+      ReplayCall *call = l->data;
+      if(!call->used)
+         return call;
+   }
+   /* all used up, start over */
+   if(queue && queue->head)
+   {
+      for(l = queue->head; l; l = l->next)
+         ((ReplayCall*)l->data)->used = FALSE;
+      return queue->head->data;
+   }
+   return NULL;
+}
+
+static void
+replay_index(Replay *self)
+{
+   GHashTable *calls = g_hash_table_new(NULL, NULL);
+   guint i;
+
+   self->exact = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+         (GDestroyNotify)g_queue_free);
+   self->byMember = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+         (GDestroyNotify)g_queue_free);
+   self->firstCall = -1;
+   for(i = 0; i < self->entries->len; i++)
+   {
+      HamsterTraceEntry *entry = g_ptr_array_index(self->entries, i);
+      ReplayCall *call;
+
+      if(entry->kind == HAMSTER_TRACE_CALL && entry->member)
+      {
+         call = g_new0(ReplayCall, 1);
+         call->call = entry;
+         g_hash_table_insert(calls, GUINT_TO_POINTER(entry->serial), call);
+         replay_queue(self->exact, replay_key(entry->interface, entry->member,
+                  entry->body), call);
+         replay_queue(self->byMember, replay_method(entry->interface,
+                  entry->member), call);
+         if(self->firstCall < 0)
+            self->firstCall = entry->time;
+      }
+      else if(entry->kind == HAMSTER_TRACE_RETURN
+            || entry->kind == HAMSTER_TRACE_ERROR)
+      {
+         call = g_hash_table_lookup(calls, GUINT_TO_POINTER(entry->replySerial));
+         if(call)
+            call->reply = entry;
+      }
+   }
+   g_hash_table_unref(calls);
+}
+
+static guint
+replay_ms(Replay *self, gint64 usec)
+{
+   return MAX(usec, 0) * self->scale / 1000;
+}
+
+static ReplayStats*
+replay_stats(Replay *self, const gchar *interface, const gchar *member)
+{
+   gchar *method = replay_method(interface, member);
+   ReplayStats *stats = g_hash_table_lookup(self->stats, method);
+
+   if(!stats)
+   {
+      stats = g_new0(ReplayStats, 1);
+      g_hash_table_insert(self->stats, method, stats);
+   }
+   else
+      g_free(method);
+   return stats;
+}
+
+/* Signals */
+static gboolean
+replay_cb_signal(ReplayPending *pending)
+{
+   HamsterTraceEntry *entry = pending->entry;
+   GError *error = NULL;
+
+   if(!g_dbus_connection_emit_signal(pending->replay->bus, NULL, entry->path,
+            entry->interface, entry->member, entry->body, &error))
+   {
+      g_printerr("%s: %s\n", entry->member, error->message);
+      g_error_free(error);
+   }
+   g_free(pending);
+   return G_SOURCE_REMOVE;
+}
+
+/* the recording's clock starts with the first call we get */
+static void
+replay_start(Replay *self)
+{
+   guint i;
+
+   self->started = TRUE;
+   for(i = 0; i < self->entries->len; i++)
+   {
+      HamsterTraceEntry *entry = g_ptr_array_index(self->entries, i);
+      ReplayPending *pending;
+
+      if(entry->kind != HAMSTER_TRACE_SIGNAL || entry->time < self->firstCall)
+         continue;
+      pending = g_new0(ReplayPending, 1);
+      pending->replay = self;
+      pending->entry = entry;
+      g_timeout_add(replay_ms(self, entry->time - self->firstCall),
+            (GSourceFunc)replay_cb_signal, pending);
+   }
+}
+
+/* Calls */
+static gboolean
+replay_cb_reply(ReplayPending *pending)
+{
+   HamsterTraceEntry *reply = pending->entry;
+   GDBusMessage *answer;
+   const gchar *text = "replayed";
+
+   if(!reply)
+      answer = g_dbus_message_new_method_error_literal(pending->message,
+            "org.freedesktop.DBus.Error.UnknownMethod", "not in the trace");
+   else if(reply->kind == HAMSTER_TRACE_ERROR)
+   {
+      if(reply->body && g_variant_is_of_type(reply->body, G_VARIANT_TYPE("(s)")))
+         g_variant_get(reply->body, "(&s)", &text);
+      answer = g_dbus_message_new_method_error_literal(pending->message,
+            reply->member, text);
+   }
+   else
+   {
+      answer = g_dbus_message_new_method_reply(pending->message);
+      if(reply->body)
+         g_dbus_message_set_body(answer, reply->body);
+   }
+   g_dbus_connection_send_message(pending->replay->bus, answer,
+         G_DBUS_SEND_MESSAGE_FLAGS_NONE, NULL, NULL);
+   g_object_unref(answer);
+   g_object_unref(pending->message);
+   g_free(pending);
+   return G_SOURCE_REMOVE;
+}
+
+static gboolean
+replay_cb_call(ReplayPending *pending)
+{
+   Replay *self = pending->replay;
+   GDBusMessage *message = pending->message;
+   const gchar *interface = g_dbus_message_get_interface(message);
+   const gchar *member = g_dbus_message_get_member(message);
+   ReplayStats *stats = replay_stats(self, interface, member);
+   gchar *key = replay_key(interface, member, g_dbus_message_get_body(message));
+   ReplayCall *call = replay_take(self->exact, key);
+   gint64 delay = 0;
+
+   g_free(key);
+   if(!self->started)
+      replay_start(self);
+   if(!call)
+   {
+      gchar *method = replay_method(interface, member);
+      if((call = replay_take(self->byMember, method)))
+         stats->guessed++;
+      g_free(method);
+   }
+   if(call && call->reply)
+   {
+      call->used = TRUE;
+      stats->served++;
+      delay = call->reply->time - call->call->time;
+      stats->delay += delay;
+      pending->entry = call->reply;
+   }
+   else
+      stats->missed++;
+
+   if(pending->entry && self->scale > 0)
+      g_timeout_add(replay_ms(self, delay), (GSourceFunc)replay_cb_reply,
+            pending);
+   else
+      replay_cb_reply(pending);
+   return G_SOURCE_REMOVE;
+}
+
+/* on GDBus' worker thread, calls go to the main loop */
+static GDBusMessage*
+replay_cb_filter(GDBusConnection *bus, GDBusMessage *message,
+                 gboolean incoming, Replay *self)
+{
+   const gchar *path = g_dbus_message_get_path(message);
+   ReplayPending *pending;
+
+   if(!incoming
+         || g_dbus_message_get_message_type(message)
+               != G_DBUS_MESSAGE_TYPE_METHOD_CALL
+         || !path || !g_str_has_prefix(path, "/org/gnome/Hamster"))
+      return message;
+   pending = g_new0(ReplayPending, 1);
+   pending->replay = self;
+   pending->message = message;   /* our reference now */
+   g_main_context_invoke(NULL, (GSourceFunc)replay_cb_call, pending);
+   return NULL;
+}
+
+static gboolean
+replay_cb_quit(Replay *self)
+{
+   g_main_loop_quit(self->loop);
+   return G_SOURCE_REMOVE;
+}
+
+static void
+replay_cb_name_lost(GDBusConnection *bus, const gchar *name, Replay *self)
+{
+   g_printerr("could not own %s\n", name);
+   g_main_loop_quit(self->loop);
+}
+
+static void
+replay_print(Replay *self)
+{
+   GHashTableIter iter;
+   const gchar *method;
+   ReplayStats *stats;
+
+   printf("%-44s %7s %7s %7s %10s\n", "method", "served", "guessed",
+         "missed", "recorded");
+   g_hash_table_iter_init(&iter, self->stats);
+   while(g_hash_table_iter_next(&iter, (gpointer)&method, (gpointer)&stats))
+      printf("%-44s %7u %7u %7u %7.1f ms\n", method, stats->served,
+            stats->guessed, stats->missed, stats->served
+            ? stats->delay / 1000.0 / stats->served : 0.0);
+}
+
+int
+main(int argc, char **argv)
+{
+   static const gchar *names[] =
+   {
+      "org.gnome.Hamster", "org.gnome.Hamster.WindowServer"
+   };
+   Replay self = { 0, };
+   GOptionContext *context;
+   GError *error = NULL;
+   GOptionEntry options[] =
+   {
+      { "scale", 's', 0, G_OPTION_ARG_DOUBLE, &self.scale,
+         "multiply recorded delays, 0 answers at once (default 1)", "F" },
+      { NULL }
+   };
+   guint i;
+
+   self.scale = 1;
+   context = g_option_context_new("TRACE - serve a recorded hamster session");
+   g_option_context_add_main_entries(context, options, NULL);
+   if(!g_option_context_parse(context, &argc, &argv, &error) || argc != 2)
+   {
+      g_printerr("%s\n", error ? error->message
+            : "usage: hamster-replay [--scale=F] TRACE");
+      return 1;
+   }
+   g_option_context_free(context);
+
+   if(!(self.entries = hamster_trace_load(argv[1], &error))
+         || !(self.bus = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, &error)))
+   {
+      g_printerr("%s\n", error->message);
+      return 1;
+   }
+   replay_index(&self);
+   self.stats = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+   self.loop = g_main_loop_new(NULL, FALSE);
+   g_dbus_connection_add_filter(self.bus,
+         (GDBusMessageFilterFunction)replay_cb_filter, &self, NULL);
+   for(i = 0; i < G_N_ELEMENTS(names); i++)
+      g_bus_own_name_on_connection(self.bus, names[i],
+            G_BUS_NAME_OWNER_FLAGS_NONE, NULL,
+            (GBusNameLostCallback)replay_cb_name_lost, &self, NULL);
+   g_unix_signal_add(SIGINT, (GSourceFunc)replay_cb_quit, &self);
+   g_unix_signal_add(SIGTERM, (GSourceFunc)replay_cb_quit, &self);
+   printf("serving %u entries from %s\n", self.entries->len, argv[1]);
+   fflush(stdout);
+
+   g_main_loop_run(self.loop);
+   replay_print(&self);
+   return 0;
+}
@@ -0,0 +1,199 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+#include <gdk/gdk.h>
+#ifdef HAVE_XSYNC
+#  include <gdk/gdkx.h>
+#  include <X11/Xlib.h>
+#  include <X11/extensions/sync.h>
+#endif
+#include <libxfce4util/libxfce4util.h>
+#include "idle.h"
+#include "util.h"
+
+struct _HamsterIdle
+{
+   HamsterIdleNotify notify;
+   gpointer data;
+   guint timeout;             /* seconds, 0 while disabled */
+   gboolean idle;
+#ifdef HAVE_XSYNC
+   GdkDisplay *display;       /* NULL until the extension was found */
+   gint eventBase;
+   XSyncCounter counter;      /* IDLETIME */
+   XSyncAlarm alarm;          /* the one armed, None if none */
+#endif
+};
+
+#ifdef HAVE_XSYNC
+static void
+idle_value(XSyncValue *value, gint64 ms)
+{
+   XSyncIntsToValue(value, (guint)(ms & 0xFFFFFFFF), (gint)(ms >> 32));
+}
+
+static gint64
+idle_value_ms(const XSyncValue *value)
+{
+   return ((gint64)XSyncValueHigh32(*value) << 32)
+      | (guint)XSyncValueLow32(*value);
+}
+
+static void
+idle_disarm(HamsterIdle *self)
+{
+   if(self->alarm != None)
+   {
+      XSyncDestroyAlarm(GDK_DISPLAY_XDISPLAY(self->display), self->alarm);
+      self->alarm = None;
+   }
+}
+
+/* fires once the counter crosses ms upwards, or below it if !up */
+static void
+idle_arm(HamsterIdle *self, gint64 ms, gboolean up)
+{
+   XSyncAlarmAttributes attr;
+   XSyncValue delta;
+
+   idle_disarm(self);
+   attr.trigger.counter = self->counter;
+   attr.trigger.value_type = XSyncAbsolute;
+   attr.trigger.test_type = up ? XSyncPositiveTransition : XSyncNegativeTransition;
+   idle_value(&attr.trigger.wait_value, ms);
+   idle_value(&delta, 0);
+   attr.delta = delta;
+   attr.events = True;
+   self->alarm = XSyncCreateAlarm(GDK_DISPLAY_XDISPLAY(self->display),
+         XSyncCACounter | XSyncCAValueType | XSyncCATestType | XSyncCAValue
+         | XSyncCADelta | XSyncCAEvents, &attr);
+}
+
+static GdkFilterReturn
+idle_cb_filter(GdkXEvent *gxev, GdkEvent *event, HamsterIdle *self)
+{
+   XEvent *xev = gxev;
+   XSyncAlarmNotifyEvent *ev = (XSyncAlarmNotifyEvent*)xev;
+   gint64 ms;
+
+   if(xev->type != self->eventBase + XSyncAlarmNotify
+         || ev->alarm != self->alarm || ev->state == XSyncAlarmDestroyed)
+      return GDK_FILTER_CONTINUE;
+
+   ms = idle_value_ms(&ev->counter_value);
+   if(!self->idle)
+   {
+      self->idle = TRUE;
+      /* back as soon as the counter drops below where it is now */
+      idle_arm(self, MAX(ms - 1, 1), FALSE);
+      DBG("idle for %" G_GINT64_FORMAT "ms", ms);
+      self->notify(TRUE, util_local_now() - ms / 1000, self->data);
+   }
+   else
+   {
+      self->idle = FALSE;
+      /* the timeout may have been turned off meanwhile */
+      if(self->timeout)
+         idle_arm(self, (gint64)self->timeout * 1000, TRUE);
+      else
+         idle_disarm(self);
+      DBG("back");
+      self->notify(FALSE, util_local_now(), self->data);
+   }
+   return GDK_FILTER_REMOVE;
+}
+
+static gboolean
+idle_init(HamsterIdle *self)
+{
+   GdkDisplay *display = gdk_display_get_default();
+   Display *dpy;
+   XSyncSystemCounter *counters;
+   gint errorBase, major, minor, n, i;
+
+   if(self->display)
+      return TRUE;
+   if(!GDK_IS_X11_DISPLAY(display))
+      return FALSE;
+   dpy = GDK_DISPLAY_XDISPLAY(display);
+   if(!XSyncQueryExtension(dpy, &self->eventBase, &errorBase)
+         || !XSyncInitialize(dpy, &major, &minor))
+      return FALSE;
+   counters = XSyncListSystemCounters(dpy, &n);
+   for(i = 0; i < n && !self->counter; i++)
+      if(!g_strcmp0(counters[i].name, "IDLETIME"))
+         self->counter = counters[i].counter;
+   XSyncFreeSystemCounterList(counters);
+   if(!self->counter)
+      return FALSE;
+   self->display = display;
+   gdk_window_add_filter(NULL, (GdkFilterFunc)idle_cb_filter, self);
+   return TRUE;
+}
+#endif
+
+HamsterIdle*
+hamster_idle_new(HamsterIdleNotify notify, gpointer data)
+{
+   HamsterIdle *self = g_new0(HamsterIdle, 1);
+
+   self->notify = notify;
+   self->data = data;
+   return self;
+}
+
+void
+hamster_idle_free(HamsterIdle *self)
+{
+   if(!self)
+      return;
+#ifdef HAVE_XSYNC
+   if(self->display)
+   {
+      idle_disarm(self);
+      gdk_window_remove_filter(NULL, (GdkFilterFunc)idle_cb_filter, self);
+   }
+#endif
+   g_free(self);
+}
+
+gboolean
+hamster_idle_set_timeout(HamsterIdle *self, guint seconds)
+{
+   self->timeout = seconds;
+#ifdef HAVE_XSYNC
+   if(!idle_init(self))
+   {
+      DBG("no IDLETIME counter");
+      return seconds == 0;
+   }
+   /* a change while away waits for the return */
+   if(self->idle)
+      return TRUE;
+   if(seconds)
+      idle_arm(self, (gint64)seconds * 1000, TRUE);
+   else
+      idle_disarm(self);
+   return TRUE;
+#else
+   return seconds == 0;
+#endif
+}
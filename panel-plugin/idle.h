@@ -0,0 +1,42 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <time.h>
+#include <glib.h>
+
+/*
+ * Tells when the user went away and came back, using two XSync alarms on
+ * the server's IDLETIME counter: one for the timeout and, once that fired,
+ * one for the counter going back down. The server does the counting, so
+ * nothing wakes up in here while the user is active.
+ */
+typedef struct _HamsterIdle HamsterIdle;
+
+/* idle is TRUE with the local time idleness began, FALSE on return */
+typedef void (*HamsterIdleNotify)(gboolean idle, time_t since, gpointer data);
+
+HamsterIdle*
+hamster_idle_new(HamsterIdleNotify notify, gpointer data);
+
+void
+hamster_idle_free(HamsterIdle *self);
+
+/* 0 disables; FALSE if the server can't tell */
+gboolean
+hamster_idle_set_timeout(HamsterIdle *self, guint seconds);
@@ -0,0 +1,1205 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+#include <stdio.h>
+#include <string.h>
+#include <libxfce4util/libxfce4util.h>
+#include <libxfce4ui/libxfce4ui.h>
+#include "import.h"
+#include "backend.h"
+#include "parser.h"
+#include "util.h"
+
+#define DAY_SECONDS (24 * 60 * 60)
+#define CHUNK_DAYS 7
+#define IMPORT_WINDOW 16      /* AddFact calls in flight */
+
+typedef enum
+{
+   IMPORT_PLAIN,
+   IMPORT_CSV,
+   IMPORT_ICS
+} ImportFormat;
+
+typedef enum
+{
+   ITEM_OK,
+   ITEM_CONFLICT,             /* overlaps, only sent if asked to */
+   ITEM_BAD,                  /* never sent */
+   ITEM_ADDED,
+   ITEM_FAILED
+} ItemState;
+
+typedef struct _Import Import;
+
+typedef struct
+{
+   Import *import;
+   gint line;                 /* where it starts in the file */
+   time_t start;
+   time_t end;
+   gchar *fact;               /* what AddFact gets */
+   gchar *message;            /* why it is bad, conflicts or failed */
+   ItemState state;
+} ImportItem;
+
+struct _Import
+{
+   HamsterBackend *backend;   /* our own, picked like the view's, which the
+                                 view may replace */
+   GFile *file;
+   GPtrArray *items;          /* ImportItem*, by start once checked */
+   gboolean conflicting;      /* send ITEM_CONFLICT too */
+   guint next;                /* to look at for sending */
+   guint inflight;
+   guint total;               /* to send */
+   guint added;
+   guint failed;
+   GCancellable *cancellable;
+   GCancellable *owner;       /* the caller's, drops done when cancelled */
+   gulong ownerHandler;
+   GtkWidget *window;
+   GtkWidget *progress;
+   ImportDone done;
+   gpointer data;
+};
+
+/* Items */
+static ImportItem*
+import_item_add(Import *imp, gint line)
+{
+   ImportItem *item = g_new0(ImportItem, 1);
+
+   item->import = imp;
+   item->line = line;
+   g_ptr_array_add(imp->items, item);
+   return item;
+}
+
+static void
+import_item_free(ImportItem *item)
+{
+   g_free(item->fact);
+   g_free(item->message);
+   g_free(item);
+}
+
+static gboolean
+import_item_bad(ImportItem *item, const gchar *message)
+{
+   item->state = ITEM_BAD;
+   g_free(item->message);
+   item->message = g_strdup(message);
+   return FALSE;
+}
+
+/* the first reason is kept */
+static void
+import_item_conflict(ImportItem *item, gchar *message)
+{
+   if(item->state == ITEM_OK)
+   {
+      item->state = ITEM_CONFLICT;
+      item->message = message;
+   }
+   else
+      g_free(message);
+}
+
+static gboolean
+import_item_submittable(const Import *imp, const ImportItem *item)
+{
+   return item->state == ITEM_OK
+      || (imp->conflicting && item->state == ITEM_CONFLICT);
+}
+
+/* checks what the daemon would choke on, takes the fact if it is fine */
+static gboolean
+import_item_set(ImportItem *item, const fact_spec *spec)
+{
+   gchar **tag;
+
+   if(!spec->startTime || !spec->endTime)
+      return import_item_bad(item, _("Needs a start and an end"));
+   if(spec->endTime <= spec->startTime)
+      return import_item_bad(item, _("Ends before it starts"));
+   if(!spec->name || !*spec->name)
+      return import_item_bad(item, _("Activity is missing"));
+   if(strpbrk(spec->name, "@,") || (spec->category && strpbrk(spec->category, "@,")))
+      return import_item_bad(item,
+            _("Activity and category can't contain '@' or ','"));
+   for(tag = spec->tags; tag && *tag; tag++)
+      if(!**tag || strpbrk(*tag, " \t,#"))
+         return import_item_bad(item, _("Tags can't be empty or contain blanks"));
+   item->start = spec->startTime;
+   item->end = spec->endTime;
+   item->fact = fact_spec_to_string(spec);
+   return TRUE;
+}
+
+static gint
+import_item_by_start(gconstpointer a, gconstpointer b)
+{
+   const ImportItem *x = *(const ImportItem**)a, *y = *(const ImportItem**)b;
+
+   if(x->start != y->start)
+      return x->start < y->start ? -1 : 1;
+   return x->line - y->line;
+}
+
+static gint
+import_item_by_line(gconstpointer a, gconstpointer b)
+{
+   const ImportItem *x = *(const ImportItem**)a, *y = *(const ImportItem**)b;
+   return x->line - y->line;
+}
+
+/* Times */
+static time_t
+import_local(gint y, gint m, gint d, gint hh, gint mm, gint ss)
+{
+   GDate date;
+
+   g_date_clear(&date, 1);
+   g_date_set_dmy(&date, d, m, y);
+   /* 1970-01-01 is julian day 719163 */
+   return ((time_t)g_date_get_julian(&date) - 719163) * DAY_SECONDS
+      + hh * 3600 + mm * 60 + ss;
+}
+
+/* "YYYY-MM-DD HH:MM[:SS]", also with a T */
+static gboolean
+import_parse_time(const gchar *text, time_t *out)
+{
+   gint y, m, d, hh, mm, ss = 0;
+
+   if(sscanf(text, "%4d-%2d-%2d%*1[ T]%2d:%2d:%2d", &y, &m, &d, &hh, &mm,
+            &ss) < 5
+         || !g_date_valid_dmy(d, m, y) || hh > 23 || mm > 59 || ss > 59)
+      return FALSE;
+   *out = import_local(y, m, d, hh, mm, ss);
+   return TRUE;
+}
+
+static void
+import_format_span(gchar *buf, gsize size, time_t start, time_t end)
+{
+   struct tm s, e;
+
+   /* hamster times are local already */
+   gmtime_r(&start, &s);
+   gmtime_r(&end, &e);
+   g_snprintf(buf, size, "%04d-%02d-%02d %02d:%02d - %02d:%02d",
+         s.tm_year + 1900, s.tm_mon + 1, s.tm_mday, s.tm_hour, s.tm_min,
+         e.tm_hour, e.tm_min);
+}
+
+/* Plain lines */
+static void
+import_parse_plain(Import *imp, const gchar *text, time_t now)
+{
+   gchar **lines = g_strsplit(text, "\n", -1);
+   gint i;
+
+   for(i = 0; lines[i]; i++)
+   {
+      gchar *line = g_strstrip(lines[i]);
+      GError *error = NULL;
+      ImportItem *item;
+      fact_spec spec;
+
+      /* blank lines and comments */
+      if(!*line || *line == '#')
+         continue;
+      item = import_item_add(imp, i + 1);
+      if(!fact_spec_parse(&spec, line, now, &error))
+      {
+         import_item_bad(item, error->message);
+         g_error_free(error);
+         continue;
+      }
+      import_item_set(item, &spec);
+      fact_spec_clear(&spec);
+   }
+   g_strfreev(lines);
+}
+
+/* CSV */
+typedef enum
+{
+   CSV_START,
+   CSV_END,
+   CSV_MINUTES,
+   CSV_ACTIVITY,
+   CSV_CATEGORY,
+   CSV_DESCRIPTION,
+   CSV_TAGS,
+   CSV_COLUMNS
+} CsvColumn;
+
+/* header names, the second one is an alias */
+static const gchar *import_csv_names[CSV_COLUMNS][2] =
+{
+   { "start", NULL },
+   { "end", NULL },
+   { "minutes", "duration" },
+   { "activity", "name" },
+   { "category", NULL },
+   { "description", NULL },
+   { "tags", NULL }
+};
+
+/* one record, quoted fields may span lines; NULL at the end */
+static GPtrArray*
+import_csv_record(const gchar **p, gint *line)
+{
+   const gchar *s = *p;
+   GPtrArray *fields;
+   GString *field;
+
+   if(!*s)
+      return NULL;
+   fields = g_ptr_array_new_with_free_func(g_free);
+   for(;;)
+   {
+      field = g_string_new(NULL);
+      if(*s == '"')
+      {
+         for(s++; *s; s++)
+         {
+            if(*s == '"')
+            {
+               if(s[1] != '"')
+               {
+                  s++;
+                  break;
+               }
+               s++;
+            }
+            else if(*s == '\n')
+               (*line)++;
+            g_string_append_c(field, *s);
+         }
+      }
+      while(*s && *s != ',' && *s != '\n' && *s != '\r')
+         g_string_append_c(field, *s++);
+      g_ptr_array_add(fields, g_string_free(field, FALSE));
+      if(*s != ',')
+         break;
+      s++;
+   }
+   if(*s == '\r')
+      s++;
+   if(*s == '\n')
+   {
+      s++;
+      (*line)++;
+   }
+   *p = s;
+   return fields;
+}
+
+static const gchar*
+import_csv_field(GPtrArray *record, const gint *columns, CsvColumn column)
+{
+   gint i = columns[column];
+   return i >= 0 && (guint)i < record->len
+      ? g_ptr_array_index(record, i) : "";
+}
+
+static gchar**
+import_split_tags(const gchar *text)
+{
+   gchar **words = g_strsplit_set(text, " ,", -1);
+   GPtrArray *tags = g_ptr_array_new();
+   gint i;
+
+   for(i = 0; words[i]; i++)
+   {
+      const gchar *tag = words[i][0] == '#' ? words[i] + 1 : words[i];
+      if(*tag)
+         g_ptr_array_add(tags, g_strdup(tag));
+   }
+   g_ptr_array_add(tags, NULL);
+   g_strfreev(words);
+   return (gchar**)g_ptr_array_free(tags, FALSE);
+}
+
+static gboolean
+import_csv_item(ImportItem *item, GPtrArray *record, const gint *columns)
+{
+   const gchar *end = import_csv_field(record, columns, CSV_END);
+   const gchar *category = import_csv_field(record, columns, CSV_CATEGORY);
+   gint minutes = atoi(import_csv_field(record, columns, CSV_MINUTES));
+   fact_spec spec = { 0 };
+   gboolean ok;
+
+   if(!import_parse_time(import_csv_field(record, columns, CSV_START),
+            &spec.startTime))
+      return import_item_bad(item, _("Start is not YYYY-MM-DD HH:MM"));
+   if(*end)
+   {
+      if(!import_parse_time(end, &spec.endTime))
+         return import_item_bad(item, _("End is not YYYY-MM-DD HH:MM"));
+   }
+   else if(minutes > 0)
+      spec.endTime = spec.startTime + minutes * 60;
+   spec.name = g_strstrip(g_strdup(import_csv_field(record, columns,
+               CSV_ACTIVITY)));
+   spec.category = *category ? g_strstrip(g_strdup(category)) : NULL;
+   spec.description = g_strdup(import_csv_field(record, columns,
+            CSV_DESCRIPTION));
+   spec.tags = import_split_tags(import_csv_field(record, columns, CSV_TAGS));
+   ok = import_item_set(item, &spec);
+   fact_spec_clear(&spec);
+   return ok;
+}
+
+static void
+import_parse_csv(Import *imp, const gchar *text)
+{
+   const gchar *p = text;
+   gint line = 1, first, columns[CSV_COLUMNS];
+   GPtrArray *record = import_csv_record(&p, &line);
+   guint i, c;
+
+   for(c = 0; c < CSV_COLUMNS; c++)
+   {
+      columns[c] = -1;
+      for(i = 0; record && i < record->len; i++)
+      {
+         gchar *name = g_strstrip(g_ptr_array_index(record, i));
+         if(!g_ascii_strcasecmp(name, import_csv_names[c][0])
+               || (import_csv_names[c][1]
+                  && !g_ascii_strcasecmp(name, import_csv_names[c][1])))
+            columns[c] = i;
+      }
+   }
+   if(record)
+      g_ptr_array_unref(record);
+   if(columns[CSV_START] < 0 || columns[CSV_ACTIVITY] < 0
+         || (columns[CSV_END] < 0 && columns[CSV_MINUTES] < 0))
+   {
+      import_item_bad(import_item_add(imp, 1),
+            _("The first line must name the columns: start, end or minutes, "
+              "activity, and optionally category, description and tags"));
+      return;
+   }
+
+   for(first = line; (record = import_csv_record(&p, &line)); first = line)
+   {
+      /* a blank line */
+      if(record->len == 1 && !*(gchar*)g_ptr_array_index(record, 0))
+      {
+         g_ptr_array_unref(record);
+         continue;
+      }
+      import_csv_item(import_item_add(imp, first), record, columns);
+      g_ptr_array_unref(record);
+   }
+}
+
+/* iCalendar */
+typedef struct
+{
+   gint line;
+   gchar *summary;
+   gchar *description;
+   gchar *categories;
+   time_t start;
+   time_t end;
+   gint duration;             /* seconds, -1 if not given */
+   const gchar *bad;          /* the first problem */
+} IcsEvent;
+
+static gchar*
+import_ics_unescape(const gchar *value)
+{
+   GString *out = g_string_new(NULL);
+
+   for(; *value; value++)
+   {
+      if(*value == '\\' && value[1])
+      {
+         value++;
+         g_string_append_c(out, *value == 'n' || *value == 'N' ? '\n' : *value);
+      }
+      else
+         g_string_append_c(out, *value);
+   }
+   return g_string_free(out, FALSE);
+}
+
+/* YYYYMMDDTHHMMSS, UTC with a Z, else taken as wall clock */
+static const gchar*
+import_ics_time(const gchar *params, const gchar *value, time_t *out)
+{
+   gint y, m, d, hh, mm, ss;
+   gsize n = strlen(value);
+
+   if(n == 8 || (params && strstr(params, "VALUE=DATE")
+            && !strstr(params, "VALUE=DATE-TIME")))
+      return _("All-day events are not imported");
+   if(sscanf(value, "%4d%2d%2dT%2d%2d%2d", &y, &m, &d, &hh, &mm, &ss) != 6
+         || !g_date_valid_dmy(d, m, y) || hh > 23 || mm > 59 || ss > 60)
+      return _("Not an iCalendar date and time");
+   if(value[n - 1] == 'Z')
+   {
+      GDateTime *utc = g_date_time_new_utc(y, m, d, hh, mm, ss);
+      GDateTime *local = g_date_time_to_local(utc);
+      *out = g_date_time_to_unix(local)
+         + g_date_time_get_utc_offset(local) / G_TIME_SPAN_SECOND;
+      g_date_time_unref(local);
+      g_date_time_unref(utc);
+   }
+   else
+      *out = import_local(y, m, d, hh, mm, MIN(ss, 59));
+   return NULL;
+}
+
+/* [+-]P[nW][nD][T[nH][nM][nS]] */
+static gint
+import_ics_duration(const gchar *value)
+{
+   gint seconds = 0, n = 0, sign = 1;
+   const gchar *s = value;
+
+   if(*s == '+' || *s == '-')
+      sign = *s++ == '-' ? -1 : 1;
+   if(*s++ != 'P')
+      return -1;
+   for(; *s; s++)
+   {
+      if(g_ascii_isdigit(*s))
+      {
+         n = n * 10 + (*s - '0');
+         continue;
+      }
+      switch(*s)
+      {
+         case 'W': seconds += n * 7 * DAY_SECONDS; break;
+         case 'D': seconds += n * DAY_SECONDS; break;
+         case 'H': seconds += n * 3600; break;
+         case 'M': seconds += n * 60; break;
+         case 'S': seconds += n; break;
+         case 'T': break;
+         default: return -1;
+      }
+      n = 0;
+   }
+   return sign * seconds;
+}
+
+static void
+import_ics_property(IcsEvent *ev, gchar *line)
+{
+   gchar *colon = strchr(line, ':'), *params, *value;
+   time_t *when = NULL;
+   const gchar *bad = NULL;
+
+   if(!colon)
+      return;
+   *colon = '\0';
+   value = colon + 1;
+   params = strchr(line, ';');
+   if(params)
+      *params++ = '\0';
+
+   if(!g_ascii_strcasecmp(line, "SUMMARY"))
+   {
+      g_free(ev->summary);
+      ev->summary = import_ics_unescape(value);
+   }
+   else if(!g_ascii_strcasecmp(line, "DESCRIPTION"))
+   {
+      g_free(ev->description);
+      ev->description = import_ics_unescape(value);
+   }
+   else if(!g_ascii_strcasecmp(line, "CATEGORIES") && !ev->categories)
+   {
+      /* the first one, escaped commas are not worth it */
+      gchar *comma = strchr(value, ',');
+      ev->categories = import_ics_unescape(value);
+      if(comma)
+         ev->categories[strcspn(ev->categories, ",")] = '\0';
+   }
+   else if(!g_ascii_strcasecmp(line, "DTSTART"))
+      when = &ev->start;
+   else if(!g_ascii_strcasecmp(line, "DTEND"))
+      when = &ev->end;
+   else if(!g_ascii_strcasecmp(line, "DURATION")
+         && (ev->duration = import_ics_duration(value)) < 0)
+      bad = _("Not an iCalendar duration");
+
+   if(when)
+      bad = import_ics_time(params, value, when);
+   if(bad && !ev->bad)
+      ev->bad = bad;
+}
+
+/* SUMMARY is read as a fact, so "Call@Work, budget #billable" works */
+static gboolean
+import_ics_item(ImportItem *item, IcsEvent *ev, time_t now)
+{
+   GError *error = NULL;
+   fact_spec spec;
+   gboolean ok;
+
+   if(ev->bad)
+      return import_item_bad(item, ev->bad);
+   if(!ev->summary || !*ev->summary)
+      return import_item_bad(item, _("The event has no SUMMARY"));
+   if(!ev->start)
+      return import_item_bad(item, _("The event has no DTSTART"));
+   if(!ev->end && ev->duration < 0)
+      return import_item_bad(item, _("The event has no DTEND or DURATION"));
+   if(!fact_spec_parse(&spec, ev->summary, now, &error))
+   {
+      import_item_bad(item, error->message);
+      g_error_free(error);
+      return FALSE;
+   }
+   spec.startTime = ev->start;
+   spec.endTime = ev->end ? ev->end : ev->start + ev->duration;
+   if(!spec.category && ev->categories && *ev->categories)
+      spec.category = g_strdup(ev->categories);
+   if(!spec.description && ev->description && *ev->description)
+      spec.description = g_strdelimit(g_strdup(ev->description), "\r\n", ' ');
+   ok = import_item_set(item, &spec);
+   fact_spec_clear(&spec);
+   return ok;
+}
+
+static void
+import_ics_clear(IcsEvent *ev)
+{
+   g_free(ev->summary);
+   g_free(ev->description);
+   g_free(ev->categories);
+   memset(ev, 0, sizeof(*ev));
+   ev->duration = -1;
+}
+
+static void
+import_ics_line(Import *imp, IcsEvent *ev, gchar *line, gint number,
+                time_t now)
+{
+   if(!g_ascii_strcasecmp(line, "BEGIN:VEVENT"))
+   {
+      import_ics_clear(ev);
+      ev->line = number;
+   }
+   else if(!ev->line)
+      return;  /* outside of an event */
+   else if(!g_ascii_strcasecmp(line, "END:VEVENT"))
+   {
+      import_ics_item(import_item_add(imp, ev->line), ev, now);
+      import_ics_clear(ev);
+   }
+   else
+      import_ics_property(ev, line);
+}
+
+static void
+import_parse_ics(Import *imp, const gchar *text, time_t now)
+{
+   gchar **lines = g_strsplit(text, "\n", -1);
+   GString *logical = g_string_new(NULL);
+   IcsEvent ev = { 0 };
+   gint i, start = 0;
+
+   import_ics_clear(&ev);
+   for(i = 0; ; i++)
+   {
+      gchar *raw = lines[i];
+
+      if(raw)
+      {
+         gsize n = strlen(raw);
+         if(n && raw[n - 1] == '\r')
+            raw[n - 1] = '\0';
+         /* folded: a blank starts a continuation */
+         if((raw[0] == ' ' || raw[0] == '\t') && logical->len)
+         {
+            g_string_append(logical, raw + 1);
+            continue;
+         }
+      }
+      if(logical->len)
+         import_ics_line(imp, &ev, logical->str, start, now);
+      if(!raw)
+         break;
+      g_string_assign(logical, raw);
+      start = i + 1;
+   }
+   import_ics_clear(&ev);
+   g_string_free(logical, TRUE);
+   g_strfreev(lines);
+}
+
+/* Reading, on a worker; nothing here talks to the backend */
+static ImportFormat
+import_format(GFile *file, const gchar *text)
+{
+   gchar *name = g_file_get_basename(file);
+   gchar *lower = g_ascii_strdown(name, -1);
+   ImportFormat format = IMPORT_PLAIN;
+
+   if(g_str_has_suffix(lower, ".ics") || g_str_has_prefix(text, "BEGIN:VCALENDAR"))
+      format = IMPORT_ICS;
+   else if(g_str_has_suffix(lower, ".csv"))
+      format = IMPORT_CSV;
+   g_free(lower);
+   g_free(name);
+   return format;
+}
+
+/* Checking, back on the main thread where the backend lives; sorted by
+ * start like the items, hamster's own facts don't overlap, so their ends
+ * are sorted too */
+static gboolean
+import_fetch_tracked(Import *imp, time_t from, time_t to, GArray *tracked,
+                     GCancellable *cancellable, GError **error)
+{
+   time_t day, now = util_local_now();
+
+   for(day = from; day <= to; day += CHUNK_DAYS * DAY_SECONDS)
+   {
+      time_t last = MIN(day + (CHUNK_DAYS - 1) * DAY_SECONDS, to);
+      GVariant *res;
+      gsize i, n;
+
+      if(g_cancellable_set_error_if_cancelled(cancellable, error))
+         return FALSE;
+      res = hamster_backend_get_facts(imp->backend, day, last, "", error);
+      if(!res)
+         return FALSE;
+      n = g_variant_n_children(res);
+      for(i = 0; i < n; i++)
+      {
+         GVariant *child = g_variant_get_child_value(res, i);
+         fact *f = fact_new(child);
+         time_t span[2];
+
+         g_variant_unref(child);
+         if(!f)
+            continue;
+         span[0] = f->startTime;
+         span[1] = f->endTime ? f->endTime : now;
+         /* facts over midnight come again with the next chunk */
+         if(!tracked->len
+               || g_array_index(tracked, time_t, tracked->len - 2) < span[0])
+            g_array_append_vals(tracked, span, 2);
+         fact_free(f);
+      }
+      g_variant_unref(res);
+   }
+   return TRUE;
+}
+
+static void
+import_check_overlaps(Import *imp, GArray *tracked)
+{
+   ImportItem *prev = NULL;
+   guint i, j = 0, n = tracked->len / 2;
+
+   for(i = 0; i < imp->items->len; i++)
+   {
+      ImportItem *item = g_ptr_array_index(imp->items, i);
+      guint k;
+
+      if(!item->fact)
+         continue;
+      /* among themselves */
+      if(prev && item->start < prev->end)
+      {
+         import_item_conflict(item,
+               g_strdup_printf(_("Overlaps line %d"), prev->line));
+         import_item_conflict(prev,
+               g_strdup_printf(_("Overlaps line %d"), item->line));
+      }
+      if(!prev || item->end > prev->end)
+         prev = item;
+
+      /* with what is tracked */
+      while(j < n && g_array_index(tracked, time_t, 2 * j + 1) <= item->start)
+         j++;
+      for(k = j; k < n; k++)
+      {
+         time_t start = g_array_index(tracked, time_t, 2 * k);
+         time_t end = g_array_index(tracked, time_t, 2 * k + 1);
+         if(start >= item->end)
+            break;
+         if(end > item->start)
+         {
+            import_item_conflict(item, start == item->start && end == item->end
+                  ? g_strdup(_("Already tracked"))
+                  : g_strdup(_("Overlaps a tracked fact")));
+            break;
+         }
+      }
+   }
+}
+
+static gboolean
+import_check(Import *imp, GError **error)
+{
+   time_t from = 0, to = 0;
+   GArray *tracked;
+   guint i;
+
+   for(i = 0; i < imp->items->len; i++)
+   {
+      const ImportItem *item = g_ptr_array_index(imp->items, i);
+      if(!item->fact)
+         continue;
+      if(!from)
+         from = item->start - item->start % DAY_SECONDS;
+      to = MAX(to, item->end - item->end % DAY_SECONDS);
+   }
+   tracked = g_array_new(FALSE, FALSE, sizeof(time_t));
+   if(from && !import_fetch_tracked(imp, from, to, tracked, imp->cancellable,
+            error))
+   {
+      g_array_unref(tracked);
+      return FALSE;
+   }
+   import_check_overlaps(imp, tracked);
+   g_array_unref(tracked);
+   return TRUE;
+}
+
+static void
+import_read(GTask *task, gpointer source, Import *imp,
+            GCancellable *cancellable)
+{
+   GError *error = NULL;
+   gchar *contents = NULL, *text;
+   gsize length;
+   time_t now = util_local_now();
+
+   if(!g_file_load_contents(imp->file, cancellable, &contents, &length, NULL,
+            &error))
+   {
+      g_task_return_error(task, error);
+      return;
+   }
+   if(!g_utf8_validate(contents, length, NULL))
+   {
+      g_free(contents);
+      g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+            _("The file is not UTF-8 text"));
+      return;
+   }
+   /* a byte order mark is not part of the first line */
+   text = g_str_has_prefix(contents, "\xEF\xBB\xBF") ? contents + 3 : contents;
+   switch(import_format(imp->file, text))
+   {
+      case IMPORT_CSV:
+         import_parse_csv(imp, text);
+         break;
+      case IMPORT_ICS:
+         import_parse_ics(imp, text, now);
+         break;
+      default:
+         import_parse_plain(imp, text, now);
+   }
+   g_free(contents);
+
+   g_ptr_array_sort(imp->items, import_item_by_start);
+   g_task_return_boolean(task, TRUE);
+}
+
+static void
+import_free(Import *imp)
+{
+   if(imp->window)
+      gtk_widget_destroy(imp->window);
+   if(imp->owner)
+   {
+      g_cancellable_disconnect(imp->owner, imp->ownerHandler);
+      g_object_unref(imp->owner);
+   }
+   hamster_backend_free(imp->backend);
+   g_object_unref(imp->file);
+   g_object_unref(imp->cancellable);
+   g_ptr_array_unref(imp->items);
+   g_free(imp);
+}
+
+/* Report */
+static void
+import_report(const gchar *summary, const gchar *report)
+{
+   GtkWidget *dlg, *cnt, *lbl, *scr, *txt;
+
+   dlg = gtk_dialog_new_with_buttons(_("Import"), NULL, 0,
+         _("_Close"), GTK_RESPONSE_CLOSE, NULL);
+   gtk_window_set_icon_name(GTK_WINDOW(dlg), "org.gnome.Hamster.GUI");
+   gtk_window_set_default_size(GTK_WINDOW(dlg), 480, 320);
+   cnt = gtk_dialog_get_content_area(GTK_DIALOG(dlg));
+   gtk_container_set_border_width(GTK_CONTAINER(cnt), 6);
+   lbl = gtk_label_new(summary);
+   gtk_widget_set_halign(lbl, GTK_ALIGN_START);
+   gtk_container_add(GTK_CONTAINER(cnt), lbl);
+   txt = gtk_text_view_new();
+   gtk_text_view_set_editable(GTK_TEXT_VIEW(txt), FALSE);
+   gtk_text_view_set_monospace(GTK_TEXT_VIEW(txt), TRUE);
+   gtk_text_buffer_set_text(gtk_text_view_get_buffer(GTK_TEXT_VIEW(txt)),
+         report, -1);
+   scr = gtk_scrolled_window_new(NULL, NULL);
+   gtk_widget_set_vexpand(scr, TRUE);
+   gtk_scrolled_window_set_shadow_type(GTK_SCROLLED_WINDOW(scr), GTK_SHADOW_IN);
+   gtk_container_add(GTK_CONTAINER(scr), txt);
+   gtk_container_add(GTK_CONTAINER(cnt), scr);
+   gtk_widget_show_all(dlg);
+   gtk_dialog_run(GTK_DIALOG(dlg));
+   gtk_widget_destroy(dlg);
+}
+
+static void
+import_finish(Import *imp)
+{
+   GString *report = g_string_new(NULL);
+   gchar *summary;
+   time_t first = 0, last = 0;
+   guint i;
+
+   g_ptr_array_sort(imp->items, import_item_by_line);
+   for(i = 0; i < imp->items->len; i++)
+   {
+      const ImportItem *item = g_ptr_array_index(imp->items, i);
+      switch(item->state)
+      {
+         case ITEM_ADDED:
+            first = first ? MIN(first, item->start) : item->start;
+            last = MAX(last, item->start);
+            break;
+         case ITEM_BAD:
+         case ITEM_FAILED:
+            g_string_append_printf(report, _("Line %d: %s\n"), item->line,
+                  item->message);
+            break;
+         case ITEM_CONFLICT:
+            g_string_append_printf(report, _("Line %d: %s, skipped\n"),
+                  item->line, item->message);
+            break;
+         case ITEM_OK:
+            /* cancelled before it was sent */
+            g_string_append_printf(report, _("Line %d: not sent\n"),
+                  item->line);
+            break;
+         default:
+            break;
+      }
+   }
+   summary = g_strdup_printf(_("Facts added: %u of %u"), imp->added,
+         imp->total);
+   util_notify(_("Import finished"), summary);
+   if(imp->added && imp->done)
+      imp->done(first, last, imp->data);
+   if(imp->window)
+   {
+      gtk_widget_destroy(imp->window);
+      imp->window = NULL;
+   }
+   if(report->len)
+      import_report(summary, report->str);
+   g_free(summary);
+   g_string_free(report, TRUE);
+   import_free(imp);
+}
+
+/* Sending: up to IMPORT_WINDOW AddFact calls wait for the daemon at once,
+ * each answer sends the next one */
+static void
+import_pump(Import *imp);
+
+static void
+import_cb_added(GObject *source, GAsyncResult *result, ImportItem *item)
+{
+   Import *imp = item->import;
+   GError *error = NULL;
+
+   if(hamster_backend_add_fact_finish(result, NULL, &error))
+   {
+      item->state = ITEM_ADDED;
+      imp->added++;
+   }
+   else
+   {
+      item->state = ITEM_FAILED;
+      g_free(item->message);
+      item->message = g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)
+         ? g_strdup(_("Cancelled, it may have been added anyway"))
+         : g_strdup(error->message);
+      imp->failed++;
+      g_error_free(error);
+   }
+   imp->inflight--;
+   gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(imp->progress),
+         (gdouble)(imp->added + imp->failed) / MAX(imp->total, 1));
+   import_pump(imp);
+}
+
+static void
+import_pump(Import *imp)
+{
+   while(imp->inflight < IMPORT_WINDOW && imp->next < imp->items->len
+         && !g_cancellable_is_cancelled(imp->cancellable))
+   {
+      ImportItem *item = g_ptr_array_index(imp->items, imp->next++);
+      if(!import_item_submittable(imp, item))
+         continue;
+      imp->inflight++;
+      hamster_backend_add_fact_async(imp->backend, item->fact, item->start,
+            item->end, imp->cancellable,
+            (GAsyncReadyCallback)import_cb_added, item);
+   }
+   if(!imp->inflight)
+      import_finish(imp);
+}
+
+static void
+import_cb_cancel(GtkWidget *widget, Import *imp)
+{
+   g_cancellable_cancel(imp->cancellable);
+}
+
+static void
+import_start(Import *imp)
+{
+   GtkWidget *box, *lbl, *btn;
+   gchar *name = g_file_get_basename(imp->file);
+   gchar *text = g_strdup_printf(_("Importing %u facts from %s"), imp->total,
+         name);
+
+   imp->window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+   gtk_window_set_title(GTK_WINDOW(imp->window), _("Import"));
+   gtk_window_set_icon_name(GTK_WINDOW(imp->window), "org.gnome.Hamster.GUI");
+   gtk_window_set_deletable(GTK_WINDOW(imp->window), FALSE);
+   box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 6);
+   gtk_container_set_border_width(GTK_CONTAINER(box), 12);
+   gtk_container_add(GTK_CONTAINER(imp->window), box);
+   lbl = gtk_label_new(text);
+   gtk_container_add(GTK_CONTAINER(box), lbl);
+   imp->progress = gtk_progress_bar_new();
+   gtk_container_add(GTK_CONTAINER(box), imp->progress);
+   btn = gtk_button_new_with_mnemonic(_("_Cancel"));
+   gtk_widget_set_halign(btn, GTK_ALIGN_END);
+   g_signal_connect(btn, "clicked", G_CALLBACK(import_cb_cancel), imp);
+   gtk_container_add(GTK_CONTAINER(box), btn);
+   gtk_widget_show_all(imp->window);
+   g_free(text);
+   g_free(name);
+
+   imp->next = 0;
+   import_pump(imp);
+}
+
+/* Preview */
+enum
+{
+   PREVIEW_ICON,
+   PREVIEW_LINE,
+   PREVIEW_SPAN,
+   PREVIEW_FACT,
+   PREVIEW_MESSAGE,
+   PREVIEW_COLUMNS
+};
+
+static guint
+import_count(const Import *imp, ItemState state)
+{
+   guint i, n = 0;
+
+   for(i = 0; i < imp->items->len; i++)
+      n += ((ImportItem*)g_ptr_array_index(imp->items, i))->state == state;
+   return n;
+}
+
+static GtkWidget*
+import_preview_view(Import *imp)
+{
+   GtkListStore *store = gtk_list_store_new(PREVIEW_COLUMNS, G_TYPE_STRING,
+         G_TYPE_INT, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING);
+   GtkWidget *tv;
+   GtkTreeIter iter;
+   guint i;
+
+   for(i = 0; i < imp->items->len; i++)
+   {
+      const ImportItem *item = g_ptr_array_index(imp->items, i);
+      gchar span[64] = "";
+
+      if(item->fact)
+         import_format_span(span, sizeof(span), item->start, item->end);
+      gtk_list_store_insert_with_values(store, &iter, -1,
+            PREVIEW_ICON, item->state == ITEM_BAD ? "dialog-error"
+               : item->state == ITEM_CONFLICT ? "dialog-warning" : NULL,
+            PREVIEW_LINE, item->line,
+            PREVIEW_SPAN, span,
+            PREVIEW_FACT, item->fact,
+            PREVIEW_MESSAGE, item->message,
+            -1);
+   }
+   tv = gtk_tree_view_new_with_model(GTK_TREE_MODEL(store));
+   g_object_unref(store);
+   gtk_tree_view_insert_column_with_attributes(GTK_TREE_VIEW(tv), -1, NULL,
+         gtk_cell_renderer_pixbuf_new(), "icon-name", PREVIEW_ICON, NULL);
+   gtk_tree_view_insert_column_with_attributes(GTK_TREE_VIEW(tv), -1,
+         _("Line"), gtk_cell_renderer_text_new(), "text", PREVIEW_LINE, NULL);
+   gtk_tree_view_insert_column_with_attributes(GTK_TREE_VIEW(tv), -1,
+         _("Time"), gtk_cell_renderer_text_new(), "text", PREVIEW_SPAN, NULL);
+   gtk_tree_view_insert_column_with_attributes(GTK_TREE_VIEW(tv), -1,
+         _("Fact"), gtk_cell_renderer_text_new(), "text", PREVIEW_FACT, NULL);
+   gtk_tree_view_insert_column_with_attributes(GTK_TREE_VIEW(tv), -1,
+         _("Problem"), gtk_cell_renderer_text_new(), "text", PREVIEW_MESSAGE,
+         NULL);
+   return tv;
+}
+
+static void
+import_preview(Import *imp)
+{
+   GtkWidget *dlg, *cnt, *lbl, *scr, *chk;
+   guint ok = import_count(imp, ITEM_OK);
+   guint conflicts = import_count(imp, ITEM_CONFLICT);
+   guint bad = import_count(imp, ITEM_BAD);
+   gchar *text;
+   gint response;
+
+   dlg = gtk_dialog_new_with_buttons(_("Import facts"), NULL, 0,
+         _("_Cancel"), GTK_RESPONSE_CANCEL,
+         _("_Import"), GTK_RESPONSE_ACCEPT,
+         NULL);
+   gtk_window_set_icon_name(GTK_WINDOW(dlg), "org.gnome.Hamster.GUI");
+   gtk_window_set_default_size(GTK_WINDOW(dlg), 640, 480);
+   cnt = gtk_dialog_get_content_area(GTK_DIALOG(dlg));
+   gtk_container_set_border_width(GTK_CONTAINER(cnt), 6);
+   gtk_box_set_spacing(GTK_BOX(cnt), 6);
+
+   text = g_strdup_printf(_("%u facts can be added, %u overlap others, "
+            "%u have errors."), ok, conflicts, bad);
+   lbl = gtk_label_new(text);
+   gtk_widget_set_halign(lbl, GTK_ALIGN_START);
+   gtk_container_add(GTK_CONTAINER(cnt), lbl);
+   g_free(text);
+
+   scr = gtk_scrolled_window_new(NULL, NULL);
+   gtk_widget_set_vexpand(scr, TRUE);
+   gtk_scrolled_window_set_shadow_type(GTK_SCROLLED_WINDOW(scr), GTK_SHADOW_IN);
+   gtk_container_add(GTK_CONTAINER(scr), import_preview_view(imp));
+   gtk_container_add(GTK_CONTAINER(cnt), scr);
+
+   chk = gtk_check_button_new_with_label(_("Add overlapping facts too"));
+   gtk_widget_set_sensitive(chk, conflicts > 0);
+   gtk_container_add(GTK_CONTAINER(cnt), chk);
+
+   gtk_dialog_set_response_sensitive(GTK_DIALOG(dlg), GTK_RESPONSE_ACCEPT,
+         ok + conflicts > 0);
+   gtk_widget_show_all(dlg);
+   response = gtk_dialog_run(GTK_DIALOG(dlg));
+   imp->conflicting = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(chk));
+   gtk_widget_destroy(dlg);
+
+   imp->total = ok + (imp->conflicting ? conflicts : 0);
+   if(response == GTK_RESPONSE_ACCEPT && imp->total)
+      import_start(imp);
+   else
+      import_free(imp);
+}
+
+static void
+import_cb_read(GObject *source, GAsyncResult *result, Import *imp)
+{
+   GError *error = NULL;
+
+   if(!g_task_propagate_boolean(G_TASK(result), &error)
+         || !import_check(imp, &error))
+   {
+      if(!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+         xfce_dialog_show_error(NULL, error, _("Import failed"));
+      g_error_free(error);
+      import_free(imp);
+      return;
+   }
+   import_preview(imp);
+}
+
+/* the caller is going away, whatever is left must not reach it */
+static void
+import_cb_owner_gone(GCancellable *owner, Import *imp)
+{
+   imp->done = NULL;
+   g_cancellable_cancel(imp->cancellable);
+}
+
+/* Dialog */
+void
+import_show(GtkWindow *parent, gboolean directReads, gboolean standalone,
+            GCancellable *owner, ImportDone done, gpointer data)
+{
+   GtkWidget *dlg;
+   GtkFileFilter *filter;
+
+   dlg = gtk_file_chooser_dialog_new(_("Import facts"), parent,
+         GTK_FILE_CHOOSER_ACTION_OPEN,
+         _("_Cancel"), GTK_RESPONSE_CANCEL,
+         _("_Open"), GTK_RESPONSE_ACCEPT,
+         NULL);
+   filter = gtk_file_filter_new();
+   gtk_file_filter_set_name(filter, _("CSV, iCalendar or fact lines"));
+   gtk_file_filter_add_pattern(filter, "*.csv");
+   gtk_file_filter_add_pattern(filter, "*.ics");
+   gtk_file_filter_add_pattern(filter, "*.txt");
+   gtk_file_chooser_add_filter(GTK_FILE_CHOOSER(dlg), filter);
+   filter = gtk_file_filter_new();
+   gtk_file_filter_set_name(filter, _("All files"));
+   gtk_file_filter_add_pattern(filter, "*");
+   gtk_file_chooser_add_filter(GTK_FILE_CHOOSER(dlg), filter);
+
+   if(gtk_dialog_run(GTK_DIALOG(dlg)) == GTK_RESPONSE_ACCEPT)
+   {
+      Import *imp = g_new0(Import, 1);
+      GTask *task;
+
+      imp->file = gtk_file_chooser_get_file(GTK_FILE_CHOOSER(dlg));
+      imp->done = done;
+      imp->data = data;
+      imp->backend = hamster_backend_new(directReads, standalone);
+      imp->cancellable = g_cancellable_new();
+      imp->items = g_ptr_array_new_with_free_func(
+            (GDestroyNotify)import_item_free);
+      if(owner)
+      {
+         imp->owner = g_object_ref(owner);
+         imp->ownerHandler = g_cancellable_connect(owner,
+               G_CALLBACK(import_cb_owner_gone), imp, NULL);
+      }
+      task = g_task_new(NULL, imp->cancellable,
+            (GAsyncReadyCallback)import_cb_read, imp);
+      g_task_set_task_data(task, imp, NULL);
+      g_task_run_in_thread(task, (GTaskThreadFunc)import_read);
+      g_object_unref(task);
+   }
+   gtk_widget_destroy(dlg);
+}
@@ -0,0 +1,37 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <gtk/gtk.h>
+
+/*
+ * Reads facts from a file on a worker, checks them all against the backend
+ * on the main thread, where it lives, before anything is sent and shows
+ * what would be added, then adds them with a bounded number of AddFact
+ * calls in flight. Takes CSV with a header naming the columns
+ * (export.c's own output included), iCalendar events, and plain lines in
+ * hamster's fact syntax with a date, start and end.
+ */
+typedef void (*ImportDone)(time_t first, time_t last, gpointer data);
+
+/* directReads and standalone pick the backend like the view's; done gets
+ * the span of the facts added, if any; cancelling owner, when data goes
+ * away, stops sending and done is not called any more */
+void
+import_show(GtkWindow *parent, gboolean directReads, gboolean standalone,
+            GCancellable *owner, ImportDone done, gpointer data);
@@ -0,0 +1,402 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+#include <string.h>
+#include <libxfce4util/libxfce4util.h>
+#include "label.h"
+
+#define LABEL_MAX_OPS 32
+#define LABEL_BUFFER 1024
+#define LABEL_ELLIPSIS "\xE2\x80\xA6"   /* U+2026, one character */
+
+G_DEFINE_QUARK(hamster-label-error-quark, hamster_label_error)
+
+typedef enum
+{
+   OP_LITERAL,
+   /* text, shortened to fit */
+   OP_ACTIVITY,
+   OP_CATEGORY,
+   OP_DESCRIPTION,
+   OP_TAGS,
+   /* durations, never shortened */
+   OP_ELAPSED,
+   OP_CATEGORY_TOTAL,
+   OP_DAY_TOTAL
+} OpKind;
+
+typedef enum
+{
+   DURATION_CLOCK,            /* h:mm */
+   DURATION_WORDS,            /* 1h 5min */
+   DURATION_MINUTES           /* 65 */
+} DurationFormat;
+
+typedef struct
+{
+   OpKind kind;
+   gint arg;                  /* DurationFormat, or max characters, 0 none */
+   guint offset;              /* OP_LITERAL: into literals */
+   guint length;              /* OP_LITERAL: bytes */
+   guint chars;               /* OP_LITERAL: characters */
+} LabelOp;
+
+struct _HamsterLabel
+{
+   LabelOp ops[LABEL_MAX_OPS];
+   guint count;
+   gchar *literals;
+   gchar buffer[LABEL_BUFFER];
+};
+
+static const struct
+{
+   const gchar *name;
+   OpKind kind;
+} label_fields[] =
+{
+   { "activity", OP_ACTIVITY },
+   { "category", OP_CATEGORY },
+   { "description", OP_DESCRIPTION },
+   { "tags", OP_TAGS },
+   { "elapsed", OP_ELAPSED },
+   { "category_total", OP_CATEGORY_TOTAL },
+   { "day_total", OP_DAY_TOTAL }
+};
+
+static gboolean
+label_is_text(OpKind kind)
+{
+   return kind >= OP_ACTIVITY && kind <= OP_TAGS;
+}
+
+/* Compiling */
+static gboolean
+label_field(LabelOp *op, const gchar *spec, gsize length, GError **error)
+{
+   const gchar *colon = memchr(spec, ':', length);
+   gsize nameLength = colon ? (gsize)(colon - spec) : length;
+   gchar *arg = colon ? g_strndup(colon + 1, length - nameLength - 1) : NULL;
+   gboolean ok = FALSE;
+   guint i;
+
+   for(i = 0; i < G_N_ELEMENTS(label_fields); i++)
+      if(strlen(label_fields[i].name) == nameLength
+            && !strncmp(label_fields[i].name, spec, nameLength))
+         break;
+   if(i == G_N_ELEMENTS(label_fields))
+   {
+      gchar *name = g_strndup(spec, nameLength);
+      g_set_error(error, HAMSTER_LABEL_ERROR, 0, _("Unknown field {%s}"), name);
+      g_free(name);
+      goto done;
+   }
+   op->kind = label_fields[i].kind;
+
+   if(!arg)
+      ok = TRUE;
+   else if(label_is_text(op->kind))
+   {
+      gchar *end;
+      gint64 n = g_ascii_strtoll(arg, &end, 10);
+      ok = *arg && !*end && n > 0 && n < LABEL_BUFFER;
+      op->arg = n;
+      if(!ok)
+         g_set_error(error, HAMSTER_LABEL_ERROR, 0,
+               _("{%s:...} takes a number of characters"), label_fields[i].name);
+   }
+   else
+   {
+      ok = TRUE;
+      if(!strcmp(arg, "h:mm"))
+         op->arg = DURATION_CLOCK;
+      else if(!strcmp(arg, "hm"))
+         op->arg = DURATION_WORDS;
+      else if(!strcmp(arg, "m"))
+         op->arg = DURATION_MINUTES;
+      else
+      {
+         ok = FALSE;
+         g_set_error(error, HAMSTER_LABEL_ERROR, 0,
+               _("{%s:...} takes h:mm, hm or m"), label_fields[i].name);
+      }
+   }
+
+done:
+   g_free(arg);
+   return ok;
+}
+
+static gboolean
+label_add(guint *count, GError **error)
+{
+   if(*count < LABEL_MAX_OPS)
+   {
+      (*count)++;
+      return TRUE;
+   }
+   g_set_error_literal(error, HAMSTER_LABEL_ERROR, 0,
+         _("The template has too many parts"));
+   return FALSE;
+}
+
+gboolean
+hamster_label_compile(HamsterLabel *self, const gchar *template,
+                      GError **error)
+{
+   LabelOp ops[LABEL_MAX_OPS];
+   GString *literals = g_string_new(NULL);
+   const gchar *p = template ? template : "";
+   guint count = 0;
+
+   if(!g_utf8_validate(p, -1, NULL))
+   {
+      g_set_error_literal(error, HAMSTER_LABEL_ERROR, 0,
+            _("The template is not UTF-8"));
+      goto fail;
+   }
+   while(*p)
+   {
+      LabelOp *op;
+
+      if(*p == '{' && p[1] != '{')
+      {
+         const gchar *end = strchr(p, '}');
+         if(!end)
+         {
+            g_set_error_literal(error, HAMSTER_LABEL_ERROR, 0,
+                  _("A field is missing its '}'"));
+            goto fail;
+         }
+         if(!label_add(&count, error))
+            goto fail;
+         op = &ops[count - 1];
+         memset(op, 0, sizeof(*op));
+         if(!label_field(op, p + 1, end - p - 1, error))
+            goto fail;
+         p = end + 1;
+         continue;
+      }
+
+      /* a run of literal text, braces doubled */
+      if(!count || ops[count - 1].kind != OP_LITERAL)
+      {
+         if(!label_add(&count, error))
+            goto fail;
+         op = &ops[count - 1];
+         memset(op, 0, sizeof(*op));
+         op->kind = OP_LITERAL;
+         op->offset = literals->len;
+      }
+      op = &ops[count - 1];
+      if((*p == '{' || *p == '}') && p[1] == *p)
+         p++;
+      else if(*p == '}')
+      {
+         g_set_error_literal(error, HAMSTER_LABEL_ERROR, 0,
+               _("A '}' without its field, write }} for the brace"));
+         goto fail;
+      }
+      {
+         const gchar *next = g_utf8_next_char(p);
+         g_string_append_len(literals, p, next - p);
+         op->length += next - p;
+         op->chars++;
+         p = next;
+      }
+   }
+
+   g_free(self->literals);
+   self->literals = g_string_free(literals, FALSE);
+   memcpy(self->ops, ops, count * sizeof(LabelOp));
+   self->count = count;
+   return TRUE;
+
+fail:
+   g_string_free(literals, TRUE);
+   return FALSE;
+}
+
+HamsterLabel*
+hamster_label_new(void)
+{
+   HamsterLabel *self = g_new0(HamsterLabel, 1);
+
+   hamster_label_compile(self, HAMSTER_LABEL_DEFAULT, NULL);
+   return self;
+}
+
+void
+hamster_label_free(HamsterLabel *self)
+{
+   if(!self)
+      return;
+   g_free(self->literals);
+   g_free(self);
+}
+
+/* Formatting */
+static gint
+label_duration(gchar *buf, gsize size, gint seconds, gint format)
+{
+   seconds = MAX(seconds, 0);
+   switch(format)
+   {
+      case DURATION_WORDS:
+         if(seconds >= 3600)
+            return g_snprintf(buf, size, "%dh %dmin", seconds / 3600,
+                  (seconds / 60) % 60);
+         return g_snprintf(buf, size, "%dmin", seconds / 60);
+      case DURATION_MINUTES:
+         return g_snprintf(buf, size, "%d", seconds / 60);
+      default:
+         return g_snprintf(buf, size, "%d:%02d", seconds / 3600,
+               (seconds / 60) % 60);
+   }
+}
+
+static const gchar*
+label_text(const LabelOp *op, const HamsterLabelData *data)
+{
+   const gchar *text = NULL;
+
+   switch(op->kind)
+   {
+      case OP_ACTIVITY: text = data->activity; break;
+      case OP_CATEGORY: text = data->category; break;
+      case OP_DESCRIPTION: text = data->description; break;
+      case OP_TAGS: text = data->tags; break;
+      default: break;
+   }
+   return text ? text : "";
+}
+
+static gint
+label_seconds(const LabelOp *op, const HamsterLabelData *data)
+{
+   switch(op->kind)
+   {
+      case OP_ELAPSED: return data->elapsed;
+      case OP_CATEGORY_TOTAL: return data->categoryTotal;
+      default: return data->dayTotal;
+   }
+}
+
+/* the longest length all text fields can keep and still fit */
+static glong
+label_cap(const glong *lengths, guint n, glong budget)
+{
+   glong low = 1, high = 1;
+   guint i;
+
+   for(i = 0; i < n; i++)
+      high = MAX(high, lengths[i]);
+   while(low < high)
+   {
+      glong mid = (low + high + 1) / 2, sum = 0;
+      for(i = 0; i < n; i++)
+         sum += MIN(lengths[i], mid);
+      if(sum <= budget)
+         low = mid;
+      else
+         high = mid - 1;
+   }
+   return low;
+}
+
+const gchar*
+hamster_label_format(HamsterLabel *self, const HamsterLabelData *data,
+                     gint maxChars)
+{
+   glong lengths[LABEL_MAX_OPS], fixed = 0, text = 0, cap = G_MAXLONG;
+   gchar duration[32];
+   gchar *out = self->buffer, *end = self->buffer + LABEL_BUFFER - 1;
+   guint i, n = 0;
+
+   /* what everything would take */
+   for(i = 0; i < self->count; i++)
+   {
+      const LabelOp *op = &self->ops[i];
+      if(op->kind == OP_LITERAL)
+         fixed += op->chars;
+      else if(label_is_text(op->kind))
+      {
+         lengths[n] = g_utf8_strlen(label_text(op, data), -1);
+         if(op->arg)
+            lengths[n] = MIN(lengths[n], op->arg);
+         text += lengths[n++];
+      }
+      else
+         fixed += label_duration(duration, sizeof(duration),
+               label_seconds(op, data), op->arg);
+   }
+   if(maxChars > 0 && n && fixed + text > maxChars)
+      cap = label_cap(lengths, n, maxChars - fixed);
+
+   /* and now for real */
+   for(i = 0, n = 0; i < self->count && out < end; i++)
+   {
+      const LabelOp *op = &self->ops[i];
+      const gchar *src;
+      gsize bytes;
+      gboolean cut = FALSE;
+
+      if(op->kind == OP_LITERAL)
+      {
+         src = self->literals + op->offset;
+         bytes = op->length;
+      }
+      else if(label_is_text(op->kind))
+      {
+         glong keep = MIN(lengths[n], cap);
+         src = label_text(op, data);
+         /* the ellipsis takes the last character kept */
+         cut = keep < lengths[n] || keep < g_utf8_strlen(src, -1);
+         if(cut)
+            keep--;
+         n++;
+         bytes = g_utf8_offset_to_pointer(src, MAX(keep, 0)) - src;
+      }
+      else
+      {
+         src = duration;
+         bytes = label_duration(duration, sizeof(duration),
+               label_seconds(op, data), op->arg);
+      }
+      if(bytes > (gsize)(end - out))
+      {
+         /* out of room: stop at a whole character, and there */
+         bytes = end - out;
+         while(bytes && ((guchar)src[bytes] & 0xC0) == 0x80)
+            bytes--;
+         end = out + bytes;
+      }
+      memcpy(out, src, bytes);
+      out += bytes;
+      if(cut && end - out >= (gssize)strlen(LABEL_ELLIPSIS))
+      {
+         memcpy(out, LABEL_ELLIPSIS, strlen(LABEL_ELLIPSIS));
+         out += strlen(LABEL_ELLIPSIS);
+      }
+   }
+   *out = '\0';
+   return self->buffer;
+}
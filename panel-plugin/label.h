@@ -0,0 +1,73 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <glib.h>
+
+/*
+ * The panel button's text from a template like
+ *
+ *   {activity} {elapsed:h:mm} · {category} {category_total}
+ *
+ * Fields: activity, category, description, tags, elapsed (of the running
+ * fact), category_total (today, the running fact's category) and
+ * day_total (today, all). Durations take :h:mm (the default), :hm for
+ * "1h 5min" or :m for minutes; text fields take a maximum length in
+ * characters, like {activity:12}. {{ and }} are literal braces.
+ *
+ * A template is compiled once into a list of ops; formatting walks them
+ * into a buffer owned by the label, without parsing or allocating.
+ * No GTK in here, this is part of libhamster-model.
+ */
+typedef struct _HamsterLabel HamsterLabel;
+
+typedef struct _HamsterLabelData
+{
+   const gchar *activity;
+   const gchar *category;
+   const gchar *description;
+   const gchar *tags;         /* "#a #b" */
+   gint elapsed;              /* seconds */
+   gint categoryTotal;
+   gint dayTotal;
+} HamsterLabelData;
+
+#define HAMSTER_LABEL_DEFAULT "{activity} {elapsed}"
+
+#define HAMSTER_LABEL_ERROR (hamster_label_error_quark())
+
+GQuark
+hamster_label_error_quark(void);
+
+/* starts out with HAMSTER_LABEL_DEFAULT */
+HamsterLabel*
+hamster_label_new(void);
+
+void
+hamster_label_free(HamsterLabel *self);
+
+/* on error the previous template stays */
+gboolean
+hamster_label_compile(HamsterLabel *self, const gchar *template,
+                      GError **error);
+
+/* valid until the next call; maxChars > 0 shortens the text fields, the
+ * longest first, so that literals and times stay whole */
+const gchar*
+hamster_label_format(HamsterLabel *self, const HamsterLabelData *data,
+                     gint maxChars);
@@ -0,0 +1,282 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+#include <libxfce4util/libxfce4util.h>
+#include "latency.h"
+
+/* 4 linear buckets per power of two up to 2^32us, about 19% resolution */
+#define SUB_BITS 2
+#define SUB_BUCKETS (1 << SUB_BITS)
+#define BUCKETS (32 * SUB_BUCKETS)
+/* seconds between dumps, so a panel that dies leaves most of its data */
+#define DUMP_INTERVAL 300
+
+typedef enum
+{
+   PHASE_MODEL,   /* input to model applied */
+   PHASE_FRAME,   /* input to frame painted */
+   PHASES
+} Phase;
+
+typedef struct
+{
+   HamsterLatency *owner;
+   HamsterLatencyEvent event;
+   gint64 input;            /* 0 while idle */
+   GdkFrameClock *clock;
+   gulong handler;
+} Pending;
+
+struct _HamsterLatency
+{
+   Pending pending[HAMSTER_LATENCY_EVENTS];
+   guint32 counts[HAMSTER_LATENCY_EVENTS][PHASES][BUCKETS];
+   gint64 started;          /* wall clock, for the dump header */
+   guint wakeups;
+   gchar *path;             /* HAMSTER_LATENCY_ENV, NULL to keep quiet */
+   guint source;            /* next dump */
+};
+
+static const gchar *eventNames[HAMSTER_LATENCY_EVENTS] =
+{
+   "popup", "switch", "stop"
+};
+
+static const gchar *phaseNames[PHASES] =
+{
+   "model", "frame"
+};
+
+static guint
+latency_bucket(gint64 us)
+{
+   guint octave, bucket;
+
+   if(us < SUB_BUCKETS)
+      return us < 0 ? 0 : us;
+   octave = g_bit_storage(us) - 1;
+   bucket = (octave - SUB_BITS + 1) * SUB_BUCKETS
+      + ((us >> (octave - SUB_BITS)) & (SUB_BUCKETS - 1));
+   return MIN(bucket, BUCKETS - 1);
+}
+
+static gint64
+latency_bucket_lower(guint bucket)
+{
+   guint octave;
+
+   if(bucket < SUB_BUCKETS)
+      return bucket;
+   octave = bucket / SUB_BUCKETS + SUB_BITS - 1;
+   return (gint64)(SUB_BUCKETS + bucket % SUB_BUCKETS) << (octave - SUB_BITS);
+}
+
+static void
+latency_record(HamsterLatency *self, HamsterLatencyEvent event, Phase phase,
+               gint64 us)
+{
+   self->counts[event][phase][latency_bucket(us)]++;
+   DBG("%s %s %" G_GINT64_FORMAT "us", eventNames[event], phaseNames[phase], us);
+}
+
+static void
+latency_reset(Pending *p)
+{
+   if(p->clock)
+   {
+      g_signal_handler_disconnect(p->clock, p->handler);
+      g_object_unref(p->clock);
+      p->clock = NULL;
+      p->handler = 0;
+   }
+   p->input = 0;
+}
+
+static void
+latency_cb_after_paint(GdkFrameClock *clock, Pending *p)
+{
+   latency_record(p->owner, p->event, PHASE_FRAME,
+         g_get_monotonic_time() - p->input);
+   latency_reset(p);
+}
+
+static gboolean
+latency_cb_dump(HamsterLatency *self)
+{
+   hamster_latency_dump(self);
+   return TRUE;
+}
+
+HamsterLatency*
+hamster_latency_new(void)
+{
+   HamsterLatency *self = g_new0(HamsterLatency, 1);
+   gint i;
+
+   for(i = 0; i < HAMSTER_LATENCY_EVENTS; i++)
+   {
+      self->pending[i].owner = self;
+      self->pending[i].event = i;
+   }
+   self->started = g_get_real_time();
+   self->path = g_strdup(g_getenv(HAMSTER_LATENCY_ENV));
+   if(self->path)
+      self->source = g_timeout_add_seconds(DUMP_INTERVAL,
+            (GSourceFunc)latency_cb_dump, self);
+   return self;
+}
+
+void
+hamster_latency_free(HamsterLatency *self)
+{
+   gint i;
+
+   if(!self)
+      return;
+   for(i = 0; i < HAMSTER_LATENCY_EVENTS; i++)
+      latency_reset(&self->pending[i]);
+   if(self->source)
+      g_source_remove(self->source);
+   g_free(self->path);
+   g_free(self);
+}
+
+void
+hamster_latency_input(HamsterLatency *self, HamsterLatencyEvent event)
+{
+   Pending *p = &self->pending[event];
+
+   latency_reset(p);
+   p->input = g_get_monotonic_time();
+}
+
+void
+hamster_latency_updated(HamsterLatency *self, HamsterLatencyEvent event,
+                        GtkWidget *widget)
+{
+   Pending *p = &self->pending[event];
+   GdkFrameClock *clock;
+
+   if(!p->input || p->clock)
+      return;
+   latency_record(self, event, PHASE_MODEL, g_get_monotonic_time() - p->input);
+   clock = gtk_widget_get_frame_clock(widget);
+   if(!clock)
+   {
+      /* not on screen, nothing will be painted */
+      p->input = 0;
+      return;
+   }
+   p->clock = g_object_ref(clock);
+   p->handler = g_signal_connect(clock, "after-paint",
+         G_CALLBACK(latency_cb_after_paint), p);
+   gdk_frame_clock_request_phase(clock, GDK_FRAME_CLOCK_PHASE_PAINT);
+}
+
+/* value at or below which fraction of the samples lie, bucket resolution */
+static gint64
+latency_percentile(const guint32 *counts, guint64 total, gdouble fraction)
+{
+   guint64 seen = 0, want = (guint64)(total * fraction + 0.5);
+   guint i;
+
+   for(i = 0; i < BUCKETS; i++)
+   {
+      seen += counts[i];
+      if(seen >= want && seen > 0)
+         return latency_bucket_lower(i);
+   }
+   return 0;
+}
+
+void
+hamster_latency_set_wakeups(HamsterLatency *self, guint wakeups)
+{
+   self->wakeups = wakeups;
+}
+
+/*
+ * # wakeups count seconds
+ * # event phase samples p50 p90 p99
+ * event phase lower upper count
+ * ...
+ */
+gchar*
+hamster_latency_to_string(HamsterLatency *self)
+{
+   GString *str = g_string_new(NULL);
+   gint e, ph;
+   guint i;
+
+   if(self->wakeups)
+      g_string_append_printf(str, "# wakeups %u %" G_GINT64_FORMAT "\n",
+            self->wakeups, g_get_real_time() / G_USEC_PER_SEC
+            - self->started / G_USEC_PER_SEC);
+   for(e = 0; e < HAMSTER_LATENCY_EVENTS; e++)
+   {
+      for(ph = 0; ph < PHASES; ph++)
+      {
+         const guint32 *counts = self->counts[e][ph];
+         guint64 total = 0;
+
+         for(i = 0; i < BUCKETS; i++)
+            total += counts[i];
+         if(!total)
+            continue;
+         g_string_append_printf(str, "# %s %s %" G_GUINT64_FORMAT
+               " %" G_GINT64_FORMAT " %" G_GINT64_FORMAT " %" G_GINT64_FORMAT "\n",
+               eventNames[e], phaseNames[ph], total,
+               latency_percentile(counts, total, 0.5),
+               latency_percentile(counts, total, 0.9),
+               latency_percentile(counts, total, 0.99));
+         for(i = 0; i < BUCKETS; i++)
+         {
+            if(counts[i])
+               g_string_append_printf(str, "%s %s %" G_GINT64_FORMAT
+                     " %" G_GINT64_FORMAT " %u\n",
+                     eventNames[e], phaseNames[ph], latency_bucket_lower(i),
+                     i + 1 < BUCKETS ? latency_bucket_lower(i + 1) : G_MAXINT64,
+                     counts[i]);
+         }
+      }
+   }
+   return g_string_free(str, FALSE);
+}
+
+void
+hamster_latency_dump(HamsterLatency *self)
+{
+   gchar *body, *text;
+   GError *error = NULL;
+
+   if(!self->path)
+      return;
+   body = hamster_latency_to_string(self);
+   text = g_strdup_printf("# session %" G_GINT64_FORMAT "\n%s",
+         self->started / G_USEC_PER_SEC, body);
+   if(!g_file_set_contents(self->path, text, -1, &error))
+   {
+      g_warning("%s", error->message);
+      g_error_free(error);
+   }
+   g_free(text);
+   g_free(body);
+}
@@ -0,0 +1,68 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <gtk/gtk.h>
+
+/*
+ * How long the user waits. Each measurement starts at an input, notes when
+ * the model reflecting it was applied and ends at the first frame painted
+ * after that, as reported by the widget's GdkFrameClock. Both spans go into
+ * log-linear histograms in microseconds. Nothing is connected while no
+ * measurement is pending, so an idle update costs one comparison.
+ * With XFCE4_HAMSTER_LATENCY=file they are written there every few minutes
+ * and at exit, replacing what the file held; without, nothing is written.
+ */
+#define HAMSTER_LATENCY_ENV "XFCE4_HAMSTER_LATENCY"
+
+typedef struct _HamsterLatency HamsterLatency;
+
+typedef enum
+{
+   HAMSTER_LATENCY_POPUP,    /* button click to painted popup */
+   HAMSTER_LATENCY_SWITCH,   /* activity submitted to painted label */
+   HAMSTER_LATENCY_STOP,     /* stop clicked to painted label */
+   HAMSTER_LATENCY_EVENTS
+} HamsterLatencyEvent;
+
+HamsterLatency*
+hamster_latency_new(void);
+
+void
+hamster_latency_free(HamsterLatency *self);
+
+/* starts a measurement, replacing a pending one of the same kind */
+void
+hamster_latency_input(HamsterLatency *self, HamsterLatencyEvent event);
+
+/* the model is in, wait for widget to paint; ignored if nothing pending */
+void
+hamster_latency_updated(HamsterLatency *self, HamsterLatencyEvent event,
+                        GtkWidget *widget);
+
+/* the scheduler's wakeups this session, for the dump */
+void
+hamster_latency_set_wakeups(HamsterLatency *self, guint wakeups);
+
+/* one line per non-empty bucket plus percentiles, see latency.c */
+gchar*
+hamster_latency_to_string(HamsterLatency *self);
+
+/* writes this session's histograms to HAMSTER_LATENCY_ENV's file, if set */
+void
+hamster_latency_dump(HamsterLatency *self);
@@ -0,0 +1,122 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * model-bench: ns per fact for turning a GetTodaysFacts reply into what the
+ * popup shows. Not installed, "make bench" builds it; run it before and
+ * after touching model.c or fact.c and compare.
+ *
+ *   parse      fact_new and fact_free per element
+ *   format     parse plus the row's span, duration and tags strings
+ *   build      hamster_model_build, parse, format, per category totals and
+ *              the summary line
+ *
+ * Each size is run for the tuple API's reply and for the JSON API's.
+ *
+ * Usage: model-bench [facts...]   default 20 200 2000 20000
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <glib.h>
+#include "model.h"
+#include "bench.h"
+
+#define MIN_SECONDS 0.25   /* per measurement */
+
+static void
+bench_parse(GVariant *reply)
+{
+   gsize i, n = g_variant_n_children(reply);
+
+   for(i = 0; i < n; i++)
+   {
+      GVariant *child = g_variant_get_child_value(reply, i);
+      fact_free(fact_new(child));
+      g_variant_unref(child);
+   }
+}
+
+static void
+bench_format(GVariant *reply)
+{
+   gsize i, n = g_variant_n_children(reply);
+
+   for(i = 0; i < n; i++)
+   {
+      GVariant *child = g_variant_get_child_value(reply, i);
+      hamster_model_row_free(hamster_model_row_new(fact_new(child), FALSE));
+      g_variant_unref(child);
+   }
+}
+
+static void
+bench_build(GVariant *reply)
+{
+   hamster_model_free(hamster_model_build(HAMSTER_MODEL_FACTS, reply));
+}
+
+/* runs fn until MIN_SECONDS passed, returns ns per fact */
+static gdouble
+bench_run(void (*fn)(GVariant*), GVariant *reply, gint count)
+{
+   gint64 start, elapsed;
+   guint64 rounds = 0;
+
+   fn(reply);   /* warm up */
+   start = g_get_monotonic_time();
+   do
+   {
+      fn(reply);
+      rounds++;
+      elapsed = g_get_monotonic_time() - start;
+   }
+   while(elapsed < MIN_SECONDS * G_USEC_PER_SEC);
+   return elapsed * 1000.0 / ((gdouble)rounds * MAX(count, 1));
+}
+
+int
+main(int argc, char **argv)
+{
+   static const gint defaults[] = { 20, 200, 2000, 20000 };
+   gint i, n = argc > 1 ? argc - 1 : (gint)G_N_ELEMENTS(defaults);
+
+   printf("%8s %6s %12s %12s %12s\n", "facts", "api", "parse", "format",
+         "build");
+   for(i = 0; i < n; i++)
+   {
+      gint count = argc > 1 ? atoi(argv[i + 1]) : defaults[i];
+      GVariant *replies[] = { bench_facts_reply(count),
+                              bench_facts_reply_json(count) };
+      static const gchar *apis[] = { "tuple", "json" };
+      gsize j;
+
+      for(j = 0; j < G_N_ELEMENTS(replies); j++)
+      {
+         printf("%8d %6s %9.0f ns %9.0f ns %9.0f ns\n", count, apis[j],
+               bench_run(bench_parse, replies[j], count),
+               bench_run(bench_format, replies[j], count),
+               bench_run(bench_build, replies[j], count));
+         g_variant_unref(replies[j]);
+      }
+   }
+   return 0;
+}
@@ -0,0 +1,395 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+#include <stdio.h>
+#include <string.h>
+#include <libxfce4util/libxfce4util.h>
+#include "model.h"
+
+struct _HamsterModelBuilder
+{
+   GThreadPool *pool;        /* one thread, so builds finish in order */
+   gpointer slots[HAMSTER_MODEL_PARTS];
+   HamsterModelReady ready;
+   gpointer data;
+   gint scheduled;
+   gint refs;                /* the pending idle holds one */
+   gint dead;
+};
+
+typedef struct
+{
+   HamsterModelPart part;
+   GVariant *reply;
+} Job;
+
+/* Formatting */
+
+// Hours and minutes format when given INT_MAX produces "596523h 14min", but
+// "snprintf" reports max possible output size like below.
+#define HOURS_AND_MINUTES_MIN_LENGTH 16
+
+static void
+model_seconds_to_hours_and_minutes(gchar *duration, int length, int seconds)
+{
+  snprintf(duration, length,
+      "%dh %dmin", seconds / 3600, (seconds / 60) % 60);
+}
+
+static size_t
+model_time_to_string(char *str, size_t maxsize, time_t time)
+{
+  struct tm tm;
+
+  gmtime_r(&time, &tm);
+  return strftime(str, maxsize, "%H:%M", &tm);
+}
+
+// Using less than that may cause output to be truncated.
+#define MODEL_TIMES_TO_SPAN_MIN_BUF_SIZE 14
+
+static void
+model_times_to_span(char *time_span, size_t maxsize, time_t start_time, time_t end_time)
+{
+   char *ptr = time_span;
+   size_t charsWritten;
+
+   charsWritten = model_time_to_string(ptr, maxsize, start_time);
+   maxsize -= charsWritten;
+   ptr += charsWritten;
+
+   // snprintf() should never return negative value with static string like this.
+   int dataWritten = snprintf(ptr, maxsize, " - ");
+   maxsize -= dataWritten;
+   ptr += dataWritten;
+
+   if (end_time)
+    model_time_to_string(ptr, maxsize, end_time);
+}
+
+static void
+model_increment_category_time(gchar *category, gint duration_in_seconds, GHashTable *categories)
+{
+  gint *category_duration = g_hash_table_lookup(categories, category);
+  if(category_duration == NULL)
+  {
+    category_duration = g_new0(gint, 1);
+    g_hash_table_insert(categories, g_strdup(category), category_duration);
+  }
+
+  *category_duration += duration_in_seconds;
+}
+
+HamsterModelRow*
+hamster_model_row_new(fact *f, gboolean dated)
+{
+   HamsterModelRow *row = g_new0(HamsterModelRow, 1);
+   gchar span[MODEL_TIMES_TO_SPAN_MIN_BUF_SIZE + 11];
+   gchar duration[HOURS_AND_MINUTES_MIN_LENGTH];
+   gsize offset = 0;
+
+   if(dated)
+   {
+      struct tm tm;
+      time_t start = f->startTime;
+      gmtime_r(&start, &tm);
+      offset = strftime(span, sizeof(span), "%Y-%m-%d ", &tm);
+   }
+   model_times_to_span(span + offset, sizeof(span) - offset,
+         f->startTime, f->endTime);
+   model_seconds_to_hours_and_minutes(duration, sizeof(duration), f->seconds);
+
+   row->fact = f;
+   row->span = g_strdup(span);
+   row->duration = g_strdup(duration);
+   if(f->tags && *f->tags)
+   {
+      gchar *tags = g_strjoinv(" #", f->tags);
+      row->hashtags = g_strconcat("#", tags, NULL);
+      g_free(tags);
+   }
+   else
+      row->hashtags = g_strdup("");
+   return row;
+}
+
+void
+hamster_model_row_free(HamsterModelRow *row)
+{
+   fact_free(row->fact);
+   g_free(row->span);
+   g_free(row->duration);
+   g_free(row->hashtags);
+   g_free(row);
+}
+
+void
+hamster_model_free(HamsterModel *model)
+{
+   if(!model)
+      return;
+   if(model->rows)
+      g_ptr_array_unref(model->rows);
+   if(model->categories)
+      g_hash_table_unref(model->categories);
+   if(model->columns)
+      g_ptr_array_unref(model->columns);
+   g_free(model->summary);
+   g_free(model);
+}
+
+/* Building, on the worker */
+/* totals, the running fact and the summary line from the rows */
+static void
+model_summarize(HamsterModel *model)
+{
+   GHashTableIter iter;
+   GString *summary = g_string_new("");
+   gchar *cat;
+   gint *sum;
+   gsize i, count = model->rows->len;
+
+   model->categories = g_hash_table_new_full(g_str_hash, g_str_equal,
+         g_free, g_free);
+   for(i = 0; i < count; i++)
+   {
+      const fact *f = ((HamsterModelRow*)g_ptr_array_index(model->rows, i))->fact;
+      model_increment_category_time(f->category, f->seconds, model->categories);
+      model->total += f->seconds;
+   }
+
+   if(count)
+   {
+      const HamsterModelRow *last = g_ptr_array_index(model->rows, count - 1);
+      if(last->fact->id && 0 == last->fact->endTime)
+         model->running = last;
+
+      count = g_hash_table_size(model->categories);
+      g_hash_table_iter_init(&iter, model->categories);
+      while(g_hash_table_iter_next(&iter, (gpointer)&cat, (gpointer)&sum))
+      {
+         count--;
+         g_string_append_printf(summary, count ? "%s: %dh %dmin, " : "%s: %dh %dmin",
+               cat, *sum / 3600, (*sum / 60) % 60);
+      }
+   }
+   else
+   {
+      g_string_append(summary, _("No activities yet."));
+   }
+   model->summary = g_string_free(summary, FALSE);
+}
+
+static void
+model_build_facts(HamsterModel *model, GVariant *reply)
+{
+   gsize i, count = reply ? g_variant_n_children(reply) : 0;
+
+   model->rows = g_ptr_array_new_with_free_func(
+         (GDestroyNotify)hamster_model_row_free);
+   for(i = 0; i < count; i++)
+   {
+      GVariant *dbusFact = g_variant_get_child_value(reply, i);
+      fact *f = fact_new(dbusFact);
+      g_variant_unref(dbusFact);
+      /* not even shown, fact_new warned */
+      if(f)
+         g_ptr_array_add(model->rows, hamster_model_row_new(f, FALSE));
+   }
+   model_summarize(model);
+}
+
+static void
+model_build_activities(HamsterModel *model, GVariant *reply)
+{
+   GVariantIter iter;
+   const gchar *act, *cat;
+
+   model->columns = g_ptr_array_new_with_free_func(g_free);
+   if(!reply)
+      return;
+   g_variant_iter_init(&iter, reply);
+   while(g_variant_iter_next(&iter, "(&s&s)", &act, &cat))
+   {
+      g_ptr_array_add(model->columns, g_utf8_casefold(act, -1));
+      g_ptr_array_add(model->columns, g_strdup(cat));
+   }
+}
+
+static void
+model_build_tags(HamsterModel *model, GVariant *reply)
+{
+   GVariantIter iter;
+   const gchar *tag;
+
+   model->columns = g_ptr_array_new_with_free_func(g_free);
+   if(!reply)
+      return;
+   g_variant_iter_init(&iter, reply);
+   while(g_variant_iter_next(&iter, "(i&sb)", NULL, &tag, NULL))
+   {
+      g_ptr_array_add(model->columns, g_strdup(tag));
+      g_ptr_array_add(model->columns, g_utf8_casefold(tag, -1));
+   }
+}
+
+HamsterModel*
+hamster_model_build(HamsterModelPart part, GVariant *reply)
+{
+   HamsterModel *model = g_new0(HamsterModel, 1);
+
+   model->part = part;
+   switch(part)
+   {
+      case HAMSTER_MODEL_FACTS:
+         model_build_facts(model, reply);
+         break;
+      case HAMSTER_MODEL_ACTIVITIES:
+         model_build_activities(model, reply);
+         break;
+      case HAMSTER_MODEL_TAGS:
+         model_build_tags(model, reply);
+         break;
+      default:
+         g_assert_not_reached();
+   }
+   return model;
+}
+
+HamsterModel*
+hamster_model_switch(const HamsterModel *current, fact *next)
+{
+   HamsterModel *model = g_new0(HamsterModel, 1);
+   gsize i, count = current && current->rows ? current->rows->len : 0;
+
+   model->part = HAMSTER_MODEL_FACTS;
+   model->rows = g_ptr_array_new_with_free_func(
+         (GDestroyNotify)hamster_model_row_free);
+   for(i = 0; i < count; i++)
+   {
+      const HamsterModelRow *row = g_ptr_array_index(current->rows, i);
+      fact *f = fact_dup(row->fact);
+      if(row == current->running)
+      {
+         f->endTime = MAX(next->startTime, f->startTime);
+         f->seconds = f->endTime - f->startTime;
+      }
+      g_ptr_array_add(model->rows, hamster_model_row_new(f, FALSE));
+   }
+   g_ptr_array_add(model->rows, hamster_model_row_new(next, FALSE));
+   model_summarize(model);
+   /* it has no id until the daemon answers */
+   model->running = g_ptr_array_index(model->rows, model->rows->len - 1);
+   return model;
+}
+
+static void
+model_builder_unref(HamsterModelBuilder *self)
+{
+   guint i;
+
+   if(!g_atomic_int_dec_and_test(&self->refs))
+      return;
+   for(i = 0; i < HAMSTER_MODEL_PARTS; i++)
+      hamster_model_free(self->slots[i]);
+   g_free(self);
+}
+
+static gboolean
+model_builder_cb_ready(HamsterModelBuilder *self)
+{
+   g_atomic_int_set(&self->scheduled, FALSE);
+   if(!g_atomic_int_get(&self->dead))
+      self->ready(self->data);
+   model_builder_unref(self);
+   return FALSE;
+}
+
+/* swaps model into its slot, whatever was there was never taken */
+static HamsterModel*
+model_builder_exchange(HamsterModelBuilder *self, HamsterModelPart part,
+                       HamsterModel *model)
+{
+   gpointer old;
+
+   do
+      old = g_atomic_pointer_get(&self->slots[part]);
+   while(!g_atomic_pointer_compare_and_exchange(&self->slots[part], old, model));
+   return old;
+}
+
+static void
+model_builder_run(Job *job, HamsterModelBuilder *self)
+{
+   HamsterModel *model = hamster_model_build(job->part, job->reply);
+
+   if(job->reply)
+      g_variant_unref(job->reply);
+   g_free(job);
+
+   hamster_model_free(model_builder_exchange(self, model->part, model));
+   if(g_atomic_int_compare_and_exchange(&self->scheduled, FALSE, TRUE))
+   {
+      g_atomic_int_inc(&self->refs);
+      g_idle_add((GSourceFunc)model_builder_cb_ready, self);
+   }
+}
+
+HamsterModelBuilder*
+hamster_model_builder_new(HamsterModelReady ready, gpointer data)
+{
+   HamsterModelBuilder *self = g_new0(HamsterModelBuilder, 1);
+
+   self->ready = ready;
+   self->data = data;
+   self->refs = 1;
+   self->pool = g_thread_pool_new((GFunc)model_builder_run, self, 1, FALSE,
+         NULL);
+   return self;
+}
+
+void
+hamster_model_builder_free(HamsterModelBuilder *self)
+{
+   if(!self)
+      return;
+   /* finish what was pushed, a pending idle then finds us dead */
+   g_thread_pool_free(self->pool, FALSE, TRUE);
+   g_atomic_int_set(&self->dead, TRUE);
+   model_builder_unref(self);
+}
+
+void
+hamster_model_builder_push(HamsterModelBuilder *self, HamsterModelPart part,
+                           GVariant *reply)
+{
+   Job *job = g_new0(Job, 1);
+
+   job->part = part;
+   job->reply = reply ? g_variant_ref(reply) : NULL;
+   g_thread_pool_push(self->pool, job, NULL);
+}
+
+HamsterModel*
+hamster_model_builder_take(HamsterModelBuilder *self, HamsterModelPart part)
+{
+   return model_builder_exchange(self, part, NULL);
+}
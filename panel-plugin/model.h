@@ -0,0 +1,95 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <glib.h>
+#include "fact.h"
+
+typedef enum
+{
+   HAMSTER_MODEL_FACTS,
+   HAMSTER_MODEL_ACTIVITIES,
+   HAMSTER_MODEL_TAGS,
+   HAMSTER_MODEL_PARTS
+} HamsterModelPart;
+
+/* a fact with everything the fact list shows already formatted */
+typedef struct _HamsterModelRow
+{
+   fact *fact;
+   gchar *span;         /* "HH:MM - HH:MM", dated if asked for */
+   gchar *duration;     /* "1h 5min" */
+   gchar *hashtags;     /* "#a #b" or "" */
+} HamsterModelRow;
+
+/*
+ * One part of what the view shows, built from a raw reply off the GTK
+ * thread. Never changed once built.
+ */
+typedef struct _HamsterModel
+{
+   HamsterModelPart part;
+
+   /* HAMSTER_MODEL_FACTS */
+   GPtrArray *rows;              /* HamsterModelRow*, oldest first */
+   GHashTable *categories;       /* category -> gint* seconds */
+   gchar *summary;
+   const HamsterModelRow *running;
+   gint total;                   /* seconds, all of today */
+
+   /* HAMSTER_MODEL_ACTIVITIES and _TAGS: two completion columns per row */
+   GPtrArray *columns;
+} HamsterModel;
+
+typedef struct _HamsterModelBuilder HamsterModelBuilder;
+
+/* called on the main loop when new parts can be taken */
+typedef void (*HamsterModelReady)(gpointer data);
+
+HamsterModelRow*
+hamster_model_row_new(fact *f, gboolean dated);
+
+void
+hamster_model_row_free(HamsterModelRow *row);
+
+/* what the builder runs, exposed for model-bench */
+HamsterModel*
+hamster_model_build(HamsterModelPart part, GVariant *reply);
+
+/* current with its running fact ended where next starts and next running,
+ * what is shown until the daemon has the switch; takes next */
+HamsterModel*
+hamster_model_switch(const HamsterModel *current, fact *next);
+
+void
+hamster_model_free(HamsterModel *model);
+
+HamsterModelBuilder*
+hamster_model_builder_new(HamsterModelReady ready, gpointer data);
+
+void
+hamster_model_builder_free(HamsterModelBuilder *self);
+
+/* reply of GetTodaysFacts, GetActivities or GetTags; NULL for none */
+void
+hamster_model_builder_push(HamsterModelBuilder *self, HamsterModelPart part,
+                           GVariant *reply);
+
+/* the newest build of part, or NULL if none since the last take */
+HamsterModel*
+hamster_model_builder_take(HamsterModelBuilder *self, HamsterModelPart part);
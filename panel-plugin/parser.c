@@ -0,0 +1,392 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+#include <string.h>
+#include <libxfce4util/libxfce4util.h>
+#include "parser.h"
+
+#define DAY_SECONDS (24 * 60 * 60)
+#define MAX_RELATIVE_MINUTES (7 * 24 * 60)
+
+G_DEFINE_QUARK(fact-spec-error-quark, fact_spec_error)
+
+typedef enum
+{
+   TIME_NONE,  /* not a time, leave the input alone */
+   TIME_OK,
+   TIME_BAD    /* looks like a time but isn't one */
+} TimeResult;
+
+static const gchar*
+parser_skip_space(const gchar *p)
+{
+   while(g_ascii_isspace(*p))
+      p++;
+   return p;
+}
+
+static gboolean
+parser_token_end(const gchar *p)
+{
+   return *p == '\0' || *p == '-' || g_ascii_isspace(*p);
+}
+
+/* HH:MM, also H:MM and HH.MM */
+static TimeResult
+parser_clock(const gchar **p, time_t day, time_t *out)
+{
+   const gchar *s = *p;
+   gint h = 0, m, digits = 0;
+
+   while(g_ascii_isdigit(*s) && digits < 3)
+   {
+      h = h * 10 + (*s++ - '0');
+      digits++;
+   }
+   if(!digits || digits > 2 || (*s != ':' && *s != '.'))
+      return TIME_NONE;
+   s++;
+   if(!g_ascii_isdigit(s[0]) || !g_ascii_isdigit(s[1]))
+      return TIME_NONE;
+   m = (s[0] - '0') * 10 + (s[1] - '0');
+   s += 2;
+   if(!parser_token_end(s))
+      return TIME_NONE;
+   if(h > 23 || m > 59)
+      return TIME_BAD;
+   *out = day + h * 3600 + m * 60;
+   *p = s;
+   return TIME_OK;
+}
+
+/* -N, N minutes before now */
+static TimeResult
+parser_relative(const gchar **p, time_t now, time_t *out)
+{
+   const gchar *s = *p;
+   gint minutes = 0, digits = 0;
+
+   if(*s++ != '-' || !g_ascii_isdigit(*s))
+      return TIME_NONE;
+   while(g_ascii_isdigit(*s))
+   {
+      if(++digits > 6)
+         return TIME_BAD;
+      minutes = minutes * 10 + (*s++ - '0');
+   }
+   if(*s != '\0' && !g_ascii_isspace(*s))
+      return TIME_NONE;
+   if(minutes > MAX_RELATIVE_MINUTES)
+      return TIME_BAD;
+   *out = now - minutes * 60;
+   *p = s;
+   return TIME_OK;
+}
+
+static TimeResult
+parser_time(const gchar **p, time_t day, time_t now, time_t *out)
+{
+   TimeResult r = parser_relative(p, now, out);
+   if(r == TIME_NONE)
+      r = parser_clock(p, day, out);
+   return r;
+}
+
+/* YYYY-MM-DD followed by a blank */
+static TimeResult
+parser_date(const gchar **p, time_t *day)
+{
+   const gchar *s = *p;
+   gint y, m, d;
+
+   if(strlen(s) < 11
+         || !g_ascii_isdigit(s[0]) || !g_ascii_isdigit(s[1])
+         || !g_ascii_isdigit(s[2]) || !g_ascii_isdigit(s[3]) || s[4] != '-'
+         || !g_ascii_isdigit(s[5]) || !g_ascii_isdigit(s[6]) || s[7] != '-'
+         || !g_ascii_isdigit(s[8]) || !g_ascii_isdigit(s[9])
+         || !g_ascii_isspace(s[10]))
+      return TIME_NONE;
+   y = (s[0] - '0') * 1000 + (s[1] - '0') * 100 + (s[2] - '0') * 10 + (s[3] - '0');
+   m = (s[5] - '0') * 10 + (s[6] - '0');
+   d = (s[8] - '0') * 10 + (s[9] - '0');
+   if(!g_date_valid_dmy(d, m, y))
+      return TIME_BAD;
+   {
+      GDate date;
+      g_date_clear(&date, 1);
+      g_date_set_dmy(&date, d, m, y);
+      /* 1970-01-01 is julian day 719163 */
+      *day = ((time_t)g_date_get_julian(&date) - 719163) * DAY_SECONDS;
+   }
+   *p = s + 10;
+   return TIME_OK;
+}
+
+static gchar*
+parser_strip_dup(const gchar *start, const gchar *end)
+{
+   while(start < end && g_ascii_isspace(*start))
+      start++;
+   while(end > start && g_ascii_isspace(end[-1]))
+      end--;
+   return g_strndup(start, end - start);
+}
+
+/* peels trailing " #tag" words off [start, *end) */
+static gboolean
+parser_tags(const gchar *start, const gchar **end, GPtrArray *tags,
+            GError **error)
+{
+   for(;;)
+   {
+      const gchar *e = *end, *w;
+
+      while(e > start && g_ascii_isspace(e[-1]))
+         e--;
+      w = e;
+      while(w > start && !g_ascii_isspace(w[-1]))
+         w--;
+      if(w == e || *w != '#')
+         return TRUE;
+      if(w == start)
+      {
+         /* nothing left for the activity */
+         *end = w;
+         return TRUE;
+      }
+      if(e - w == 1)
+      {
+         g_set_error_literal(error, FACT_SPEC_ERROR, FACT_SPEC_ERROR_TAG,
+               _("Empty tag"));
+         return FALSE;
+      }
+      g_ptr_array_insert(tags, 0, g_strndup(w + 1, e - w - 1));
+      *end = w;
+   }
+}
+
+/* a #word left in activity@category is a tag in the wrong place */
+static gboolean
+parser_has_tag(const gchar *start, const gchar *end)
+{
+   const gchar *p;
+
+   for(p = start; p < end; p++)
+      if(*p == '#' && (p == start || g_ascii_isspace(p[-1]) || p[-1] == '@'))
+         return TRUE;
+   return FALSE;
+}
+
+gboolean
+fact_spec_parse(fact_spec *out, const gchar *text, time_t now, GError **error)
+{
+   const gchar *p, *q, *end, *comma, *at, *verbatim;
+   time_t day = now - now % DAY_SECONDS;
+   TimeResult r;
+   GPtrArray *tags;
+   TimeResult dated;
+   gboolean byClock;
+
+   memset(out, 0, sizeof(*out));
+   p = parser_skip_space(text);
+   if(!*p)
+   {
+      g_set_error_literal(error, FACT_SPEC_ERROR, FACT_SPEC_ERROR_EMPTY,
+            _("Nothing to track"));
+      return FALSE;
+   }
+
+   /* [date] [start [- end]] */
+   dated = parser_date(&p, &day);
+   if(dated == TIME_BAD)
+   {
+      g_set_error_literal(error, FACT_SPEC_ERROR, FACT_SPEC_ERROR_TIME,
+            _("Not a valid date"));
+      return FALSE;
+   }
+   if(dated == TIME_OK)
+      p = parser_skip_space(p);
+   r = parser_time(&p, day, now, &out->startTime);
+   if(dated == TIME_OK && r == TIME_NONE)
+   {
+      g_set_error_literal(error, FACT_SPEC_ERROR, FACT_SPEC_ERROR_TIME,
+            _("A date needs a start time"));
+      return FALSE;
+   }
+   if(r == TIME_OK)
+   {
+      q = parser_skip_space(p);
+      r = parser_relative(&q, now, &out->endTime);
+      if(r == TIME_NONE && *q == '-')
+      {
+         q = parser_skip_space(q + 1);
+         byClock = *q != '-';
+         r = parser_time(&q, day, now, &out->endTime);
+         /* past midnight, like the editor reads it */
+         if(r == TIME_OK && byClock && out->endTime <= out->startTime)
+            out->endTime += DAY_SECONDS;
+      }
+      if(r == TIME_OK)
+         p = q;
+      else
+         out->endTime = 0;
+   }
+   if(r == TIME_BAD)
+   {
+      g_set_error_literal(error, FACT_SPEC_ERROR, FACT_SPEC_ERROR_TIME,
+            _("Not a valid time"));
+      return FALSE;
+   }
+
+   /* activity[@category][, description][ #tag...], or hamster's
+    * activity[@category][ #tag...],, description where the description
+    * is taken as is, #words included */
+   p = parser_skip_space(p);
+   end = p + strlen(p);
+   verbatim = strstr(p, ",,");
+   if(verbatim)
+   {
+      out->description = parser_strip_dup(verbatim + 2, end);
+      end = verbatim;
+   }
+   tags = g_ptr_array_new_with_free_func(g_free);
+   if(!parser_tags(p, &end, tags, error))
+   {
+      g_ptr_array_free(tags, TRUE);
+      goto fail;
+   }
+   g_ptr_array_add(tags, NULL);
+   out->tags = (gchar**)g_ptr_array_free(tags, FALSE);
+
+   comma = verbatim ? NULL : memchr(p, ',', end - p);
+   if(comma)
+   {
+      out->description = parser_strip_dup(comma + 1, end);
+      end = comma;
+   }
+   /* "foo #bar, baz" would make "foo #bar" the activity */
+   if(parser_has_tag(p, end))
+   {
+      g_set_error_literal(error, FACT_SPEC_ERROR, FACT_SPEC_ERROR_TAG,
+            _("Tags go at the end, or before ',,' and the description"));
+      goto fail;
+   }
+   at = memchr(p, '@', end - p);
+   if(at)
+   {
+      out->category = parser_strip_dup(at + 1, end);
+      end = at;
+   }
+   out->name = parser_strip_dup(p, end);
+
+   if(!*out->name)
+   {
+      g_set_error_literal(error, FACT_SPEC_ERROR, FACT_SPEC_ERROR_ACTIVITY,
+            _("Activity is missing"));
+      goto fail;
+   }
+   if(out->category && !*out->category)
+   {
+      g_set_error_literal(error, FACT_SPEC_ERROR, FACT_SPEC_ERROR_CATEGORY,
+            _("Category is missing after '@'"));
+      goto fail;
+   }
+   if(out->endTime && out->endTime <= out->startTime)
+   {
+      g_set_error_literal(error, FACT_SPEC_ERROR, FACT_SPEC_ERROR_RANGE,
+            _("Ends before it starts"));
+      goto fail;
+   }
+   if(!out->endTime && out->startTime > now)
+   {
+      g_set_error_literal(error, FACT_SPEC_ERROR, FACT_SPEC_ERROR_RANGE,
+            _("Starts in the future"));
+      goto fail;
+   }
+   return TRUE;
+
+fail:
+   fact_spec_clear(out);
+   return FALSE;
+}
+
+void
+fact_spec_clear(fact_spec *spec)
+{
+   g_free(spec->name);
+   g_free(spec->category);
+   g_free(spec->description);
+   g_strfreev(spec->tags);
+   memset(spec, 0, sizeof(*spec));
+}
+
+static void
+fact_spec_append_tail(GString *str, const fact_spec *spec)
+{
+   gchar **tag;
+   /* a '#' in the description would be read back as a tag, a ',' might
+    * start the verbatim form */
+   gboolean verbatim = spec->description && strpbrk(spec->description, "#,");
+
+   g_string_append(str, spec->name);
+   if(spec->category)
+      g_string_append_printf(str, "@%s", spec->category);
+   if(spec->description && *spec->description && !verbatim)
+      g_string_append_printf(str, ", %s", spec->description);
+   for(tag = spec->tags; tag && *tag; tag++)
+      g_string_append_printf(str, " #%s", *tag);
+   if(verbatim)
+      g_string_append_printf(str, ",, %s", spec->description);
+}
+
+gchar*
+fact_spec_to_string(const fact_spec *spec)
+{
+   GString *str = g_string_new(NULL);
+   fact_spec_append_tail(str, spec);
+   return g_string_free(str, FALSE);
+}
+
+static void
+fact_spec_append_time(GString *str, time_t t)
+{
+   g_string_append_printf(str, "%02d:%02d",
+         (gint)(t % DAY_SECONDS) / 3600, (gint)(t % 3600) / 60);
+}
+
+gchar*
+fact_spec_describe(const fact_spec *spec)
+{
+   GString *str = g_string_new(NULL);
+
+   if(spec->startTime)
+      fact_spec_append_time(str, spec->startTime);
+   else
+      g_string_append(str, _("now"));
+   if(spec->endTime)
+   {
+      g_string_append(str, " - ");
+      fact_spec_append_time(str, spec->endTime);
+   }
+   g_string_append(str, "  ");
+   fact_spec_append_tail(str, spec);
+   return g_string_free(str, FALSE);
+}
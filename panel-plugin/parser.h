@@ -0,0 +1,75 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <time.h>
+#include <glib.h>
+
+/*
+ * What the user typed, in hamster's fact syntax:
+ *
+ *   [YYYY-MM-DD] [start [- end]] activity[@category][, description][ #tag...]
+ *   [YYYY-MM-DD] [start [- end]] activity[@category][ #tag...],, description
+ *
+ * the second, hamster's too, keeps a description with '#' or ',' as is.
+ * Tags anywhere else, like "activity #tag, description", are an error
+ * rather than part of the activity.
+ * where start and end are either HH:MM or -N (N minutes ago).
+ * Times are hamster's local epoch seconds, 0 meaning "now" for the start
+ * and "still running" for the end.
+ */
+typedef struct _fact_spec
+{
+   time_t startTime;
+   time_t endTime;
+   char *name;
+   char *category; // NULL if not given
+   char *description; // NULL if not given
+   char **tags; // never NULL
+}fact_spec;
+
+#define FACT_SPEC_ERROR (fact_spec_error_quark())
+
+typedef enum
+{
+   FACT_SPEC_ERROR_EMPTY,
+   FACT_SPEC_ERROR_TIME,
+   FACT_SPEC_ERROR_RANGE,
+   FACT_SPEC_ERROR_ACTIVITY,
+   FACT_SPEC_ERROR_CATEGORY,
+   FACT_SPEC_ERROR_TAG
+} FactSpecError;
+
+GQuark
+fact_spec_error_quark(void);
+
+/* on failure out is left cleared and error says why */
+gboolean
+fact_spec_parse(fact_spec *out, const gchar *text, time_t now, GError **error);
+
+void
+fact_spec_clear(fact_spec *spec);
+
+/* "activity[@category][, description][ #tag...]" for AddFact, or the ",,"
+ * form when the description has a '#' or ','; times are passed separately */
+gchar*
+fact_spec_to_string(const fact_spec *spec);
+
+/* one line for the user to check before submitting */
+gchar*
+fact_spec_describe(const fact_spec *spec);
@@ -0,0 +1,191 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * render-bench: layout and paint cost of the popup's fact list and of the
+ * panel button, per frame, on an offscreen window. "make bench" builds it.
+ * It needs a display; run it under Xvfb where there is none:
+ *
+ *   xvfb-run ./render-bench [facts...]   default 10 100 1000
+ *
+ * Each frame invalidates the size caches, then measures the size request,
+ * the allocation and a draw into an image surface. Results are printed as
+ * one JSON object per line, times in microseconds per frame.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gtk/gtk.h>
+#include <libxfce4panel/libxfce4panel.h>
+#include "button.h"
+#include "timeline.h"
+#include "factlist.h"
+#include "model.h"
+#include "bench.h"
+
+#define FRAMES 50
+#define LABEL_UPDATES 1000
+
+typedef struct
+{
+   gint64 request;
+   gint64 allocate;
+   gint64 draw;
+} Times;
+
+static void
+bench_frame(GtkWidget *window, GtkWidget *content, Times *times)
+{
+   GtkRequisition min, nat;
+   GtkAllocation alloc = { 0, 0, 0, 0 };
+   cairo_surface_t *surface;
+   cairo_t *cr;
+   gint64 t0, t1, t2, t3;
+
+   gtk_widget_queue_resize(content);
+   t0 = g_get_monotonic_time();
+   gtk_widget_get_preferred_size(window, &min, &nat);
+   t1 = g_get_monotonic_time();
+   alloc.width = nat.width;
+   alloc.height = nat.height;
+   gtk_widget_size_allocate(window, &alloc);
+   t2 = g_get_monotonic_time();
+   surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+         MAX(alloc.width, 1), MAX(alloc.height, 1));
+   cr = cairo_create(surface);
+   gtk_widget_draw(window, cr);
+   cairo_destroy(cr);
+   cairo_surface_destroy(surface);
+   t3 = g_get_monotonic_time();
+
+   times->request += t1 - t0;
+   times->allocate += t2 - t1;
+   times->draw += t3 - t2;
+}
+
+static void
+bench_print(const gchar *bench, const gchar *key, gint n, gint frames,
+            const Times *times)
+{
+   printf("{\"bench\":\"%s\",\"%s\":%d,\"frames\":%d,"
+         "\"request_us\":%.1f,\"allocate_us\":%.1f,\"draw_us\":%.1f}\n",
+         bench, key, n, frames,
+         (gdouble)times->request / frames,
+         (gdouble)times->allocate / frames,
+         (gdouble)times->draw / frames);
+   fflush(stdout);
+}
+
+/* the fact list, timeline and summary as the popup packs them */
+static void
+bench_popup(gint count)
+{
+   GVariant *reply = bench_facts_reply(count);
+   HamsterModel *model = hamster_model_build(HAMSTER_MODEL_FACTS, reply);
+   GtkWidget *window = gtk_offscreen_window_new();
+   GtkWidget *vbx = gtk_box_new(GTK_ORIENTATION_VERTICAL, 2);
+   GtkListStore *store = fact_list_store_new();
+   GtkWidget *tv = gtk_tree_view_new_with_model(GTK_TREE_MODEL(store));
+   GtkWidget *timeline = hamster_timeline_new();
+   GtkWidget *summary = gtk_label_new(model->summary);
+   Times times = { 0 };
+   guint i;
+
+   fact_list_columns_add(GTK_TREE_VIEW(tv));
+   for(i = 0; i < model->rows->len; i++)
+   {
+      const HamsterModelRow *row = g_ptr_array_index(model->rows, i);
+      fact_list_store_append(store, row);
+      hamster_timeline_add(HAMSTER_TIMELINE(timeline), row->fact->id,
+            row->fact->startTime, row->fact->endTime, row->fact->name,
+            row->fact->category);
+   }
+   hamster_timeline_commit(HAMSTER_TIMELINE(timeline), BENCH_DAY + 86399);
+   gtk_label_set_line_wrap(GTK_LABEL(summary), TRUE);
+
+   gtk_container_add(GTK_CONTAINER(vbx), gtk_label_new("Today's activities"));
+   gtk_container_add(GTK_CONTAINER(vbx), tv);
+   gtk_container_add(GTK_CONTAINER(vbx), timeline);
+   gtk_container_add(GTK_CONTAINER(vbx), summary);
+   gtk_container_add(GTK_CONTAINER(window), vbx);
+   gtk_widget_show_all(window);
+
+   bench_frame(window, vbx, &times);   /* warm up */
+   memset(&times, 0, sizeof(times));
+   for(i = 0; i < FRAMES; i++)
+      bench_frame(window, vbx, &times);
+   bench_print("popup", "facts", count, FRAMES, &times);
+
+   gtk_widget_destroy(window);
+   g_object_unref(store);
+   hamster_model_free(model);
+   g_variant_unref(reply);
+}
+
+/* a running fact's label ticking over, one frame per update */
+static void
+bench_label(void)
+{
+   XfcePanelPlugin *plugin = g_object_new(XFCE_TYPE_PANEL_PLUGIN,
+         "name", "hamster", "unique-id", -1, NULL);
+   GtkWidget *window = gtk_offscreen_window_new();
+   GtkWidget *button = places_button_new(plugin);
+   Times times = { 0 };
+   gint i;
+
+   gtk_container_add(GTK_CONTAINER(plugin), button);
+   gtk_container_add(GTK_CONTAINER(window), GTK_WIDGET(plugin));
+   gtk_widget_show_all(window);
+   places_button_set_ellipsize(PLACES_BUTTON(button), TRUE);
+   places_button_set_progress(PLACES_BUTTON(button), 40);
+
+   for(i = 0; i < LABEL_UPDATES; i++)
+   {
+      gchar *label = g_strdup_printf("activity %d %d:%02d", i % 37,
+            i / 60, i % 60);
+      places_button_set_label(PLACES_BUTTON(button), label);
+      places_button_set_progress(PLACES_BUTTON(button), i % 100);
+      g_free(label);
+      bench_frame(window, button, &times);
+   }
+   bench_print("label", "updates", LABEL_UPDATES, LABEL_UPDATES, &times);
+
+   gtk_widget_destroy(window);
+}
+
+int
+main(int argc, char **argv)
+{
+   static const gint defaults[] = { 10, 100, 1000 };
+   gint i, n;
+
+   if(!gtk_init_check(&argc, &argv))
+   {
+      fprintf(stderr, "render-bench: no display, try xvfb-run\n");
+      return 77;
+   }
+   n = argc > 1 ? argc - 1 : (gint)G_N_ELEMENTS(defaults);
+   for(i = 0; i < n; i++)
+      bench_popup(argc > 1 ? atoi(argv[i + 1]) : defaults[i]);
+   bench_label();
+   return 0;
+}
@@ -0,0 +1,239 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+#include <gio/gio.h>
+#include <libxfce4util/libxfce4util.h>
+#include "scheduler.h"
+#include "util.h"
+
+#define DAY_SECONDS (24 * 60 * 60)
+
+struct _HamsterScheduler
+{
+   HamsterSchedulerTick tick;
+   gpointer data;
+   guint source;
+   guint wakeups;
+   time_t since;
+   gboolean visible;
+   gboolean locked;
+   gboolean idle;
+   gboolean sleeping;
+   gboolean paused;
+   gboolean ticking;        /* inside tick, re-armed afterwards */
+   GDBusConnection *session;
+   GDBusConnection *system;
+   guint lockWatch[2];
+   guint idleWatch;
+   guint sleepWatch;
+};
+
+static void
+hamster_scheduler_arm(HamsterScheduler *self);
+
+static gboolean
+hamster_scheduler_fire(HamsterScheduler *self)
+{
+   self->source = 0;
+   self->wakeups++;
+   DBG("wakeup %u", self->wakeups);
+   self->ticking = TRUE;
+   self->tick(self->data);
+   self->ticking = FALSE;
+   hamster_scheduler_arm(self);
+   return FALSE;
+}
+
+/* seconds until the label would change */
+static guint
+hamster_scheduler_delay(HamsterScheduler *self)
+{
+   time_t now = util_local_now();
+
+   if(self->since && self->since <= now)
+      return 60 - (now - self->since) % 60;
+   return DAY_SECONDS - now % DAY_SECONDS + 1;
+}
+
+static void
+hamster_scheduler_arm(HamsterScheduler *self)
+{
+   gboolean paused = !self->visible || self->locked || self->idle
+      || self->sleeping;
+
+   if(self->source)
+   {
+      g_source_remove(self->source);
+      self->source = 0;
+   }
+   if(paused)
+   {
+      self->paused = TRUE;
+      return;
+   }
+   if(self->paused)
+   {
+      /* whatever happened meanwhile, catch up once */
+      self->paused = FALSE;
+      self->source = g_idle_add((GSourceFunc)hamster_scheduler_fire, self);
+      return;
+   }
+   self->source = g_timeout_add_seconds(hamster_scheduler_delay(self),
+         (GSourceFunc)hamster_scheduler_fire, self);
+}
+
+static void
+hamster_scheduler_cb_locked(GDBusConnection *connection,
+                            const gchar *sender,
+                            const gchar *path,
+                            const gchar *interface,
+                            const gchar *signal,
+                            GVariant *parameters,
+                            HamsterScheduler *self)
+{
+   self->wakeups++;
+   if(!g_variant_is_of_type(parameters, G_VARIANT_TYPE("(b)")))
+      return;
+   g_variant_get(parameters, "(b)", &self->locked);
+   DBG("locked: %d", self->locked);
+   hamster_scheduler_arm(self);
+}
+
+static void
+hamster_scheduler_cb_sleep(GDBusConnection *connection,
+                           const gchar *sender,
+                           const gchar *path,
+                           const gchar *interface,
+                           const gchar *signal,
+                           GVariant *parameters,
+                           HamsterScheduler *self)
+{
+   self->wakeups++;
+   if(!g_variant_is_of_type(parameters, G_VARIANT_TYPE("(b)")))
+      return;
+   g_variant_get(parameters, "(b)", &self->sleeping);
+   DBG("sleeping: %d", self->sleeping);
+   hamster_scheduler_arm(self);
+}
+
+/* the session manager's presence, 3 is idle */
+static void
+hamster_scheduler_cb_presence(GDBusConnection *connection,
+                              const gchar *sender,
+                              const gchar *path,
+                              const gchar *interface,
+                              const gchar *signal,
+                              GVariant *parameters,
+                              HamsterScheduler *self)
+{
+   guint32 status;
+
+   self->wakeups++;
+   if(!g_variant_is_of_type(parameters, G_VARIANT_TYPE("(u)")))
+      return;
+   g_variant_get(parameters, "(u)", &status);
+   self->idle = status == 3;
+   DBG("idle: %d", self->idle);
+   hamster_scheduler_arm(self);
+}
+
+HamsterScheduler*
+hamster_scheduler_new(HamsterSchedulerTick tick, gpointer data)
+{
+   HamsterScheduler *self = g_new0(HamsterScheduler, 1);
+
+   self->tick = tick;
+   self->data = data;
+   self->paused = TRUE;
+
+   /* no sender filter, so a stand-in service can emit these as well */
+   self->session = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, NULL);
+   if(self->session)
+   {
+      self->lockWatch[0] = g_dbus_connection_signal_subscribe(self->session,
+            NULL, "org.freedesktop.ScreenSaver", "ActiveChanged", NULL, NULL,
+            G_DBUS_SIGNAL_FLAGS_NONE,
+            (GDBusSignalCallback)hamster_scheduler_cb_locked, self, NULL);
+      self->lockWatch[1] = g_dbus_connection_signal_subscribe(self->session,
+            NULL, "org.xfce.ScreenSaver", "ActiveChanged", NULL, NULL,
+            G_DBUS_SIGNAL_FLAGS_NONE,
+            (GDBusSignalCallback)hamster_scheduler_cb_locked, self, NULL);
+      self->idleWatch = g_dbus_connection_signal_subscribe(self->session,
+            NULL, "org.gnome.SessionManager.Presence", "StatusChanged", NULL,
+            NULL, G_DBUS_SIGNAL_FLAGS_NONE,
+            (GDBusSignalCallback)hamster_scheduler_cb_presence, self, NULL);
+   }
+   self->system = g_bus_get_sync(G_BUS_TYPE_SYSTEM, NULL, NULL);
+   if(self->system)
+      self->sleepWatch = g_dbus_connection_signal_subscribe(self->system,
+            NULL, "org.freedesktop.login1.Manager", "PrepareForSleep",
+            "/org/freedesktop/login1", NULL, G_DBUS_SIGNAL_FLAGS_NONE,
+            (GDBusSignalCallback)hamster_scheduler_cb_sleep, self, NULL);
+   return self;
+}
+
+void
+hamster_scheduler_free(HamsterScheduler *self)
+{
+   if(!self)
+      return;
+   if(self->source)
+      g_source_remove(self->source);
+   if(self->session)
+   {
+      g_dbus_connection_signal_unsubscribe(self->session, self->lockWatch[0]);
+      g_dbus_connection_signal_unsubscribe(self->session, self->lockWatch[1]);
+      g_dbus_connection_signal_unsubscribe(self->session, self->idleWatch);
+      g_object_unref(self->session);
+   }
+   if(self->system)
+   {
+      g_dbus_connection_signal_unsubscribe(self->system, self->sleepWatch);
+      g_object_unref(self->system);
+   }
+   DBG("%u wakeups", self->wakeups);
+   g_free(self);
+}
+
+void
+hamster_scheduler_set_visible(HamsterScheduler *self, gboolean visible)
+{
+   if(self->visible == visible)
+      return;
+   self->visible = visible;
+   hamster_scheduler_arm(self);
+}
+
+void
+hamster_scheduler_set_running(HamsterScheduler *self, time_t since)
+{
+   if(self->since == since)
+      return;
+   self->since = since;
+   if(!self->ticking)
+      hamster_scheduler_arm(self);
+}
+
+guint
+hamster_scheduler_get_wakeups(HamsterScheduler *self)
+{
+   return self->wakeups;
+}
@@ -0,0 +1,50 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <time.h>
+#include <glib.h>
+
+/*
+ * Decides when the button needs refreshing. While a fact runs it ticks when
+ * the running minute rolls over, otherwise once at midnight. Ticks are
+ * suspended while the button is not visible, the screensaver is active, the
+ * session manager says the session is idle or the system is about to sleep;
+ * leaving any of these states catches up with one immediate tick.
+ */
+typedef struct _HamsterScheduler HamsterScheduler;
+
+typedef void (*HamsterSchedulerTick)(gpointer data);
+
+HamsterScheduler*
+hamster_scheduler_new(HamsterSchedulerTick tick, gpointer data);
+
+void
+hamster_scheduler_free(HamsterScheduler *self);
+
+void
+hamster_scheduler_set_visible(HamsterScheduler *self, gboolean visible);
+
+/* start of the running fact in hamster's local time, 0 if none */
+void
+hamster_scheduler_set_running(HamsterScheduler *self, time_t since);
+
+/* main loop wakeups it caused so far: ticks, catch-ups and the signals it
+ * listens to, to compare against the old fixed 60s timer */
+guint
+hamster_scheduler_get_wakeups(HamsterScheduler *self);
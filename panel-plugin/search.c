@@ -0,0 +1,626 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+#include <string.h>
+#include <glib/gstdio.h>
+#include <libxfce4util/libxfce4util.h>
+#include "search.h"
+#include "backend.h"
+#include "util.h"
+
+#define DAY_SECONDS (24 * 60 * 60)
+#define CHUNK_DAYS 7
+/* this long without facts means we have seen them all */
+#define EMPTY_DAYS_DONE 366
+/* dead docs tolerated before compacting, at least as many as live ones */
+#define DEAD_DOCS_MIN 1024
+#define SEARCH_VERSION 1
+#define SEARCH_FORMAT "(uxxba(iiisssas))"
+
+typedef struct
+{
+   gint id;
+   time_t startTime;
+   time_t endTime;
+   gchar *name;
+   gchar *category;
+   gchar *description;
+   gchar **tags;
+   gchar *text;       /* casefolded name, category, tags, description */
+   gboolean dead;
+} Doc;
+
+typedef struct
+{
+   gint score;
+   const Doc *doc;
+} Hit;
+
+struct _HamsterSearch
+{
+   GMutex lock;
+   GCond cond;
+   GPtrArray *docs;
+   GHashTable *byId;       /* live docs */
+   GHashTable *grams;      /* trigram -> GArray of indices into docs */
+   guint dead;             /* docs replaced or removed, still in docs */
+   time_t from;            /* indexed days, inclusive */
+   time_t to;
+   gboolean complete;
+   gboolean building;
+   gboolean today;         /* reindex requested */
+   time_t rangeFirst;      /* days to reindex, none while first > last */
+   time_t rangeLast;
+   gboolean stop;
+   HamsterBackend *backend;
+   GThread *thread;
+};
+
+static void
+doc_free(Doc *doc)
+{
+   g_free(doc->name);
+   g_free(doc->category);
+   g_free(doc->description);
+   g_strfreev(doc->tags);
+   g_free(doc->text);
+   g_free(doc);
+}
+
+static gpointer
+search_gram(const gchar *p)
+{
+   return GUINT_TO_POINTER((guint)(guchar)p[0] << 16
+         | (guint)(guchar)p[1] << 8 | (guchar)p[2]);
+}
+
+static gchar*
+search_path(void)
+{
+   return g_build_filename(g_get_user_cache_dir(), PACKAGE, "search", NULL);
+}
+
+/* Index, all with the lock held */
+static void
+search_postings(HamsterSearch *self, const Doc *doc, guint idx)
+{
+   const gchar *p;
+
+   for(p = doc->text; p[0] && p[1] && p[2]; p++)
+   {
+      GArray *posting;
+
+      if(p[0] == '\n' || p[1] == '\n' || p[2] == '\n')
+         continue;
+      posting = g_hash_table_lookup(self->grams, search_gram(p));
+      if(!posting)
+      {
+         posting = g_array_new(FALSE, FALSE, sizeof(guint));
+         g_hash_table_insert(self->grams, search_gram(p), posting);
+      }
+      if(!posting->len || g_array_index(posting, guint, posting->len - 1) != idx)
+         g_array_append_val(posting, idx);
+   }
+}
+
+/* drops the dead docs once they outnumber the live ones, which takes
+ * renumbering the rest and so new postings */
+static void
+search_compact(HamsterSearch *self)
+{
+   GPtrArray *docs;
+   guint i;
+
+   if(self->dead < MAX(DEAD_DOCS_MIN, self->docs->len - self->dead))
+      return;
+   DBG("dropping %u of %u docs", self->dead, self->docs->len);
+   docs = g_ptr_array_new_full(self->docs->len - self->dead,
+         (GDestroyNotify)doc_free);
+   g_hash_table_remove_all(self->grams);
+   for(i = 0; i < self->docs->len; i++)
+   {
+      Doc *doc = g_ptr_array_index(self->docs, i);
+
+      if(doc->dead)
+         doc_free(doc);
+      else
+      {
+         search_postings(self, doc, docs->len);
+         g_ptr_array_add(docs, doc);
+      }
+   }
+   g_ptr_array_set_free_func(self->docs, NULL);
+   g_ptr_array_unref(self->docs);
+   self->docs = docs;
+   self->dead = 0;
+}
+
+static void
+search_insert(HamsterSearch *self, gint id, time_t startTime, time_t endTime,
+              const gchar *name, const gchar *category,
+              const gchar *description, const gchar *const *tags)
+{
+   Doc *doc = g_new0(Doc, 1), *old;
+   gchar *joined, *text;
+
+   old = g_hash_table_lookup(self->byId, GINT_TO_POINTER(id));
+   if(old)
+   {
+      old->dead = TRUE;
+      self->dead++;
+   }
+
+   doc->id = id;
+   doc->startTime = startTime;
+   doc->endTime = endTime;
+   doc->name = g_strdup(name);
+   doc->category = g_strdup(category);
+   doc->description = g_strdup(description);
+   doc->tags = g_strdupv((gchar**)tags);
+   joined = g_strjoinv(" ", doc->tags);
+   text = g_strdup_printf("%s\n%s\n%s\n%s", name, category, joined,
+         description ? description : "");
+   /* only the separators may be newlines, search_score counts them */
+   g_strdelimit(text, "\n", ' ');
+   text[strlen(name)] = '\n';
+   text[strlen(name) + 1 + strlen(category)] = '\n';
+   text[strlen(name) + 1 + strlen(category) + 1 + strlen(joined)] = '\n';
+   doc->text = g_utf8_casefold(text, -1);
+   g_free(text);
+   g_free(joined);
+   search_postings(self, doc, self->docs->len);
+   g_ptr_array_add(self->docs, doc);
+   g_hash_table_insert(self->byId, GINT_TO_POINTER(id), doc);
+}
+
+static void
+search_remove_days(HamsterSearch *self, time_t first, time_t last)
+{
+   GHashTableIter iter;
+   Doc *doc;
+
+   g_hash_table_iter_init(&iter, self->byId);
+   while(g_hash_table_iter_next(&iter, NULL, (gpointer*)&doc))
+   {
+      if(doc->startTime >= first && doc->startTime < last + DAY_SECONDS)
+      {
+         doc->dead = TRUE;
+         self->dead++;
+         g_hash_table_iter_remove(&iter);
+      }
+   }
+}
+
+/* Persistence */
+static void
+search_load(HamsterSearch *self)
+{
+   gchar *path = search_path(), *data;
+   gsize len;
+   GVariant *v, *facts;
+   GVariantIter iter;
+   guint version;
+   gint64 from, to;
+   gboolean complete;
+   gint id, start, end;
+   const gchar *name, *category, *description;
+   const gchar **tags;
+
+   if(!g_file_get_contents(path, &data, &len, NULL))
+   {
+      g_free(path);
+      return;
+   }
+   g_free(path);
+   v = g_variant_ref_sink(g_variant_new_from_data(G_VARIANT_TYPE(SEARCH_FORMAT),
+         data, len, FALSE, g_free, data));
+   g_variant_get(v, "(uxxb@a(iiisssas))", &version, &from, &to, &complete,
+         &facts);
+   if(version == SEARCH_VERSION && from <= to)
+   {
+      g_mutex_lock(&self->lock);
+      g_variant_iter_init(&iter, facts);
+      while(g_variant_iter_next(&iter, "(iii&s&s&s^a&s)", &id, &start, &end,
+               &name, &category, &description, &tags))
+      {
+         search_insert(self, id, start, end, name, category, description,
+               tags);
+         g_free(tags);
+      }
+      self->from = from;
+      self->to = to;
+      self->complete = complete;
+      g_mutex_unlock(&self->lock);
+      DBG("loaded %u facts", self->docs->len);
+   }
+   g_variant_unref(facts);
+   g_variant_unref(v);
+}
+
+static void
+search_save(HamsterSearch *self)
+{
+   GVariantBuilder facts;
+   GVariant *v;
+   gchar *path = search_path(), *dir = g_path_get_dirname(path);
+   GError *error = NULL;
+   guint i;
+
+   g_variant_builder_init(&facts, G_VARIANT_TYPE("a(iiisssas)"));
+   g_mutex_lock(&self->lock);
+   for(i = 0; i < self->docs->len; i++)
+   {
+      Doc *doc = g_ptr_array_index(self->docs, i);
+      if(!doc->dead)
+         g_variant_builder_add(&facts, "(iiisss^as)", doc->id,
+               (gint)doc->startTime, (gint)doc->endTime, doc->name,
+               doc->category, doc->description ? doc->description : "",
+               doc->tags);
+   }
+   v = g_variant_ref_sink(g_variant_new(SEARCH_FORMAT, SEARCH_VERSION,
+         (gint64)self->from, (gint64)self->to, self->complete, &facts));
+   g_mutex_unlock(&self->lock);
+
+   g_mkdir_with_parents(dir, 0700);
+   if(!g_file_set_contents(path, g_variant_get_data(v), g_variant_get_size(v),
+            &error))
+   {
+      g_warning("%s", error->message);
+      g_error_free(error);
+   }
+   g_variant_unref(v);
+   g_free(dir);
+   g_free(path);
+}
+
+/* Worker */
+
+/* replaces the facts starting in [first, last] with the daemon's */
+static gboolean
+search_fetch(HamsterSearch *self, time_t first, time_t last, gsize *found)
+{
+   GError *error = NULL;
+   GVariant *res = hamster_backend_get_facts(self->backend, first, last, "",
+         &error);
+   gsize i, n;
+
+   if(!res)
+   {
+      DBG("%s", error->message);
+      g_error_free(error);
+      return FALSE;
+   }
+   n = g_variant_n_children(res);
+   *found = 0;
+   g_mutex_lock(&self->lock);
+   search_remove_days(self, first, last);
+   for(i = 0; i < n; i++)
+   {
+      GVariant *child = g_variant_get_child_value(res, i);
+      fact *f = fact_new(child);
+      g_variant_unref(child);
+      if(!f)
+         continue;
+      /* facts reaching in from the day before belong to that day */
+      if(f->startTime >= first && f->startTime < last + DAY_SECONDS)
+      {
+         search_insert(self, f->id, f->startTime, f->endTime, f->name,
+               f->category, f->description, (const gchar* const*)f->tags);
+         (*found)++;
+      }
+      fact_free(f);
+   }
+   search_compact(self);
+   self->from = MIN(self->from, first);
+   self->to = MAX(self->to, last);
+   g_mutex_unlock(&self->lock);
+   g_variant_unref(res);
+   return TRUE;
+}
+
+/* the days [first, last] in chunks */
+static gboolean
+search_refetch(HamsterSearch *self, time_t first, time_t last)
+{
+   time_t day, chunk;
+   gsize found;
+
+   for(day = first; day <= last; day = chunk + DAY_SECONDS)
+   {
+      chunk = MIN(day + (CHUNK_DAYS - 1) * DAY_SECONDS, last);
+      if(g_atomic_int_get(&self->stop) || !search_fetch(self, day, chunk, &found))
+         return FALSE;
+   }
+   return TRUE;
+}
+
+/* from the last indexed day, which may have been partial, up to today */
+static gboolean
+search_forward(HamsterSearch *self)
+{
+   time_t today = util_local_now() / DAY_SECONDS * DAY_SECONDS;
+
+   return search_refetch(self, MIN(self->to, today), today);
+}
+
+static gboolean
+search_backward(HamsterSearch *self)
+{
+   guint empty = 0;
+   gsize found;
+
+   while(!self->complete)
+   {
+      time_t last = self->from - DAY_SECONDS;
+      time_t first = last - (CHUNK_DAYS - 1) * DAY_SECONDS;
+
+      if(g_atomic_int_get(&self->stop) || !search_fetch(self, first, last, &found))
+         return FALSE;
+      empty = found ? 0 : empty + CHUNK_DAYS;
+      g_mutex_lock(&self->lock);
+      self->complete = empty >= EMPTY_DAYS_DONE || first <= 0;
+      g_mutex_unlock(&self->lock);
+   }
+   return TRUE;
+}
+
+static gpointer
+search_run(HamsterSearch *self)
+{
+   search_load(self);
+   if(self->from > self->to)
+      self->to = self->from = util_local_now() / DAY_SECONDS * DAY_SECONDS;
+   if(search_forward(self))
+      search_backward(self);
+   search_save(self);
+
+   g_mutex_lock(&self->lock);
+   self->building = FALSE;
+   while(!self->stop)
+   {
+      if(self->today)
+      {
+         self->today = FALSE;
+         g_mutex_unlock(&self->lock);
+         search_forward(self);
+         g_mutex_lock(&self->lock);
+         continue;
+      }
+      if(self->rangeFirst <= self->rangeLast)
+      {
+         /* the walks pick up what lies beyond the indexed days, a
+          * fetch there would leave a gap */
+         time_t first = self->complete ? self->rangeFirst
+            : MAX(self->rangeFirst, self->from);
+         time_t last = MIN(self->rangeLast, self->to);
+         self->rangeFirst = 1;
+         self->rangeLast = 0;
+         g_mutex_unlock(&self->lock);
+         if(first <= last)
+            search_refetch(self, first, last);
+         g_mutex_lock(&self->lock);
+         continue;
+      }
+      g_cond_wait(&self->cond, &self->lock);
+   }
+   g_mutex_unlock(&self->lock);
+   return NULL;
+}
+
+HamsterSearch*
+hamster_search_new(gboolean standalone)
+{
+   HamsterSearch *self = g_new0(HamsterSearch, 1);
+
+   g_mutex_init(&self->lock);
+   g_cond_init(&self->cond);
+   self->docs = g_ptr_array_new_with_free_func((GDestroyNotify)doc_free);
+   self->byId = g_hash_table_new(NULL, NULL);
+   self->grams = g_hash_table_new_full(NULL, NULL, NULL,
+         (GDestroyNotify)g_array_unref);
+   /* empty range until something is loaded or fetched */
+   self->from = 1;
+   self->to = 0;
+   self->rangeFirst = 1;
+   self->rangeLast = 0;
+   self->building = TRUE;
+   /* our own, the view replaces its backend when settings change */
+   self->backend = hamster_backend_new(FALSE, standalone);
+   self->thread = g_thread_new("hamster-search", (GThreadFunc)search_run, self);
+   return self;
+}
+
+void
+hamster_search_free(HamsterSearch *self)
+{
+   gboolean building;
+
+   if(!self)
+      return;
+   g_mutex_lock(&self->lock);
+   g_atomic_int_set(&self->stop, TRUE);
+   building = self->building;
+   g_cond_signal(&self->cond);
+   g_mutex_unlock(&self->lock);
+   g_thread_join(self->thread);
+   /* an interrupted build saved already, keep what today added */
+   if(!building)
+      search_save(self);
+
+   hamster_backend_free(self->backend);
+   g_hash_table_unref(self->grams);
+   g_hash_table_unref(self->byId);
+   g_ptr_array_unref(self->docs);
+   g_cond_clear(&self->cond);
+   g_mutex_clear(&self->lock);
+   g_free(self);
+}
+
+void
+hamster_search_update_today(HamsterSearch *self)
+{
+   g_mutex_lock(&self->lock);
+   self->today = TRUE;
+   g_cond_signal(&self->cond);
+   g_mutex_unlock(&self->lock);
+}
+
+void
+hamster_search_update_range(HamsterSearch *self, time_t first, time_t last)
+{
+   first -= first % DAY_SECONDS;
+   last -= last % DAY_SECONDS;
+   g_mutex_lock(&self->lock);
+   if(self->rangeFirst > self->rangeLast)
+   {
+      self->rangeFirst = first;
+      self->rangeLast = last;
+   }
+   else
+   {
+      self->rangeFirst = MIN(self->rangeFirst, first);
+      self->rangeLast = MAX(self->rangeLast, last);
+   }
+   g_cond_signal(&self->cond);
+   g_mutex_unlock(&self->lock);
+}
+
+gboolean
+hamster_search_is_building(HamsterSearch *self)
+{
+   gboolean building;
+
+   g_mutex_lock(&self->lock);
+   building = self->building;
+   g_mutex_unlock(&self->lock);
+   return building;
+}
+
+/* Query */
+
+/* name beats category beats tags beats description */
+static gint
+search_score(const Doc *doc, const gchar *match)
+{
+   const gchar *p;
+   gint field = 0;
+
+   for(p = doc->text; p < match; p++)
+      if(*p == '\n')
+         field++;
+   return 4 - field;
+}
+
+static gint
+search_hit_compare(const Hit *a, const Hit *b)
+{
+   if(a->score != b->score)
+      return b->score - a->score;
+   /* then most recent first */
+   return (b->doc->startTime > a->doc->startTime)
+      - (b->doc->startTime < a->doc->startTime);
+}
+
+static fact*
+search_doc_to_fact(const Doc *doc, time_t now)
+{
+   fact *f = g_new0(fact, 1);
+
+   f->id = doc->id;
+   f->startTime = doc->startTime;
+   f->endTime = doc->endTime;
+   f->name = g_strdup(doc->name);
+   f->category = g_strdup(doc->category);
+   f->description = g_strdup(doc->description);
+   f->tags = g_strdupv(doc->tags);
+   f->seconds = (doc->endTime ? doc->endTime : now) - doc->startTime;
+   return f;
+}
+
+GPtrArray*
+hamster_search_query(HamsterSearch *self, const gchar *query, guint limit)
+{
+   GPtrArray *result = g_ptr_array_new_with_free_func((GDestroyNotify)fact_free);
+   gchar *folded = g_utf8_casefold(query, -1);
+   gchar **words = g_strsplit_set(folded, " \t", -1), **w;
+   GArray *hits = g_array_new(FALSE, FALSE, sizeof(Hit));
+   GArray *candidates = NULL;
+   gboolean any = FALSE, none = FALSE;
+   time_t now = util_local_now();
+   guint i, n;
+
+   g_mutex_lock(&self->lock);
+
+   /* the rarest trigram of any word limits what has to be checked */
+   for(w = words; *w && !none; w++)
+   {
+      const gchar *p;
+
+      if(!**w)
+         continue;
+      any = TRUE;
+      for(p = *w; p[0] && p[1] && p[2]; p++)
+      {
+         GArray *posting = g_hash_table_lookup(self->grams, search_gram(p));
+         if(!posting)
+         {
+            none = TRUE;
+            break;
+         }
+         if(!candidates || posting->len < candidates->len)
+            candidates = posting;
+      }
+   }
+
+   n = candidates ? candidates->len : self->docs->len;
+   for(i = 0; any && !none && i < n; i++)
+   {
+      const Doc *doc = g_ptr_array_index(self->docs,
+            candidates ? g_array_index(candidates, guint, i) : i);
+      Hit hit = { 0, doc };
+
+      if(doc->dead)
+         continue;
+      for(w = words; *w; w++)
+      {
+         const gchar *match;
+
+         if(!**w)
+            continue;
+         if(!(match = strstr(doc->text, *w)))
+            break;
+         hit.score += search_score(doc, match);
+      }
+      if(!*w)
+         g_array_append_val(hits, hit);
+   }
+
+   g_array_sort(hits, (GCompareFunc)search_hit_compare);
+   for(i = 0; i < hits->len && i < limit; i++)
+      g_ptr_array_add(result,
+            search_doc_to_fact(g_array_index(hits, Hit, i).doc, now));
+   g_mutex_unlock(&self->lock);
+
+   g_array_free(hits, TRUE);
+   g_strfreev(words);
+   g_free(folded);
+   return result;
+}
@@ -0,0 +1,52 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <glib.h>
+
+/*
+ * Trigram index over all facts, for searching the history from the popup.
+ *
+ * A worker thread fills it from the on-disk copy, fetches the days since
+ * that was written and then walks backwards in weekly GetFacts chunks until
+ * a year without facts is found. Queries can be made at any time and see
+ * whatever has been indexed so far.
+ */
+typedef struct _HamsterSearch HamsterSearch;
+
+HamsterSearch*
+hamster_search_new(gboolean standalone);
+
+/* stops the worker and saves the index */
+void
+hamster_search_free(HamsterSearch *self);
+
+/* facts changed, reindex today */
+void
+hamster_search_update_today(HamsterSearch *self);
+
+/* facts starting in these days changed, reindex them */
+void
+hamster_search_update_range(HamsterSearch *self, time_t first, time_t last);
+
+gboolean
+hamster_search_is_building(HamsterSearch *self);
+
+/* best first, all words must match; a GPtrArray of fact* (see util.h) */
+GPtrArray*
+hamster_search_query(HamsterSearch *self, const gchar *query, guint limit);
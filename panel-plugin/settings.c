@@ -19,16 +19,166 @@
 #ifdef HAVE_CONFIG_H
 #  include "config.h"
 #endif
+#include <string.h>
 #include <libxfce4ui/libxfce4ui.h>
 #include <libxfce4panel/libxfce4panel.h>
 #include <xfconf/xfconf.h>
+#include "label.h"
 #include "settings.h"
 
+typedef struct
+{
+   const gchar *property;
+   GType type;
+   gsize offset;
+   gboolean defBool;
+   gdouble defDouble;
+   gdouble min;
+   gdouble max;
+   const gchar *defString;
+} SettingSpec;
+
+#define SETTING_BOOL(prop, field, def) \
+   { prop, G_TYPE_BOOLEAN, G_STRUCT_OFFSET(HamsterSettings, field), def, 0, 0, 0, NULL }
+#define SETTING_DOUBLE(prop, field, def, min, max) \
+   { prop, G_TYPE_DOUBLE, G_STRUCT_OFFSET(HamsterSettings, field), FALSE, def, min, max, NULL }
+#define SETTING_STRING(prop, field, def) \
+   { prop, G_TYPE_STRING, G_STRUCT_OFFSET(HamsterSettings, field), FALSE, 0, 0, 0, def }
+
+static const SettingSpec settings_spec[] =
+{
+   SETTING_BOOL(XFPROP_DONTHIDE, donthide, FALSE),
+   SETTING_BOOL(XFPROP_DROPDOWN, dropdown, FALSE),
+   SETTING_BOOL(XFPROP_TOOLTIPS, tooltips, TRUE),
+   SETTING_BOOL(XFPROP_SANITIZE, sanitize, FALSE),
+   SETTING_BOOL(XFPROP_DIRECTREADS, directreads, FALSE),
+   SETTING_BOOL(XFPROP_STANDALONE, standalone, FALSE),
+   SETTING_DOUBLE(XFPROP_TARGET, target, 0, 0, 24),
+   SETTING_STRING(XFPROP_CATEGORYTARGETS, categorytargets, ""),
+   SETTING_STRING(XFPROP_AUTOSWITCH, autoswitch, ""),
+   SETTING_DOUBLE(XFPROP_IDLESTOP, idlestop, 0, 0, 240),
+   SETTING_STRING(XFPROP_LABEL, label, HAMSTER_LABEL_DEFAULT),
+};
+
+/* value NULL or of the wrong type means default */
+static gboolean
+settings_apply(HamsterSettings *settings, const SettingSpec *spec,
+               const GValue *value)
+{
+   gpointer field = G_STRUCT_MEMBER_P(settings, spec->offset);
+
+   if(value && !G_VALUE_HOLDS(value, spec->type))
+   {
+      if(G_IS_VALUE(value))
+         g_warning("%s: expected %s, got %s", spec->property,
+               g_type_name(spec->type), G_VALUE_TYPE_NAME(value));
+      value = NULL;
+   }
+   switch(spec->type)
+   {
+      case G_TYPE_BOOLEAN:
+      {
+         gboolean b = value ? g_value_get_boolean(value) : spec->defBool;
+         if(*(gboolean*)field == b)
+            return FALSE;
+         *(gboolean*)field = b;
+         return TRUE;
+      }
+      case G_TYPE_DOUBLE:
+      {
+         gdouble d = value ? g_value_get_double(value) : spec->defDouble;
+         d = CLAMP(d, spec->min, spec->max);
+         if(*(gdouble*)field == d)
+            return FALSE;
+         *(gdouble*)field = d;
+         return TRUE;
+      }
+      case G_TYPE_STRING:
+      {
+         const gchar *str = value ? g_value_get_string(value) : NULL;
+         gchar **s = field;
+         if(!str)
+            str = spec->defString;
+         if(*s && !strcmp(*s, str))
+            return FALSE;
+         g_free(*s);
+         *s = g_strdup(str);
+         return TRUE;
+      }
+      default:
+         g_assert_not_reached();
+   }
+   return FALSE;
+}
+
+void
+settings_load(HamsterSettings *settings, XfconfChannel *channel)
+{
+   GHashTable *props = xfconf_channel_get_properties(channel, NULL);
+   guint i;
+
+   memset(settings, 0, sizeof(*settings));
+   for(i = 0; i < G_N_ELEMENTS(settings_spec); i++)
+      settings_apply(settings, &settings_spec[i], props
+            ? g_hash_table_lookup(props, settings_spec[i].property) : NULL);
+   if(props)
+      g_hash_table_destroy(props);
+}
+
+gboolean
+settings_update(HamsterSettings *settings, const gchar *property,
+                const GValue *value)
+{
+   guint i;
+
+   for(i = 0; i < G_N_ELEMENTS(settings_spec); i++)
+      if(!strcmp(property, settings_spec[i].property))
+         return settings_apply(settings, &settings_spec[i], value);
+   return FALSE;
+}
+
+void
+settings_clear(HamsterSettings *settings)
+{
+   g_free(settings->categorytargets);
+   g_free(settings->autoswitch);
+   g_free(settings->label);
+   memset(settings, 0, sizeof(*settings));
+}
+
+/* rules are taken as a whole, not at every keystroke of a half-typed
+ * pattern */
+static gboolean
+settings_cb_rules_commit(GtkWidget *txt, GdkEvent *event,
+                         XfconfChannel *channel)
+{
+   GtkTextBuffer *buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(txt));
+   GtkTextIter start, end;
+   gchar *text, *old;
+
+   gtk_text_buffer_get_bounds(buffer, &start, &end);
+   text = gtk_text_buffer_get_text(buffer, &start, &end, FALSE);
+   old = xfconf_channel_get_string(channel, XFPROP_AUTOSWITCH, "");
+   if(strcmp(text, old))
+      xfconf_channel_set_string(channel, XFPROP_AUTOSWITCH, text);
+   g_free(old);
+   g_free(text);
+   return FALSE;
+}
+
+/* closing the dialog doesn't always move the focus first */
+static void
+settings_cb_rules_unmap(GtkWidget *txt, XfconfChannel *channel)
+{
+   settings_cb_rules_commit(txt, NULL, channel);
+}
+
 void
 config_show(XfcePanelPlugin *plugin, XfconfChannel *channel)
 {
    GtkWidget *dlg = xfce_titled_dialog_new();
-   GtkWidget *cnt, *lbl, *chk;
+   GtkWidget *cnt, *lbl, *chk, *grd, *spn, *ent, *scr, *txt;
+   gchar *rules;
    g_object_set(G_OBJECT(dlg),
          "title", _("Hamster"),
          "icon_name", "org.gnome.Hamster.GUI",
@@ -61,6 +211,95 @@ config_show(XfcePanelPlugin *plugin, XfconfChannel *channel)
    xfconf_g_property_bind(channel, XFPROP_SANITIZE, G_TYPE_BOOLEAN, G_OBJECT(chk), "active");
    gtk_container_add(GTK_CONTAINER(cnt), chk);
 
+   grd = gtk_grid_new();
+   gtk_grid_set_column_spacing(GTK_GRID(grd), 8);
+   lbl = gtk_label_new(_("Button label:"));
+   gtk_widget_set_halign(lbl, GTK_ALIGN_START);
+   gtk_grid_attach(GTK_GRID(grd), lbl, 0, 0, 1, 1);
+   ent = gtk_entry_new();
+   gtk_entry_set_placeholder_text(GTK_ENTRY(ent), HAMSTER_LABEL_DEFAULT);
+   gtk_widget_set_tooltip_text(ent, _("Fields: {activity} {category} "
+            "{description} {tags} {elapsed} {category_total} {day_total}\n"
+            "Times take :h:mm, :hm or :m, text a length like {activity:12}"));
+   gtk_widget_set_hexpand(ent, TRUE);
+   xfconf_g_property_bind(channel, XFPROP_LABEL, G_TYPE_STRING, G_OBJECT(ent), "text");
+   gtk_grid_attach(GTK_GRID(grd), ent, 1, 0, 1, 1);
+   gtk_container_add(GTK_CONTAINER(cnt), grd);
+
+#ifdef HAVE_SQLITE
+   chk = gtk_check_button_new_with_label(_("Read today's facts from hamster.db"));
+   xfconf_g_property_bind(channel, XFPROP_DIRECTREADS, G_TYPE_BOOLEAN, G_OBJECT(chk), "active");
+   gtk_container_add(GTK_CONTAINER(cnt), chk);
+
+   chk = gtk_check_button_new_with_label(_("Track in hamster.db without hamster-service"));
+   xfconf_g_property_bind(channel, XFPROP_STANDALONE, G_TYPE_BOOLEAN, G_OBJECT(chk), "active");
+   gtk_container_add(GTK_CONTAINER(cnt), chk);
+#endif
+
+   lbl = gtk_label_new(_("<b>Daily targets</b>"));
+   gtk_label_set_use_markup(GTK_LABEL(lbl), TRUE);
+   gtk_container_add(GTK_CONTAINER(cnt), lbl);
+
+   grd = gtk_grid_new();
+   gtk_grid_set_row_spacing(GTK_GRID(grd), 4);
+   gtk_grid_set_column_spacing(GTK_GRID(grd), 8);
+   lbl = gtk_label_new(_("Hours per day, 0 for none:"));
+   gtk_widget_set_halign(lbl, GTK_ALIGN_START);
+   gtk_grid_attach(GTK_GRID(grd), lbl, 0, 0, 1, 1);
+   spn = gtk_spin_button_new_with_range(0, 24, 0.25);
+   gtk_spin_button_set_digits(GTK_SPIN_BUTTON(spn), 2);
+   xfconf_g_property_bind(channel, XFPROP_TARGET, G_TYPE_DOUBLE, G_OBJECT(spn), "value");
+   gtk_grid_attach(GTK_GRID(grd), spn, 1, 0, 1, 1);
+   lbl = gtk_label_new(_("Per category:"));
+   gtk_widget_set_halign(lbl, GTK_ALIGN_START);
+   gtk_grid_attach(GTK_GRID(grd), lbl, 0, 1, 1, 1);
+   ent = gtk_entry_new();
+   gtk_entry_set_placeholder_text(GTK_ENTRY(ent), _("Work=6, Study=1.5"));
+   xfconf_g_property_bind(channel, XFPROP_CATEGORYTARGETS, G_TYPE_STRING, G_OBJECT(ent), "text");
+   gtk_grid_attach(GTK_GRID(grd), ent, 1, 1, 1, 1);
+   gtk_container_add(GTK_CONTAINER(cnt), grd);
+
+   lbl = gtk_label_new(_("<b>Switch by focused window</b>"));
+   gtk_label_set_use_markup(GTK_LABEL(lbl), TRUE);
+   gtk_container_add(GTK_CONTAINER(cnt), lbl);
+   lbl = gtk_label_new(_("One rule per line, like\n"
+            "class:jetbrains|code => Coding@Work\n"
+            "title:jira => Tickets@Work"));
+   gtk_widget_set_halign(lbl, GTK_ALIGN_START);
+   gtk_style_context_add_class(gtk_widget_get_style_context(lbl),
+         GTK_STYLE_CLASS_DIM_LABEL);
+   gtk_container_add(GTK_CONTAINER(cnt), lbl);
+   txt = gtk_text_view_new();
+   gtk_text_view_set_monospace(GTK_TEXT_VIEW(txt), TRUE);
+   rules = xfconf_channel_get_string(channel, XFPROP_AUTOSWITCH, "");
+   gtk_text_buffer_set_text(gtk_text_view_get_buffer(GTK_TEXT_VIEW(txt)),
+         rules, -1);
+   g_free(rules);
+   g_signal_connect(txt, "focus-out-event",
+         G_CALLBACK(settings_cb_rules_commit), channel);
+   g_signal_connect(txt, "unmap",
+         G_CALLBACK(settings_cb_rules_unmap), channel);
+   scr = gtk_scrolled_window_new(NULL, NULL);
+   gtk_scrolled_window_set_min_content_height(GTK_SCROLLED_WINDOW(scr), 80);
+   gtk_scrolled_window_set_shadow_type(GTK_SCROLLED_WINDOW(scr), GTK_SHADOW_IN);
+   gtk_container_add(GTK_CONTAINER(scr), txt);
+   gtk_container_add(GTK_CONTAINER(cnt), scr);
+
+#ifdef HAVE_XSYNC
+   lbl = gtk_label_new(_("<b>When away</b>"));
+   gtk_label_set_use_markup(GTK_LABEL(lbl), TRUE);
+   gtk_container_add(GTK_CONTAINER(cnt), lbl);
+   grd = gtk_grid_new();
+   gtk_grid_set_column_spacing(GTK_GRID(grd), 8);
+   lbl = gtk_label_new(_("Stop tracking after minutes idle, 0 for never:"));
+   gtk_widget_set_halign(lbl, GTK_ALIGN_START);
+   gtk_grid_attach(GTK_GRID(grd), lbl, 0, 0, 1, 1);
+   spn = gtk_spin_button_new_with_range(0, 240, 1);
+   xfconf_g_property_bind(channel, XFPROP_IDLESTOP, G_TYPE_DOUBLE, G_OBJECT(spn), "value");
+   gtk_grid_attach(GTK_GRID(grd), spn, 1, 0, 1, 1);
+   gtk_container_add(GTK_CONTAINER(cnt), grd);
+#endif
+
    gtk_dialog_add_button(GTK_DIALOG(dlg), "_Close", 0);
 
    gtk_widget_show_all(dlg);
@@ -17,8 +17,48 @@
  */
 
 #pragma once
+#include <xfconf/xfconf.h>
 
 #define XFPROP_DONTHIDE "/donthide"
 #define XFPROP_DROPDOWN "/dropdown"
 #define XFPROP_TOOLTIPS "/tooltips"
 #define XFPROP_SANITIZE "/sanitize"
+#define XFPROP_DIRECTREADS "/directreads"
+#define XFPROP_STANDALONE "/standalone"
+#define XFPROP_TARGET "/target"
+#define XFPROP_CATEGORYTARGETS "/categorytargets"
+#define XFPROP_AUTOSWITCH "/autoswitch"
+#define XFPROP_IDLESTOP "/idlestop"
+#define XFPROP_LABEL "/label"
+
+/*
+ * What the view reads, kept in sync from property-changed so no reader
+ * ever asks xfconfd. New options go here and into the table in settings.c.
+ */
+typedef struct _HamsterSettings
+{
+   gboolean donthide;
+   gboolean dropdown;
+   gboolean tooltips;
+   gboolean sanitize;
+   gboolean directreads;
+   gboolean standalone;       /* hamster.db without hamster-service */
+   gdouble target;            /* hours per day, 0 for none */
+   gchar *categorytargets;    /* "Category=hours, ..." never NULL */
+   gchar *autoswitch;         /* rules, see autoswitch.h, never NULL */
+   gdouble idlestop;          /* minutes away before stopping, 0 for never */
+   gchar *label;              /* button template, see label.h, never NULL */
+}HamsterSettings;
+
+/* one round trip for all properties, defaults for missing ones */
+void
+settings_load(HamsterSettings *settings, XfconfChannel *channel);
+
+/* apply a property-changed value, an unset value restores the default;
+ * FALSE if the property is unknown or nothing changed */
+gboolean
+settings_update(HamsterSettings *settings, const gchar *property,
+                const GValue *value);
+
+void
+settings_clear(HamsterSettings *settings);
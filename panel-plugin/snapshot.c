@@ -0,0 +1,198 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+#include <string.h>
+#include <glib/gstdio.h>
+#include <libxfce4util/libxfce4util.h>
+#include "snapshot.h"
+#include "util.h"
+
+#define DAY_SECONDS (24 * 60 * 60)
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_DELAY 3
+
+/* version, sha1 of the payload, payload */
+#define SNAPSHOT_FORMAT "(usv)"
+/* day written, one maybe-reply per part */
+#define SNAPSHOT_PAYLOAD "(xmvmvmv)"
+
+struct _HamsterSnapshot
+{
+   gchar *path;
+   GVariant *parts[HAMSTER_MODEL_PARTS];
+   guint source;            /* pending write */
+};
+
+static gint64
+snapshot_today(void)
+{
+   return util_local_now() / DAY_SECONDS;
+}
+
+static gchar*
+snapshot_checksum(GVariant *payload)
+{
+   return g_compute_checksum_for_data(G_CHECKSUM_SHA1,
+         g_variant_get_data(payload), g_variant_get_size(payload));
+}
+
+static gboolean
+snapshot_read(HamsterSnapshot *self)
+{
+   GMappedFile *map;
+   GBytes *bytes;
+   GVariant *v, *payload, *part[HAMSTER_MODEL_PARTS];
+   guint32 version;
+   const gchar *stored;
+   gchar *sum;
+   gint64 day;
+   gboolean ok = FALSE;
+   gint i;
+
+   if(!(map = g_mapped_file_new(self->path, FALSE, NULL)))
+      return FALSE;
+   bytes = g_mapped_file_get_bytes(map);
+   g_mapped_file_unref(map);
+   v = g_variant_ref_sink(g_variant_new_from_bytes(
+            G_VARIANT_TYPE(SNAPSHOT_FORMAT), bytes, FALSE));
+   g_bytes_unref(bytes);
+
+   g_variant_get(v, "(u&sv)", &version, &stored, &payload);
+   if(version != SNAPSHOT_VERSION)
+      DBG("version %u", version);
+   else if(!g_variant_is_of_type(payload, G_VARIANT_TYPE(SNAPSHOT_PAYLOAD)))
+      DBG("bad payload");
+   else
+   {
+      sum = snapshot_checksum(payload);
+      if(strcmp(sum, stored))
+         DBG("checksum mismatch");
+      else
+      {
+         g_variant_get(payload, SNAPSHOT_PAYLOAD, &day,
+               &part[HAMSTER_MODEL_FACTS], &part[HAMSTER_MODEL_ACTIVITIES],
+               &part[HAMSTER_MODEL_TAGS]);
+         /* yesterday's facts would show as today's */
+         if(day == snapshot_today())
+         {
+            for(i = 0; i < HAMSTER_MODEL_PARTS; i++)
+               self->parts[i] = part[i];
+            ok = TRUE;
+         }
+         else
+         {
+            DBG("stale, from day %" G_GINT64_FORMAT, day);
+            for(i = 0; i < HAMSTER_MODEL_PARTS; i++)
+               if(part[i])
+                  g_variant_unref(part[i]);
+         }
+      }
+      g_free(sum);
+   }
+   g_variant_unref(payload);
+   g_variant_unref(v);
+   if(!ok)
+      g_unlink(self->path);
+   return ok;
+}
+
+static gboolean
+snapshot_write(HamsterSnapshot *self)
+{
+   GVariant *payload, *v;
+   gchar *dir, *sum;
+   GError *error = NULL;
+
+   self->source = 0;
+   payload = g_variant_ref_sink(g_variant_new(SNAPSHOT_PAYLOAD,
+            snapshot_today(), self->parts[HAMSTER_MODEL_FACTS],
+            self->parts[HAMSTER_MODEL_ACTIVITIES],
+            self->parts[HAMSTER_MODEL_TAGS]));
+   sum = snapshot_checksum(payload);
+   v = g_variant_ref_sink(g_variant_new(SNAPSHOT_FORMAT, SNAPSHOT_VERSION,
+            sum, payload));
+
+   dir = g_path_get_dirname(self->path);
+   g_mkdir_with_parents(dir, 0700);
+   if(!g_file_set_contents(self->path, g_variant_get_data(v),
+            g_variant_get_size(v), &error))
+   {
+      g_warning("%s", error->message);
+      g_error_free(error);
+   }
+   g_free(dir);
+   g_free(sum);
+   g_variant_unref(v);
+   g_variant_unref(payload);
+   return FALSE;
+}
+
+HamsterSnapshot*
+hamster_snapshot_new(void)
+{
+   HamsterSnapshot *self = g_new0(HamsterSnapshot, 1);
+
+   self->path = g_build_filename(g_get_user_cache_dir(), PACKAGE, "snapshot",
+         NULL);
+   if(snapshot_read(self))
+      DBG("loaded %s", self->path);
+   return self;
+}
+
+void
+hamster_snapshot_free(HamsterSnapshot *self)
+{
+   gint i;
+
+   if(!self)
+      return;
+   if(self->source)
+   {
+      g_source_remove(self->source);
+      snapshot_write(self);
+   }
+   for(i = 0; i < HAMSTER_MODEL_PARTS; i++)
+      if(self->parts[i])
+         g_variant_unref(self->parts[i]);
+   g_free(self->path);
+   g_free(self);
+}
+
+GVariant*
+hamster_snapshot_get(HamsterSnapshot *self, HamsterModelPart part)
+{
+   return self->parts[part];
+}
+
+void
+hamster_snapshot_set(HamsterSnapshot *self, HamsterModelPart part,
+                     GVariant *reply)
+{
+   if(self->parts[part] == reply
+         || (self->parts[part] && reply && g_variant_equal(self->parts[part], reply)))
+      return;
+   if(self->parts[part])
+      g_variant_unref(self->parts[part]);
+   self->parts[part] = reply ? g_variant_ref_sink(reply) : NULL;
+   if(!self->source)
+      self->source = g_timeout_add_seconds(SNAPSHOT_DELAY,
+            (GSourceFunc)snapshot_write, self);
+}
@@ -0,0 +1,46 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <glib.h>
+#include "model.h"
+
+/*
+ * The last replies the models were built from, kept in
+ * ~/.cache/PACKAGE/snapshot so a restarted panel has something to show
+ * before the daemon answered. The file is one serialized GVariant that is
+ * read through a mapping; it carries a version, a checksum of its payload
+ * and the day it was written, and is discarded if any of them is off.
+ * Writes are coalesced and happen a few seconds after the last change.
+ */
+typedef struct _HamsterSnapshot HamsterSnapshot;
+
+HamsterSnapshot*
+hamster_snapshot_new(void);
+
+/* writes what is still pending */
+void
+hamster_snapshot_free(HamsterSnapshot *self);
+
+/* the stored reply for part, NULL if there is none for today */
+GVariant*
+hamster_snapshot_get(HamsterSnapshot *self, HamsterModelPart part);
+
+void
+hamster_snapshot_set(HamsterSnapshot *self, HamsterModelPart part,
+                     GVariant *reply);
@@ -0,0 +1,215 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * test-fact-json: fact_new_json on what hamster's JSON API sends, and on
+ * what it must not take. "make check" runs it.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+#include <string.h>
+#include <glib.h>
+#include "fact.h"
+
+/* 2024-05-02 00:00 in hamster's local epoch seconds */
+#define DAY 1714608000
+#define AT(h, m) (DAY + (h) * 3600 + (m) * 60)
+
+typedef struct
+{
+   const gchar *json;
+   gint id;
+   time_t startTime;
+   time_t endTime;
+   time_t date;
+   const gchar *name;
+   const gchar *category;
+   const gchar *description;
+   const gchar *tags;         /* space separated */
+} JsonCase;
+
+static const JsonCase json_cases[] =
+{
+   { "{\"activity\": \"Coding\", \"category\": \"Work\", \"description\": \"\","
+     " \"tags\": [\"a\", \"b\"], \"id\": 7, \"activity_id\": 3,"
+     " \"exported\": false, \"range\": \"2024-05-02 09:30 - 11:15\","
+     " \"date\": \"2024-05-02\"}",
+     7, AT(9, 30), AT(11, 15), DAY, "Coding", "Work", "", "a b" },
+   /* the end's date is left out, and past midnight it is the next day */
+   { "{\"id\": 1, \"activity\": \"late\", \"range\": \"2024-05-02 23:30 - 00:15\","
+     " \"date\": \"2024-05-02\"}",
+     1, AT(23, 30), AT(24, 15), DAY, "late", "", "", "" },
+   /* the service's day, which starts later than midnight */
+   { "{\"id\": 2, \"activity\": \"late\", \"range\": \"2024-05-03 01:30 - 02:00\","
+     " \"date\": \"2024-05-02\"}",
+     2, AT(25, 30), AT(26, 0), DAY, "late", "", "", "" },
+   /* without one, the start's */
+   { "{\"id\": 3, \"activity\": \"x\", \"range\": \"2024-05-03 01:30 - 02:00\"}",
+     3, AT(25, 30), AT(26, 0), DAY + 24 * 3600, "x", "", "", "" },
+   { "{\"id\": 4, \"name\": \"x\", \"start\": \"2024-05-02T09:30:00+02:00\","
+     " \"end\": \"2024-05-02 10:00:00\"}",
+     4, AT(9, 30), AT(10, 0), DAY, "x", "", "", "" },
+   { "{\"id\": 5, \"name\": \"x\", \"start_time\": 1714642200,"
+     " \"end_time\": 1714644000}",
+     5, AT(9, 30), AT(10, 0), DAY, "x", "", "", "" },
+   /* escapes, raw newlines and nulls */
+   { "{\"id\": 6, \"activity\": \"caf\\u00e9 \\ud83d\\ude00\","
+     " \"description\": \"line one\\nline two \\\"#1\\\"\","
+     " \"category\": null, \"tags\": null,"
+     " \"range\": \"2024-05-02 09:30 - 11:15\"}",
+     6, AT(9, 30), AT(11, 15), DAY, "caf\xC3\xA9 \xF0\x9F\x98\x80", "",
+     "line one\nline two \"#1\"", "" },
+   { "{\"id\": 8, \"activity\": \"x\", \"description\": \"line one\nline two\","
+     " \"range\": \"2024-05-02 09:30 - 11:15\"}",
+     8, AT(9, 30), AT(11, 15), DAY, "x", "", "line one\nline two", "" },
+   /* keys it doesn't know, whatever they hold */
+   { " { \"extra\" : {\"a\": [1, -2.5e3, {\"b\": null}, \"}\"]},"
+     " \"tr\\u0075e\": true, \"id\": 9, \"activity\": \"x\","
+     " \"range\": \"2024-05-02 09:30 - 11:15\" } ",
+     9, AT(9, 30), AT(11, 15), DAY, "x", "", "", "" },
+   { "{}", 0, 0, 0, 0, "", "", "", "" }
+};
+
+static const gchar *json_malformed[] =
+{
+   "",
+   "   ",
+   "{",
+   "[]",
+   "null",
+   "{\"id\": }",
+   "{\"id\": 1,}",
+   "{\"id\": 1 \"name\": \"x\"}",
+   "{\"id\": 1} x",
+   "{\"id\": 1}{}",
+   "{\"id\": tru}",
+   "{\"description\": \"abc}",
+   "{\"description\": \"\\q\"}",
+   "{\"description\": \"\\u12\"}",
+   "{\"description\": \"\\ud83d\"}",
+   "{\"tags\": [1]}",
+   "{\"tags\": [\"a\",]}",
+   "{\"tags\": \"a\"}",
+   "{\"range\": \"tomorrow\"}",
+   "{\"range\": \"2024-05-02 25:00 - 11:15\"}",
+   "{\"start\": \"2024-13-01 10:00\"}",
+   "{\"extra\": [[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]}",
+   "{\"extra\": [1, 2}"
+};
+
+static void
+test_json(gconstpointer data)
+{
+   const JsonCase *c = data;
+   GError *error = NULL;
+   fact *f = fact_new_json(c->json, -1, &error);
+   gchar *tags;
+
+   g_assert_no_error(error);
+   g_assert_nonnull(f);
+   g_assert_cmpint(f->id, ==, c->id);
+   g_assert_cmpint(f->startTime, ==, c->startTime);
+   g_assert_cmpint(f->endTime, ==, c->endTime);
+   g_assert_cmpint(f->date, ==, c->date);
+   if(c->endTime)
+      g_assert_cmpint(f->seconds, ==, c->endTime - c->startTime);
+   g_assert_cmpstr(f->name, ==, c->name);
+   g_assert_cmpstr(f->category, ==, c->category);
+   g_assert_cmpstr(f->description, ==, c->description);
+   tags = g_strjoinv(" ", f->tags);
+   g_assert_cmpstr(tags, ==, c->tags);
+   g_free(tags);
+   fact_free(f);
+}
+
+static void
+test_malformed(gconstpointer data)
+{
+   const gchar *json = data;
+   GError *error = NULL;
+
+   g_assert_null(fact_new_json(json, -1, &error));
+   g_assert_error(error, FACT_JSON_ERROR, 0);
+   g_error_free(error);
+}
+
+/* only the given length is read */
+static void
+test_length(void)
+{
+   static const gchar json[] = "{\"id\": 12, \"activity\": \"x\"}garbage";
+   GError *error = NULL;
+   fact *f = fact_new_json(json, strlen(json) - strlen("garbage"), &error);
+
+   g_assert_no_error(error);
+   g_assert_cmpint(f->id, ==, 12);
+   fact_free(f);
+   g_assert_null(fact_new_json(json, 10, &error));
+   g_assert_error(error, FACT_JSON_ERROR, 0);
+   g_error_free(error);
+}
+
+/* an end left open is still running */
+static void
+test_running(void)
+{
+   static const gchar *running[] =
+   {
+      "{\"range\": \"2024-05-02 09:30 - --\"}",
+      "{\"range\": \"2024-05-02 09:30\"}",
+      "{\"start\": \"2024-05-02 09:30\", \"end\": null}"
+   };
+   guint i;
+
+   for(i = 0; i < G_N_ELEMENTS(running); i++)
+   {
+      fact *f = fact_new_json(running[i], -1, NULL);
+
+      g_assert_nonnull(f);
+      g_assert_cmpint(f->startTime, ==, AT(9, 30));
+      g_assert_cmpint(f->endTime, ==, 0);
+      g_assert_cmpint(f->date, ==, DAY);
+      g_assert_cmpint(f->seconds, >, 0);
+      fact_free(f);
+   }
+}
+
+int
+main(int argc, char **argv)
+{
+   guint i;
+
+   g_test_init(&argc, &argv, NULL);
+   for(i = 0; i < G_N_ELEMENTS(json_cases); i++)
+   {
+      gchar *path = g_strdup_printf("/fact-json/read/%u", i);
+      g_test_add_data_func(path, &json_cases[i], test_json);
+      g_free(path);
+   }
+   for(i = 0; i < G_N_ELEMENTS(json_malformed); i++)
+   {
+      gchar *path = g_strdup_printf("/fact-json/malformed/%u", i);
+      g_test_add_data_func(path, json_malformed[i], test_malformed);
+      g_free(path);
+   }
+   g_test_add_func("/fact-json/length", test_length);
+   g_test_add_func("/fact-json/running", test_running);
+   return g_test_run();
+}
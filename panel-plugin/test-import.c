@@ -0,0 +1,257 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * test-import: the plain, CSV and iCalendar readers, up to the items they
+ * make; nothing is checked against or sent to the daemon. Run in UTC, so
+ * that iCalendar's UTC times read the same everywhere. "make check" runs it.
+ */
+
+#include "import.c"
+
+/* what import.c links against, never called without a dialog */
+HamsterBackend*
+hamster_backend_new(gboolean directReads, gboolean standalone)
+{
+   return NULL;
+}
+
+void
+hamster_backend_free(HamsterBackend *backend)
+{
+}
+
+GVariant*
+hamster_backend_get_facts(HamsterBackend *backend, guint start_date,
+                          guint end_date, const gchar *search, GError **error)
+{
+   g_assert_not_reached();
+   return NULL;
+}
+
+void
+hamster_backend_add_fact_async(HamsterBackend *backend, const gchar *fact,
+                               gint start_time, gint end_time,
+                               GCancellable *cancellable,
+                               GAsyncReadyCallback callback,
+                               gpointer user_data)
+{
+   g_assert_not_reached();
+}
+
+gboolean
+hamster_backend_add_fact_finish(GAsyncResult *result, gint *id,
+                                GError **error)
+{
+   g_assert_not_reached();
+   return FALSE;
+}
+
+/* 2024-05-02 15:00 in hamster's local epoch seconds */
+#define NOW (1714608000 + 15 * 3600)
+
+typedef struct
+{
+   ImportFormat format;
+   const gchar *text;
+   const gchar *items;        /* one line each, see test_items */
+} ImportCase;
+
+static const ImportCase import_cases[] =
+{
+   { IMPORT_PLAIN,
+     "# a comment\n"
+     "\n"
+     "2024-05-02 09:30-11:15 meeting@work, notes #billable\n"
+     "10:00 running\n"
+     "  2024-05-01 23:30-00:15 late@home  \n"
+     "12:00-13:00 fix@dev #t,, see #123\n"
+     "foo #bar, desc\n"
+     "13:00-14:00 a, b, c",
+     "3 2024-05-02 09:30 - 11:15 105 meeting@work, notes #billable\n"
+     "4 bad\n"
+     "5 2024-05-01 23:30 - 00:15 45 late@home\n"
+     "6 2024-05-02 12:00 - 13:00 60 fix@dev #t,, see #123\n"
+     "7 bad\n"
+     "8 2024-05-02 13:00 - 14:00 60 a,, b, c\n" },
+
+   /* quoted fields with commas, quotes and newlines; records are
+    * numbered by the line they start on */
+   { IMPORT_CSV,
+     "Start, End ,Activity,Category,Description,Tags\n"
+     "2024-05-02 09:30,2024-05-02 11:15,meeting,work,\"notes, more\","
+       "billable #review\n"
+     "2024-05-02T23:30:00,2024-05-03 00:15,late,,\"line one\n"
+     "line two\",\n"
+     "yesterday,2024-05-02 11:15,x,,,\n"
+     "2024-05-02 12:00,2024-05-02 11:00,x,,,\n"
+     "\n"
+     "2024-05-02 13:00,2024-05-02 14:00,\"say \"\"hi\"\"\",,,\n"
+     "2024-05-02 14:00,2024-05-02 15:00,a@b,,,\n"
+     "2024-05-02 14:00,2024-05-02 15:00,x,,,\"a b,c\"\n",
+     "2 2024-05-02 09:30 - 11:15 105 meeting@work #billable #review,, notes, more\n"
+     "3 2024-05-02 23:30 - 00:15 45 late, line one\\nline two\n"
+     "5 bad\n"
+     "6 bad\n"
+     "8 2024-05-02 13:00 - 14:00 60 say \"hi\"\n"
+     "9 bad\n"
+     "10 2024-05-02 14:00 - 15:00 60 x #a #b #c\n" },
+   { IMPORT_CSV,
+     "start,duration,name\r\n"
+     "2024-05-02 09:00,30,tea\r\n"
+     "2024-05-02 10:00,0,tea\r\n",
+     "2 2024-05-02 09:00 - 09:30 30 tea\n"
+     "3 bad\n" },
+   { IMPORT_CSV,
+     "when,what\n"
+     "2024-05-02 09:00,tea\n",
+     "1 bad\n" },
+   { IMPORT_CSV, "", "1 bad\n" },
+
+   { IMPORT_ICS,
+     "BEGIN:VCALENDAR\r\n"
+     "BEGIN:VEVENT\r\n"
+     "SUMMARY:Call@Work\\, budget #billable\r\n"
+     "DTSTART:20240502T093000\r\n"
+     "DTEND:20240502T101500\r\n"
+     "END:VEVENT\r\n"
+     "BEGIN:VEVENT\r\n"
+     "SUMMARY:Review\r\n"
+     "CATEGORIES:Work,Other\r\n"
+     "DESCRIPTION:line one\\nline two\r\n"
+     "DTSTART:20240502T120000Z\r\n"
+     "DURATION:PT1H30M\r\n"
+     "END:VEVENT\r\n"
+     "BEGIN:VEVENT\r\n"
+     "SUMMARY:Holiday\r\n"
+     "DTSTART;VALUE=DATE:20240502\r\n"
+     "END:VEVENT\r\n"
+     "BEGIN:VEVENT\r\n"
+     "SUMMARY:Fol\r\n"
+     " ded\r\n"
+     "DTSTART:20240502T233000\r\n"
+     "DTEND:20240503T001500\r\n"
+     "END:VEVENT\r\n"
+     "BEGIN:VEVENT\r\n"
+     "DTSTART:20240502T090000\r\n"
+     "DTEND:20240502T100000\r\n"
+     "END:VEVENT\r\n"
+     "BEGIN:VEVENT\r\n"
+     "SUMMARY:x\r\n"
+     "DTSTART:20240502T090000\r\n"
+     "DURATION:P1X\r\n"
+     "END:VEVENT\r\n"
+     "END:VCALENDAR\r\n",
+     "2 2024-05-02 09:30 - 10:15 45 Call@Work, budget #billable\n"
+     "7 2024-05-02 12:00 - 13:30 90 Review@Work, line one line two\n"
+     "14 bad\n"
+     "18 2024-05-02 23:30 - 00:15 45 Folded\n"
+     "24 bad\n"
+     "28 bad\n" }
+};
+
+/* "line start - end minutes fact" or "line bad", fact escaped */
+static gchar*
+test_items(Import *imp)
+{
+   GString *out = g_string_new(NULL);
+   guint i;
+
+   for(i = 0; i < imp->items->len; i++)
+   {
+      const ImportItem *item = g_ptr_array_index(imp->items, i);
+      gchar span[64], *fact;
+
+      if(item->state == ITEM_BAD)
+      {
+         g_assert_nonnull(item->message);
+         g_string_append_printf(out, "%d bad\n", item->line);
+         continue;
+      }
+      g_assert_cmpint(item->state, ==, ITEM_OK);
+      import_format_span(span, sizeof(span), item->start, item->end);
+      fact = g_strescape(item->fact, "\"");
+      g_string_append_printf(out, "%d %s %d %s\n", item->line, span,
+            (gint)(item->end - item->start) / 60, fact);
+      g_free(fact);
+   }
+   return g_string_free(out, FALSE);
+}
+
+static void
+test_import(gconstpointer data)
+{
+   const ImportCase *c = data;
+   Import *imp = g_new0(Import, 1);
+   gchar *items;
+
+   imp->items = g_ptr_array_new_with_free_func((GDestroyNotify)import_item_free);
+   switch(c->format)
+   {
+      case IMPORT_PLAIN: import_parse_plain(imp, c->text, NOW); break;
+      case IMPORT_CSV: import_parse_csv(imp, c->text); break;
+      case IMPORT_ICS: import_parse_ics(imp, c->text, NOW); break;
+   }
+   items = test_items(imp);
+   g_assert_cmpstr(items, ==, c->items);
+   g_free(items);
+   g_ptr_array_unref(imp->items);
+   g_free(imp);
+}
+
+static void
+test_ics_duration(void)
+{
+   static const struct
+   {
+      const gchar *text;
+      gint seconds;
+   } durations[] =
+   {
+      { "PT1H30M", 5400 },
+      { "PT45S", 45 },
+      { "P1DT2H", 26 * 3600 },
+      { "P1W", 7 * 24 * 3600 },
+      { "+PT5M", 300 },
+      { "-PT5M", -300 },
+      { "T5M", -1 },
+      { "P1X", -1 }
+   };
+   guint i;
+
+   for(i = 0; i < G_N_ELEMENTS(durations); i++)
+      g_assert_cmpint(import_ics_duration(durations[i].text), ==,
+            durations[i].seconds);
+}
+
+int
+main(int argc, char **argv)
+{
+   guint i;
+
+   g_setenv("TZ", "UTC", TRUE);
+   g_test_init(&argc, &argv, NULL);
+   for(i = 0; i < G_N_ELEMENTS(import_cases); i++)
+   {
+      gchar *path = g_strdup_printf("/import/parse/%u", i);
+      g_test_add_data_func(path, &import_cases[i], test_import);
+      g_free(path);
+   }
+   g_test_add_func("/import/ics-duration", test_ics_duration);
+   return g_test_run();
+}
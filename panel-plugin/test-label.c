@@ -0,0 +1,188 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * test-label: compiling and formatting the panel button's templates.
+ * "make check" runs it.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+#include <string.h>
+#include <glib.h>
+#include "label.h"
+
+#define E_ACUTE "\xC3\xA9"
+#define ELLIPSIS "\xE2\x80\xA6"
+
+static const HamsterLabelData label_data =
+{
+   "Coding", "Work", "line one\nline two", "#a #b", 3900, 7500, 30000
+};
+
+typedef struct
+{
+   const gchar *template;
+   gint maxChars;
+   const gchar *activity;     /* NULL for label_data's */
+   const gchar *category;
+   const gchar *expected;
+} FormatCase;
+
+static const FormatCase format_cases[] =
+{
+   { HAMSTER_LABEL_DEFAULT, 0, NULL, NULL, "Coding 1:05" },
+   { "{activity} {elapsed:hm} \xC2\xB7 {category} {category_total:m}", 0,
+      NULL, NULL, "Coding 1h 5min \xC2\xB7 Work 125" },
+   { "{day_total:h:mm} {day_total:hm}", 0, NULL, NULL, "8:20 8h 20min" },
+   { "{{x}} {tags}", 0, NULL, NULL, "{x} #a #b" },
+   { "{description}", 0, NULL, NULL, "line one\nline two" },
+   { "{category}", 0, NULL, "", "" },
+   /* shortened, the longest first, durations and literals stay */
+   { "{activity} {elapsed}", 10, "Coding project", NULL, "Codi" ELLIPSIS " 1:05" },
+   { "{activity}@{category}", 7, "abcdefgh", "xy", "abc" ELLIPSIS "@xy" },
+   { "{activity}@{category}", 11, "abcdefgh", "xy", "abcdefgh@xy" },
+   { "{activity:3}", 0, NULL, NULL, "Co" ELLIPSIS },
+   { "{activity:6}", 0, NULL, NULL, "Coding" },
+   { "{activity}", 3, E_ACUTE E_ACUTE E_ACUTE E_ACUTE, NULL,
+      E_ACUTE E_ACUTE ELLIPSIS }
+};
+
+static void
+test_format(gconstpointer data)
+{
+   const FormatCase *c = data;
+   HamsterLabel *label = hamster_label_new();
+   HamsterLabelData d = label_data;
+   GError *error = NULL;
+
+   if(c->activity)
+      d.activity = c->activity;
+   if(c->category)
+      d.category = c->category;
+   g_assert_true(hamster_label_compile(label, c->template, &error));
+   g_assert_no_error(error);
+   g_assert_cmpstr(hamster_label_format(label, &d, c->maxChars), ==,
+         c->expected);
+   hamster_label_free(label);
+}
+
+static void
+test_null_fields(void)
+{
+   HamsterLabel *label = hamster_label_new();
+   HamsterLabelData d = { NULL };
+
+   g_assert_true(hamster_label_compile(label,
+            "[{activity}|{category}|{description}|{tags}] {elapsed:m}", NULL));
+   g_assert_cmpstr(hamster_label_format(label, &d, 5), ==, "[|||] 0");
+   hamster_label_free(label);
+}
+
+/* a bad template leaves the last good one */
+static void
+test_errors(void)
+{
+   static const gchar *bad[] =
+   {
+      "{nope}",
+      "{activity",
+      "activity}",
+      "{activity:0}",
+      "{activity:x}",
+      "{activity:1024}",
+      "{elapsed:s}",
+      "{elapsed:}",
+      "caf\xE9"
+   };
+   HamsterLabel *label = hamster_label_new();
+   GString *many = g_string_new(NULL);
+   guint i;
+
+   for(i = 0; i < G_N_ELEMENTS(bad); i++)
+   {
+      GError *error = NULL;
+
+      g_assert_false(hamster_label_compile(label, bad[i], &error));
+      g_assert_error(error, HAMSTER_LABEL_ERROR, 0);
+      g_error_free(error);
+      g_assert_cmpstr(hamster_label_format(label, &label_data, 0), ==,
+            "Coding 1:05");
+   }
+
+   for(i = 0; i < 17; i++)
+      g_string_append(many, "{activity} ");
+   g_assert_false(hamster_label_compile(label, many->str, NULL));
+   g_string_free(many, TRUE);
+   hamster_label_free(label);
+}
+
+/* the buffer holds 1023 bytes; what doesn't fit is left out a whole
+ * character at a time */
+static void
+test_buffer_end(void)
+{
+   static const gchar *chars[] = { E_ACUTE, ELLIPSIS, "\xF0\x9F\x98\x80" };
+   HamsterLabel *label = hamster_label_new();
+   guint i, lead;
+
+   g_assert_true(hamster_label_compile(label, "{activity}!{elapsed}", NULL));
+   for(i = 0; i < G_N_ELEMENTS(chars); i++)
+   {
+      /* every position of the cut within a character */
+      for(lead = 0; lead < 4; lead++)
+      {
+         HamsterLabelData d = label_data;
+         GString *activity = g_string_new(NULL);
+         const gchar *text;
+         gsize length;
+
+         g_string_append_len(activity, "xxxx", lead);
+         while(activity->len < 1100)
+            g_string_append(activity, chars[i]);
+         d.activity = activity->str;
+         text = hamster_label_format(label, &d, 0);
+         length = strlen(text);
+         g_assert_true(g_utf8_validate(text, -1, NULL));
+         g_assert_cmpuint(length, <=, 1023);
+         g_assert_cmpuint(length, >, 1023 - strlen(chars[i]));
+         g_assert_true(strncmp(text, activity->str, length) == 0);
+         g_string_free(activity, TRUE);
+      }
+   }
+   hamster_label_free(label);
+}
+
+int
+main(int argc, char **argv)
+{
+   guint i;
+
+   g_test_init(&argc, &argv, NULL);
+   for(i = 0; i < G_N_ELEMENTS(format_cases); i++)
+   {
+      gchar *path = g_strdup_printf("/label/format/%u", i);
+      g_test_add_data_func(path, &format_cases[i], test_format);
+      g_free(path);
+   }
+   g_test_add_func("/label/null-fields", test_null_fields);
+   g_test_add_func("/label/errors", test_errors);
+   g_test_add_func("/label/buffer-end", test_buffer_end);
+   return g_test_run();
+}
@@ -0,0 +1,185 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * test-parser: fact_spec_parse and fact_spec_to_string on what users type.
+ * "make check" runs it.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+#include <glib.h>
+#include "parser.h"
+
+/* 2023-11-14 15:00 in hamster's local epoch seconds */
+#define DAY 1699920000
+#define NOW (DAY + 15 * 3600)
+#define AT(h, m) (DAY + (h) * 3600 + (m) * 60)
+
+typedef struct
+{
+   const gchar *text;
+   gint error;                /* FactSpecError, -1 if it parses */
+   time_t startTime;
+   time_t endTime;
+   const gchar *name;
+   const gchar *category;
+   const gchar *description;
+   const gchar *tags;         /* space separated */
+} ParseCase;
+
+static const ParseCase parse_cases[] =
+{
+   /* times */
+   { "meeting", -1, 0, 0, "meeting", NULL, NULL, "" },
+   { "-10 meeting@work, notes #billable", -1, AT(14, 50), 0,
+      "meeting", "work", "notes", "billable" },
+   { "12:30-13:45 x@y", -1, AT(12, 30), AT(13, 45), "x", "y", NULL, "" },
+   { "12:30 - 13:45 x", -1, AT(12, 30), AT(13, 45), "x", NULL, NULL, "" },
+   { "9.05 tea", -1, AT(9, 5), 0, "tea", NULL, NULL, "" },
+   { "13:00 - -10 x", -1, AT(13, 0), AT(14, 50), "x", NULL, NULL, "" },
+   { "-30 -10 foo", -1, AT(14, 30), AT(14, 50), "foo", NULL, NULL, "" },
+   { "2024-02-03 10:00-11:00 a@b", -1, 1706954400, 1706958000,
+      "a", "b", NULL, "" },
+   /* an end before the start is past midnight */
+   { "23:00-01:00 late", -1, AT(23, 0), AT(25, 0), "late", NULL, NULL, "" },
+   { "13:00-12:00 x", -1, AT(13, 0), AT(36, 0), "x", NULL, NULL, "" },
+   { "14:00-14:00 x", -1, AT(14, 0), AT(38, 0), "x", NULL, NULL, "" },
+   { "2024-02-03 22:30 - 00:15 x", -1, 1706999400, 1707005700,
+      "x", NULL, NULL, "" },
+   /* tags and descriptions */
+   { "a@b, c, d #t1 #t2", -1, 0, 0, "a", "b", "c, d", "t1 t2" },
+   { "tea, with #x milk #y", -1, 0, 0, "tea", NULL, "with #x milk", "y" },
+   { "fix@dev #t,, see #123, later", -1, 0, 0,
+      "fix", "dev", "see #123, later", "t" },
+   { "a,, #only", -1, 0, 0, "a", NULL, "#only", "" },
+   { "C# dev@x, y #t", -1, 0, 0, "C# dev", "x", "y", "t" },
+   { "write, line one\nline two #t", -1, 0, 0,
+      "write", NULL, "line one\nline two", "t" },
+   { "write #t,, line one\nline two", -1, 0, 0,
+      "write", NULL, "line one\nline two", "t" },
+   /* errors */
+   { "", FACT_SPEC_ERROR_EMPTY },
+   { "  ", FACT_SPEC_ERROR_EMPTY },
+   { "25:00 x", FACT_SPEC_ERROR_TIME },
+   { "2024-02-30 10:00 x", FACT_SPEC_ERROR_TIME },
+   { "2024-01-01 x", FACT_SPEC_ERROR_TIME },
+   { "16:00 x", FACT_SPEC_ERROR_RANGE },
+   { "13:00 - -200 x", FACT_SPEC_ERROR_RANGE },
+   { "#", FACT_SPEC_ERROR_ACTIVITY },
+   { "a@", FACT_SPEC_ERROR_CATEGORY },
+   { "x #", FACT_SPEC_ERROR_TAG },
+   { "foo #bar, desc", FACT_SPEC_ERROR_TAG },
+   { "foo@#bar", FACT_SPEC_ERROR_TAG }
+};
+
+static void
+test_parse(gconstpointer data)
+{
+   const ParseCase *c = data;
+   GError *error = NULL;
+   fact_spec spec;
+   gchar *tags;
+
+   if(c->error >= 0)
+   {
+      g_assert_false(fact_spec_parse(&spec, c->text, NOW, &error));
+      g_assert_error(error, FACT_SPEC_ERROR, c->error);
+      g_assert_null(spec.name);
+      g_assert_null(spec.tags);
+      g_error_free(error);
+      return;
+   }
+
+   g_assert_true(fact_spec_parse(&spec, c->text, NOW, &error));
+   g_assert_no_error(error);
+   g_assert_cmpint(spec.startTime, ==, c->startTime);
+   g_assert_cmpint(spec.endTime, ==, c->endTime);
+   g_assert_cmpstr(spec.name, ==, c->name);
+   g_assert_cmpstr(spec.category, ==, c->category);
+   g_assert_cmpstr(spec.description, ==, c->description);
+   tags = g_strjoinv(" ", spec.tags);
+   g_assert_cmpstr(tags, ==, c->tags);
+   g_free(tags);
+   fact_spec_clear(&spec);
+}
+
+/* what the editor and the importer send has to read back the same */
+static void
+test_round_trip(void)
+{
+   static const struct
+   {
+      const gchar *name;
+      const gchar *category;
+      const gchar *description;
+      const gchar *tags;
+   } specs[] =
+   {
+      { "meeting", NULL, NULL, "" },
+      { "meeting", "work", "notes", "billable" },
+      { "fix", "dev", "see #123", "" },
+      { "fix", "dev", "a, b", "t1 t2" },
+      { "call", NULL, "#first", "t" },
+      { "write", "docs", "line one\nline two", "t" },
+      { "C# dev", "x", "plain", "" }
+   };
+   guint i;
+
+   for(i = 0; i < G_N_ELEMENTS(specs); i++)
+   {
+      fact_spec in = { 0 }, out;
+      GError *error = NULL;
+      gchar *text, *tags;
+
+      in.name = (gchar*)specs[i].name;
+      in.category = (gchar*)specs[i].category;
+      in.description = (gchar*)specs[i].description;
+      /* "" splits into no tags at all */
+      in.tags = g_strsplit(specs[i].tags, " ", -1);
+      text = fact_spec_to_string(&in);
+      if(!fact_spec_parse(&out, text, NOW, &error))
+         g_error("\"%s\" doesn't read back: %s", text, error->message);
+      g_assert_cmpstr(out.name, ==, in.name);
+      g_assert_cmpstr(out.category, ==, in.category);
+      g_assert_cmpstr(out.description, ==, in.description);
+      tags = g_strjoinv(" ", out.tags);
+      g_assert_cmpstr(tags, ==, specs[i].tags);
+      g_free(tags);
+      fact_spec_clear(&out);
+      g_strfreev(in.tags);
+      g_free(text);
+   }
+}
+
+int
+main(int argc, char **argv)
+{
+   guint i;
+
+   g_test_init(&argc, &argv, NULL);
+   for(i = 0; i < G_N_ELEMENTS(parse_cases); i++)
+   {
+      gchar *path = g_strdup_printf("/parser/parse/%u", i);
+      g_test_add_data_func(path, &parse_cases[i], test_parse);
+      g_free(path);
+   }
+   g_test_add_func("/parser/round-trip", test_round_trip);
+   return g_test_run();
+}
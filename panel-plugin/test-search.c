@@ -0,0 +1,173 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * test-search: the index and its scoring, filled by hand rather than by the
+ * worker, which isn't started. "make check" runs it.
+ */
+
+#include "search.c"
+
+/* what search.c links against, never called without the worker */
+HamsterBackend*
+hamster_backend_new(gboolean directReads, gboolean standalone)
+{
+   return NULL;
+}
+
+void
+hamster_backend_free(HamsterBackend *backend)
+{
+}
+
+GVariant*
+hamster_backend_get_facts(HamsterBackend *backend, guint start_date,
+                          guint end_date, const gchar *search, GError **error)
+{
+   g_assert_not_reached();
+   return NULL;
+}
+
+/* 2023-11-14 00:00 in hamster's local epoch seconds */
+#define DAY 1699920000
+
+static HamsterSearch*
+test_search_new(void)
+{
+   HamsterSearch *self = g_new0(HamsterSearch, 1);
+
+   g_mutex_init(&self->lock);
+   self->docs = g_ptr_array_new_with_free_func((GDestroyNotify)doc_free);
+   self->byId = g_hash_table_new(NULL, NULL);
+   self->grams = g_hash_table_new_full(NULL, NULL, NULL,
+         (GDestroyNotify)g_array_unref);
+   return self;
+}
+
+static void
+test_search_free(HamsterSearch *self)
+{
+   g_hash_table_unref(self->grams);
+   g_hash_table_unref(self->byId);
+   g_ptr_array_unref(self->docs);
+   g_mutex_clear(&self->lock);
+   g_free(self);
+}
+
+/* tags space separated, the day's hour as the start */
+static void
+test_insert(HamsterSearch *self, gint id, gint hour, const gchar *name,
+            const gchar *category, const gchar *description,
+            const gchar *tags)
+{
+   gchar **split = g_strsplit(tags, " ", -1);
+
+   search_insert(self, id, DAY + hour * 3600, DAY + hour * 3600 + 1800,
+         name, category, description, (const gchar* const*)split);
+   g_strfreev(split);
+}
+
+/* the ids found, space separated */
+static gchar*
+test_query(HamsterSearch *self, const gchar *query, guint limit)
+{
+   GPtrArray *found = hamster_search_query(self, query, limit);
+   GString *ids = g_string_new(NULL);
+   guint i;
+
+   for(i = 0; i < found->len; i++)
+   {
+      const fact *f = g_ptr_array_index(found, i);
+      g_string_append_printf(ids, "%s%d", i ? " " : "", f->id);
+   }
+   g_ptr_array_unref(found);
+   return g_string_free(ids, FALSE);
+}
+
+#define assert_query(self, query, limit, expected)             \
+   G_STMT_START {                                               \
+      gchar *ids = test_query((self), (query), (limit));        \
+      g_assert_cmpstr(ids, ==, (expected));                     \
+      g_free(ids);                                              \
+   } G_STMT_END
+
+static void
+test_fields(void)
+{
+   HamsterSearch *self = test_search_new();
+
+   /* the oldest first, so that recency alone would get it backwards */
+   test_insert(self, 1, 8, "Budget", "work", "", "");
+   test_insert(self, 2, 9, "call", "budget", "", "");
+   test_insert(self, 3, 10, "call", "work", "", "budget");
+   test_insert(self, 4, 11, "call", "work", "budget review", "");
+   test_insert(self, 5, 12, "mail", "work", "", "");
+
+   assert_query(self, "budget", 10, "1 2 3 4");
+   assert_query(self, "BUDGET", 10, "1 2 3 4");
+   assert_query(self, "budget", 2, "1 2");
+   /* every word has to match, each adds its field's score */
+   assert_query(self, "call review", 10, "4");
+   assert_query(self, "work call", 10, "4 3");
+   /* shorter than a trigram, every doc is looked at */
+   assert_query(self, "ma", 10, "5");
+   assert_query(self, "nowhere", 10, "");
+   assert_query(self, "", 10, "");
+   test_search_free(self);
+}
+
+/* only the separators may count as newlines */
+static void
+test_newlines(void)
+{
+   HamsterSearch *self = test_search_new();
+
+   test_insert(self, 1, 8, "call", "work", "budget", "");
+   test_insert(self, 2, 9, "call", "work", "line one\nline two\nbudget", "");
+   test_insert(self, 3, 10, "call", "work", "", "budget");
+
+   /* the tag, then the descriptions alike, the more recent first */
+   assert_query(self, "budget", 10, "3 2 1");
+   /* words from either side of the description's newline */
+   assert_query(self, "two budget", 10, "2");
+   test_search_free(self);
+}
+
+/* a fact fetched again replaces the one indexed */
+static void
+test_replace(void)
+{
+   HamsterSearch *self = test_search_new();
+
+   test_insert(self, 1, 8, "budget", "work", "", "");
+   test_insert(self, 1, 8, "review", "work", "", "");
+   g_assert_cmpuint(self->dead, ==, 1);
+   assert_query(self, "budget", 10, "");
+   assert_query(self, "review", 10, "1");
+   test_search_free(self);
+}
+
+int
+main(int argc, char **argv)
+{
+   g_test_init(&argc, &argv, NULL);
+   g_test_add_func("/search/fields", test_fields);
+   g_test_add_func("/search/newlines", test_newlines);
+   g_test_add_func("/search/replace", test_replace);
+   return g_test_run();
+}
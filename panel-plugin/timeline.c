@@ -0,0 +1,410 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+#include <math.h>
+#include <string.h>
+#include <libxfce4util/libxfce4util.h>
+#include "timeline.h"
+
+#define DAY_SECONDS (24 * 60 * 60)
+#define HOUR_SECONDS (60 * 60)
+#define STRIP_HEIGHT 12
+/* the strip spans at least this much of the day */
+#define DAY_FIRST_HOUR 8
+#define DAY_LAST_HOUR 18
+
+typedef struct
+{
+   gint id;
+   time_t start;
+   time_t end;       /* now for the running fact */
+   gboolean running;
+   gchar *name;
+   gchar *category;
+} Segment;
+
+enum
+{
+   GAP_CLICKED,
+   LAST_SIGNAL
+};
+
+static guint timeline_signals[LAST_SIGNAL];
+
+G_DEFINE_TYPE(HamsterTimeline, hamster_timeline, GTK_TYPE_DRAWING_AREA);
+
+static void
+segment_clear(Segment *seg)
+{
+   g_free(seg->name);
+   g_free(seg->category);
+}
+
+static gdouble
+hamster_timeline_x(HamsterTimeline *self, time_t t, gint width)
+{
+   return (gdouble)(t - self->from) * width / (self->to - self->from);
+}
+
+static time_t
+hamster_timeline_time(HamsterTimeline *self, gint x, gint width)
+{
+   return self->from + (time_t)x * (self->to - self->from) / MAX(width, 1);
+}
+
+static void
+hamster_timeline_format(gchar *buf, gsize size, time_t t)
+{
+   g_snprintf(buf, size, "%02d:%02d",
+         (gint)(t % DAY_SECONDS) / 3600, (gint)(t % 3600) / 60);
+}
+
+/* stable color per category */
+static void
+hamster_timeline_color(const gchar *category, gdouble *r, gdouble *g,
+                       gdouble *b)
+{
+   guint hash = g_str_hash(category ? category : "");
+   gtk_hsv_to_rgb((hash % 360) / 360.0, 0.55, 0.85, r, g, b);
+}
+
+static void
+hamster_timeline_paint_span(HamsterTimeline *self, cairo_t *cr,
+                            const Segment *seg, time_t from, time_t to,
+                            gint width, gint height)
+{
+   gdouble r, g, b;
+   gdouble x0 = hamster_timeline_x(self, from, width);
+   gdouble x1 = hamster_timeline_x(self, to, width);
+
+   hamster_timeline_color(seg->category, &r, &g, &b);
+   cairo_set_source_rgb(cr, r, g, b);
+   cairo_rectangle(cr, x0, 1, MAX(x1 - x0, 1.0), height - 2);
+   cairo_fill(cr);
+}
+
+/* full repaint into the cache */
+static void
+hamster_timeline_render(HamsterTimeline *self, gint width, gint height)
+{
+   GtkWidget *widget = GTK_WIDGET(self);
+   time_t t;
+   guint i;
+   cairo_t *cr;
+
+   if(self->cache)
+      cairo_surface_destroy(self->cache);
+   self->cache = gdk_window_create_similar_surface(
+         gtk_widget_get_window(widget), CAIRO_CONTENT_COLOR_ALPHA,
+         width, height);
+   self->cacheWidth = width;
+   self->cacheHeight = height;
+
+   cr = cairo_create(self->cache);
+   cairo_set_source_rgba(cr, 0.5, 0.5, 0.5, 0.15);
+   cairo_paint(cr);
+
+   cairo_set_source_rgba(cr, 0.5, 0.5, 0.5, 0.6);
+   for(t = self->from + HOUR_SECONDS; t < self->to; t += HOUR_SECONDS)
+      cairo_rectangle(cr, floor(hamster_timeline_x(self, t, width)),
+            height - 3, 1, 3);
+   cairo_fill(cr);
+
+   for(i = 0; i < self->segments->len; i++)
+   {
+      Segment *seg = &g_array_index(self->segments, Segment, i);
+      hamster_timeline_paint_span(self, cr, seg, seg->start, seg->end,
+            width, height);
+   }
+   cairo_destroy(cr);
+   self->dirty = FALSE;
+}
+
+static gboolean
+hamster_timeline_draw(GtkWidget *widget, cairo_t *cr)
+{
+   HamsterTimeline *self = HAMSTER_TIMELINE(widget);
+   gint width = gtk_widget_get_allocated_width(widget);
+   gint height = gtk_widget_get_allocated_height(widget);
+
+   if(self->dirty || !self->cache || self->cacheWidth != width
+         || self->cacheHeight != height)
+      hamster_timeline_render(self, width, height);
+
+   cairo_set_source_surface(cr, self->cache, 0, 0);
+   cairo_paint(cr);
+   return FALSE;
+}
+
+static const Segment*
+hamster_timeline_segment_at(HamsterTimeline *self, time_t t)
+{
+   guint i;
+   for(i = 0; i < self->segments->len; i++)
+   {
+      const Segment *seg = &g_array_index(self->segments, Segment, i);
+      if(t >= seg->start && t < seg->end)
+         return seg;
+   }
+   return NULL;
+}
+
+/* the free span around t, up to now */
+static gboolean
+hamster_timeline_gap_at(HamsterTimeline *self, time_t t, time_t *start,
+                        time_t *end)
+{
+   guint i;
+
+   *start = self->from;
+   *end = MIN(self->now, self->to);
+   if(t >= *end)
+      return FALSE;
+   for(i = 0; i < self->segments->len; i++)
+   {
+      const Segment *seg = &g_array_index(self->segments, Segment, i);
+      if(t >= seg->start && t < seg->end)
+         return FALSE;
+      if(seg->end <= t)
+         *start = MAX(*start, seg->end);
+      if(seg->start > t)
+         *end = MIN(*end, seg->start);
+   }
+   return *end > *start;
+}
+
+static gboolean
+hamster_timeline_query_tooltip(GtkWidget *widget, gint x, gint y,
+                               gboolean keyboard_mode, GtkTooltip *tooltip)
+{
+   HamsterTimeline *self = HAMSTER_TIMELINE(widget);
+   time_t t = hamster_timeline_time(self, x,
+         gtk_widget_get_allocated_width(widget));
+   const Segment *seg = hamster_timeline_segment_at(self, t);
+   gchar from[8], to[8], *text;
+   time_t start, end;
+
+   if(seg)
+   {
+      hamster_timeline_format(from, sizeof(from), seg->start);
+      hamster_timeline_format(to, sizeof(to), seg->end);
+      text = g_strdup_printf("%s - %s  %s@%s", from, to, seg->name,
+            seg->category);
+   }
+   else if(hamster_timeline_gap_at(self, t, &start, &end))
+   {
+      hamster_timeline_format(from, sizeof(from), start);
+      hamster_timeline_format(to, sizeof(to), end);
+      text = g_strdup_printf(_("%s - %s untracked, click to fill in"),
+            from, to);
+   }
+   else
+      return FALSE;
+
+   gtk_tooltip_set_text(tooltip, text);
+   g_free(text);
+   return TRUE;
+}
+
+static gboolean
+hamster_timeline_button_press(GtkWidget *widget, GdkEventButton *evt)
+{
+   HamsterTimeline *self = HAMSTER_TIMELINE(widget);
+   time_t start, end;
+
+   if(evt->button == 1 && hamster_timeline_gap_at(self,
+            hamster_timeline_time(self, (gint)evt->x,
+               gtk_widget_get_allocated_width(widget)), &start, &end))
+   {
+      g_signal_emit(self, timeline_signals[GAP_CLICKED], 0,
+            (gint)start, (gint)end);
+      return TRUE;
+   }
+   return FALSE;
+}
+
+static void
+hamster_timeline_finalize(GObject *object)
+{
+   HamsterTimeline *self = HAMSTER_TIMELINE(object);
+
+   if(self->cache)
+      cairo_surface_destroy(self->cache);
+   g_array_free(self->segments, TRUE);
+   g_array_free(self->pending, TRUE);
+
+   (*G_OBJECT_CLASS(hamster_timeline_parent_class)->finalize) (object);
+}
+
+static void
+hamster_timeline_class_init(HamsterTimelineClass *klass)
+{
+   GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+   GtkWidgetClass *widget_class = GTK_WIDGET_CLASS(klass);
+
+   gobject_class->finalize = hamster_timeline_finalize;
+   widget_class->draw = hamster_timeline_draw;
+   widget_class->query_tooltip = hamster_timeline_query_tooltip;
+   widget_class->button_press_event = hamster_timeline_button_press;
+
+   timeline_signals[GAP_CLICKED] = g_signal_new("gap-clicked",
+         G_TYPE_FROM_CLASS(klass),
+         G_SIGNAL_RUN_LAST,
+         0, NULL, NULL, NULL,
+         G_TYPE_NONE, 2, G_TYPE_INT, G_TYPE_INT);
+}
+
+static void
+hamster_timeline_init(HamsterTimeline *self)
+{
+   self->segments = g_array_new(FALSE, TRUE, sizeof(Segment));
+   self->pending = g_array_new(FALSE, TRUE, sizeof(Segment));
+   g_array_set_clear_func(self->segments, (GDestroyNotify)segment_clear);
+   g_array_set_clear_func(self->pending, (GDestroyNotify)segment_clear);
+   self->from = 0;
+   self->to = DAY_SECONDS;
+   self->dirty = TRUE;
+
+   gtk_widget_set_size_request(GTK_WIDGET(self), -1, STRIP_HEIGHT);
+   gtk_widget_set_has_tooltip(GTK_WIDGET(self), TRUE);
+   gtk_widget_add_events(GTK_WIDGET(self), GDK_BUTTON_PRESS_MASK);
+}
+
+GtkWidget*
+hamster_timeline_new(void)
+{
+   return GTK_WIDGET(g_object_new(HAMSTER_TYPE_TIMELINE, NULL));
+}
+
+void
+hamster_timeline_clear(HamsterTimeline *self)
+{
+   g_return_if_fail(HAMSTER_IS_TIMELINE(self));
+   g_array_set_size(self->pending, 0);
+}
+
+void
+hamster_timeline_add(HamsterTimeline *self, gint id, time_t startTime,
+                     time_t endTime, const gchar *name, const gchar *category)
+{
+   Segment seg;
+
+   g_return_if_fail(HAMSTER_IS_TIMELINE(self));
+   seg.id = id;
+   seg.start = startTime;
+   seg.end = endTime;
+   seg.running = endTime == 0;
+   seg.name = g_strdup(name);
+   seg.category = g_strdup(category);
+   g_array_append_val(self->pending, seg);
+}
+
+/* TRUE if pending equals segments except for a longer running fact */
+static gboolean
+hamster_timeline_grows_only(HamsterTimeline *self, time_t *oldEnd)
+{
+   const Segment *a, *b;
+   guint i, n = self->segments->len;
+
+   if(self->dirty || !self->cache || n == 0 || n != self->pending->len)
+      return FALSE;
+   for(i = 0; i < n; i++)
+   {
+      a = &g_array_index(self->segments, Segment, i);
+      b = &g_array_index(self->pending, Segment, i);
+      if(a->id != b->id || a->start != b->start || a->running != b->running
+            || (!a->running && a->end != b->end)
+            || g_strcmp0(a->category, b->category))
+         return FALSE;
+   }
+   a = &g_array_index(self->segments, Segment, n - 1);
+   b = &g_array_index(self->pending, Segment, n - 1);
+   if(!a->running || b->end < a->end || b->end > self->to)
+      return FALSE;
+   *oldEnd = a->end;
+   return TRUE;
+}
+
+static void
+hamster_timeline_window(HamsterTimeline *self)
+{
+   time_t day = self->now - self->now % DAY_SECONDS;
+   time_t from = day + DAY_FIRST_HOUR * HOUR_SECONDS;
+   time_t to = day + DAY_LAST_HOUR * HOUR_SECONDS;
+   guint i;
+
+   for(i = 0; i < self->segments->len; i++)
+   {
+      const Segment *seg = &g_array_index(self->segments, Segment, i);
+      from = MIN(from, seg->start);
+      to = MAX(to, seg->end);
+   }
+   self->from = from - from % HOUR_SECONDS;
+   self->to = to + (HOUR_SECONDS - to % HOUR_SECONDS) % HOUR_SECONDS;
+   if(self->to <= self->from)
+      self->to = self->from + HOUR_SECONDS;
+}
+
+void
+hamster_timeline_commit(HamsterTimeline *self, time_t now)
+{
+   GtkWidget *widget = GTK_WIDGET(self);
+   GArray *swap;
+   time_t oldEnd;
+   guint i;
+
+   g_return_if_fail(HAMSTER_IS_TIMELINE(self));
+   for(i = 0; i < self->pending->len; i++)
+   {
+      Segment *seg = &g_array_index(self->pending, Segment, i);
+      if(seg->running)
+         seg->end = MAX(now, seg->start);
+   }
+   self->now = now;
+
+   if(hamster_timeline_grows_only(self, &oldEnd))
+   {
+      Segment *tip = &g_array_index(self->pending, Segment,
+            self->pending->len - 1);
+      cairo_t *cr = cairo_create(self->cache);
+      gint x0, x1;
+
+      hamster_timeline_paint_span(self, cr, tip, oldEnd, tip->end,
+            self->cacheWidth, self->cacheHeight);
+      cairo_destroy(cr);
+      x0 = (gint)floor(hamster_timeline_x(self, oldEnd, self->cacheWidth)) - 1;
+      x1 = (gint)ceil(hamster_timeline_x(self, tip->end, self->cacheWidth)) + 1;
+      gtk_widget_queue_draw_area(widget, x0, 0, x1 - x0, self->cacheHeight);
+   }
+   else
+      self->dirty = TRUE;
+
+   swap = self->segments;
+   self->segments = self->pending;
+   self->pending = swap;
+   g_array_set_size(self->pending, 0);
+
+   if(self->dirty)
+   {
+      hamster_timeline_window(self);
+      gtk_widget_queue_draw(widget);
+   }
+}
@@ -0,0 +1,75 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <time.h>
+#include <gtk/gtk.h>
+
+#define HAMSTER_TYPE_TIMELINE             (hamster_timeline_get_type ())
+#define HAMSTER_TIMELINE(obj)             (G_TYPE_CHECK_INSTANCE_CAST ((obj), HAMSTER_TYPE_TIMELINE, HamsterTimeline))
+#define HAMSTER_TIMELINE_CLASS(obj)       (G_TYPE_CHECK_CLASS_CAST ((obj), HAMSTER_TYPE_TIMELINE, HamsterTimelineClass))
+#define HAMSTER_IS_TIMELINE(obj)          (G_TYPE_CHECK_INSTANCE_TYPE ((obj), HAMSTER_TYPE_TIMELINE))
+
+typedef struct _HamsterTimeline            HamsterTimeline;
+typedef struct _HamsterTimelineClass       HamsterTimelineClass;
+
+/*
+ * Today as a strip of colored segments, one per fact. The strip is painted
+ * into a cached surface; when a commit differs from the previous one only
+ * by the running fact getting longer, just the new tip is painted.
+ *
+ * Signals:
+ *   gap-clicked (gint start, gint end)  a free span was clicked
+ */
+struct _HamsterTimeline
+{
+    GtkDrawingArea parent;
+
+    /* private */
+    GArray *segments;      /* what is painted */
+    GArray *pending;       /* being collected until commit */
+    cairo_surface_t *cache;
+    gint cacheWidth;
+    gint cacheHeight;
+    gboolean dirty;
+    time_t from;           /* left edge */
+    time_t to;             /* right edge */
+    time_t now;
+};
+
+struct _HamsterTimelineClass
+{
+    GtkDrawingAreaClass parent_class;
+};
+
+GType
+hamster_timeline_get_type(void);
+
+GtkWidget*
+hamster_timeline_new(void);
+
+void
+hamster_timeline_clear(HamsterTimeline *self);
+
+/* endTime 0 is the running fact, it ends at now */
+void
+hamster_timeline_add(HamsterTimeline *self, gint id, time_t startTime,
+                     time_t endTime, const gchar *name, const gchar *category);
+
+void
+hamster_timeline_commit(HamsterTimeline *self, time_t now);
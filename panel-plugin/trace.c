@@ -0,0 +1,297 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+#include <string.h>
+#include <gio/gio.h>
+#include <libxfce4util/libxfce4util.h>
+#include "trace.h"
+
+#define TRACE_HEADER "# hamster trace 1"
+#define TRACE_PATH "/org/gnome/Hamster"
+#define TRACE_FIELDS 8
+
+struct _HamsterTrace
+{
+   GMutex lock;               /* the filter runs on GDBus' worker thread */
+   GDBusConnection *bus;
+   guint filter;
+   GOutputStream *out;        /* NULL once closed */
+   GHashTable *pending;       /* serials of recorded calls */
+   gint64 started;
+   GString *line;
+};
+
+static const gchar *trace_kinds[] =
+{
+   "call", "return", "error", "signal"
+};
+
+static gboolean
+trace_is_hamster(GDBusMessage *message)
+{
+   const gchar *path = g_dbus_message_get_path(message);
+
+   return path && g_str_has_prefix(path, TRACE_PATH);
+}
+
+static void
+trace_field(GString *line, const gchar *value)
+{
+   g_string_append(line, value && *value ? value : "-");
+   g_string_append_c(line, '\t');
+}
+
+/* with the lock held */
+static void
+trace_write(HamsterTrace *self, GDBusMessage *message, HamsterTraceKind kind)
+{
+   GVariant *body = g_dbus_message_get_body(message);
+   GError *error = NULL;
+
+   g_string_printf(self->line, "%" G_GINT64_FORMAT "\t%s\t%u\t%u\t",
+         g_get_monotonic_time() - self->started, trace_kinds[kind],
+         g_dbus_message_get_serial(message),
+         g_dbus_message_get_reply_serial(message));
+   trace_field(self->line, g_dbus_message_get_path(message));
+   trace_field(self->line, g_dbus_message_get_interface(message));
+   trace_field(self->line, kind == HAMSTER_TRACE_ERROR
+         ? g_dbus_message_get_error_name(message)
+         : g_dbus_message_get_member(message));
+   if(body)
+      g_variant_print_string(body, self->line, TRUE);
+   else
+      g_string_append_c(self->line, '-');
+   g_string_append_c(self->line, '\n');
+   if(!g_output_stream_write_all(self->out, self->line->str, self->line->len,
+            NULL, NULL, &error))
+   {
+      g_warning("stopped recording: %s", error->message);
+      g_error_free(error);
+      g_clear_object(&self->out);
+   }
+}
+
+/* with the lock held */
+static void
+trace_record(HamsterTrace *self, GDBusMessage *message, gboolean incoming)
+{
+   GDBusMessageType type = g_dbus_message_get_message_type(message);
+   gpointer serial;
+
+   if(!incoming && type == G_DBUS_MESSAGE_TYPE_METHOD_CALL
+         && trace_is_hamster(message))
+   {
+      serial = GUINT_TO_POINTER(g_dbus_message_get_serial(message));
+      g_hash_table_add(self->pending, serial);
+      trace_write(self, message, HAMSTER_TRACE_CALL);
+   }
+   else if(incoming && type == G_DBUS_MESSAGE_TYPE_SIGNAL
+         && trace_is_hamster(message))
+      trace_write(self, message, HAMSTER_TRACE_SIGNAL);
+   else if(incoming && (type == G_DBUS_MESSAGE_TYPE_METHOD_RETURN
+            || type == G_DBUS_MESSAGE_TYPE_ERROR))
+   {
+      serial = GUINT_TO_POINTER(g_dbus_message_get_reply_serial(message));
+      if(g_hash_table_remove(self->pending, serial))
+         trace_write(self, message, type == G_DBUS_MESSAGE_TYPE_ERROR
+               ? HAMSTER_TRACE_ERROR : HAMSTER_TRACE_RETURN);
+   }
+}
+
+static GDBusMessage*
+trace_cb_filter(GDBusConnection *bus, GDBusMessage *message,
+                gboolean incoming, HamsterTrace *self)
+{
+   g_mutex_lock(&self->lock);
+   if(self->out)
+      trace_record(self, message, incoming);
+   g_mutex_unlock(&self->lock);
+   return message;
+}
+
+/* once GDBus is done with the filter */
+static void
+trace_destroy(HamsterTrace *self)
+{
+   g_hash_table_unref(self->pending);
+   g_string_free(self->line, TRUE);
+   g_object_unref(self->bus);
+   g_mutex_clear(&self->lock);
+   g_free(self);
+}
+
+HamsterTrace*
+hamster_trace_new(GDBusConnection *bus, const gchar *path, GError **error)
+{
+   GFile *file = g_file_new_for_path(path);
+   GFileOutputStream *raw;
+   GConverter *gzip;
+   HamsterTrace *self;
+
+   raw = g_file_replace(file, NULL, FALSE, G_FILE_CREATE_PRIVATE, NULL, error);
+   g_object_unref(file);
+   if(!raw)
+      return NULL;
+   self = g_new0(HamsterTrace, 1);
+   g_mutex_init(&self->lock);
+   self->bus = g_object_ref(bus);
+   gzip = G_CONVERTER(g_zlib_compressor_new(G_ZLIB_COMPRESSOR_FORMAT_GZIP, -1));
+   self->out = g_converter_output_stream_new(G_OUTPUT_STREAM(raw), gzip);
+   g_object_unref(gzip);
+   g_object_unref(raw);
+   self->pending = g_hash_table_new(NULL, NULL);
+   self->line = g_string_sized_new(256);
+   self->started = g_get_monotonic_time();
+   g_output_stream_write_all(self->out, TRACE_HEADER "\n",
+         strlen(TRACE_HEADER "\n"), NULL, NULL, NULL);
+   self->filter = g_dbus_connection_add_filter(bus,
+         (GDBusMessageFilterFunction)trace_cb_filter, self,
+         (GDestroyNotify)trace_destroy);
+   DBG("recording to %s", path);
+   return self;
+}
+
+void
+hamster_trace_free(HamsterTrace *self)
+{
+   GError *error = NULL;
+
+   if(!self)
+      return;
+   g_mutex_lock(&self->lock);
+   if(self->out && !g_output_stream_close(self->out, NULL, &error))
+   {
+      g_warning("recording: %s", error->message);
+      g_error_free(error);
+   }
+   g_clear_object(&self->out);
+   g_mutex_unlock(&self->lock);
+   g_dbus_connection_remove_filter(self->bus, self->filter);
+}
+
+/* Reading */
+static void
+trace_entry_free(HamsterTraceEntry *entry)
+{
+   g_free(entry->path);
+   g_free(entry->interface);
+   g_free(entry->member);
+   if(entry->body)
+      g_variant_unref(entry->body);
+   g_free(entry);
+}
+
+static gchar*
+trace_field_dup(const gchar *field)
+{
+   return strcmp(field, "-") ? g_strdup(field) : NULL;
+}
+
+static HamsterTraceEntry*
+trace_parse(const gchar *line, GError **error)
+{
+   gchar **f = g_strsplit(line, "\t", TRACE_FIELDS);
+   HamsterTraceEntry *entry = NULL;
+   GVariant *body = NULL;
+   guint kind;
+
+   if(g_strv_length(f) != TRACE_FIELDS)
+      goto bad;
+   for(kind = 0; kind < G_N_ELEMENTS(trace_kinds); kind++)
+      if(!strcmp(f[1], trace_kinds[kind]))
+         break;
+   if(kind == G_N_ELEMENTS(trace_kinds))
+      goto bad;
+   if(strcmp(f[7], "-")
+         && !(body = g_variant_parse(NULL, f[7], NULL, NULL, error)))
+      goto done;
+
+   entry = g_new0(HamsterTraceEntry, 1);
+   entry->time = g_ascii_strtoll(f[0], NULL, 10);
+   entry->kind = kind;
+   entry->serial = g_ascii_strtoull(f[2], NULL, 10);
+   entry->replySerial = g_ascii_strtoull(f[3], NULL, 10);
+   entry->path = trace_field_dup(f[4]);
+   entry->interface = trace_field_dup(f[5]);
+   entry->member = trace_field_dup(f[6]);
+   entry->body = body ? g_variant_ref_sink(body) : NULL;
+   goto done;
+
+bad:
+   g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+         "not a trace line");
+done:
+   g_strfreev(f);
+   return entry;
+}
+
+GPtrArray*
+hamster_trace_load(const gchar *path, GError **error)
+{
+   GFile *file = g_file_new_for_path(path);
+   GFileInputStream *raw = g_file_read(file, NULL, error);
+   GConverter *gunzip;
+   GInputStream *in;
+   GDataInputStream *data;
+   GPtrArray *entries = NULL;
+   GError *lineError = NULL;
+   gchar *line;
+   guint number = 0;
+
+   g_object_unref(file);
+   if(!raw)
+      return NULL;
+   gunzip = G_CONVERTER(g_zlib_decompressor_new(G_ZLIB_COMPRESSOR_FORMAT_GZIP));
+   in = g_converter_input_stream_new(G_INPUT_STREAM(raw), gunzip);
+   data = g_data_input_stream_new(in);
+   g_object_unref(gunzip);
+   g_object_unref(in);
+   g_object_unref(raw);
+
+   entries = g_ptr_array_new_with_free_func((GDestroyNotify)trace_entry_free);
+   while((line = g_data_input_stream_read_line_utf8(data, NULL, NULL,
+               &lineError)))
+   {
+      HamsterTraceEntry *entry;
+
+      number++;
+      if(*line == '#' || !*line)
+      {
+         g_free(line);
+         continue;
+      }
+      entry = trace_parse(line, &lineError);
+      g_free(line);
+      if(!entry)
+         break;
+      g_ptr_array_add(entries, entry);
+   }
+   g_object_unref(data);
+   if(lineError)
+   {
+      g_set_error(error, lineError->domain, lineError->code, "%s:%u: %s",
+            path, number, lineError->message);
+      g_error_free(lineError);
+      g_ptr_array_unref(entries);
+      return NULL;
+   }
+   return entries;
+}
@@ -0,0 +1,69 @@
+/*  xfce4-hamster-plugin
+ *
+ *  Copyright (c) 2014 Hakan Erduman <smultimeter@gmail.com>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <gio/gio.h>
+
+/*
+ * Hamster's D-Bus traffic as the plugin saw it, to be served again by
+ * hamster-replay. With XFCE4_HAMSTER_RECORD=file the D-Bus backend writes
+ * every call to an object under /org/gnome/Hamster, its reply and every
+ * signal from there into a gzipped file, one line each:
+ *
+ *   usec  kind  serial  reply-serial  path  interface  member  body
+ *
+ * separated by tabs. usec counts from the start of the recording, kind is
+ * call, return, error or signal, member is the error name for errors and
+ * body is the g_variant_print()ed tuple with types. Empty fields are "-".
+ */
+
+#define HAMSTER_RECORD_ENV "XFCE4_HAMSTER_RECORD"
+
+typedef struct _HamsterTrace HamsterTrace;
+
+typedef enum
+{
+   HAMSTER_TRACE_CALL,
+   HAMSTER_TRACE_RETURN,
+   HAMSTER_TRACE_ERROR,
+   HAMSTER_TRACE_SIGNAL
+} HamsterTraceKind;
+
+typedef struct _HamsterTraceEntry
+{
+   gint64 time;               /* usec since the recording started */
+   HamsterTraceKind kind;
+   guint32 serial;
+   guint32 replySerial;       /* the call answered, 0 for others */
+   gchar *path;               /* NULL for replies */
+   gchar *interface;
+   gchar *member;             /* or the error name */
+   GVariant *body;            /* NULL if empty */
+} HamsterTraceEntry;
+
+/* starts recording what passes bus, until freed */
+HamsterTrace*
+hamster_trace_new(GDBusConnection *bus, const gchar *path, GError **error);
+
+/* flushes and closes the file */
+void
+hamster_trace_free(HamsterTrace *self);
+
+/* a recording read back, HamsterTraceEntry* in file order */
+GPtrArray*
+hamster_trace_load(const gchar *path, GError **error);
@@ -18,32 +18,57 @@
 
 #include "util.h"
 
-fact *
-fact_new(GVariant *in)
+#define HAMSTER_SCHEMA "org.gnome.hamster"
+#define DAY_MINUTES (24 * 60)
+
+time_t
+util_local_now(void)
+{
+   GDateTime *dt = g_date_time_new_now_local();
+   time_t now = g_date_time_to_unix(dt)
+      + g_date_time_get_utc_offset(dt) / G_TIME_SPAN_SECOND;
+   g_date_time_unref(dt);
+   return now;
+}
+
+gint
+util_day_start(void)
 {
-   //bzero(out, sizeof(fact));
-   fact *out = g_new0(fact, 1);
-   g_variant_get(in, "(iiissisasii)",
-         &out->id,
-         &out->startTime,
-         &out->endTime,
-         &out->description,
-         &out->name,
-         &out->activityId,
-         &out->category,
-         &out->tags,
-         &out->date,
-         &out->seconds
-         );
-   return out;
+   GSettingsSchemaSource *source = g_settings_schema_source_get_default();
+   GSettingsSchema *schema;
+   GSettings *settings;
+   gint minutes = 0;
+
+   /* g_settings_new() aborts on a schema that isn't there */
+   schema = source
+      ? g_settings_schema_source_lookup(source, HAMSTER_SCHEMA, TRUE) : NULL;
+   if(!schema)
+      return 0;
+   if(g_settings_schema_has_key(schema, "day-start-minutes"))
+   {
+      settings = g_settings_new_full(schema, NULL, NULL);
+      minutes = g_settings_get_int(settings, "day-start-minutes");
+      g_object_unref(settings);
+   }
+   g_settings_schema_unref(schema);
+   return CLAMP(minutes, 0, DAY_MINUTES - 1) * 60;
 }
 
 void
-fact_free(fact *in)
+util_notify(const gchar *summary, const gchar *body)
 {
-   g_free(in->description);
-   g_free(in->name);
-   g_free(in->category);
-   //g_free(in->tags); // TODO: fix leak
-   g_free(in);
+   GDBusConnection *bus = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, NULL);
+
+   if(!bus)
+      return;
+   /* fire and forget, a missing notification daemon is not an error */
+   g_dbus_connection_call(bus,
+         "org.freedesktop.Notifications",
+         "/org/freedesktop/Notifications",
+         "org.freedesktop.Notifications",
+         "Notify",
+         g_variant_new("(susssasa{sv}i)", "Hamster", 0,
+            "org.gnome.Hamster.GUI", summary, body, NULL, NULL, -1),
+         NULL, G_DBUS_CALL_FLAGS_NONE, -1, NULL, NULL, NULL);
+   g_object_unref(bus);
 }
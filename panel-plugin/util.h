@@ -19,23 +19,17 @@
 #pragma once
 #include <glib.h>
 #include <gtk/gtk.h>
+#include "fact.h"
 
-typedef struct _fact
-{
-   int id; // 0
-   time_t startTime; // 1
-   time_t endTime; // 2
-   char *description; // 3
-   char *name; // 4
-   int activityId; // 5
-   char *category; // 6
-   char **tags; // 7
-   time_t date; // 8
-   int seconds; // 9
-}fact;
+/* wall clock time as hamster stores it: local time in epoch seconds */
+time_t
+util_local_now(void);
 
-fact*
-fact_new(GVariant *in);
+/* seconds after midnight at which hamster's day starts, its
+ * day-start-minutes setting; 0 when hamster's settings aren't installed */
+gint
+util_day_start(void);
 
+/* desktop notification via org.freedesktop.Notifications */
 void
-fact_free(fact *in);
+util_notify(const gchar *summary, const gchar *body);
@@ -28,11 +28,26 @@
 #include <xfconf/xfconf.h>
 #include "view.h"
 #include "button.h"
-#include "hamster.h"
-#include "windowserver.h"
+#include "backend.h"
 #include "util.h"
+#include "parser.h"
+#include "timeline.h"
+#include "scheduler.h"
+#include "export.h"
+#include "import.h"
+#include "search.h"
+#include "model.h"
+#include "factlist.h"
+#include "autoswitch.h"
+#include "latency.h"
+#include "snapshot.h"
+#include "editor.h"
+#include "idle.h"
+#include "label.h"
 #include "settings.h"
 
+#define DAY_SECONDS (24 * 60 * 60)
+
 struct _HamsterView
 {
     /* plugin */
@@ -43,34 +58,70 @@ struct _HamsterView
     GtkWidget                 *popup;
     GtkWidget                 *vbx;
     GtkWidget                 *entry;
+    GtkWidget                 *preview;
     GtkWidget                 *treeview;
     GtkWidget                 *summary;
+    GtkWidget                 *timeline;
+    GtkWidget                 *spinner;    /* revalidating what is shown */
+    HamsterEditor             *editor;     /* in place of the treeview */
+    GtkWidget                 *resume;     /* offers idleStopped */
     gboolean                  alive;
+    gboolean                  tagging;
+    gchar                     *tagPrefix;
     guint                     sourceTimeout;
 
     /* model */
     GtkListStore              *storeFacts;
     GtkListStore              *storeActivities;
-    Hamster                   *hamster;
-    WindowServer              *windowserver;
+    GtkListStore              *storeTags;
+    HamsterBackend            *backend;
+    HamsterScheduler          *scheduler;
+    HamsterSearch             *search;     /* created by the first search */
+    HamsterModelBuilder       *builder;
+    HamsterLatency            *latency;
+    HamsterSnapshot           *snapshot;   /* replies for the next start */
+    HamsterAutoSwitch         *autoswitch;
+    HamsterIdle               *idle;
+    HamsterLabel              *label;      /* compiled settings.label */
+    gboolean                  away;
+    gchar                     *idleStopped;/* stopped when we went away */
+    time_t                    idleSince;
+    HamsterModel              *facts;      /* what the fact list shows */
+    GCancellable              *switches;   /* AddFacts in flight */
+    gint                      switching;   /* how many, facts is a guess */
+    guint                     switchesSent;/* ever, counts generations */
+    guint                     fetchSwitches;/* switchesSent at fetchStamp */
+    guint                     factsSwitches;/* and for the facts pushed last */
+    GCancellable              *revalidate; /* today's facts in flight */
+    GCancellable              *imports;    /* cancelled when we go */
+    gint64                    fetchStamp;  /* when that request was sent */
+    gint64                    factsStamp;  /* when facts was requested */
+    gint64                    changedStamp;/* last FactsChanged */
+    gint64                    snapshotStamp;/* when the stored facts were requested */
+    time_t                    snapshotDay; /* and on which day */
+    GtkListStore              *storeResults;
+    GHashTable                *targets;    /* casefolded category -> seconds */
+    gint                      target;      /* all categories, seconds */
+    GHashTable                *reached;    /* categories notified today */
+    gboolean                  overallReached;
+    time_t                    reachedDay;
 
     /* config */
     XfconfChannel             *channel;
-    gboolean                  donthide;
-    gboolean                  tooltips;
+    HamsterSettings           settings;
 };
 
-enum
-{
-   TIME_SPAN,
-   TITLE,
-   DURATION,
-   BTNEDIT,
-   BTNCONT,
-   ID,
-   CATEGORY, 
-   NUM_COL
-};
+static void
+hview_completion_mode_update(HamsterView *view);
+
+static void
+hview_search_update(HamsterView *view, const gchar *query);
+
+static void
+hview_button_update(HamsterView *view);
+
+static void
+hview_facts_apply(HamsterView *view, HamsterModel *model);
 
 /* Button */
 static void
@@ -79,6 +130,8 @@ hview_popup_hide(HamsterView *view)
     /* untoggle the button */
     gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(view->button), FALSE);
 
+    hamster_editor_close(view->editor);
+
     /* empty entry */
     if(view->entry)
     {
@@ -98,59 +151,308 @@ hview_popup_hide(HamsterView *view)
 static void
 hview_cb_show_overview(GtkWidget *widget, HamsterView *view)
 {
-   window_server_call_overview_sync(view->windowserver, NULL, NULL);
-   if(!view->donthide)
+   hamster_backend_overview(view->backend, NULL);
+   if(!view->settings.donthide)
       hview_popup_hide(view);
 }
 
+static void
+hview_stop_tracking(HamsterView *view, time_t endTime)
+{
+   hamster_latency_input(view->latency, HAMSTER_LATENCY_STOP);
+   hamster_backend_stop_tracking(view->backend, endTime, NULL);
+}
+
+/* 0 is now as the daemon's clock has it */
 static void
 hview_cb_stop_tracking(GtkWidget *widget, HamsterView *view)
 {
-   time_t now = time(NULL);
-   struct tm *tmlt = localtime(&now);
-   now -= timezone;
-   if(tmlt->tm_isdst)
-      now += (daylight * 3600);
-   GVariant *stopTime = g_variant_new_int32(now);
-   GVariant *var = g_variant_new_variant(stopTime);
-   hamster_call_stop_tracking_sync(view->hamster, var, NULL, NULL);
-   if(!view->donthide)
+   hview_stop_tracking(view, 0);
+   if(!view->settings.donthide)
       hview_popup_hide(view);
 }
 
+/* Switching */
+
+/* the category hamster would pick, from the completion store: its
+ * activities come most recently used first. Only the same name counts,
+ * casefolded, and the name stays as typed; NULL when there is none or it
+ * has no category */
+static gchar*
+hview_category_lookup(HamsterView *view, const gchar *name)
+{
+   GtkTreeModel *model = GTK_TREE_MODEL(view->storeActivities);
+   gchar *key = g_utf8_casefold(name, -1);
+   gchar *category = NULL;
+   GtkTreeIter iter;
+   gboolean valid;
+
+   for(valid = gtk_tree_model_get_iter_first(model, &iter);
+         valid && !category;
+         valid = gtk_tree_model_iter_next(model, &iter))
+   {
+      gchar *activity;
+      gtk_tree_model_get(model, &iter, 0, &activity, -1);
+      if(!g_strcmp0(activity, key))
+         gtk_tree_model_get(model, &iter, 1, &category, -1);
+      g_free(activity);
+   }
+   g_free(key);
+   /* "name@" would not parse */
+   if(category && !*category)
+      g_clear_pointer(&category, g_free);
+   return category;
+}
+
 static void
-hview_cb_add_earlier_activity(GtkWidget *widget, HamsterView *view)
+hview_cb_switched(GObject *source, GAsyncResult *result, HamsterView *view)
+{
+   GError *error = NULL;
+   gint id = 0;
+
+   if(!hamster_backend_add_fact_finish(result, &id, &error) || id <= 0)
+   {
+      /* cancelled means we are gone */
+      if(g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+      {
+         g_error_free(error);
+         return;
+      }
+      util_notify(_("Could not switch"),
+            error ? error->message : _("Hamster did not take the activity."));
+      g_clear_error(&error);
+   }
+   DBG("switched [%d], %d more in flight", id, view->switching - 1);
+   /* what hamster has now replaces the guess, or takes it back */
+   if(--view->switching == 0)
+      hview_button_update(view);
+}
+
+/*
+ * One AddFact, without a lookup first: the category comes from the
+ * completion store and the label and list show the switch before the
+ * daemon answers. Facts asked for before it was sent are dropped, the
+ * last switch answering asks again.
+ */
+static void
+hview_switch(HamsterView *view, fact_spec *spec)
+{
+   time_t now = util_local_now();
+   gchar *text;
+
+   if(!spec->category)
+      spec->category = hview_category_lookup(view, spec->name);
+   text = fact_spec_to_string(spec);
+   DBG("switching to %s", text);
+   hamster_latency_input(view->latency, HAMSTER_LATENCY_SWITCH);
+   view->switching++;
+   view->switchesSent++;
+   hamster_backend_add_fact_async(view->backend, text, spec->startTime,
+         spec->endTime, view->switches,
+         (GAsyncReadyCallback)hview_cb_switched, view);
+   g_free(text);
+
+   /* past facts are not guessed at */
+   if(spec->endTime || spec->startTime > now)
+      return;
+   if(view->revalidate)
+   {
+      g_cancellable_cancel(view->revalidate);
+      g_clear_object(&view->revalidate);
+   }
+   {
+      fact *next = g_new0(fact, 1);
+      next->startTime = spec->startTime ? spec->startTime : now;
+      next->date = next->startTime - next->startTime % DAY_SECONDS;
+      next->seconds = now - next->startTime;
+      next->name = g_strdup(spec->name);
+      next->category = g_strdup(spec->category ? spec->category : "");
+      next->description = g_strdup(spec->description ? spec->description : "");
+      next->tags = g_strdupv(spec->tags);
+      hview_facts_apply(view, hamster_model_switch(view->facts, next));
+   }
+}
+
+/* for the fact syntax strings of the completion, list and rules */
+static void
+hview_switch_text(HamsterView *view, const gchar *text)
+{
+   fact_spec spec;
+
+   if(fact_spec_parse(&spec, text, util_local_now(), NULL))
+   {
+      hview_switch(view, &spec);
+      fact_spec_clear(&spec);
+      return;
+   }
+   /* hamster may still make sense of it */
+   hamster_latency_input(view->latency, HAMSTER_LATENCY_SWITCH);
+   view->switching++;
+   view->switchesSent++;
+   hamster_backend_add_fact_async(view->backend, text, 0, 0, view->switches,
+         (GAsyncReadyCallback)hview_cb_switched, view);
+}
+
+/* the resume button is there while something stopped by idleness waits */
+static void
+hview_resume_update(HamsterView *view)
+{
+   gchar *label;
+
+   if(!view->resume)
+      return;
+   if(!view->idleStopped || view->away)
+   {
+      gtk_widget_hide(view->resume);
+      return;
+   }
+   label = g_strdup_printf(_("Resume %s, stopped at %02d:%02d"),
+         view->idleStopped, (gint)(view->idleSince % DAY_SECONDS) / 3600,
+         (gint)(view->idleSince % 3600) / 60);
+   gtk_button_set_label(GTK_BUTTON(view->resume), label);
+   gtk_widget_set_halign(gtk_bin_get_child(GTK_BIN(view->resume)),
+         GTK_ALIGN_START);
+   gtk_widget_show(view->resume);
+   g_free(label);
+}
+
+static void
+hview_resume_clear(HamsterView *view)
 {
-   /* pass empty variants?
-   GVariant *dummy = g_variant_new_maybe(G_VARIANT_TYPE_VARIANT, NULL);
-   GVariant *var = g_variant_new_variant(dummy);
-   window_server_call_edit_sync(view->windowserver, var, NULL, NULL);
-   */
-   {
-     GVariant *_ret;
-     _ret = g_dbus_proxy_call_sync (G_DBUS_PROXY (view->windowserver),
-       "edit",
-       g_variant_new ("()"),
-       G_DBUS_CALL_FLAGS_NONE,
-       -1,
-       NULL,
-       NULL);
-     if (_ret == NULL)
-       goto _out;
-     g_variant_get (_ret,
-                    "()");
-     g_variant_unref (_ret);
-   }
-   _out:
-   if(!view->donthide)
+   g_free(view->idleStopped);
+   view->idleStopped = NULL;
+   hview_resume_update(view);
+}
+
+static void
+hview_cb_resume(GtkWidget *widget, HamsterView *view)
+{
+   if(!view->idleStopped)
+      return;
+   DBG("resumed: %s", view->idleStopped);
+   hview_switch_text(view, view->idleStopped);
+   hview_resume_clear(view);
+   if(!view->settings.donthide)
       hview_popup_hide(view);
 }
 
+/* away: stop what runs as of when idleness began; back: offer it again */
+static void
+hview_cb_idle(gboolean idle, time_t since, HamsterView *view)
+{
+   view->away = idle;
+   if(idle)
+   {
+      const fact *running;
+      fact_spec spec = { 0 };
+
+      if(!view->facts || !view->facts->running)
+         return;
+      running = view->facts->running->fact;
+      spec.name = running->name;
+      spec.category = running->category;
+      spec.description = running->description;
+      spec.tags = running->tags;
+      g_free(view->idleStopped);
+      view->idleStopped = fact_spec_to_string(&spec);
+      /* never before it started */
+      view->idleSince = MAX(since, running->startTime);
+      DBG("idle, stopping %s at %ld", view->idleStopped,
+            (long)view->idleSince);
+      hview_stop_tracking(view, view->idleSince);
+   }
+   else if(view->idleStopped)
+   {
+      gchar *body = g_strdup_printf(_("%s was stopped while you were away."),
+            view->idleStopped);
+      util_notify(_("Welcome back"), body);
+      g_free(body);
+   }
+   hview_resume_update(view);
+}
+
+/* the tracker's window is only started if the editor can't do it */
+static void
+hview_fact_edit(HamsterView *view, gint id)
+{
+   GError *error = NULL;
+
+   if(view->popup
+         && hamster_editor_open(view->editor, view->backend, id, &error))
+   {
+      gtk_widget_hide(view->treeview);
+      return;
+   }
+   if(error)
+   {
+      DBG("%s", error->message);
+      g_error_free(error);
+   }
+   hamster_backend_edit(view->backend, id, NULL);
+   if(!view->settings.donthide)
+      hview_popup_hide(view);
+}
+
+static void
+hview_cb_editor_done(HamsterEditorResult result, gint id, HamsterView *view)
+{
+   gtk_widget_show(view->treeview);
+   if(view->popup)
+      gtk_window_resize(GTK_WINDOW(view->popup), 1, 1);
+   if(result == HAMSTER_EDITOR_EXTERNAL)
+      hamster_backend_edit(view->backend, id, NULL);
+   /* FactsChanged only has the search look at today */
+   if(result == HAMSTER_EDITOR_SAVED && view->search)
+      hamster_search_update_range(view->search,
+            hamster_editor_get_day(view->editor),
+            hamster_editor_get_day(view->editor));
+   if(result != HAMSTER_EDITOR_CANCELLED && !view->settings.donthide)
+      hview_popup_hide(view);
+}
+
+static void
+hview_cb_add_earlier_activity(GtkWidget *widget, HamsterView *view)
+{
+   hview_fact_edit(view, 0);
+}
+
+static void
+hview_cb_autoswitch(const gchar *activity, HamsterView *view)
+{
+   DBG("autoswitched: %s", activity);
+   hview_switch_text(view, activity);
+}
+
+static void
+hview_cb_export(GtkWidget *widget, HamsterView *view)
+{
+   /* the file chooser takes the focus anyway */
+   hview_popup_hide(view);
+   export_show(NULL, view->settings.directreads, view->settings.standalone);
+}
+
+/* the index on disk misses them too, so it is opened here if need be */
+static void
+hview_cb_imported(time_t first, time_t last, HamsterView *view)
+{
+   if(!view->search)
+      view->search = hamster_search_new(view->settings.standalone);
+   hamster_search_update_range(view->search, first, last);
+}
+
+static void
+hview_cb_import(GtkWidget *widget, HamsterView *view)
+{
+   hview_popup_hide(view);
+   import_show(NULL, view->settings.directreads, view->settings.standalone,
+         view->imports, (ImportDone)hview_cb_imported, view);
+}
+
 static void
 hview_cb_tracking_settings(GtkWidget *widget, HamsterView *view)
 {
-   window_server_call_preferences_sync(view->windowserver, NULL, NULL);
-   if(!view->donthide)
+   hamster_backend_preferences(view->backend, NULL);
+   if(!view->settings.donthide)
       hview_popup_hide(view);
 }
 
@@ -167,7 +469,7 @@ hview_cb_popup_focus_out (GtkWidget *widget,
                     GdkEventFocus *event,
                     HamsterView *view)
 {
-   if(view->donthide)
+   if(view->settings.donthide)
       return FALSE;
    if(!view->sourceTimeout)
    {
@@ -183,16 +485,31 @@ hview_cb_match_select(GtkEntryCompletion *widget,
                      GtkTreeIter *iter,
                      HamsterView *view)
 {
-   char *activity, *category;
-   char fact[256];
-   int id = 0;
+   char *activity, *category, *fact;
+
+   if(view->tagging)
+   {
+      /* complete the tag in place and keep on typing */
+      const gchar *text = gtk_entry_get_text(GTK_ENTRY(view->entry));
+      const gchar *hash = strrchr(text, '#');
+      gchar *tag, *completed;
+
+      gtk_tree_model_get(model, iter, 0, &tag, -1);
+      completed = g_strdup_printf("%.*s%s ", (int)(hash - text + 1), text, tag);
+      gtk_entry_set_text(GTK_ENTRY(view->entry), completed);
+      gtk_editable_set_position(GTK_EDITABLE(view->entry), -1);
+      g_free(completed);
+      g_free(tag);
+      return TRUE;
+   }
 
    gtk_tree_model_get(model, iter, 0, &activity, 1, &category, -1);
-   snprintf(fact, sizeof(fact), "%s@%s", activity, category);
-   hamster_call_add_fact_sync(view->hamster, fact, 0, 0, FALSE, &id, NULL, NULL);
-   DBG("selected: %s[%d]", fact, id);
-   if(!view->donthide)
+   fact = g_strdup_printf("%s@%s", activity, category);
+   DBG("selected: %s", fact);
+   hview_switch_text(view, fact);
+   if(!view->settings.donthide)
       hview_popup_hide(view);
+   g_free(fact);
    g_free(activity);
    g_free(category);
    return FALSE;
@@ -202,39 +519,118 @@ static void
 hview_cb_entry_activate(GtkEntry *entry,
                   HamsterView *view)
 {
-   const char *fact = gtk_entry_get_text(GTK_ENTRY(view->entry));
-   int id = 0;
-   char buffer[256];
-   GVariant* res;
-   GVariant* child;
-   char* act = NULL;
-   char* cat = NULL;
+   const char *text = gtk_entry_get_text(GTK_ENTRY(view->entry));
+   fact_spec spec;
+   GError *error = NULL;
+
+   /* search results are resumed from the list */
+   if (*text == '?')
+      return;
 
-   if (!strchr(fact, '@'))
+   if (!fact_spec_parse(&spec, text, util_local_now(), &error))
    {
-      hamster_call_get_activities_sync(view->hamster, fact, &res, 0, 0);
-      if (NULL != res && g_variant_n_children(res) > 0)
-      {
-         child = g_variant_get_child_value(res, 0); // topmost in history is OK
-         if (child)
-         {
-            g_variant_get(child, "(ss)", &act, &cat);
-            if (NULL != act && NULL != cat)
-            {
-               snprintf(buffer, sizeof(buffer), "%s@%s", act, cat);
-               fact = buffer;
-            }
-            g_variant_unref(child);
-         }
-      }
+      /* the preview already says what's wrong, keep the text for fixing */
+      DBG("rejected: %s (%s)", text, error->message);
+      g_error_free(error);
+      gtk_widget_error_bell(view->entry);
+      return;
    }
-   
-   hamster_call_add_fact_sync(view->hamster, fact, 0, 0, FALSE, &id, NULL, NULL);
-   DBG("activated: %s[%d]", fact, id);
-   if(!view->donthide)
+
+   hview_switch(view, &spec);
+   fact_spec_clear(&spec);
+   if(!view->settings.donthide)
       hview_popup_hide(view);
 }
 
+/* completes tags instead of activities while a "#word" is being typed */
+static void
+hview_completion_tag_update(HamsterView *view, const gchar *text)
+{
+   const gchar *word = text + strlen(text);
+   gboolean tagging;
+
+   while(word > text && !g_ascii_isspace(word[-1]))
+      word--;
+   tagging = word > text && *word == '#';
+
+   g_free(view->tagPrefix);
+   view->tagPrefix = tagging ? g_utf8_casefold(word + 1, -1) : NULL;
+   if(tagging != view->tagging)
+   {
+      GtkEntryCompletion *completion = gtk_entry_get_completion(
+            GTK_ENTRY(view->entry));
+      view->tagging = tagging;
+      gtk_entry_completion_set_model(completion, GTK_TREE_MODEL(
+               tagging ? view->storeTags : view->storeActivities));
+      hview_completion_mode_update(view);
+   }
+}
+
+static gboolean
+hview_completion_match(GtkEntryCompletion *completion,
+                       const gchar *key,
+                       GtkTreeIter *iter,
+                       HamsterView *view)
+{
+   GtkTreeModel *model = gtk_entry_completion_get_model(completion);
+   gchar *item = NULL;
+   gboolean match;
+
+   /* both stores keep their search column casefolded already */
+   if(view->tagging)
+   {
+      gtk_tree_model_get(model, iter, 1, &item, -1);
+      match = item && g_str_has_prefix(item, view->tagPrefix);
+   }
+   else
+   {
+      gtk_tree_model_get(model, iter, 0, &item, -1);
+      match = item && g_str_has_prefix(item, key);
+   }
+   g_free(item);
+   return match;
+}
+
+static void
+hview_cb_entry_changed(GtkEditable *editable,
+                       HamsterView *view)
+{
+   const char *text = gtk_entry_get_text(GTK_ENTRY(view->entry));
+   GtkStyleContext *style = gtk_widget_get_style_context(view->preview);
+   fact_spec spec;
+   GError *error = NULL;
+
+   if (*text == '?')
+   {
+      hview_search_update(view, text + 1);
+      return;
+   }
+   hview_search_update(view, NULL);
+   hview_completion_tag_update(view, text);
+
+   if (!*text)
+   {
+      gtk_widget_hide(view->preview);
+      return;
+   }
+
+   if (fact_spec_parse(&spec, text, util_local_now(), &error))
+   {
+      gchar *line = fact_spec_describe(&spec);
+      gtk_label_set_text(GTK_LABEL(view->preview), line);
+      gtk_style_context_remove_class(style, GTK_STYLE_CLASS_ERROR);
+      g_free(line);
+      fact_spec_clear(&spec);
+   }
+   else
+   {
+      gtk_label_set_text(GTK_LABEL(view->preview), error->message);
+      gtk_style_context_add_class(style, GTK_STYLE_CLASS_ERROR);
+      g_error_free(error);
+   }
+   gtk_widget_show(view->preview);
+}
+
 static gboolean
 hview_cb_tv_query_tooltip(GtkWidget  *widget,
                gint        x,
@@ -243,7 +639,7 @@ hview_cb_tv_query_tooltip(GtkWidget  *widget,
                GtkTooltip *tooltip,
                HamsterView *view)
 {
-   if(view->tooltips)
+   if(view->settings.tooltips)
    {
       GtkTreePath *path;
       GtkTreeViewColumn *column;
@@ -282,28 +678,30 @@ hview_cb_tv_button_press(GtkWidget *tv,
             char* icon;
             char* fact;
             char* category;
+            char* tags;
             gtk_tree_model_get(model, &iter, 
                ID, &id, 
                BTNCONT, &icon, 
                TITLE, &fact, 
-               CATEGORY, &category, -1);
+               CATEGORY, &category,
+               TAGS, &tags, -1);
             DBG("%s:%s:%s", fact, category, icon);
             if(!strcmp(gtk_tree_view_column_get_title (column), "ed"))
             {
-               GVariant *dummy = g_variant_new_int32(id);
-               GVariant *var = g_variant_new_variant(dummy);
-               window_server_call_edit_sync(view->windowserver, var, NULL, NULL);
+               hview_fact_edit(view, id);
             }
             else if(!strcmp(gtk_tree_view_column_get_title(column), "ct") && !strcmp(icon, "gtk-media-play"))
             {
-               char fact_at_category[255];
-               snprintf(fact_at_category, sizeof(fact_at_category), "%s@%s", fact, category);
+               gchar *fact_at_category = g_strdup_printf(*tags ? "%s@%s %s" : "%s@%s",
+                     fact, category, tags);
                DBG("Resume %s", fact_at_category);
-               hamster_call_add_fact_sync(view->hamster, fact_at_category, 0, 0, FALSE, &id, NULL, NULL);
+               hview_switch_text(view, fact_at_category);
+               g_free(fact_at_category);
             }
             g_free(icon);
             g_free(fact);
             g_free(category);
+            g_free(tags);
          }
          gtk_tree_path_free(path);
       }
@@ -329,6 +727,27 @@ hview_cb_label_allocate( GtkWidget *label,
    }
 }
 
+/* prefill the entry with the free span, up to now means still running */
+static void
+hview_cb_gap_clicked(GtkWidget *timeline, gint start, gint end,
+                     HamsterView *view)
+{
+   gchar text[32];
+
+   if(!view->entry)
+      return;
+   if(end >= util_local_now() - 60)
+      snprintf(text, sizeof(text), "%02d:%02d ",
+            (start / 3600) % 24, (start / 60) % 60);
+   else
+      snprintf(text, sizeof(text), "%02d:%02d-%02d:%02d ",
+            (start / 3600) % 24, (start / 60) % 60,
+            (end / 3600) % 24, (end / 60) % 60);
+   gtk_entry_set_text(GTK_ENTRY(view->entry), text);
+   gtk_widget_grab_focus(view->entry);
+   gtk_editable_set_position(GTK_EDITABLE(view->entry), -1);
+}
+
 static gboolean
 hview_cb_key_pressed(GtkWidget *widget,
       GdkEventKey  *evt,
@@ -358,9 +777,7 @@ hview_cb_style_set(GtkWidget *widget, GtkStyle *previous, HamsterView *view)
 static void
 hview_popup_new(HamsterView *view)
 {
-   GtkWidget *frm, *lbl, *ovw, *stp, *add, *cfg;
-   GtkCellRenderer *renderer;
-   GtkTreeViewColumn *column;
+   GtkWidget *frm, *hbx, *lbl, *ovw, *stp, *add, *exp, *imp, *cfg;
    GtkEntryCompletion *completion;
 
    /* Create a new popup */
@@ -397,56 +814,55 @@ hview_popup_new(HamsterView *view)
                            G_CALLBACK(hview_cb_match_select), view);
    g_signal_connect(view->entry, "activate",
                            G_CALLBACK(hview_cb_entry_activate), view);
+   g_signal_connect(view->entry, "changed",
+                           G_CALLBACK(hview_cb_entry_changed), view);
    gtk_entry_completion_set_text_column(completion, 0);
+   gtk_entry_completion_set_match_func(completion,
+         (GtkEntryCompletionMatchFunc)hview_completion_match, view, NULL);
    gtk_entry_completion_set_model(completion, GTK_TREE_MODEL(view->storeActivities));
    gtk_container_add(GTK_CONTAINER(view->vbx), view->entry);
    gtk_entry_set_completion(GTK_ENTRY(view->entry), completion);
 
+   // what the entry will submit
+   view->preview = gtk_label_new(NULL);
+   gtk_widget_set_halign(view->preview, GTK_ALIGN_START);
+   gtk_label_set_ellipsize(GTK_LABEL(view->preview), PANGO_ELLIPSIZE_END);
+   gtk_style_context_add_class(gtk_widget_get_style_context(view->preview),
+         GTK_STYLE_CLASS_DIM_LABEL);
+   gtk_widget_set_no_show_all(view->preview, TRUE);
+   gtk_container_add(GTK_CONTAINER(view->vbx), view->preview);
+
+   // offer to resume after being away
+   view->resume = gtk_button_new_with_label("");
+   gtk_button_set_relief(GTK_BUTTON(view->resume), GTK_RELIEF_NONE);
+   gtk_widget_set_focus_on_click(view->resume, FALSE);
+   gtk_widget_set_no_show_all(view->resume, TRUE);
+   g_signal_connect(view->resume, "clicked",
+                           G_CALLBACK(hview_cb_resume), view);
+   gtk_container_add(GTK_CONTAINER(view->vbx), view->resume);
+
    // label
+   hbx = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+   gtk_widget_set_halign(hbx, GTK_ALIGN_CENTER);
    lbl = gtk_label_new(_("Today's activities"));
-   gtk_container_add(GTK_CONTAINER(view->vbx), lbl);
+   gtk_container_add(GTK_CONTAINER(hbx), lbl);
+   gtk_container_add(GTK_CONTAINER(hbx), view->spinner);
+   gtk_container_add(GTK_CONTAINER(view->vbx), hbx);
 
    // tree view
    view->treeview = gtk_tree_view_new_with_model(GTK_TREE_MODEL(view->storeFacts));
    gtk_widget_set_has_tooltip(view->treeview, TRUE);
-   gtk_tree_view_set_headers_visible(GTK_TREE_VIEW(view->treeview), FALSE);
-   gtk_tree_view_set_hover_selection(GTK_TREE_VIEW(view->treeview), TRUE);
-   gtk_widget_set_can_focus(view->treeview, FALSE);
-   gtk_tree_view_set_grid_lines(GTK_TREE_VIEW(view->treeview), GTK_TREE_VIEW_GRID_LINES_NONE);
    g_signal_connect(view->treeview, "query-tooltip",
                            G_CALLBACK(hview_cb_tv_query_tooltip), view);
    g_signal_connect(view->treeview, "button-release-event",
                            G_CALLBACK(hview_cb_tv_button_press), view);
-   renderer = gtk_cell_renderer_text_new ();
-   column = gtk_tree_view_column_new_with_attributes ("Time",
-                                                      renderer,
-                                                      "text", TIME_SPAN,
-                                                      NULL);
-   gtk_tree_view_append_column (GTK_TREE_VIEW (view->treeview), column);
-   column = gtk_tree_view_column_new_with_attributes ("Name",
-                                                      renderer,
-                                                      "text", TITLE,
-                                                      NULL);
-   gtk_tree_view_append_column (GTK_TREE_VIEW (view->treeview), column);
-   column = gtk_tree_view_column_new_with_attributes ("Duration",
-                                                      renderer,
-                                                      "text", DURATION,
-                                                      NULL);
-   gtk_tree_view_append_column (GTK_TREE_VIEW (view->treeview), column);
-   renderer = gtk_cell_renderer_pixbuf_new();
-   column = gtk_tree_view_column_new_with_attributes ("ed",
-                                                      renderer,
-                                                      "stock-id", BTNEDIT,
-                                                      NULL);
-   g_object_set_data(G_OBJECT(column), "tip", _("Edit activity"));
-   gtk_tree_view_append_column (GTK_TREE_VIEW (view->treeview), column);
-   column = gtk_tree_view_column_new_with_attributes ("ct",
-                                                      renderer,
-                                                      "stock-id", BTNCONT,
-                                                      NULL);
-   g_object_set_data(G_OBJECT(column), "tip", _("Resume activity"));
-   gtk_tree_view_append_column (GTK_TREE_VIEW (view->treeview), column);
+   fact_list_columns_add(GTK_TREE_VIEW(view->treeview));
    gtk_container_add(GTK_CONTAINER(view->vbx), view->treeview);
+   gtk_container_add(GTK_CONTAINER(view->vbx),
+         hamster_editor_get_widget(view->editor));
+
+   // timeline
+   gtk_container_add(GTK_CONTAINER(view->vbx), view->timeline);
 
    // summary
    gtk_widget_set_halign(view->summary, GTK_ALIGN_END);
@@ -479,6 +895,20 @@ hview_popup_new(HamsterView *view)
    g_signal_connect(add, "clicked",
                            G_CALLBACK(hview_cb_add_earlier_activity), view);
 
+   exp = gtk_button_new_with_label(_("Export..."));
+   gtk_widget_set_halign(gtk_bin_get_child(GTK_BIN(exp)), GTK_ALIGN_START);
+   gtk_button_set_relief(GTK_BUTTON(exp), GTK_RELIEF_NONE);
+   gtk_widget_set_focus_on_click(exp, FALSE);
+   g_signal_connect(exp, "clicked",
+                           G_CALLBACK(hview_cb_export), view);
+
+   imp = gtk_button_new_with_label(_("Import..."));
+   gtk_widget_set_halign(gtk_bin_get_child(GTK_BIN(imp)), GTK_ALIGN_START);
+   gtk_button_set_relief(GTK_BUTTON(imp), GTK_RELIEF_NONE);
+   gtk_widget_set_focus_on_click(imp, FALSE);
+   g_signal_connect(imp, "clicked",
+                           G_CALLBACK(hview_cb_import), view);
+
    cfg = gtk_button_new_with_label(_("Tracking settings"));
    gtk_widget_set_halign(gtk_bin_get_child(GTK_BIN(cfg)), GTK_ALIGN_START);
    gtk_button_set_relief(GTK_BUTTON(cfg), GTK_RELIEF_NONE);
@@ -489,9 +919,12 @@ hview_popup_new(HamsterView *view)
    gtk_box_pack_start(GTK_BOX(view->vbx), ovw, FALSE, FALSE, 0);
    gtk_box_pack_start(GTK_BOX(view->vbx), stp, FALSE, FALSE, 0);
    gtk_box_pack_start(GTK_BOX(view->vbx), add, FALSE, FALSE, 0);
+   gtk_box_pack_start(GTK_BOX(view->vbx), exp, FALSE, FALSE, 0);
+   gtk_box_pack_start(GTK_BOX(view->vbx), imp, FALSE, FALSE, 0);
    gtk_box_pack_start(GTK_BOX(view->vbx), cfg, FALSE, FALSE, 0);
 
    gtk_widget_show_all(view->popup);
+   hview_resume_update(view);
 
    g_signal_connect (G_OBJECT (view->popup),
                     "focus-out-event",
@@ -509,8 +942,9 @@ hview_completion_mode_update(HamsterView *view)
 {
    if(view->entry && gtk_widget_get_realized(view->entry))
    {
-      gboolean dropdown = xfconf_channel_get_bool(view->channel, XFPROP_DROPDOWN,
-            FALSE);
+      /* inline completion would replace the whole entry with a tag */
+      gboolean dropdown = view->tagging
+         || view->settings.dropdown;
       GtkEntryCompletion *completion = gtk_entry_get_completion(
             GTK_ENTRY(view->entry));
       gtk_entry_completion_set_inline_completion(completion, !dropdown);
@@ -518,40 +952,23 @@ hview_completion_mode_update(HamsterView *view)
    }
 }
 
-static void
-hview_autohide_mode_update(HamsterView *view)
-{
-   view->donthide = xfconf_channel_get_bool(view->channel, XFPROP_DONTHIDE,
-         FALSE);
-}
-
-static void
-hview_tooltips_mode_update(HamsterView *view)
-{
-   view->tooltips = xfconf_channel_get_bool(view->channel, XFPROP_TOOLTIPS,
-         TRUE);
-}
-
 /* Actions */
 void
 hview_popup_show(HamsterView *view, gboolean atPointer)
 {
    gint x = 0, y = 0;
 
+   hamster_latency_input(view->latency, HAMSTER_LATENCY_POPUP);
+
    /* check if popup is needed, or it needs an update */
    if (view->popup == NULL)
    {
       hview_popup_new(view);
       gtk_widget_realize(view->popup);
-
-      /* init properties from xfconf */
-      hview_autohide_mode_update(view);
-      hview_tooltips_mode_update(view);
-      hview_completion_mode_update(view);
    }
    else if(view->alive)
    {
-      if(view->donthide)
+      if(view->settings.donthide)
          gdk_window_raise(gtk_widget_get_window(view->popup));
       if(view->sourceTimeout)
       {
@@ -568,7 +985,6 @@ hview_popup_show(HamsterView *view, gboolean atPointer)
 
    /* honor settings */
    hview_completion_mode_update(view);
-   hview_tooltips_mode_update(view);
 
    /* popup popup */
    if(atPointer)
@@ -610,220 +1026,395 @@ hview_popup_show(HamsterView *view, gboolean atPointer)
          gtk_get_current_event_time());
    gtk_widget_add_events(view->popup, GDK_FOCUS_CHANGE_MASK|GDK_KEY_PRESS_MASK);
    xfce_panel_plugin_take_window(view->plugin, GTK_WINDOW(view->popup));
+   /* shown from the last model, nothing else to wait for */
+   hamster_latency_updated(view->latency, HAMSTER_LATENCY_POPUP, view->popup);
 }
 
-// Hours and minutes format when given INT_MAX produces "596523h 14min", but
-// "snprintf" reports max possible output size like below.
-const int HOURS_AND_MINUTES_MIN_LENGTH = 16;
+#define SEARCH_LIMIT 50
 
+/* "?words" in the entry lists matching facts from all of the history,
+ * NULL goes back to today's facts */
 static void
-hview_seconds_to_hours_and_minutes(gchar *duration, int length, int seconds)
+hview_search_update(HamsterView *view, const gchar *query)
 {
-  snprintf(duration, length,
-      "%dh %dmin", seconds / 3600, (seconds / 60) % 60);
+   GtkTreeView *tv = GTK_TREE_VIEW(view->treeview);
+   GtkStyleContext *style = gtk_widget_get_style_context(view->preview);
+   GPtrArray *hits;
+   gchar *status;
+   guint i;
+
+   if(!query)
+   {
+      if(gtk_tree_view_get_model(tv) != GTK_TREE_MODEL(view->storeFacts))
+      {
+         gtk_tree_view_set_model(tv, GTK_TREE_MODEL(view->storeFacts));
+         gtk_widget_set_sensitive(view->treeview,
+               gtk_tree_model_iter_n_children(GTK_TREE_MODEL(view->storeFacts), NULL) > 0);
+      }
+      return;
+   }
+
+   if(!view->search)
+      view->search = hamster_search_new(view->settings.standalone);
+   hits = hamster_search_query(view->search, query, SEARCH_LIMIT);
+   /* the rows take the facts */
+   g_ptr_array_set_free_func(hits, NULL);
+   gtk_list_store_clear(view->storeResults);
+   for(i = 0; i < hits->len; i++)
+   {
+      HamsterModelRow *row = hamster_model_row_new(g_ptr_array_index(hits, i), TRUE);
+      fact_list_store_append(view->storeResults, row);
+      hamster_model_row_free(row);
+   }
+   if(gtk_tree_view_get_model(tv) != GTK_TREE_MODEL(view->storeResults))
+      gtk_tree_view_set_model(tv, GTK_TREE_MODEL(view->storeResults));
+   gtk_widget_set_sensitive(view->treeview, hits->len > 0);
+
+   if(hamster_search_is_building(view->search))
+      status = g_strdup_printf(_("%u found so far, still indexing"), hits->len);
+   else
+      status = g_strdup_printf(_("%u found"), hits->len);
+   gtk_label_set_text(GTK_LABEL(view->preview), status);
+   gtk_style_context_remove_class(style, GTK_STYLE_CLASS_ERROR);
+   gtk_widget_show(view->preview);
+   g_free(status);
+   g_ptr_array_unref(hits);
 }
 
-static size_t
-hview_time_to_string(char *str, size_t maxsize, time_t time)
+/* the running fact's seconds differ on every tick, so today's facts are
+ * stored again only once refetched after a change, or on a new day */
+static gboolean
+hview_snapshot_due(HamsterView *view, HamsterModelPart part)
 {
-  struct tm *tm = gmtime(&time);
+   time_t day = util_local_now() / DAY_SECONDS;
 
-  return strftime(str, maxsize, "%H:%M", tm);
+   if(part != HAMSTER_MODEL_FACTS)
+      return TRUE;
+   if(view->snapshotStamp > view->changedStamp && view->snapshotDay == day)
+      return FALSE;
+   view->snapshotStamp = view->factsStamp;
+   view->snapshotDay = day;
+   return TRUE;
 }
 
-// Using less than that may cause output to be truncated.
-const int HVIEW_TIMES_TO_SPAN_MIN_BUF_SIZE = 14;
-
+/* takes res, which is also kept for the next start */
 static void
-hview_times_to_span(char *time_span, size_t maxsize, time_t start_time, time_t end_time)
+hview_model_push(HamsterView *view, HamsterModelPart part, GVariant *res)
 {
-   char *ptr = time_span;
-   size_t charsWritten;
-
-   charsWritten = hview_time_to_string(ptr, maxsize, start_time);
-   maxsize -= charsWritten;
-   ptr += charsWritten;
-
-   // snprintf() should never return negative value with static string like this.
-   int dataWritten = snprintf(ptr, maxsize, " - ");
-   maxsize -= dataWritten;
-   ptr += dataWritten;
-
-   if (end_time)
-    hview_time_to_string(ptr, maxsize, end_time);
+   hamster_model_builder_push(view->builder, part, res);
+   if(NULL != res)
+   {
+      if(hview_snapshot_due(view, part))
+         hamster_snapshot_set(view->snapshot, part, res);
+      g_variant_unref(res);
+   }
 }
 
-static gint*
-hview_create_category(gchar *category, GHashTable *categories)
+/* fetching stays here, parsing happens on the builder's thread */
+static void
+hview_completion_update(HamsterView *view)
 {
-  gint *duration_in_seconds = g_new0(gint, 1);
-  g_hash_table_insert(categories, strdup(category), duration_in_seconds);
-
-  return duration_in_seconds;
+   GVariant *res = NULL;
+   if(NULL != view->backend)
+      res = hamster_backend_get_activities(view->backend, "", NULL);
+   hview_model_push(view, HAMSTER_MODEL_ACTIVITIES, res);
 }
 
 static void
-hview_increment_category_time(gchar *category, gint duration_in_seconds, GHashTable *categories)
+hview_tags_update(HamsterView *view)
 {
-  gint *category_duration = g_hash_table_lookup(categories, category);
-  if(category_duration == NULL)
-  {
-    category_duration = hview_create_category(category, categories);
-  }
-
-  *category_duration += duration_in_seconds;
+   GVariant *res = NULL;
+   if(NULL != view->backend)
+      res = hamster_backend_get_tags(view->backend, TRUE, NULL);
+   hview_model_push(view, HAMSTER_MODEL_TAGS, res);
 }
 
-static gboolean
-hview_activity_stopped(fact *activity)
+static void
+hview_targets_update(HamsterView *view)
 {
-  if(activity->endTime)
-    return TRUE;
+   gchar *spec, **items, **item;
 
-  return FALSE;
+   view->target = (gint)(view->settings.target * 3600);
+   g_hash_table_remove_all(view->targets);
+   spec = g_strdup(view->settings.categorytargets);
+   items = g_strsplit(spec, ",", -1);
+   for(item = items; *item; item++)
+   {
+      gchar *eq = strchr(*item, '=');
+      gdouble hours;
+
+      if(!eq)
+         continue;
+      *eq = '\0';
+      hours = g_ascii_strtod(eq + 1, NULL);
+      if(hours > 0)
+         g_hash_table_insert(view->targets,
+               g_utf8_casefold(g_strstrip(*item), -1),
+               GINT_TO_POINTER((gint)(hours * 3600)));
+   }
+   g_strfreev(items);
+   g_free(spec);
 }
 
 static void
-hview_store_update(HamsterView *view, fact *activity, GHashTable *categories)
+hview_target_check(HamsterView *view, const gchar *category, gint seconds,
+                   gint target, gboolean quiet)
 {
-   if(NULL == view->storeFacts)
-      return;
-
-   gchar time_span[HVIEW_TIMES_TO_SPAN_MIN_BUF_SIZE];
-   hview_times_to_span(time_span, sizeof(time_span), activity->startTime, activity->endTime);
-
-   gchar duration[HOURS_AND_MINUTES_MIN_LENGTH];
-   hview_seconds_to_hours_and_minutes(duration, sizeof(duration), activity->seconds);
-
-   GtkTreeIter   iter;
-   gtk_list_store_append (view->storeFacts, &iter);  /* Acquire an iterator */
-   gtk_list_store_set (view->storeFacts, &iter,
-                       TIME_SPAN, time_span,
-                       TITLE, activity->name,
-                       DURATION, duration,
-                       BTNEDIT, "gtk-edit",
-                       BTNCONT, hview_activity_stopped(activity) ? "gtk-media-play" : "",
-                       ID, activity->id,
-                       CATEGORY, activity->category,
-                       -1);
+   gchar *body;
 
-   hview_increment_category_time(activity->category, activity->seconds, categories);
+   if(seconds < target)
+      return;
+   /* "" is a category too, the one of uncategorized facts */
+   if(category)
+   {
+      if(g_hash_table_contains(view->reached, category))
+         return;
+      g_hash_table_add(view->reached, g_strdup(category));
+   }
+   else
+   {
+      if(view->overallReached)
+         return;
+      view->overallReached = TRUE;
+   }
+   if(quiet)
+      return;
+   if(category)
+      body = g_strdup_printf(_("%s: %dh %dmin tracked today"),
+            category, seconds / 3600, (seconds / 60) % 60);
+   else
+      body = g_strdup_printf(_("%dh %dmin tracked today"),
+            seconds / 3600, (seconds / 60) % 60);
+   util_notify(_("Daily target reached"), body);
+   g_free(body);
 }
 
+/* from the per-category sums the summary uses, no extra calls */
 static void
-hview_summary_update(HamsterView *view, GHashTable *tbl)
+hview_progress_update(HamsterView *view, GHashTable *tbl, const gchar *running)
 {
    GHashTableIter iter;
-   GString *string = g_string_new("");
    gchar *cat;
    gint *sum;
-   guint count;
+   gint total = 0, shown = -1;
+   time_t day = util_local_now() / DAY_SECONDS;
+   /* targets already met when the plugin starts are not news */
+   gboolean quiet = view->reachedDay == 0;
 
+   if(day != view->reachedDay)
+   {
+      g_hash_table_remove_all(view->reached);
+      view->overallReached = FALSE;
+      view->reachedDay = day;
+   }
    if(tbl)
    {
-      count = g_hash_table_size(tbl);
       g_hash_table_iter_init(&iter, tbl);
       while(g_hash_table_iter_next(&iter, (gpointer)&cat, (gpointer)&sum))
       {
-         count--;
-         g_string_append_printf(string, count ? "%s: %dh %dmin, " : "%s: %dh %dmin",
-               cat, *sum / 3600, (*sum / 60) % 60);
+         gchar *key = g_utf8_casefold(cat, -1);
+         gint target = GPOINTER_TO_INT(g_hash_table_lookup(view->targets, key));
+         g_free(key);
+         total += *sum;
+         if(!target)
+            continue;
+         hview_target_check(view, cat, *sum, target, quiet);
+         if(running && !strcmp(cat, running))
+            shown = *sum * 100 / target;
       }
    }
-   else
+   if(view->target > 0)
    {
-      g_string_append(string, _("No activities yet."));
+      hview_target_check(view, NULL, total, view->target, quiet);
+      if(shown < 0)
+         shown = total * 100 / view->target;
    }
-   gtk_label_set_label(GTK_LABEL(view->summary), string->str);
-   g_string_free(string, TRUE);
+   places_button_set_progress(PLACES_BUTTON(view->button), shown);
 }
 
 static void
-hview_completion_update(HamsterView *view)
+hview_cb_todays_facts(GObject *source, GAsyncResult *result, HamsterView *view)
 {
-   GVariant *res;
-   if(NULL != view->storeActivities)
-      gtk_list_store_clear(view->storeActivities);
-   if(NULL != view->hamster)
+   GError *error = NULL;
+   GVariant *res = hamster_backend_get_todays_facts_finish(result, &error);
+
+   if(g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
    {
-      if(hamster_call_get_activities_sync(view->hamster, "", &res, NULL, NULL))
-      {
-         gsize count = 0;
-         if(NULL != res && (count = g_variant_n_children(res)))
-         {
-            gsize i;
-            for(i=0; i< count; i++)
-            {
-               GtkTreeIter iter;
-               GVariant *dbusAct = g_variant_get_child_value(res, i);
-               gchar *act, *cat, *actlow;
-               g_variant_get(dbusAct, "(ss)", &act, &cat);
-               actlow = g_utf8_casefold(act, -1);
-               gtk_list_store_append(view->storeActivities, &iter);
-               gtk_list_store_set(view->storeActivities, &iter,
-                     0, actlow, 1, cat, -1);
-               g_free(actlow);
-            }
-            g_variant_unref(res);
-         }
-      }
+      /* superseded by a newer request, or the view is gone */
+      g_error_free(error);
+      return;
+   }
+   g_clear_object(&view->revalidate);
+   if(error)
+   {
+      DBG("%s", error->message);
+      g_error_free(error);
+      view->factsStamp = 0;
    }
+   else
+      view->factsStamp = view->fetchStamp;
+   view->factsSwitches = view->fetchSwitches;
+   hview_model_push(view, HAMSTER_MODEL_FACTS, res);
 }
 
+/* fire and forget, only the newest request gets applied */
 static void
 hview_button_update(HamsterView *view)
 {
-   GVariant *res;
-   gsize count = 0;
-   gboolean ellipsize;
+   if(view->revalidate)
+   {
+      g_cancellable_cancel(view->revalidate);
+      g_object_unref(view->revalidate);
+   }
+   view->revalidate = g_cancellable_new();
+   view->fetchStamp = g_get_monotonic_time();
+   view->fetchSwitches = view->switchesSent;
+   hamster_backend_get_todays_facts_async(view->backend, view->revalidate,
+         (GAsyncReadyCallback)hview_cb_todays_facts, view);
+}
 
-   if(NULL != view->storeFacts)
-      gtk_list_store_clear(view->storeFacts);
-   if(NULL != view->hamster)
+static void
+hview_label_update(HamsterView *view)
+{
+   GError *error = NULL;
+
+   if(!hamster_label_compile(view->label, view->settings.label, &error))
    {
-      ellipsize = xfconf_channel_get_bool(view->channel, XFPROP_SANITIZE, FALSE);
-      places_button_set_ellipsize(PLACES_BUTTON(view->button), ellipsize);
+      g_warning("button label: %s", error->message);
+      g_error_free(error);
+      hamster_label_compile(view->label, HAMSTER_LABEL_DEFAULT, NULL);
+   }
+}
 
-      if(hamster_call_get_todays_facts_sync(view->hamster, &res, NULL, NULL))
-      {
-         if(NULL != res && (count = g_variant_n_children(res)))
-         {
-            gsize i;
-            GHashTable *tbl = g_hash_table_new(g_str_hash, g_str_equal);
-            gtk_widget_set_sensitive(view->treeview, TRUE);
-            for(i = 0; i < count; i++)
-            {
-               GVariant *dbusFact = g_variant_get_child_value(res, i);
-               fact *last = fact_new(dbusFact);
-               g_variant_unref(dbusFact);
-               hview_store_update(view, last, tbl);
-               if(last->id && i == count -1)
-               {
-                  hview_summary_update(view, tbl);
-                  if(0 == last->endTime)
-                  {
-                     gchar label[128];
-                     snprintf(label, sizeof(label), "%s %d:%02d",
-                           last->name,
-                           last->seconds / 3600,
-                           (last->seconds/60) % 60);
-                     places_button_set_label(PLACES_BUTTON(view->button), label);
-                     fact_free(last);
-                     g_hash_table_unref(tbl);
-                     return;
-                  }
-               }
-               fact_free(last);
-            }
-            g_hash_table_unref(tbl);
-         }
-      }
+/* Model swaps, only cheap store and widget updates from here on */
+static void
+hview_label_apply(HamsterView *view)
+{
+   const HamsterModelRow *running = view->facts ? view->facts->running : NULL;
+   HamsterLabelData data;
+   gint *categoryTotal;
+
+   places_button_set_ellipsize(PLACES_BUTTON(view->button),
+         view->settings.sanitize);
+   if(!running)
+   {
+      places_button_set_label(PLACES_BUTTON(view->button), _("inactive"));
+      return;
+   }
+   categoryTotal = g_hash_table_lookup(view->facts->categories,
+         running->fact->category);
+   data.activity = running->fact->name;
+   data.category = running->fact->category;
+   data.description = running->fact->description;
+   data.tags = running->hashtags;
+   data.elapsed = running->fact->seconds;
+   data.categoryTotal = categoryTotal ? *categoryTotal : 0;
+   data.dayTotal = view->facts->total;
+   places_button_set_label(PLACES_BUTTON(view->button),
+         hamster_label_format(view->label, &data,
+            view->settings.sanitize ? PLACES_BUTTON_MAX_CHARS : 0));
+}
+
+static void
+hview_facts_apply(HamsterView *view, HamsterModel *model)
+{
+   GtkTreeIter iter;
+   gboolean valid;
+   guint i;
+
+   hamster_model_free(view->facts);
+   view->facts = model;
+   if(!view->revalidate)
+   {
+      gtk_spinner_stop(GTK_SPINNER(view->spinner));
+      gtk_widget_hide(view->spinner);
+   }
+
+   /* patch rows in place so an open popup keeps its hover and size */
+   valid = gtk_tree_model_get_iter_first(GTK_TREE_MODEL(view->storeFacts), &iter);
+   hamster_timeline_clear(HAMSTER_TIMELINE(view->timeline));
+   for(i = 0; i < model->rows->len; i++)
+   {
+      const HamsterModelRow *row = g_ptr_array_index(model->rows, i);
+      if(!valid)
+         gtk_list_store_append(view->storeFacts, &iter);
+      fact_list_store_set(view->storeFacts, &iter, row);
+      if(valid)
+         valid = gtk_tree_model_iter_next(GTK_TREE_MODEL(view->storeFacts), &iter);
+      hamster_timeline_add(HAMSTER_TIMELINE(view->timeline), row->fact->id,
+            row->fact->startTime, row->fact->endTime, row->fact->name,
+            row->fact->category);
+   }
+   while(valid)
+      valid = gtk_list_store_remove(view->storeFacts, &iter);
+   hamster_timeline_commit(HAMSTER_TIMELINE(view->timeline), util_local_now());
+   gtk_label_set_label(GTK_LABEL(view->summary), model->summary);
+   hview_progress_update(view, model->rows->len ? model->categories : NULL,
+         model->running ? model->running->fact->category : NULL);
+
+   hview_label_apply(view);
+   if(model->running)
+   {
+      hamster_scheduler_set_running(view->scheduler,
+            model->running->fact->startTime);
+      hamster_autoswitch_set_running(view->autoswitch,
+            model->running->fact->name, model->running->fact->category);
+      /* resumed or replaced, by whatever means */
+      if(view->idleStopped
+            && model->running->fact->startTime > view->idleSince)
+         hview_resume_clear(view);
+   }
+   else
+   {
+      hamster_scheduler_set_running(view->scheduler, 0);
+      hamster_autoswitch_set_running(view->autoswitch, NULL, NULL);
+   }
+   hamster_latency_updated(view->latency, HAMSTER_LATENCY_SWITCH, view->button);
+   hamster_latency_updated(view->latency, HAMSTER_LATENCY_STOP, view->button);
+
+   if(gtk_tree_view_get_model(GTK_TREE_VIEW(view->treeview))
+         == GTK_TREE_MODEL(view->storeFacts))
+      gtk_widget_set_sensitive(view->treeview, model->rows->len > 0);
+   if(view->popup)
       gtk_window_resize(GTK_WINDOW(view->popup), 1, 1);
+}
+
+/* column 0 and 1 of the completion stores */
+static void
+hview_columns_apply(GtkListStore *store, HamsterModel *model)
+{
+   guint i;
+
+   gtk_list_store_clear(store);
+   for(i = 0; i + 1 < model->columns->len; i += 2)
+   {
+      GtkTreeIter iter;
+      gtk_list_store_append(store, &iter);
+      gtk_list_store_set(store, &iter,
+            0, g_ptr_array_index(model->columns, i),
+            1, g_ptr_array_index(model->columns, i + 1), -1);
    }
-   places_button_set_label(PLACES_BUTTON(view->button), _("inactive"));
-   if (!count)
-      hview_summary_update(view, NULL);
-   gtk_widget_set_sensitive(view->treeview, count > 0);
+   hamster_model_free(model);
+}
+
+static void
+hview_cb_model_ready(HamsterView *view)
+{
+   HamsterModel *model;
+
+   if((model = hamster_model_builder_take(view->builder, HAMSTER_MODEL_FACTS)))
+   {
+      /* asked before the last switch was sent, the guess is newer; the
+       * service answers in order, so later requests already have it */
+      if(view->factsSwitches < view->switchesSent)
+         hamster_model_free(model);
+      else
+         hview_facts_apply(view, model);
+   }
+   if((model = hamster_model_builder_take(view->builder, HAMSTER_MODEL_ACTIVITIES)))
+      hview_columns_apply(view->storeActivities, model);
+   if((model = hamster_model_builder_take(view->builder, HAMSTER_MODEL_TAGS)))
+      hview_columns_apply(view->storeTags, model);
 }
 
 static gboolean
@@ -847,24 +1438,69 @@ hview_cb_button_pressed(GtkWidget *widget, GdkEventButton *evt, HamsterView *vie
    {
       hview_cb_show_overview(NULL, view);
    }
-   hview_button_update(view);
+   /* the popup shows the last model right away; ask again only if
+    * something changed since that was requested */
+   if(!view->facts || view->factsStamp <= view->changedStamp)
+   {
+      hview_button_update(view);
+      gtk_widget_show(view->spinner);
+      gtk_spinner_start(GTK_SPINNER(view->spinner));
+   }
    return TRUE;
 }
 
-static gboolean
-hview_cb_hamster_changed(Hamster *hamster, HamsterView *view)
+static void
+hview_cb_hamster_changed(HamsterBackend *backend,
+                         HamsterBackendChange what,
+                         HamsterView *view)
 {
-   DBG("dbus-callback %p", view);
-   hview_button_update(view);
-   hview_completion_update(view);
-   return FALSE;
+   DBG("backend-callback %p", view);
+   if(what & HAMSTER_BACKEND_FACTS)
+      view->changedStamp = g_get_monotonic_time();
+   if(view->search && (what & HAMSTER_BACKEND_FACTS))
+      hamster_search_update_today(view->search);
+   if(what & (HAMSTER_BACKEND_FACTS | HAMSTER_BACKEND_ACTIVITIES))
+   {
+      hview_button_update(view);
+      hview_completion_update(view);
+   }
+   if(what & HAMSTER_BACKEND_TAGS)
+      hview_tags_update(view);
 }
 
-static gboolean
+static void
 hview_cb_cyclic(HamsterView *view)
 {
+   hamster_latency_set_wakeups(view->latency,
+         hamster_scheduler_get_wakeups(view->scheduler));
    hview_button_update(view);
-   return TRUE;
+}
+
+static void
+hview_cb_button_mapped(GtkWidget *widget, HamsterView *view)
+{
+   hamster_scheduler_set_visible(view->scheduler, gtk_widget_get_mapped(widget));
+}
+
+static void
+hview_backend_update(HamsterView *view)
+{
+   hamster_editor_close(view->editor);
+   /* nothing in flight may answer for the backend freed here */
+   g_cancellable_cancel(view->switches);
+   g_object_unref(view->switches);
+   view->switches = g_cancellable_new();
+   view->switching = 0;
+   if(view->revalidate)
+   {
+      g_cancellable_cancel(view->revalidate);
+      g_clear_object(&view->revalidate);
+   }
+   hamster_backend_free(view->backend);
+   view->backend = hamster_backend_new(view->settings.directreads,
+         view->settings.standalone);
+   hamster_backend_set_notify(view->backend,
+         (HamsterBackendNotify)hview_cb_hamster_changed, view);
 }
 
 static void
@@ -873,22 +1509,52 @@ hview_cb_channel(XfconfChannel *channel,
                  GValue        *value,
                  HamsterView   *view)
 {
-   DBG("%s=%d", property, g_value_get_boolean(value));
+   DBG("%s", property);
+   /* donthide and tooltips are read where used */
+   if(!settings_update(&view->settings, property, value))
+      return;
    if(!strcmp(property, XFPROP_DROPDOWN))
       hview_completion_mode_update(view);
-   else if(!strcmp(property, XFPROP_DONTHIDE))
-      hview_autohide_mode_update(view);
-   else if(!strcmp(property, XFPROP_TOOLTIPS))
-      hview_tooltips_mode_update(view);
    else if(!strcmp(property, XFPROP_SANITIZE))
+      hview_label_apply(view);
+   else if(!strcmp(property, XFPROP_LABEL))
+   {
+      hview_label_update(view);
+      hview_label_apply(view);
+   }
+   else if(!strcmp(property, XFPROP_TARGET)
+         || !strcmp(property, XFPROP_CATEGORYTARGETS))
+   {
+      hview_targets_update(view);
       hview_button_update(view);
-
+   }
+   else if(!strcmp(property, XFPROP_DIRECTREADS)
+         || !strcmp(property, XFPROP_STANDALONE))
+   {
+      /* the search reads through a backend of its own */
+      if(!strcmp(property, XFPROP_STANDALONE))
+      {
+         hamster_search_free(view->search);
+         view->search = NULL;
+      }
+      /* other facts, even without a change signal */
+      view->snapshotStamp = 0;
+      hview_backend_update(view);
+      hview_button_update(view);
+      hview_completion_update(view);
+      hview_tags_update(view);
+   }
+   else if(!strcmp(property, XFPROP_AUTOSWITCH))
+      hamster_autoswitch_set_rules(view->autoswitch, view->settings.autoswitch);
+   else if(!strcmp(property, XFPROP_IDLESTOP))
+      hamster_idle_set_timeout(view->idle, (guint)(view->settings.idlestop * 60));
 }
 
 HamsterView*
 hamster_view_init(XfcePanelPlugin* plugin)
 {
    HamsterView *view;
+   HamsterModelPart part;
 
    g_assert(plugin != NULL);
 
@@ -900,8 +1566,33 @@ hamster_view_init(XfcePanelPlugin* plugin)
 
    DBG("init GUI");
 
+   view->latency = hamster_latency_new();
+   view->switches = g_cancellable_new();
+   view->imports = g_cancellable_new();
+
+   /* replies are parsed off the GTK thread */
+   view->builder = hamster_model_builder_new(
+         (HamsterModelReady)hview_cb_model_ready, view);
+
+   /* last session's replies until the daemon answered */
+   view->snapshot = hamster_snapshot_new();
+   for(part = 0; part < HAMSTER_MODEL_PARTS; part++)
+   {
+      GVariant *res = hamster_snapshot_get(view->snapshot, part);
+      if(NULL != res)
+         hamster_model_builder_push(view->builder, part, res);
+   }
+
+   /* refresh only while someone can see it */
+   view->scheduler = hamster_scheduler_new((HamsterSchedulerTick)hview_cb_cyclic,
+                                           view);
+
    /* create the button */
    view->button = g_object_ref(places_button_new(view->plugin));
+   g_signal_connect(view->button, "map",
+                            G_CALLBACK(hview_cb_button_mapped), view);
+   g_signal_connect(view->button, "unmap",
+                            G_CALLBACK(hview_cb_button_mapped), view);
    xfce_panel_plugin_add_action_widget(view->plugin, view->button);
    gtk_container_add(GTK_CONTAINER(view->plugin), view->button);
    gtk_widget_show(view->button);
@@ -910,46 +1601,43 @@ hamster_view_init(XfcePanelPlugin* plugin)
    g_signal_connect(view->button, "button-press-event",
                             G_CALLBACK(hview_cb_button_pressed), view);
 
-   g_timeout_add_seconds(60, (GSourceFunc)hview_cb_cyclic, view);
-
-   /* remote control */
-   view->hamster = hamster_proxy_new_for_bus_sync
-         (
-                     G_BUS_TYPE_SESSION,
-                     G_DBUS_PROXY_FLAGS_NONE,
-                     "org.gnome.Hamster",             /* bus name */
-                     "/org/gnome/Hamster",            /* object */
-                     NULL,                            /* GCancellable* */
-                     NULL);
-
-   g_signal_connect(view->hamster, "facts-changed",
-                            G_CALLBACK(hview_cb_hamster_changed), view);
-   g_signal_connect(view->hamster, "activities-changed",
-                            G_CALLBACK(hview_cb_hamster_changed), view);
-
-   view->windowserver = window_server_proxy_new_for_bus_sync
-         (
-               G_BUS_TYPE_SESSION,
-               G_DBUS_PROXY_FLAGS_NONE,
-               "org.gnome.Hamster.WindowServer",      /* bus name */
-               "/org/gnome/Hamster/WindowServer",     /* object */
-               NULL,                                  /* GCancellable* */
-               NULL);
-
    /* storage */
    view->storeActivities = gtk_list_store_new(2, G_TYPE_STRING, G_TYPE_STRING);
-   view->storeFacts = gtk_list_store_new(NUM_COL, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING,
-         G_TYPE_STRING, G_TYPE_STRING, G_TYPE_INT, G_TYPE_STRING);
+   view->storeTags = gtk_list_store_new(2, G_TYPE_STRING, G_TYPE_STRING);
+   view->storeFacts = fact_list_store_new();
+   view->storeResults = fact_list_store_new();
    view->summary = gtk_label_new(NULL);
    view->treeview = gtk_tree_view_new();
+   view->timeline = hamster_timeline_new();
+   view->editor = hamster_editor_new((HamsterEditorDone)hview_cb_editor_done,
+                                     view);
+   view->spinner = gtk_spinner_new();
+   gtk_widget_set_no_show_all(view->spinner, TRUE);
+   g_signal_connect(view->timeline, "gap-clicked",
+                        G_CALLBACK(hview_cb_gap_clicked), view);
 
    /* config */
    view->channel = xfce_panel_plugin_xfconf_channel_new(view->plugin);
+   settings_load(&view->settings, view->channel);
+   view->label = hamster_label_new();
+   hview_label_update(view);
    g_signal_connect(view->channel, "property-changed",
                         G_CALLBACK(hview_cb_channel), view);
    g_signal_connect(view->plugin, "configure-plugin",
                         G_CALLBACK(config_show), view->channel);
    xfce_panel_plugin_menu_show_configure(view->plugin);
+   view->targets = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+   view->reached = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+   hview_targets_update(view);
+   view->autoswitch = hamster_autoswitch_new(
+         (HamsterAutoSwitchFire)hview_cb_autoswitch, view);
+   hamster_autoswitch_set_rules(view->autoswitch, view->settings.autoswitch);
+   view->idle = hamster_idle_new((HamsterIdleNotify)hview_cb_idle, view);
+   if(!hamster_idle_set_timeout(view->idle, (guint)(view->settings.idlestop * 60)))
+      g_warning("idle time is unknown, not stopping when away");
+
+   /* remote control */
+   hview_backend_update(view);
 
    /* time helpers */
    tzset();
@@ -957,6 +1645,7 @@ hamster_view_init(XfcePanelPlugin* plugin)
    /* liftoff */
    hview_button_update(view);
    hview_completion_update(view);
+   hview_tags_update(view);
 
    DBG("done");
 
@@ -966,6 +1655,34 @@ hamster_view_init(XfcePanelPlugin* plugin)
 void
 hamster_view_finalize(HamsterView* view)
 {
+   if(view->revalidate)
+   {
+      g_cancellable_cancel(view->revalidate);
+      g_object_unref(view->revalidate);
+   }
+   hamster_latency_set_wakeups(view->latency,
+         hamster_scheduler_get_wakeups(view->scheduler));
+   hamster_scheduler_free(view->scheduler);
+   hamster_model_builder_free(view->builder);
+   hamster_latency_dump(view->latency);
+   hamster_latency_free(view->latency);
+   hamster_snapshot_free(view->snapshot);
+   hamster_editor_free(view->editor);
+   hamster_autoswitch_free(view->autoswitch);
+   hamster_idle_free(view->idle);
+   g_cancellable_cancel(view->switches);
+   g_object_unref(view->switches);
+   g_cancellable_cancel(view->imports);
+   g_object_unref(view->imports);
+   hamster_label_free(view->label);
+   hamster_model_free(view->facts);
+   hamster_search_free(view->search);
+   hamster_backend_free(view->backend);
+   g_hash_table_unref(view->targets);
+   g_hash_table_unref(view->reached);
+   settings_clear(&view->settings);
+   g_free(view->tagPrefix);
+   g_free(view->idleStopped);
    g_free(view);
 }
 